@@ -38,6 +38,10 @@ limitations under the License.
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/util/tensor_bundle/naming.h"
 
+#ifndef IS_MOBILE_PLATFORM
+#include "tensorflow/cc/saved_model/subgraph_dedup.h"
+#endif  // IS_MOBILE_PLATFORM
+
 namespace tensorflow {
 namespace {
 
@@ -235,6 +239,22 @@ Status RunRestore(const RunOptions& run_options, const string& export_dir,
                  nullptr /* outputs */, &run_metadata, session);
 }
 
+// Merges the functions and subgraphs of the MetaGraphDef shared by several
+// signatures, before the session is created and optimizes them.
+Status DedupSubgraphs(const string& export_dir, MetaGraphDef* meta_graph_def) {
+#ifdef IS_MOBILE_PLATFORM
+  return Status::OK();
+#else
+  const uint64 start_microseconds = Env::Default()->NowMicros();
+  TF_RETURN_IF_ERROR(internal::DedupFunctionLibrary(meta_graph_def));
+  TF_RETURN_IF_ERROR(
+      internal::DedupSignatureSubgraphs(export_dir, meta_graph_def));
+  load_latency_by_stage->GetCell(export_dir, "dedup_graph")
+      ->Add(GetLatencyMicroseconds(start_microseconds));
+  return Status::OK();
+#endif  // IS_MOBILE_PLATFORM
+}
+
 }  // namespace
 
 SavedModelBundleInterface::~SavedModelBundleInterface() {}
@@ -258,6 +278,9 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
                                                     &bundle->meta_graph_def));
   TF_RETURN_IF_ERROR(
       ReadSavedModelDebugInfoIfPresent(export_dir, &bundle->debug_info));
+  if (session_options.config.experimental().dedup_saved_model_subgraphs()) {
+    TF_RETURN_IF_ERROR(DedupSubgraphs(export_dir, &bundle->meta_graph_def));
+  }
   TF_RETURN_IF_ERROR(LoadMetagraphIntoSession(
       session_options, bundle->meta_graph_def, &bundle->session));
   TF_RETURN_IF_ERROR(RestoreSession(run_options, bundle->meta_graph_def,
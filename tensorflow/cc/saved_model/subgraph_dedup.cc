@@ -0,0 +1,242 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/saved_model/subgraph_dedup.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/cc/saved_model/loader_util.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/common_subgraph_elimination.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/protobuf/saved_object_graph.pb.h"
+
+namespace tensorflow {
+namespace internal {
+namespace {
+
+void AddTensorNames(const TensorInfo& tensor_info,
+                    std::vector<string>* tensor_names) {
+  switch (tensor_info.encoding_case()) {
+    case TensorInfo::kName:
+      tensor_names->push_back(tensor_info.name());
+      break;
+    case TensorInfo::kCooSparse:
+      tensor_names->push_back(tensor_info.coo_sparse().values_tensor_name());
+      tensor_names->push_back(tensor_info.coo_sparse().indices_tensor_name());
+      tensor_names->push_back(
+          tensor_info.coo_sparse().dense_shape_tensor_name());
+      break;
+    case TensorInfo::kCompositeTensor:
+      for (const TensorInfo& component :
+           tensor_info.composite_tensor().components()) {
+        AddTensorNames(component, tensor_names);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Maps merged functions to the function replacing them.
+using FunctionRenames = absl::flat_hash_map<string, string>;
+
+const string& FunctionRename(const FunctionRenames& renames,
+                             const string& name) {
+  const string* renamed = &name;
+  for (auto it = renames.find(*renamed); it != renames.end();
+       it = renames.find(*renamed)) {
+    renamed = &it->second;
+  }
+  return *renamed;
+}
+
+void RenameFunctions(const FunctionRenames& renames, AttrValue* attr) {
+  if (attr->has_func()) {
+    NameAttrList* func = attr->mutable_func();
+    func->set_name(FunctionRename(renames, func->name()));
+    for (auto& nested : *func->mutable_attr()) {
+      RenameFunctions(renames, &nested.second);
+    }
+  } else if (attr->has_list()) {
+    for (NameAttrList& func : *attr->mutable_list()->mutable_func()) {
+      func.set_name(FunctionRename(renames, func.name()));
+      for (auto& nested : *func.mutable_attr()) {
+        RenameFunctions(renames, &nested.second);
+      }
+    }
+  }
+}
+
+void RenameFunctions(const FunctionRenames& renames, NodeDef* node) {
+  node->set_op(FunctionRename(renames, node->op()));
+  for (auto& attr : *node->mutable_attr()) {
+    RenameFunctions(renames, &attr.second);
+  }
+}
+
+// Adds the names of the functions referenced by `object_graph_def` to
+// `function_names`.
+void AddObjectGraphFunctions(const SavedObjectGraph& object_graph_def,
+                             absl::flat_hash_set<string>* function_names) {
+  for (const auto& concrete_function : object_graph_def.concrete_functions()) {
+    function_names->insert(concrete_function.first);
+  }
+  for (const SavedObject& object : object_graph_def.nodes()) {
+    if (object.has_function()) {
+      for (const string& name : object.function().concrete_functions()) {
+        function_names->insert(name);
+      }
+    } else if (object.has_bare_concrete_function()) {
+      function_names->insert(
+          object.bare_concrete_function().concrete_function_name());
+    }
+  }
+}
+
+}  // namespace
+
+Status DedupSignatureSubgraphs(const string& export_dir,
+                               MetaGraphDef* meta_graph_def) {
+  grappler::GrapplerItem item;
+  item.id = export_dir;
+  for (const auto& signature : meta_graph_def->signature_def()) {
+    std::vector<string> inputs;
+    for (const auto& input : signature.second.inputs()) {
+      AddTensorNames(input.second, &inputs);
+    }
+    for (const string& input : inputs) {
+      item.feed.emplace_back(input, Tensor());
+    }
+    for (const auto& output : signature.second.outputs()) {
+      AddTensorNames(output.second, &item.fetch);
+    }
+  }
+  string init_op_name;
+  TF_RETURN_IF_ERROR(GetInitOp(export_dir, *meta_graph_def, &init_op_name));
+  if (!init_op_name.empty()) item.init_ops.push_back(init_op_name);
+  if (meta_graph_def->has_saver_def()) {
+    const SaverDef& saver_def = meta_graph_def->saver_def();
+    item.save_op = saver_def.save_tensor_name();
+    item.restore_op = saver_def.restore_op_name();
+    item.save_restore_loc_tensor = saver_def.filename_tensor_name();
+  }
+  std::vector<AssetFileDef> asset_file_defs;
+  TF_RETURN_IF_ERROR(GetAssetFileDefs(*meta_graph_def, &asset_file_defs));
+  for (const AssetFileDef& asset_file_def : asset_file_defs) {
+    item.keep_ops.push_back(asset_file_def.tensor_info().name());
+  }
+  for (const auto& collection : meta_graph_def->collection_def()) {
+    for (const string& name : collection.second.node_list().value()) {
+      item.keep_ops.push_back(name);
+    }
+  }
+  if (item.fetch.empty()) {
+    // Without fetches, duplicated nodes would be rewired but not removed.
+    return Status::OK();
+  }
+
+  GraphDef* graph_def = meta_graph_def->mutable_graph_def();
+  const int num_nodes = graph_def->node_size();
+  item.graph.Swap(graph_def);
+  grappler::CommonSubgraphElimination optimizer(RewriterConfig::ON);
+  TF_RETURN_IF_ERROR(optimizer.Optimize(/*cluster=*/nullptr, item, graph_def));
+  LOG(INFO) << "Merged " << num_nodes - graph_def->node_size()
+            << " duplicated nodes shared by the signatures of SavedModel "
+               "bundle at path: "
+            << export_dir;
+  return Status::OK();
+}
+
+Status DedupFunctionLibrary(MetaGraphDef* meta_graph_def) {
+  GraphDef* graph_def = meta_graph_def->mutable_graph_def();
+  FunctionDefLibrary* library = graph_def->mutable_library();
+  absl::flat_hash_set<string> with_gradients;
+  for (const GradientDef& gradient : library->gradient()) {
+    with_gradients.insert(gradient.function_name());
+    with_gradients.insert(gradient.gradient_func());
+  }
+
+  // Merging functions can make their callers identical, so this runs until no
+  // more functions are merged. Stateful functions are never merged: two copies
+  // of a stateful body may be meant to own distinct state (e.g. resources
+  // created with an empty shared_name), or to run separately in the same step.
+  FunctionRenames renames;
+  for (bool merged = true; merged;) {
+    merged = false;
+    // Functions keyed by their serialized body.
+    absl::flat_hash_map<string, string> functions;
+    for (const FunctionDef& function : library->function()) {
+      const string& name = function.signature().name();
+      if (with_gradients.contains(name) || renames.contains(name) ||
+          function.signature().is_stateful()) {
+        continue;
+      }
+      FunctionDef body = function;
+      body.mutable_signature()->clear_name();
+      string key;
+      if (!SerializeToStringDeterministic(body, &key)) {
+        return errors::Internal("Failed to serialize function ", name);
+      }
+      auto inserted = functions.emplace(std::move(key), name);
+      if (!inserted.second) {
+        renames[name] = inserted.first->second;
+        merged = true;
+      }
+    }
+    if (!merged) break;
+    for (NodeDef& node : *graph_def->mutable_node()) {
+      RenameFunctions(renames, &node);
+    }
+    for (FunctionDef& function : *library->mutable_function()) {
+      for (NodeDef& node : *function.mutable_node_def()) {
+        RenameFunctions(renames, &node);
+      }
+    }
+  }
+  if (renames.empty()) return Status::OK();
+
+  // The object graph of a TF2 SavedModel names the functions to restore, and
+  // their signatures may differ even if their bodies are identical, so those
+  // functions stay in the library. They have no callers left in the graph, so
+  // the function runtime still only instantiates the remaining copies.
+  absl::flat_hash_set<string> object_graph_functions;
+  AddObjectGraphFunctions(meta_graph_def->object_graph_def(),
+                          &object_graph_functions);
+  auto* functions = library->mutable_function();
+  functions->erase(
+      std::remove_if(functions->begin(), functions->end(),
+                     [&](const FunctionDef& function) {
+                       const string& name = function.signature().name();
+                       return renames.contains(name) &&
+                              !object_graph_functions.contains(name);
+                     }),
+      functions->end());
+  LOG(INFO) << "Merged " << renames.size() << " functions with identical "
+            << "bodies.";
+  return Status::OK();
+}
+
+}  // namespace internal
+}  // namespace tensorflow
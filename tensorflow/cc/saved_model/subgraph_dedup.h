@@ -0,0 +1,48 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CC_SAVED_MODEL_SUBGRAPH_DEDUP_H_
+#define TENSORFLOW_CC_SAVED_MODEL_SUBGRAPH_DEDUP_H_
+
+#include <string>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+
+namespace tensorflow {
+namespace internal {
+
+// Merges the identical subgraphs of the graph of `meta_graph_def`, typically
+// towers shared by several signatures, so that they are only optimized and
+// executed once. The tensors named in the signatures, the init op, the saver,
+// the assets and the nodes of the collections are preserved; other nodes may
+// be merged with an identical node and removed.
+Status DedupSignatureSubgraphs(const string& export_dir,
+                               MetaGraphDef* meta_graph_def);
+
+// Merges the functions of the library of the graph of `meta_graph_def` with
+// identical bodies, and points all their call sites (in the graph and in the
+// other functions) to the remaining copy, so that each distinct body is only
+// instantiated once by the function runtime. Stateful functions and functions
+// with a registered gradient are kept as is. Functions referenced by the
+// object graph are kept in the library for it, but their call sites are
+// redirected all the same.
+Status DedupFunctionLibrary(MetaGraphDef* meta_graph_def);
+
+}  // namespace internal
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CC_SAVED_MODEL_SUBGRAPH_DEDUP_H_
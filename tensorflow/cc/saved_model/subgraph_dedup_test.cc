@@ -0,0 +1,164 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/saved_model/subgraph_dedup.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow/core/protobuf/saved_object_graph.pb.h"
+
+namespace tensorflow {
+namespace internal {
+namespace {
+
+using test::function::NDef;
+
+FunctionDef Renamed(FunctionDef function, const string& name) {
+  function.mutable_signature()->set_name(name);
+  return function;
+}
+
+const NodeDef* FindNode(const GraphDef& graph, const string& name) {
+  for (const NodeDef& node : graph.node()) {
+    if (node.name() == name) return &node;
+  }
+  return nullptr;
+}
+
+TEST(SubgraphDedupTest, DedupFunctionLibrary) {
+  // XTimesFourCopy only becomes identical to XTimesFour once XTimesTwoCopy is
+  // merged into XTimesTwo.
+  FunctionDef x_times_four_copy =
+      Renamed(test::function::XTimesFour(), "XTimesFourCopy");
+  for (NodeDef& node : *x_times_four_copy.mutable_node_def()) {
+    if (node.op() == "XTimesTwo") node.set_op("XTimesTwoCopy");
+  }
+  AttrValue f;
+  f.mutable_func()->set_name("XTimesTwoCopy");
+
+  MetaGraphDef meta_graph_def;
+  *meta_graph_def.mutable_graph_def() = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("y", "XTimesFourCopy", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("z", "PartitionedCall", {"x"},
+            {{"Tin", DataTypeSlice{DT_FLOAT}},
+             {"Tout", DataTypeSlice{DT_FLOAT}},
+             {"f", f}})},
+      {test::function::XTimesTwo(), test::function::XTimesFour(),
+       Renamed(test::function::XTimesTwo(), "XTimesTwoCopy"),
+       x_times_four_copy});
+
+  TF_ASSERT_OK(DedupFunctionLibrary(&meta_graph_def));
+
+  const GraphDef& graph = meta_graph_def.graph_def();
+  ASSERT_EQ(graph.library().function_size(), 2);
+  EXPECT_EQ(graph.library().function(0).signature().name(), "XTimesTwo");
+  EXPECT_EQ(graph.library().function(1).signature().name(), "XTimesFour");
+  EXPECT_EQ(FindNode(graph, "y")->op(), "XTimesFour");
+  EXPECT_EQ(FindNode(graph, "z")->attr().at("f").func().name(), "XTimesTwo");
+}
+
+TEST(SubgraphDedupTest, DedupFunctionLibraryKeepsGradients) {
+  MetaGraphDef meta_graph_def;
+  GraphDef& graph = *meta_graph_def.mutable_graph_def();
+  graph = test::function::GDef(
+      {}, {test::function::XTimesTwo(),
+           Renamed(test::function::XTimesTwo(), "XTimesTwoCopy")});
+  GradientDef* gradient = graph.mutable_library()->add_gradient();
+  gradient->set_function_name("XTimesTwoCopy");
+  gradient->set_gradient_func("XTimesTwo");
+
+  TF_ASSERT_OK(DedupFunctionLibrary(&meta_graph_def));
+  EXPECT_EQ(graph.library().function_size(), 2);
+}
+
+TEST(SubgraphDedupTest, DedupFunctionLibraryKeepsStatefulFunctions) {
+  FunctionDef stateful = test::function::XTimesTwo();
+  stateful.mutable_signature()->set_is_stateful(true);
+  MetaGraphDef meta_graph_def;
+  GraphDef& graph = *meta_graph_def.mutable_graph_def();
+  graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("y", "XTimesTwoCopy", {"x"}, {{"T", DT_FLOAT}})},
+      {stateful, Renamed(stateful, "XTimesTwoCopy")});
+
+  TF_ASSERT_OK(DedupFunctionLibrary(&meta_graph_def));
+
+  EXPECT_EQ(graph.library().function_size(), 2);
+  EXPECT_EQ(FindNode(graph, "y")->op(), "XTimesTwoCopy");
+}
+
+TEST(SubgraphDedupTest, DedupFunctionLibraryKeepsObjectGraphFunctions) {
+  MetaGraphDef meta_graph_def;
+  GraphDef& graph = *meta_graph_def.mutable_graph_def();
+  graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("y", "XTimesTwoCopy", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("z", "XTimesFourCopy", {"x"}, {{"T", DT_FLOAT}})},
+      {test::function::XTimesTwo(), test::function::XTimesFour(),
+       Renamed(test::function::XTimesTwo(), "XTimesTwoCopy"),
+       Renamed(test::function::XTimesFour(), "XTimesFourCopy")});
+  // A tf.function restored from both copies, and a bare concrete function.
+  SavedObjectGraph& object_graph = *meta_graph_def.mutable_object_graph_def();
+  (*object_graph.mutable_concrete_functions())["XTimesTwoCopy"];
+  object_graph.add_nodes()->mutable_function()->add_concrete_functions(
+      "XTimesTwoCopy");
+  object_graph.add_nodes()
+      ->mutable_bare_concrete_function()
+      ->set_concrete_function_name("XTimesFourCopy");
+
+  TF_ASSERT_OK(DedupFunctionLibrary(&meta_graph_def));
+
+  // The copies stay in the library for the object graph, but are not called.
+  ASSERT_EQ(graph.library().function_size(), 4);
+  EXPECT_EQ(FindNode(graph, "y")->op(), "XTimesTwo");
+  EXPECT_EQ(FindNode(graph, "z")->op(), "XTimesFour");
+}
+
+TEST(SubgraphDedupTest, DedupSignatureSubgraphs) {
+  const Tensor two = test::AsScalar<float>(2.0f);
+  MetaGraphDef meta_graph_def;
+  // Both signatures compute x * 2 with their own copy of the tower.
+  *meta_graph_def.mutable_graph_def() = test::function::GDef({
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+      NDef("a/two", "Const", {}, {{"dtype", DT_FLOAT}, {"value", two}}),
+      NDef("a/mul", "Mul", {"x", "a/two"}, {{"T", DT_FLOAT}}),
+      NDef("a/out", "Identity", {"a/mul"}, {{"T", DT_FLOAT}}),
+      NDef("b/two", "Const", {}, {{"dtype", DT_FLOAT}, {"value", two}}),
+      NDef("b/mul", "Mul", {"x", "b/two"}, {{"T", DT_FLOAT}}),
+      NDef("b/out", "Identity", {"b/mul"}, {{"T", DT_FLOAT}}),
+  });
+  for (const string& name : {"a", "b"}) {
+    SignatureDef& signature = (*meta_graph_def.mutable_signature_def())[name];
+    (*signature.mutable_inputs())["x"].set_name("x:0");
+    (*signature.mutable_outputs())["y"].set_name(name + "/out:0");
+  }
+
+  TF_ASSERT_OK(DedupSignatureSubgraphs("/export_dir", &meta_graph_def));
+
+  const GraphDef& graph = meta_graph_def.graph_def();
+  EXPECT_EQ(graph.node_size(), 5);
+  ASSERT_NE(FindNode(graph, "a/out"), nullptr);
+  ASSERT_NE(FindNode(graph, "b/out"), nullptr);
+  EXPECT_EQ(FindNode(graph, "a/out")->input(0),
+            FindNode(graph, "b/out")->input(0));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace tensorflow
@@ -776,6 +776,11 @@ Status GraphExecutionState::OptimizeGraph(
 
     // Convert Graph to GraphDef and add it to the GrapplerItem.
     graph_->ToGraphDef(&item.graph);
+    // The NodeDef devices are the ones assigned by the placer, keep track of
+    // the ones that were requested.
+    for (const Node* node : graph_->op_nodes()) {
+      item.requested_devices[node->name()] = node->requested_device();
+    }
     // TODO(b/114748242): Add a unit test to test this bug fix.
     if (flib_def_) {
       *item.graph.mutable_library() = flib_def_->ToProto();
@@ -55,7 +55,7 @@ constexpr char kJournalDir[] = "tf_data_dispatcher_journal";
 // The name of the datasets directory inside the dispatcher's working directory.
 constexpr char kDatasetsDir[] = "datasets";
 
-constexpr std::array<const char*, 8> kNodeNameSharingOps = {
+constexpr std::array<const char*, 9> kNodeNameSharingOps = {
     "HashTable",
     "HashTableV2",
     "MutableHashTable",
@@ -64,6 +64,7 @@ constexpr std::array<const char*, 8> kNodeNameSharingOps = {
     "MutableDenseHashTableV2",
     "MutableHashTableOfTensors",
     "MutableHashTableOfTensorsV2",
+    "MutableEvictingHashTable",
 };
 
 using Dataset = DispatcherState::Dataset;
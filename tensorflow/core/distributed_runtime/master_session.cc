@@ -46,18 +46,23 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -421,9 +426,135 @@ void MasterSession::ReffedClientGraph::TrackFeedsAndFetches(
   }
 }
 
+// Returns the directory caching partitioned graphs across sessions and
+// processes, or an empty string if the cache is disabled.
+static string PartitionCacheDir() {
+  string cache_dir;
+  Status s = ReadStringFromEnvVar("TF_MASTER_PARTITION_CACHE_DIR", "",
+                                  &cache_dir);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring the partition cache directory: " << s;
+    return "";
+  }
+  return cache_dir;
+}
+
+// Returns the name of the cache entry holding the partitions of
+// "client_graph".  The placed graph and its function library are fingerprinted
+// together with the options and the TensorFlow version the partitions depend
+// on.  Device incarnations are not part of the key: they are restored by
+// ReadCachedPartitions().
+//
+// Since the key is computed from the placed graph, the cache only saves the
+// partitioning: placement still runs for every new session, while building
+// its GraphExecutionState.
+static string PartitionCacheKey(const ClientGraph& client_graph,
+                                const PartitionOptions& popts,
+                                const SessionOptions& session_opts) {
+  GraphDef graph_def;
+  client_graph.graph.ToGraphDef(&graph_def);
+  *graph_def.mutable_library() = client_graph.flib_def->ToProto();
+  string serialized;
+  SerializeToStringDeterministic(graph_def, &serialized);
+  const string options = strings::StrCat(
+      TF_VERSION_STRING, "/", TF_GRAPH_DEF_VERSION, "/",
+      popts.scheduling_for_recvs, popts.need_to_record_start_times,
+      session_opts.config.graph_options().enable_bfloat16_sendrecv());
+  return strings::StrCat(
+      strings::FpToString(
+          FingerprintCat64(Fingerprint64(serialized), Fingerprint64(options))),
+      ".pb");
+}
+
+// Reads the partitions stored in the cache entry "path", and sets the
+// incarnations of their Send/Recv nodes to the current device incarnations.
+// An entry is a RunMetadata file listing the partitions in partition_graphs.
+static Status ReadCachedPartitions(
+    const string& path, const PartitionOptions& popts,
+    std::unordered_map<string, GraphDef>* partitions) {
+  RunMetadata entry;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(Env::Default(), path, &entry));
+  partitions->clear();
+  for (GraphDef& graph_def : *entry.mutable_partition_graphs()) {
+    if (graph_def.node_size() == 0) {
+      return errors::DataLoss("Empty partition in ", path);
+    }
+    // All nodes of a partition are placed on the same task.
+    string task;
+    string device;
+    if (!DeviceNameUtils::SplitDeviceName(graph_def.node(0).device(), &task,
+                                          &device)) {
+      return errors::DataLoss("Invalid device in ", path, ": ",
+                              graph_def.node(0).device());
+    }
+    auto set_incarnation = [&popts](NodeDef* ndef) {
+      if (ndef->op() != "_Send" && ndef->op() != "_Recv") return;
+      const string& send_device = GetNodeAttrString(*ndef, "send_device");
+      if (send_device.empty()) return;
+      SetAttrValue(static_cast<int64>(popts.get_incarnation(send_device)),
+                   &(*ndef->mutable_attr())["send_device_incarnation"]);
+    };
+    for (NodeDef& ndef : *graph_def.mutable_node()) {
+      set_incarnation(&ndef);
+    }
+    for (FunctionDef& fdef :
+         *graph_def.mutable_library()->mutable_function()) {
+      for (NodeDef& ndef : *fdef.mutable_node_def()) {
+        set_incarnation(&ndef);
+      }
+    }
+    if (!partitions->emplace(task, std::move(graph_def)).second) {
+      return errors::DataLoss("Duplicate partition for ", task, " in ", path);
+    }
+  }
+  if (partitions->empty()) {
+    return errors::DataLoss("No partitions in ", path);
+  }
+  return Status::OK();
+}
+
+// Writes "partitions" to the cache entry "path".  The entry is a single file,
+// written under a temporary name first and then renamed, so that concurrent
+// readers and writers never observe a partially written entry.  Renaming a
+// file is atomic on local file systems, and on object stores such as GCS and
+// S3 the renamed object only becomes visible once it is complete.
+static Status WriteCachedPartitions(
+    const string& path,
+    const std::unordered_map<string, GraphDef>& partitions) {
+  Env* env = Env::Default();
+  RunMetadata entry;
+  for (const auto& name_def : partitions) {
+    *entry.add_partition_graphs() = name_def.second;
+  }
+  const string tmp_path =
+      strings::StrCat(path, ".tmp", strings::FpToString(random::New64()));
+  Status s = WriteBinaryProto(env, tmp_path, entry);
+  if (s.ok()) s = env->RenameFile(tmp_path, path);
+  if (!s.ok()) env->DeleteFile(tmp_path).IgnoreError();
+  return s;
+}
+
 Status MasterSession::ReffedClientGraph::DoBuildPartitions(
     PartitionOptions popts, ClientGraph* client_graph,
     std::unordered_map<string, GraphDef>* out_partitions) {
+  // Partitioning large graphs is expensive, so the partitions are reused
+  // across sessions and restarts of the master when a cache is configured.
+  const string cache_dir = PartitionCacheDir();
+  string cache_path;
+  if (!cache_dir.empty()) {
+    cache_path = io::JoinPath(
+        cache_dir, PartitionCacheKey(*client_graph, popts, session_opts_));
+    if (Env::Default()->FileExists(cache_path).ok()) {
+      Status s = ReadCachedPartitions(cache_path, popts, out_partitions);
+      if (s.ok()) {
+        VLOG(1) << "Read cached partitions from " << cache_path;
+        return Status::OK();
+      }
+      LOG(WARNING) << "Ignoring the cached partitions in " << cache_path
+                   << ": " << s;
+    }
+  }
+
   if (popts.need_to_record_start_times) {
     CostModel cost_model(true);
     cost_model.InitFromGraph(client_graph->graph);
@@ -434,7 +565,15 @@ Status MasterSession::ReffedClientGraph::DoBuildPartitions(
   }
 
   // Partition the graph.
-  return Partition(popts, &client_graph->graph, out_partitions);
+  TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, out_partitions));
+
+  if (!cache_path.empty()) {
+    Status s = WriteCachedPartitions(cache_path, *out_partitions);
+    if (!s.ok()) {
+      VLOG(1) << "Failed to cache partitions in " << cache_path << ": " << s;
+    }
+  }
+  return Status::OK();
 }
 
 Status MasterSession::ReffedClientGraph::DoRegisterPartitions(
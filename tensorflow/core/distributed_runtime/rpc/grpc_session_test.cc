@@ -23,11 +23,14 @@ limitations under the License.
 #include "tensorflow/core/graph/default_device.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/util/port.h"
@@ -626,6 +629,71 @@ TEST(GrpcSessionTest, SendRecv_Node_Naming) {
   TF_CHECK_OK(session->Close());
 }
 
+TEST(GrpcSessionTest, PartitionCache) {
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "grpc_session_partition_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(cache_dir));
+  // The servers of the test cluster inherit the environment.
+  setenv("TF_MASTER_PARTITION_CACHE_DIR", cache_dir.c_str(), 1);
+
+  // The second cluster reuses the partitions cached by the first one, whose
+  // Send/Recv nodes refer to the device incarnations of the first cluster.
+  // The value of the constant is changed in the cached partitions in between,
+  // so the second cluster only fetches the new value if it skipped
+  // partitioning.
+  for (int restart = 0; restart < 2; ++restart) {
+    std::unique_ptr<test::TestCluster> cluster;
+    TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+    std::unique_ptr<Session> session(
+        NewRemote(Options(cluster->targets()[0], 1)));
+    ASSERT_TRUE(session != nullptr);
+
+    Graph graph(OpRegistry::Global());
+    Tensor a_tensor(DT_FLOAT, TensorShape({1, 1}));
+    a_tensor.flat<float>()(0) = 100;
+    Node* a = test::graph::Constant(&graph, a_tensor);
+    Node* b = test::graph::Identity(&graph, a);
+    GraphDef def;
+    test::graph::ToGraphDef(&graph, &def);
+    SetDevice(&def, a->name(), cluster->devices()[0].name());
+    SetDevice(&def, b->name(), cluster->devices()[1].name());
+    TF_CHECK_OK(session->Create(def));
+
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {b->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], restart == 0 ? 100 : 200);
+    TF_CHECK_OK(session->Close());
+
+    std::vector<string> entries;
+    TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+    ASSERT_EQ(1, entries.size());
+    if (restart > 0) continue;
+
+    const string entry_path = io::JoinPath(cache_dir, entries[0]);
+    RunMetadata entry;
+    TF_ASSERT_OK(ReadBinaryProto(Env::Default(), entry_path, &entry));
+    int num_constants = 0;
+    for (GraphDef& partition : *entry.mutable_partition_graphs()) {
+      for (NodeDef& node : *partition.mutable_node()) {
+        if (node.name() != a->name()) continue;
+        Tensor value(DT_FLOAT, TensorShape({1, 1}));
+        value.flat<float>()(0) = 200;
+        value.AsProtoTensorContent(
+            (*node.mutable_attr())["value"].mutable_tensor());
+        ++num_constants;
+      }
+    }
+    ASSERT_EQ(1, num_constants);
+    TF_ASSERT_OK(WriteBinaryProto(Env::Default(), entry_path, entry));
+  }
+  unsetenv("TF_MASTER_PARTITION_CACHE_DIR");
+}
+
 TEST(GrpcSessionTest, Error) {
   std::unique_ptr<test::TestCluster> cluster;
   TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
@@ -144,6 +144,12 @@ auto* build_graph_time_usecs = monitoring::Counter<0>::New(
     "spent optimizing the graph with Grappler, and time spent pruning the "
     "sub-graph.");
 
+auto* grappler_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/grappler_cache_lookups",
+    "The number of lookups in the Grappler optimization cache, by result "
+    "(hit or miss).",
+    "result");
+
 auto* xla_compilations = monitoring::Counter<0>::New(
     "/tensorflow/core/xla_compilations",
     "The number of XLA compilations used to collect "
@@ -282,6 +288,12 @@ void UpdateGrapplerPassTime(const string& pass_name,
   }
 }
 
+void RecordGrapplerCacheLookup(bool hit) {
+  static auto* hit_cell = grappler_cache_lookups->GetCell("hit");
+  static auto* miss_cell = grappler_cache_lookups->GetCell("miss");
+  (hit ? hit_cell : miss_cell)->IncrementBy(1);
+}
+
 void UpdateGraphBuildTime(const uint64 running_time_usecs) {
   if (running_time_usecs > 0) {
     static auto* build_graph_calls_cell = build_graph_calls->GetCell();
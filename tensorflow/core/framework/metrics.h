@@ -124,6 +124,10 @@ void UpdateGraphOptimizationPassTime(const string& pass_name,
 void UpdateGrapplerPassTime(const string& pass_name,
                             const uint64 running_time_usecs);
 
+// Records a lookup in the Grappler optimization cache, which hit if `hit` is
+// true.
+void RecordGrapplerCacheLookup(bool hit);
+
 // Updates the metrics stored about time XLA spents compiling graphs.
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.pb.h"  // NOLINT
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/graph/types.h"
+#include "tensorflow/core/grappler/costs/calibrated_op_level_cost_estimator.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/grappler/costs/utils.h"
@@ -111,7 +112,7 @@ AnalyticalCostEstimator::AnalyticalCostEstimator(
     Cluster* cluster, bool use_static_shapes,
     bool use_aggressive_shape_inference)
     : AnalyticalCostEstimator(
-          cluster, absl::make_unique<OpLevelCostEstimator>(),
+          cluster, CreateOpLevelCostEstimator(),
           ReadyNodeManagerFactory("FirstReady"), use_static_shapes,
           use_aggressive_shape_inference) {}
 
@@ -0,0 +1,447 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/calibrated_op_level_cost_estimator.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/lib/core/bits.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kMeasuredNodeName[] = "op";
+// Constant inputs of measured ops with up to this many elements are kept.
+constexpr int64 kMaxConstantInputElements = 16;
+
+string CostTableKey(const OpInfo& op_info) {
+  const DataType dtype =
+      op_info.inputs_size() > 0 ? op_info.inputs(0).dtype() : DT_INVALID;
+  return strings::StrCat(op_info.op(), "/", op_info.device().type(), "/",
+                         DataTypeString(dtype));
+}
+
+// Returns the total number of elements of the inputs of the op, or -1 if the
+// shape of any input is not fully defined.
+int64 NumInputElements(const OpInfo& op_info) {
+  int64 num_elements = 0;
+  for (const auto& input : op_info.inputs()) {
+    if (input.shape().unknown_rank()) return -1;
+    int64 input_elements = 1;
+    for (const auto& dim : input.shape().dim()) {
+      if (dim.size() < 0) return -1;
+      input_elements *= dim.size();
+    }
+    num_elements += input_elements;
+  }
+  return num_elements;
+}
+
+// Returns the measured execution time of the op in nanoseconds.
+double MeasuredTimeNs(const OpPerformance& perf) {
+  if (perf.execution_time_case() == OpPerformance::kExecutionTimeNormal) {
+    return perf.execution_time_normal().mu();
+  }
+  // compute_cost is converted from the microseconds of a CostGraphDef, so 0
+  // means that the op took less than a microsecond rather than no time.
+  return std::max<double>(perf.compute_cost(), 500);
+}
+
+// Returns the execution time in nanoseconds of the node named `node_name` in
+// `step_stats`, or -1 if the node did not run. Unlike the cost graph, which
+// has a granularity of a microsecond, this resolves small ops.
+double NodeExecutionTimeNs(const StepStats& step_stats,
+                           const string& node_name) {
+  for (const auto& dev_stats : step_stats.dev_stats()) {
+    for (const auto& node_stats : dev_stats.node_stats()) {
+      if (node_stats.node_name() != node_name) continue;
+      return node_stats.op_end_rel_nanos() - node_stats.op_start_rel_nanos();
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+CalibratedOpLevelCostEstimator::CalibratedOpLevelCostEstimator(
+    const OpPerformanceList& measurements) {
+  AddMeasurements(measurements);
+}
+
+void CalibratedOpLevelCostEstimator::AddMeasurements(
+    const OpPerformanceList& measurements) {
+  auto tables = tables_ == nullptr ? std::make_shared<CostTables>()
+                                   : std::make_shared<CostTables>(*tables_);
+  for (const OpPerformance& perf : measurements.op_performance()) {
+    const int64 num_elements = NumInputElements(perf.op());
+    const double time_ns = MeasuredTimeNs(perf);
+    if (num_elements < 0 || time_ns <= 0) continue;
+    Bucket& bucket = (*tables)[CostTableKey(perf.op())]
+                              [Log2Floor64(std::max<int64>(num_elements, 1))];
+    bucket.num_elements += num_elements;
+    bucket.time_ns += time_ns;
+    bucket.count++;
+  }
+  tables_ = std::move(tables);
+}
+
+const CalibratedOpLevelCostEstimator::CostTable*
+CalibratedOpLevelCostEstimator::FindTable(const OpInfo& op_info) const {
+  if (tables_ == nullptr) return nullptr;
+  auto it = tables_->find(CostTableKey(op_info));
+  return it == tables_->end() ? nullptr : &it->second;
+}
+
+bool CalibratedOpLevelCostEstimator::IsCalibrated(const OpInfo& op_info) const {
+  return FindTable(op_info) != nullptr && NumInputElements(op_info) >= 0;
+}
+
+Costs CalibratedOpLevelCostEstimator::PredictCosts(
+    const OpContext& op_context) const {
+  Costs costs = OpLevelCostEstimator::PredictCosts(op_context);
+  const CostTable* table = FindTable(op_context.op_info);
+  const int64 num_elements = NumInputElements(op_context.op_info);
+  if (table == nullptr || num_elements < 0) {
+    return costs;
+  }
+
+  // Find the average measurements on both sides of `num_elements`.
+  const double x = std::max<double>(num_elements, 1);
+  double lower_x = 0, lower_time = 0, upper_x = 0, upper_time = 0;
+  for (const auto& it : *table) {
+    const double bucket_x = it.second.num_elements / it.second.count;
+    const double bucket_time = it.second.time_ns / it.second.count;
+    if (bucket_x <= x || lower_x == 0) {
+      lower_x = bucket_x;
+      lower_time = bucket_time;
+    }
+    if (bucket_x >= x) {
+      upper_x = bucket_x;
+      upper_time = bucket_time;
+      break;
+    }
+  }
+
+  double time_ns;
+  if (upper_x == 0) {
+    // Larger than all the measurements: extrapolate linearly.
+    time_ns = lower_time * x / std::max(lower_x, 1.0);
+  } else if (x <= lower_x || upper_x <= lower_x) {
+    // Smaller than all the measurements, or an exact match.
+    time_ns = upper_time;
+  } else {
+    const double t = (std::log(x) - std::log(std::max(lower_x, 1.0))) /
+                     (std::log(upper_x) - std::log(std::max(lower_x, 1.0)));
+    time_ns = std::exp(std::log(lower_time) +
+                       t * (std::log(upper_time) - std::log(lower_time)));
+  }
+
+  VLOG(1) << "Operation " << op_context.op_info.op() << " takes " << time_ns
+          << " ns according to calibration, vs "
+          << costs.execution_time.count() << " ns estimated.";
+  costs.compute_time = Costs::NanoSeconds(time_ns);
+  costs.memory_time = Costs::Duration::zero();
+  costs.intermediate_memory_time = Costs::Duration::zero();
+  costs.intermediate_memory_read_time = Costs::Duration::zero();
+  costs.intermediate_memory_write_time = Costs::Duration::zero();
+  costs.execution_time = costs.compute_time;
+  costs.inaccurate = false;
+  return costs;
+}
+
+std::unique_ptr<OpLevelCostEstimator> CreateOpLevelCostEstimator(
+    const string& cost_table_path) {
+  string path = cost_table_path;
+  if (path.empty()) {
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_GRAPPLER_OP_COST_TABLE", "", &path));
+  }
+  if (path.empty()) {
+    return absl::make_unique<OpLevelCostEstimator>();
+  }
+
+  // The returned estimators are copies of the one loaded for each path, which
+  // share its tables. Paths that failed to load map to nullptr, so that they
+  // are only reported once.
+  static mutex mu(LINKER_INITIALIZED);
+  static auto* calibrated =
+      new absl::flat_hash_map<string,
+                              std::unique_ptr<CalibratedOpLevelCostEstimator>>;
+  mutex_lock l(mu);
+  auto it = calibrated->find(path);
+  if (it == calibrated->end()) {
+    std::unique_ptr<CalibratedOpLevelCostEstimator> estimator;
+    OpPerformanceList measurements;
+    const Status status =
+        ReadTextOrBinaryProto(Env::Default(), path, &measurements);
+    if (status.ok()) {
+      VLOG(1) << "Read " << measurements.op_performance_size()
+              << " op cost measurements from " << path;
+      estimator = absl::make_unique<CalibratedOpLevelCostEstimator>(
+          measurements);
+    } else {
+      LOG(WARNING) << "Failed to read op cost table " << path << ": "
+                   << status;
+    }
+    it = calibrated->emplace(path, std::move(estimator)).first;
+  }
+  if (it->second == nullptr) {
+    return absl::make_unique<OpLevelCostEstimator>();
+  }
+  return absl::make_unique<CalibratedOpLevelCostEstimator>(*it->second);
+}
+
+Status CollectOpsToMeasure(const GrapplerItem& item,
+                           std::vector<OpInfo>* ops) {
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(
+      /*assume_valid_feeds=*/false,
+      /*aggressive_shape_inference=*/false,
+      /*include_input_tensor_values=*/true,
+      /*include_output_tensor_values=*/false));
+
+  std::unordered_map<string, const NodeDef*> name_to_node;
+  for (const NodeDef& node : item.graph.node()) {
+    name_to_node[node.name()] = &node;
+  }
+  absl::flat_hash_set<string> seen;
+  for (const NodeDef& node : item.graph.node()) {
+    if (node.input_size() == 0 || IsStateful(node) || IsControlFlow(node)) {
+      continue;
+    }
+    const auto& inputs = properties.GetInputProperties(node.name());
+    if (inputs.empty()) continue;
+    bool measurable = true;
+    for (const auto& input : inputs) {
+      if (input.dtype() == DT_RESOURCE || IsRefType(input.dtype()) ||
+          (!input.has_value() &&
+           !PartialTensorShape(input.shape()).IsFullyDefined())) {
+        measurable = false;
+        break;
+      }
+    }
+    for (const auto& output : properties.GetOutputProperties(node.name())) {
+      if (output.dtype() == DT_RESOURCE || IsRefType(output.dtype())) {
+        measurable = false;
+      }
+    }
+    if (!measurable) continue;
+
+    OpInfo op_info = BuildOpInfoWithoutDevice(node, name_to_node, inputs);
+    // Only small constant inputs, such as axes or shapes, can change the cost
+    // of an op. Others are measured from their shape only.
+    for (auto& input : *op_info.mutable_inputs()) {
+      if (input.has_value() &&
+          PartialTensorShape(input.shape()).num_elements() >
+              kMaxConstantInputElements) {
+        input.clear_value();
+      }
+    }
+    string key;
+    if (!SerializeToStringDeterministic(op_info, &key)) {
+      return errors::Internal("Failed to serialize the OpInfo of ",
+                              node.name());
+    }
+    if (seen.insert(std::move(key)).second) {
+      ops->push_back(std::move(op_info));
+    }
+  }
+  return Status::OK();
+}
+
+Status MeasureOpCosts(Cluster* cluster, const std::vector<OpInfo>& ops,
+                      int num_steps, OpPerformanceList* measurements) {
+  if (num_steps <= 0) {
+    return errors::InvalidArgument("num_steps must be positive: ", num_steps);
+  }
+  for (const OpInfo& op_info : ops) {
+    GrapplerItem item;
+    item.id = op_info.op();
+    NodeDef* node = item.graph.add_node();
+    node->set_name(kMeasuredNodeName);
+    node->set_op(op_info.op());
+    *node->mutable_attr() = op_info.attr();
+    for (int i = 0; i < op_info.inputs_size(); ++i) {
+      const OpInfo::TensorProperties& input = op_info.inputs(i);
+      Tensor value;
+      if (input.has_value()) {
+        if (!value.FromProto(input.value())) {
+          return errors::InvalidArgument("Invalid value for input ", i,
+                                         " of ", op_info.op());
+        }
+      } else {
+        const PartialTensorShape shape(input.shape());
+        TensorShape full_shape;
+        if (!shape.AsTensorShape(&full_shape)) {
+          return errors::InvalidArgument("Input ", i, " of ", op_info.op(),
+                                         " must have a fully defined shape: ",
+                                         shape.DebugString());
+        }
+        value = Tensor(input.dtype(), full_shape);
+        if (DataTypeCanUseMemcpy(input.dtype())) {
+          std::memset(const_cast<char*>(value.tensor_data().data()), 0,
+                      value.tensor_data().size());
+        }
+      }
+
+      NodeDef* placeholder = item.graph.add_node();
+      placeholder->set_name(strings::StrCat("input_", i));
+      placeholder->set_op("Placeholder");
+      (*placeholder->mutable_attr())["dtype"].set_type(value.dtype());
+      value.shape().AsProto(
+          (*placeholder->mutable_attr())["shape"].mutable_shape());
+      node->add_input(placeholder->name());
+      item.feed.emplace_back(placeholder->name(), value);
+    }
+    item.fetch.push_back(node->name());
+
+    TF_RETURN_IF_ERROR(cluster->Initialize(item));
+    OpPerformance measured;
+    double sum = 0, sum_squares = 0;
+    int count = 0;
+    // The first step warms up the session and is not representative.
+    for (int step = -1; step < num_steps; ++step) {
+      RunMetadata metadata;
+      TF_RETURN_IF_ERROR(cluster->Run(item, &metadata));
+      if (step < 0) continue;
+      const OpPerformanceList perf =
+          CostGraphToOpPerformanceData(metadata.cost_graph(), item.graph);
+      for (const OpPerformance& op_perf : perf.op_performance()) {
+        if (op_perf.node() != kMeasuredNodeName) continue;
+        measured = op_perf;
+        double time_ns =
+            NodeExecutionTimeNs(metadata.step_stats(), kMeasuredNodeName);
+        if (time_ns < 0) time_ns = op_perf.compute_cost();
+        // Never record a measured op as free, even if it ran below the
+        // resolution of the clock.
+        time_ns = std::max(time_ns, 1.0);
+        sum += time_ns;
+        sum_squares += time_ns * time_ns;
+        ++count;
+      }
+    }
+    if (count == 0) {
+      return errors::Unavailable("No cost was measured for ", op_info.op());
+    }
+
+    const double mean = sum / count;
+    OpPerformance* perf = measurements->add_op_performance();
+    perf->set_node(op_info.op());
+    *perf->mutable_op() = op_info;
+    *perf->mutable_op()->mutable_device() = measured.op().device();
+    perf->set_compute_cost(mean);
+    perf->set_compute_time(mean);
+    perf->mutable_execution_time_normal()->set_mu(mean);
+    perf->mutable_execution_time_normal()->set_sigma(
+        std::sqrt(std::max(0.0, sum_squares / count - mean * mean)));
+    *perf->mutable_op_memory() = measured.op_memory();
+  }
+  return Status::OK();
+}
+
+std::vector<OpInfo> ScaleOpInputs(const OpInfo& op_info,
+                                  const std::vector<int>& inputs_to_scale,
+                                  int num_buckets) {
+  std::vector<OpInfo> scaled_ops;
+  scaled_ops.reserve(num_buckets);
+  for (int i = -num_buckets / 2; i < num_buckets - num_buckets / 2; ++i) {
+    OpInfo scaled = op_info;
+    for (int input_index : inputs_to_scale) {
+      if (input_index < 0 || input_index >= scaled.inputs_size()) continue;
+      auto* input = scaled.mutable_inputs(input_index);
+      if (input->has_value() || input->shape().dim_size() == 0) continue;
+      auto* dim = input->mutable_shape()->mutable_dim(0);
+      if (dim->size() <= 0) continue;
+      dim->set_size(i < 0 ? std::max<int64>(dim->size() >> -i, 1)
+                          : dim->size() << i);
+    }
+    scaled.clear_outputs();
+    scaled_ops.push_back(std::move(scaled));
+  }
+  return scaled_ops;
+}
+
+string CostModelAccuracyReport(const OpLevelCostEstimator& estimator,
+                               const OpPerformanceList& measurements) {
+  struct Stats {
+    int64 count = 0;
+    double measured_ns = 0;
+    double predicted_ns = 0;
+    double relative_error = 0;
+  };
+  std::map<string, Stats> stats;
+  Stats total;
+  for (const OpPerformance& perf : measurements.op_performance()) {
+    const double measured_ns = MeasuredTimeNs(perf);
+    if (measured_ns <= 0) continue;
+    OpContext op_context;
+    op_context.name = perf.node();
+    op_context.op_info = perf.op();
+    const double predicted_ns =
+        estimator.PredictCosts(op_context).execution_time.count();
+    const double relative_error =
+        std::abs(predicted_ns - measured_ns) / measured_ns;
+    for (Stats* s : {&stats[perf.op().op()], &total}) {
+      s->count++;
+      s->measured_ns += measured_ns;
+      s->predicted_ns += predicted_ns;
+      s->relative_error += relative_error;
+    }
+  }
+
+  string report = strings::Printf("%-32s %8s %16s %16s %12s\n", "Op", "Count",
+                                  "Measured (us)", "Predicted (us)",
+                                  "Rel. error");
+  auto append_row = [&report](const string& name, const Stats& s) {
+    strings::Appendf(&report, "%-32s %8lld %16.3f %16.3f %12.3f\n",
+                     name.c_str(), static_cast<long long>(s.count),
+                     s.measured_ns / s.count / 1e3,
+                     s.predicted_ns / s.count / 1e3,
+                     s.relative_error / s.count);
+  };
+  for (const auto& it : stats) {
+    append_row(it.first, it.second);
+  }
+  if (total.count > 0) {
+    append_row("(all)", total);
+  }
+  return report;
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,117 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_CALIBRATED_OP_LEVEL_COST_ESTIMATOR_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_CALIBRATED_OP_LEVEL_COST_ESTIMATOR_H_
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace grappler {
+
+class Cluster;
+struct GrapplerItem;
+
+// An OpLevelCostEstimator that replaces the roofline estimates with execution
+// times measured on the target machine, whenever measurements are available
+// for the op.
+//
+// Measurements are grouped by op type, device type and data type, and
+// bucketed by the total number of input elements (in powers of 2). The
+// execution time of an op is interpolated between the two nearest buckets in
+// log-log space; above the largest bucket it is assumed to grow linearly with
+// the number of elements, and below the smallest one it is assumed constant.
+// Ops without measurements fall back to the analytical model.
+class CalibratedOpLevelCostEstimator : public OpLevelCostEstimator {
+ public:
+  CalibratedOpLevelCostEstimator() {}
+  explicit CalibratedOpLevelCostEstimator(
+      const OpPerformanceList& measurements);
+  ~CalibratedOpLevelCostEstimator() override {}
+
+  // Adds the measured execution times in `measurements` to the cost tables.
+  // Copies of the estimator share their cost tables until measurements are
+  // added to one of them.
+  void AddMeasurements(const OpPerformanceList& measurements);
+
+  Costs PredictCosts(const OpContext& op_context) const override;
+
+  // Returns true if measurements are available for the op in `op_info`.
+  bool IsCalibrated(const OpInfo& op_info) const;
+
+ private:
+  struct Bucket {
+    double num_elements = 0;
+    double time_ns = 0;
+    int64 count = 0;
+  };
+  // Buckets keyed by the base 2 logarithm of the number of input elements.
+  using CostTable = std::map<int, Bucket>;
+  // Cost tables keyed by op type, device type and data type.
+  using CostTables = std::unordered_map<string, CostTable>;
+
+  const CostTable* FindTable(const OpInfo& op_info) const;
+
+  std::shared_ptr<const CostTables> tables_;
+};
+
+// Returns a CalibratedOpLevelCostEstimator using the measurements stored as an
+// OpPerformanceList in the file `cost_table_path` (e.g. from
+// RewriterConfig.op_cost_table), or if it is empty in the file named by the
+// TF_GRAPPLER_OP_COST_TABLE environment variable. Returns a plain
+// OpLevelCostEstimator if neither is set or the file can't be read. Each file
+// is only read, and its cost tables built, once per process.
+std::unique_ptr<OpLevelCostEstimator> CreateOpLevelCostEstimator(
+    const string& cost_table_path = "");
+
+// Returns the distinct ops of the graph of `item` that MeasureOpCosts can run
+// in isolation, with the input shapes statically inferred for the graph. Ops
+// with inputs of unknown shape, stateful ops, ops consuming or producing
+// resources or references, and ops without inputs are skipped.
+Status CollectOpsToMeasure(const GrapplerItem& item, std::vector<OpInfo>* ops);
+
+// Runs each op in `ops` in isolation on `cluster` for `num_steps` steps, and
+// returns the average measured execution time of each op in `measurements`.
+// Input tensors are taken from the constant values in the OpInfo when present,
+// and zero filled otherwise, so all input shapes must be fully defined.
+Status MeasureOpCosts(Cluster* cluster, const std::vector<OpInfo>& ops,
+                      int num_steps, OpPerformanceList* measurements);
+
+// Returns copies of `op_info` with the leading dimension of the inputs listed
+// in `inputs_to_scale` (typically the batch dimension) multiplied by 2^i for i
+// in [-num_buckets/2, num_buckets - num_buckets/2), which is convenient to
+// calibrate an op over a range of shape buckets.
+std::vector<OpInfo> ScaleOpInputs(const OpInfo& op_info,
+                                  const std::vector<int>& inputs_to_scale,
+                                  int num_buckets);
+
+// Compares the execution times predicted by `estimator` with the measured ones
+// in `measurements` (e.g. converted from the step stats of a real run using
+// CostGraphToOpPerformanceData), and returns a per op type report of the mean
+// measured time, mean predicted time and mean relative error.
+string CostModelAccuracyReport(const OpLevelCostEstimator& estimator,
+                               const OpPerformanceList& measurements);
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_CALIBRATED_OP_LEVEL_COST_ESTIMATOR_H_
@@ -0,0 +1,253 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/calibrated_op_level_cost_estimator.h"
+
+#include <cmath>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/device_properties.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+DeviceProperties CpuDevice() {
+  DeviceProperties device;
+  device.set_type("CPU");
+  device.set_num_cores(1);
+  device.set_frequency(1000);
+  device.set_bandwidth(32 * 1000 * 1000);
+  return device;
+}
+
+// Returns a MatMul of a [m, k] and a [k, n] matrix.
+OpInfo MatMul(int m, int k, int n) {
+  OpInfo op_info;
+  op_info.set_op("MatMul");
+  (*op_info.mutable_attr())["T"].set_type(DT_FLOAT);
+  for (const auto& dims : {std::make_pair(m, k), std::make_pair(k, n)}) {
+    auto* input = op_info.add_inputs();
+    input->set_dtype(DT_FLOAT);
+    input->mutable_shape()->add_dim()->set_size(dims.first);
+    input->mutable_shape()->add_dim()->set_size(dims.second);
+  }
+  *op_info.mutable_device() = CpuDevice();
+  return op_info;
+}
+
+void AddMeasurement(const OpInfo& op_info, double time_ns,
+                    OpPerformanceList* measurements) {
+  OpPerformance* perf = measurements->add_op_performance();
+  *perf->mutable_op() = op_info;
+  perf->mutable_execution_time_normal()->set_mu(time_ns);
+}
+
+double PredictTimeNs(const OpLevelCostEstimator& estimator,
+                     const OpInfo& op_info) {
+  OpContext op_context;
+  op_context.op_info = op_info;
+  return estimator.PredictCosts(op_context).execution_time.count();
+}
+
+class CalibratedOpLevelCostEstimatorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // 2048 and 8192 input elements respectively.
+    AddMeasurement(MatMul(32, 32, 32), 1000, &measurements_);
+    AddMeasurement(MatMul(64, 64, 64), 8000, &measurements_);
+  }
+
+  OpPerformanceList measurements_;
+};
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, ExactMatch) {
+  CalibratedOpLevelCostEstimator estimator(measurements_);
+  EXPECT_TRUE(estimator.IsCalibrated(MatMul(32, 32, 32)));
+  EXPECT_NEAR(PredictTimeNs(estimator, MatMul(32, 32, 32)), 1000, 1);
+  EXPECT_NEAR(PredictTimeNs(estimator, MatMul(64, 64, 64)), 8000, 1);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, Interpolation) {
+  CalibratedOpLevelCostEstimator estimator(measurements_);
+  // 4096 input elements, halfway between both measurements in log space.
+  EXPECT_NEAR(PredictTimeNs(estimator, MatMul(32, 64, 32)),
+              1000 * std::sqrt(8.0), 1);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, Extrapolation) {
+  CalibratedOpLevelCostEstimator estimator(measurements_);
+  // Smaller ops are assumed to be overhead bound.
+  EXPECT_NEAR(PredictTimeNs(estimator, MatMul(8, 8, 8)), 1000, 1);
+  // Larger ops are assumed to scale linearly with their input size.
+  EXPECT_NEAR(PredictTimeNs(estimator, MatMul(128, 64, 64)), 12000, 1);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, FallsBackToAnalyticalModel) {
+  CalibratedOpLevelCostEstimator estimator(measurements_);
+  OpLevelCostEstimator analytical;
+
+  // Uncalibrated data type.
+  OpInfo double_matmul = MatMul(32, 32, 32);
+  for (auto& input : *double_matmul.mutable_inputs()) {
+    input.set_dtype(DT_DOUBLE);
+  }
+  EXPECT_FALSE(estimator.IsCalibrated(double_matmul));
+  EXPECT_EQ(PredictTimeNs(estimator, double_matmul),
+            PredictTimeNs(analytical, double_matmul));
+
+  // Unknown shapes.
+  OpInfo unknown_matmul = MatMul(32, 32, 32);
+  unknown_matmul.mutable_inputs(0)->mutable_shape()->mutable_dim(0)->set_size(
+      -1);
+  EXPECT_FALSE(estimator.IsCalibrated(unknown_matmul));
+  EXPECT_EQ(PredictTimeNs(estimator, unknown_matmul),
+            PredictTimeNs(analytical, unknown_matmul));
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, SubMicrosecondCostGraphTimes) {
+  // Cost graphs measure in microseconds, so ops that ran faster have a
+  // compute_cost of 0 and must not be ignored.
+  OpPerformanceList measurements;
+  OpPerformance* perf = measurements.add_op_performance();
+  *perf->mutable_op() = MatMul(2, 2, 2);
+  perf->set_compute_cost(0);
+  CalibratedOpLevelCostEstimator estimator(measurements);
+  EXPECT_TRUE(estimator.IsCalibrated(MatMul(2, 2, 2)));
+  const double time_ns = PredictTimeNs(estimator, MatMul(2, 2, 2));
+  EXPECT_GT(time_ns, 0);
+  EXPECT_LT(time_ns, 1000);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, CopiesShareTables) {
+  CalibratedOpLevelCostEstimator estimator(measurements_);
+  CalibratedOpLevelCostEstimator copy = estimator;
+  EXPECT_NEAR(PredictTimeNs(copy, MatMul(32, 32, 32)), 1000, 1);
+
+  // Adding measurements to a copy leaves the original unchanged.
+  OpPerformanceList more_measurements;
+  AddMeasurement(MatMul(32, 32, 32), 3000, &more_measurements);
+  copy.AddMeasurements(more_measurements);
+  EXPECT_NEAR(PredictTimeNs(copy, MatMul(32, 32, 32)), 2000, 1);
+  EXPECT_NEAR(PredictTimeNs(estimator, MatMul(32, 32, 32)), 1000, 1);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, AccuracyReport) {
+  CalibratedOpLevelCostEstimator estimator(measurements_);
+  const string report = CostModelAccuracyReport(estimator, measurements_);
+  EXPECT_NE(report.find("MatMul"), string::npos);
+  EXPECT_NE(report.find("(all)"), string::npos);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, ScaleOpInputs) {
+  const std::vector<OpInfo> scaled = ScaleOpInputs(MatMul(32, 32, 32), {0}, 4);
+  ASSERT_EQ(scaled.size(), 4);
+  EXPECT_EQ(scaled[0].inputs(0).shape().dim(0).size(), 8);
+  EXPECT_EQ(scaled[1].inputs(0).shape().dim(0).size(), 16);
+  EXPECT_EQ(scaled[2].inputs(0).shape().dim(0).size(), 32);
+  EXPECT_EQ(scaled[3].inputs(0).shape().dim(0).size(), 64);
+  for (const OpInfo& op_info : scaled) {
+    EXPECT_EQ(op_info.inputs(1).shape().dim(0).size(), 32);
+  }
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, MeasureOpCosts) {
+  VirtualCluster cluster(
+      {{"/job:localhost/replica:0/task:0/device:CPU:0", CpuDevice()}});
+  OpPerformanceList measured;
+  TF_ASSERT_OK(MeasureOpCosts(&cluster,
+                              ScaleOpInputs(MatMul(512, 512, 512), {0}, 2),
+                              /*num_steps=*/2, &measured));
+  ASSERT_EQ(measured.op_performance_size(), 2);
+  for (const OpPerformance& perf : measured.op_performance()) {
+    EXPECT_EQ(perf.op().op(), "MatMul");
+    EXPECT_GT(perf.execution_time_normal().mu(), 0);
+  }
+  // The larger op takes longer.
+  EXPECT_GT(measured.op_performance(1).execution_time_normal().mu(),
+            measured.op_performance(0).execution_time_normal().mu());
+
+  CalibratedOpLevelCostEstimator estimator(measured);
+  EXPECT_TRUE(estimator.IsCalibrated(measured.op_performance(0).op()));
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, CreateFromCostTable) {
+  const string path =
+      io::JoinPath(testing::TmpDir(), "CreateFromCostTable.pbtxt");
+  TF_ASSERT_OK(WriteTextProto(Env::Default(), path, measurements_));
+  std::unique_ptr<OpLevelCostEstimator> estimator =
+      CreateOpLevelCostEstimator(path);
+  ASSERT_NE(dynamic_cast<CalibratedOpLevelCostEstimator*>(estimator.get()),
+            nullptr);
+  EXPECT_NEAR(PredictTimeNs(*estimator, MatMul(32, 32, 32)), 1000, 1);
+
+  // A table that can't be read falls back to the analytical model.
+  estimator = CreateOpLevelCostEstimator(
+      io::JoinPath(testing::TmpDir(), "does_not_exist.pbtxt"));
+  EXPECT_EQ(dynamic_cast<CalibratedOpLevelCostEstimator*>(estimator.get()),
+            nullptr);
+}
+
+TEST_F(CalibratedOpLevelCostEstimatorTest, CollectOpsToMeasure) {
+  auto add_node = [](const string& name, const string& op,
+                     const std::vector<string>& inputs, GraphDef* graph) {
+    NodeDef* node = graph->add_node();
+    node->set_name(name);
+    node->set_op(op);
+    for (const string& input : inputs) node->add_input(input);
+    (*node->mutable_attr())[op == "Placeholder" ? "dtype" : "T"].set_type(
+        DT_FLOAT);
+    return node;
+  };
+  GrapplerItem item;
+  for (const string& name : {"a", "b"}) {
+    NodeDef* node = add_node(name, "Placeholder", {}, &item.graph);
+    auto* shape = (*node->mutable_attr())["shape"].mutable_shape();
+    shape->add_dim()->set_size(32);
+    shape->add_dim()->set_size(32);
+  }
+  NodeDef* unknown = add_node("unknown", "Placeholder", {}, &item.graph);
+  (*unknown->mutable_attr())["shape"].mutable_shape()->set_unknown_rank(true);
+  for (const auto& name_and_inputs :
+       {std::make_pair("ab", std::vector<string>{"a", "b"}),
+        std::make_pair("ba", std::vector<string>{"b", "a"})}) {
+    NodeDef* node = add_node(name_and_inputs.first, "MatMul",
+                             name_and_inputs.second, &item.graph);
+    (*node->mutable_attr())["transpose_a"].set_b(false);
+    (*node->mutable_attr())["transpose_b"].set_b(false);
+  }
+  add_node("relu", "Relu", {"ab"}, &item.graph);
+  add_node("unknown_relu", "Relu", {"unknown"}, &item.graph);
+
+  std::vector<OpInfo> ops;
+  TF_ASSERT_OK(CollectOpsToMeasure(item, &ops));
+  // The two MatMuls are identical, and the shape of unknown_relu is unknown.
+  ASSERT_EQ(ops.size(), 2);
+  EXPECT_EQ(ops[0].op(), "MatMul");
+  EXPECT_EQ(ops[1].op(), "Relu");
+  EXPECT_EQ(ops[1].inputs(0).shape().dim_size(), 2);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
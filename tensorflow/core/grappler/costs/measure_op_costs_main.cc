@@ -0,0 +1,149 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// This program measures the execution time of the ops of a graph on the local
+// machine, and writes them as an OpPerformanceList that calibrates the cost
+// model of Grappler (see RewriterConfig.op_cost_table). Each distinct op is run
+// in isolation with the input shapes inferred for the graph, optionally scaled
+// over a range of batch sizes. To use it, run something like this:
+//
+// bazel build tensorflow/core/grappler/costs:measure_op_costs
+// bazel-bin/tensorflow/core/grappler/costs/measure_op_costs \
+// --in_graph=my_graph.pb --out_table=/tmp/op_costs.pb --num_buckets=5
+
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/grappler/clusters/single_machine.h"
+#include "tensorflow/core/grappler/costs/calibrated_op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/inputs/utils.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+Status MeasureGraphOpCosts(const string& in_graph, const string& out_table,
+                           const std::vector<int>& inputs_to_scale,
+                           int num_buckets, int num_steps) {
+  GrapplerItem item;
+  item.id = in_graph;
+  TF_RETURN_IF_ERROR(ReadGraphDefFromFile(in_graph, &item.graph));
+  std::vector<OpInfo> ops;
+  TF_RETURN_IF_ERROR(CollectOpsToMeasure(item, &ops));
+  LOG(INFO) << "Measuring " << ops.size() << " distinct ops of " << in_graph;
+
+  SingleMachine cluster(/*timeout_s=*/60, port::MaxParallelism(),
+                        /*num_gpus=*/0);
+  TF_RETURN_IF_ERROR(cluster.Provision());
+  OpPerformanceList measurements;
+  for (const OpInfo& op_info : ops) {
+    // Ops that can't run in isolation are skipped, they keep their analytical
+    // estimates.
+    const Status status = MeasureOpCosts(
+        &cluster, ScaleOpInputs(op_info, inputs_to_scale, num_buckets),
+        num_steps, &measurements);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to measure " << op_info.op() << ": " << status;
+    }
+  }
+  TF_RETURN_IF_ERROR(cluster.Shutdown());
+
+  LOG(INFO) << "Writing " << measurements.op_performance_size()
+            << " measurements to " << out_table;
+  if (absl::EndsWith(out_table, ".pbtxt")) {
+    return WriteTextProto(Env::Default(), out_table, measurements);
+  }
+  return WriteBinaryProto(Env::Default(), out_table, measurements);
+}
+
+int ParseFlagsAndMeasureOpCosts(int argc, char* argv[]) {
+  string in_graph = "";
+  string out_table = "";
+  string inputs_to_scale = "0";
+  int32 num_buckets = 1;
+  int32 num_steps = 10;
+  std::vector<Flag> flag_list = {
+      Flag("in_graph", &in_graph,
+           "input GraphDef file name, in text or binary format"),
+      Flag("out_table", &out_table,
+           "output OpPerformanceList file name, written in text format if it "
+           "ends with .pbtxt and in binary format otherwise"),
+      Flag("inputs_to_scale", &inputs_to_scale,
+           "comma separated indices of the inputs whose leading dimension is "
+           "scaled to measure the shape buckets"),
+      Flag("num_buckets", &num_buckets,
+           "number of shape buckets measured per op, scaling the leading "
+           "dimension of the scaled inputs by powers of 2 around its size in "
+           "the graph"),
+      Flag("num_steps", &num_steps, "number of measured runs of each op"),
+  };
+  string usage = Flags::Usage(argv[0], flag_list);
+
+  const bool parse_result = Flags::Parse(&argc, argv, flag_list);
+  // We need to call this to set up global state for TensorFlow.
+  port::InitMain(argv[0], &argc, &argv);
+
+  if (!parse_result) {
+    LOG(ERROR) << usage;
+    return -1;
+  }
+  if (argc > 1) {
+    LOG(ERROR) << "Unknown argument " << argv[1] << ".\n" << usage;
+    return -1;
+  }
+  if (in_graph.empty() || out_table.empty()) {
+    LOG(ERROR) << "in_graph and out_table can't be empty.\n" << usage;
+    return -1;
+  }
+  std::vector<int> scaled_inputs;
+  for (const string& index : str_util::Split(inputs_to_scale, ',',
+                                             str_util::SkipEmpty())) {
+    int32 value;
+    if (!strings::safe_strto32(index, &value)) {
+      LOG(ERROR) << "Invalid input index " << index << ".\n" << usage;
+      return -1;
+    }
+    scaled_inputs.push_back(value);
+  }
+  if (num_buckets <= 0) {
+    LOG(ERROR) << "num_buckets must be positive.\n" << usage;
+    return -1;
+  }
+
+  const Status status = MeasureGraphOpCosts(in_graph, out_table, scaled_inputs,
+                                            num_buckets, num_steps);
+  if (!status.ok()) {
+    LOG(ERROR) << status.error_message() << "\n" << usage;
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
+
+int main(int argc, char* argv[]) {
+  return tensorflow::grappler::ParseFlagsAndMeasureOpCosts(argc, argv);
+}
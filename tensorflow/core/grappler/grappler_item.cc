@@ -56,6 +56,7 @@ GrapplerItem GrapplerItem::WithGraph(GraphDef&& graph_def) const {
   item.fetch = fetch;
   item.init_ops = init_ops;
   item.keep_ops = keep_ops;
+  item.requested_devices = requested_devices;
   item.expected_init_time = expected_init_time;
   item.save_op = save_op;
   item.restore_op = restore_op;
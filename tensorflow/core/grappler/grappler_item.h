@@ -23,6 +23,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/variable.pb.h"
@@ -70,6 +71,12 @@ struct GrapplerItem {
   // ensure that the optimized metagraph can still be loaded.
   std::vector<string> keep_ops;
 
+  // Devices requested for the nodes of `graph`, keyed by node name, if `graph`
+  // was already placed and its NodeDef devices are the ones assigned by the
+  // placer. Nodes that are not in the map (e.g. nodes added by an optimizer)
+  // are assumed to have been requested on their NodeDef device.
+  absl::flat_hash_map<string, string> requested_devices;
+
   // Return the set of node evaluated during a regular train/inference step.
   std::vector<const NodeDef*> MainOpsFanin() const;
   // Return the set of node run to populate the queues (if any).
@@ -24,6 +24,8 @@ limitations under the License.
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/attr_value_util.h"
 #include "tensorflow/core/framework/node_def.pb.h"
@@ -3538,14 +3540,31 @@ class SimplifyEmbeddingLookupStage : public ArithmeticOptimizerStage {
     if (IsInPreserveSet(*reduction_node)) return Status::OK();
 
     // Input 0 (data) of the reduction node must be a tf.gather() on the 0th
-    // axis.
+    // axis, or the gather of a resource variable.
     NodeDef* gather_node = nullptr;
     TF_RETURN_IF_ERROR(GetInputNode(reduction_node->input(0), &gather_node));
-    if (!IsGather(*gather_node) || IsInPreserveSet(*gather_node) ||
+    const bool is_resource_gather = gather_node->op() == "ResourceGather";
+    if (!(IsGather(*gather_node) || is_resource_gather) ||
+        IsInPreserveSet(*gather_node) ||
         gather_node->device() != reduction_node->device())
       return Status::OK();
     if (gather_node->op() == "GatherV2" && !IsAxis0(*gather_node, 2))
       return Status::OK();
+    int batch_dims = 0;
+    if (HasNodeAttr(*gather_node, "batch_dims")) {
+      TF_RETURN_IF_ERROR(GetNodeAttr(*gather_node, "batch_dims", &batch_dims));
+    }
+    if (batch_dims != 0) return Status::OK();
+    // Other consumers of the gathered rows keep the gather and the unique
+    // alive, and the reduction would then read the full params on top of them.
+    if (NumNonControlOutputs(*gather_node, *ctx().node_map) > 1)
+      return Status::OK();
+    // Nodes ordered after the read of the variable by a control dependency
+    // would not wait for the fused reduction, which reads it instead.
+    if (is_resource_gather &&
+        (!CanFuseResourceGather(*reduction_node) ||
+         NumControlOutputs(*gather_node, *ctx().node_map) > 0))
+      return Status::OK();
 
     // Input 1 (indices) of the gather node must be a tf.unique() on the 0th
     // axis.
@@ -3579,12 +3598,52 @@ class SimplifyEmbeddingLookupStage : public ArithmeticOptimizerStage {
                                 reduction_node->input(1),
                                 unique_node->input(0));
     SetDataTypeToAttr(unique_element_type, "Tidx", reduction_node);
+    if (is_resource_gather) {
+      FuseResourceGather(reduction_node);
+      // The variable must still be read after the control inputs of the
+      // gather, e.g. an initializer or an assignment.
+      ForwardControlDependencies(reduction_node, {gather_node});
+    }
 
     *simplified_node_name = reduction_node->name();
     return Status::OK();
   }
 
  private:
+  // The rows of a resource variable are reduced by a kernel reading them
+  // straight from the variable, only available on CPU.
+  bool CanFuseResourceGather(const NodeDef& reduction_node) const {
+    DataType dtype;
+    if (!NodeIsOnCpu(reduction_node) ||
+        !GetNodeAttr(reduction_node, "T", &dtype).ok() ||
+        !(dtype == DT_FLOAT || dtype == DT_DOUBLE || dtype == DT_BFLOAT16)) {
+      return false;
+    }
+    DataType num_segments_type;
+    return !GetNodeAttr(reduction_node, "Tnumsegments", &num_segments_type)
+                .ok() ||
+           num_segments_type == DT_INT32;
+  }
+
+  void FuseResourceGather(NodeDef* reduction_node) const {
+    const string& op = reduction_node->op();
+    string combiner = "sum";
+    if (absl::StartsWith(op, "SparseSegmentMean")) {
+      combiner = "mean";
+    } else if (absl::StartsWith(op, "SparseSegmentSqrtN")) {
+      combiner = "sqrtn";
+    }
+    reduction_node->set_op(
+        absl::StrCat("_ResourceSparseSegmentReduction",
+                     absl::EndsWith(op, "WithNumSegments") ? "WithNumSegments"
+                                                           : ""));
+    auto* attr = reduction_node->mutable_attr();
+    (*attr)["dtype"] = attr->at("T");
+    attr->erase("T");
+    attr->erase("Tnumsegments");
+    (*attr)["combiner"].set_s(combiner);
+  }
+
   bool IsAxis0(const NodeDef& node, int axis_input) {
     Tensor axis_tensor;
     if (!GetTensorFromConstNode(node.input(axis_input), &axis_tensor))
@@ -21,6 +21,7 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "tensorflow/cc/ops/array_ops.h"
 #include "tensorflow/cc/ops/math_ops.h"
+#include "tensorflow/cc/ops/resource_variable_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
@@ -4213,6 +4214,158 @@ TEST_F(ArithmeticOptimizerTest, SimplifyEmbeddingLookup) {
   }
 }
 
+TEST_F(ArithmeticOptimizerTest, SimplifyEmbeddingLookupWithOtherConsumers) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output embeddings = ops::Const(s.WithOpName("embeddings"),
+                                 {1.0f, 2.0f, 3.0f, 4.0f}, {2, 2});
+  Output segment_ids =
+      ops::Const(s.WithOpName("segment_ids"), {0, 1, 1, 2, 2, 2, 2});
+  Output indices = ops::Const(s.WithOpName("indices"), {0, 0, 1, 0, 1, 0, 1});
+  auto unique = ops::Unique(s.WithOpName("unique"), indices);
+  Output gathered_rows =
+      ops::Gather(s.WithOpName("gathered_rows"), embeddings, unique.y);
+  Output result = ops::SparseSegmentSum(s.WithOpName("result"), gathered_rows,
+                                        unique.idx, segment_ids);
+  Output id = ops::Identity(s.WithOpName("id"), result);
+  Output rows = ops::Identity(s.WithOpName("rows"), gathered_rows);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"id", "rows"};
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  ASSERT_EQ(tensors_expected.size(), 2);
+
+  GraphDef output;
+  ArithmeticOptimizer optimizer;
+  EnableOnlySimplifyEmbeddingLookup(&optimizer);
+  OptimizeAndPrune(&optimizer, &item, &output);
+
+  // The gather is still needed by "rows", so the reduction keeps reading it.
+  const NodeDef* result_node = nullptr;
+  for (const auto& node : output.node()) {
+    if (node.name() == "result") result_node = &node;
+  }
+  ASSERT_NE(result_node, nullptr);
+  EXPECT_EQ(result_node->input(0), "gathered_rows");
+  EXPECT_EQ(result_node->input(1), "unique:1");
+
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(tensors.size(), 2);
+  test::ExpectTensorEqual<float>(tensors[0], tensors_expected[0]);
+  test::ExpectTensorEqual<float>(tensors[1], tensors_expected[1]);
+}
+
+TEST_F(ArithmeticOptimizerTest, SimplifyEmbeddingLookupOfResourceVariable) {
+  for (const string& reduction : {"SparseSegmentMean",
+                                  "SparseSegmentSumWithNumSegments"}) {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+        "/job:localhost/replica:0/task:0/device:CPU:0");
+    auto embeddings = ops::VarHandleOp(s.WithOpName("embeddings"), DT_FLOAT,
+                                       TensorShape({2, 2}));
+    Output segment_ids =
+        ops::Const(s.WithOpName("segment_ids"), {0, 1, 1, 2, 2, 2, 2});
+    Output indices = ops::Const(s.WithOpName("indices"), {0, 0, 1, 0, 1, 0, 1});
+    Output num_segments = ops::Const(s.WithOpName("num_segments"), 3);
+    auto unique = ops::Unique(s.WithOpName("unique"), indices);
+    Output gathered_rows = ops::ResourceGather(s.WithOpName("gathered_rows"),
+                                               embeddings, unique.y, DT_FLOAT);
+    Output result =
+        reduction == "SparseSegmentMean"
+            ? ops::SparseSegmentMean(s.WithOpName("result"), gathered_rows,
+                                     unique.idx, segment_ids)
+                  .output
+            : ops::SparseSegmentSumWithNumSegments(
+                  s.WithOpName("result"), gathered_rows, unique.idx,
+                  segment_ids, num_segments)
+                  .output;
+    Output id = ops::Identity(s.WithOpName("id"), result);
+
+    GrapplerItem item;
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+    item.fetch = {"id"};
+
+    GraphDef output;
+    ArithmeticOptimizer optimizer;
+    EnableOnlySimplifyEmbeddingLookup(&optimizer);
+    OptimizeAndPrune(&optimizer, &item, &output);
+
+    const NodeDef* fused = nullptr;
+    for (const auto& node : output.node()) {
+      if (node.name() == "result") fused = &node;
+      EXPECT_NE(node.op(), "Unique");
+      EXPECT_NE(node.op(), "ResourceGather");
+    }
+    ASSERT_NE(fused, nullptr);
+    EXPECT_EQ(fused->input(0), "embeddings");
+    EXPECT_EQ(fused->input(1), "indices");
+    EXPECT_EQ(fused->input(2), "segment_ids");
+    EXPECT_EQ(fused->attr().at("dtype").type(), DT_FLOAT);
+    EXPECT_EQ(fused->attr().count("T"), 0);
+    if (reduction == "SparseSegmentMean") {
+      EXPECT_EQ(fused->op(), "_ResourceSparseSegmentReduction");
+      EXPECT_EQ(fused->attr().at("combiner").s(), "mean");
+    } else {
+      EXPECT_EQ(fused->op(), "_ResourceSparseSegmentReductionWithNumSegments");
+      EXPECT_EQ(fused->input(3), "num_segments");
+      EXPECT_EQ(fused->attr().at("combiner").s(), "sum");
+      EXPECT_EQ(fused->attr().count("Tnumsegments"), 0);
+    }
+  }
+
+  // Control dependencies of the read of the variable.
+  for (const bool has_control_output : {false, true}) {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+        "/job:localhost/replica:0/task:0/device:CPU:0");
+    auto embeddings = ops::VarHandleOp(s.WithOpName("embeddings"), DT_FLOAT,
+                                       TensorShape({2, 2}));
+    auto assign = ops::AssignVariableOp(
+        s.WithOpName("assign"), embeddings,
+        ops::Const(s.WithOpName("init"), {1.0f, 2.0f, 3.0f, 4.0f}, {2, 2}));
+    Output segment_ids =
+        ops::Const(s.WithOpName("segment_ids"), {0, 1, 1, 2, 2, 2, 2});
+    Output indices = ops::Const(s.WithOpName("indices"), {0, 0, 1, 0, 1, 0, 1});
+    auto unique = ops::Unique(s.WithOpName("unique"), indices);
+    Output gathered_rows = ops::ResourceGather(
+        s.WithOpName("gathered_rows").WithControlDependencies(assign),
+        embeddings, unique.y, DT_FLOAT);
+    Output result = ops::SparseSegmentSum(s.WithOpName("result"),
+                                          gathered_rows, unique.idx,
+                                          segment_ids);
+    Output id = ops::Identity(s.WithOpName("id"), result);
+    GrapplerItem item;
+    if (has_control_output) {
+      auto update = ops::AssignAddVariableOp(
+          s.WithOpName("update").WithControlDependencies(gathered_rows),
+          embeddings,
+          ops::Const(s.WithOpName("delta"), {1.0f, 1.0f, 1.0f, 1.0f}, {2, 2}));
+      item.fetch = {"id", "update"};
+    } else {
+      item.fetch = {"id"};
+    }
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+    GraphDef output;
+    ArithmeticOptimizer optimizer;
+    EnableOnlySimplifyEmbeddingLookup(&optimizer);
+    OptimizeAndPrune(&optimizer, &item, &output);
+
+    const NodeDef* result_node = nullptr;
+    for (const auto& node : output.node()) {
+      if (node.name() == "result") result_node = &node;
+    }
+    ASSERT_NE(result_node, nullptr);
+    if (has_control_output) {
+      // "update" must still run after the read of the variable.
+      EXPECT_EQ(result_node->op(), "SparseSegmentSum");
+      EXPECT_EQ(result_node->input(0), "gathered_rows");
+    } else {
+      EXPECT_EQ(result_node->op(), "_ResourceSparseSegmentReduction");
+      ASSERT_EQ(result_node->input_size(), 4);
+      EXPECT_EQ(result_node->input(3), "^assign");
+    }
+  }
+}
+
 TEST_F(ArithmeticOptimizerTest, RemoveCastIntoSegmentReduction) {
   for (DataType indices_type : {DT_INT32, DT_INT64}) {
     for (DataType segment_ids_type : {DT_INT32, DT_INT64}) {
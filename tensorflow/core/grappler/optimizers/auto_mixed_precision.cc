@@ -22,6 +22,7 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/attr_value_util.h"
 #include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/types.h"
@@ -953,6 +954,8 @@ class AutoMixedPrecisionImpl {
                                                              cudnn_version_);
       case AutoMixedPrecisionMode::MKL:
         return std::make_unique<AutoMixedPrecisionListsMkl>();
+      case AutoMixedPrecisionMode::CPU:
+        return std::make_unique<AutoMixedPrecisionListsCpu>();
     }
   }
   Status PrintDebugLogs(bool preop, size_t timestamp);
@@ -993,6 +996,7 @@ class AutoMixedPrecisionImpl {
       absl::flat_hash_set<int>* allow_set) const;
   NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_f16,
                         const string& device) const;
+  NodeDef* FindExistingCastToF16(const MutableGraphView::OutputPort& src) const;
   Status ChangeTypeAttrsAndAddCasts(const absl::flat_hash_set<int>& allow_set);
 
   VirtualPlacer virtual_placer_;
@@ -1036,6 +1040,29 @@ NodeDef AutoMixedPrecisionImpl::BuildCastNode(
   return node;
 }
 
+// Returns a Cast of `src` to the target type that is already in the graph (e.g.
+// added by the user or by a previous run), so that it can feed the allow nodes
+// reading `src` instead of a new Cast, or nullptr if there is none.
+NodeDef* AutoMixedPrecisionImpl::FindExistingCastToF16(
+    const MutableGraphView::OutputPort& src) const {
+  for (const MutableGraphView::InputPort& dst : graph_view_.GetFanout(src)) {
+    const NodeDef& cast = *dst.node;
+    if (cast.op() != "Cast" || dst.port_id != 0 ||
+        cast.device() != src.node->device() || HasControlInputs(cast)) {
+      continue;
+    }
+    DataType src_type, dst_type;
+    bool truncate = false;
+    if (GetNodeAttr(cast, "SrcT", &src_type).ok() && src_type == DT_FLOAT &&
+        GetNodeAttr(cast, "DstT", &dst_type).ok() &&
+        dst_type == target_dtype_ &&
+        (!GetNodeAttr(cast, "Truncate", &truncate).ok() || !truncate)) {
+      return dst.node;
+    }
+  }
+  return nullptr;
+}
+
 bool AutoMixedPrecisionImpl::NodeHasF16KernelForTypeAttr(
     const NodeDef& node, TypeAttrId taid) const {
   NodeDef node_copy(node);
@@ -1255,12 +1282,12 @@ Status AutoMixedPrecisionImpl::Optimize() {
       "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_LEVEL", "", &optimization_level));
   optimization_level = absl::AsciiStrToUpper(optimization_level);
   force_all_fp16_ = optimization_level == "UNSAFE_FORCE_ALL";
-  if (force_all_fp16_ && mode_ == AutoMixedPrecisionMode::MKL) {
+  if (force_all_fp16_ && mode_ != AutoMixedPrecisionMode::CUDA) {
     // Many ops do not support bfloat16 on the CPU so we disallowing forcing to
     // bfloat16.
     return errors::InvalidArgument(
         "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_LEVEL cannot be set to "
-        "UNSAFE_FORCE_ALL when MKL is used");
+        "UNSAFE_FORCE_ALL when converting to bfloat16 on CPU");
   }
 
   std::unique_ptr<AutoMixedPrecisionLists> mp_lists =
@@ -1285,6 +1312,7 @@ Status AutoMixedPrecisionImpl::Optimize() {
             (ShouldIgnorePerformance() || IsOnSuitableGPUArch(node));
         break;
       case AutoMixedPrecisionMode::MKL:
+      case AutoMixedPrecisionMode::CPU:
         should_process = !MustPreserve(node) && IsOnDevice(node, DEVICE_CPU);
         break;
     }
@@ -1934,6 +1962,14 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
           int dst_type_idx = maybe_dst_type_idx.value();
           bool dst_is_allow = allow_set.count(dst_type_idx);
           if (src_is_allow != dst_is_allow) {
+            if (!added_cast_node && dst_is_allow) {
+              added_cast_node = FindExistingCastToF16(src);
+              if (added_cast_node) {
+                VLOG(1) << "Reusing cast " << added_cast_node->name()
+                        << " at " << src.node->op() << " " << src.node->name()
+                        << ":" << src.port_id;
+              }
+            }
             if (!added_cast_node) {
               bool to_f16 = dst_is_allow;
               VLOG(1) << "Inserting cast to "
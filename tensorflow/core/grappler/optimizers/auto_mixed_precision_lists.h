@@ -439,6 +439,111 @@ class AutoMixedPrecisionListsMkl : public AutoMixedPrecisionLists {
   }
 };
 
+class AutoMixedPrecisionListsCpu : public AutoMixedPrecisionLists {
+ public:
+  AutoMixedPrecisionListsCpu() {}
+
+  // Tuned for inference with the default CPU kernels: the infer and clear
+  // lists are limited to cheap elementwise and data movement ops, whose
+  // bfloat16 kernels save memory bandwidth without losing precision. Ops
+  // without a bfloat16 CPU kernel are never converted, whichever list they
+  // are on.
+  //
+  // The allow list is empty: the bfloat16 MatMul, BatchMatMul and Conv2D CPU
+  // kernels convert their operands to float and run the float kernels, which
+  // is slower than running the float kernels directly. They can still be
+  // allowed with TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_ALLOWLIST_ADD, until
+  // they get native bfloat16 implementations.
+  gtl::FlatSet<string> AllowList() override {
+    auto list = gtl::FlatSet<string>{};
+    UpdateList("ALLOWLIST", &list);
+    return list;
+  }
+
+  gtl::FlatSet<string> InferList() override {
+    auto list = gtl::FlatSet<string>{
+        "Add",
+        "AddN",
+        "AddV2",
+        "AvgPool",
+        "BiasAdd",
+        "BiasAddV1",
+        "Elu",
+        "LeakyRelu",
+        "Mul",
+        "Sigmoid",
+        "Sub",
+        "Tanh",
+    };
+    UpdateList("INFERLIST", &list);
+    return list;
+  }
+
+  gtl::FlatSet<string> DenyList() override {
+    auto list = gtl::FlatSet<string>{
+        "Exp",
+        "Expm1",
+        "L2Loss",
+        "Log",
+        "LogSoftmax",
+        "Mean",
+        "Pow",
+        "SaveV2",
+        "Softmax",
+        "SoftmaxCrossEntropyWithLogits",
+        "SparseSoftmaxCrossEntropyWithLogits",
+        "Sum",
+    };
+    UpdateList("DENYLIST", &list);
+    return list;
+  }
+
+  gtl::FlatSet<string> ClearList() override {
+    auto list = gtl::FlatSet<string>{
+        "Concat",
+        "ConcatV2",
+        "EnsureShape",
+        "Enter",
+        "Exit",
+        "ExpandDims",
+        "Gather",
+        "GatherV2",
+        "Identity",
+        "IdentityN",
+        "MaxPool",
+        "MaxPoolV2",
+        "Maximum",
+        "Merge",
+        "Minimum",
+        "NextIteration",
+        "Pad",
+        "PadV2",
+        "PreventGradient",
+        "Relu",
+        "Relu6",
+        "Reshape",
+        "Select",
+        "SelectV2",
+        "Shape",
+        "ShapeN",
+        "Slice",
+        "Snapshot",
+        "Split",
+        "SplitV",
+        "Squeeze",
+        "StopGradient",
+        "StridedSlice",
+        "Switch",
+        "Tile",
+        "Transpose",
+        "ZerosLike",
+    };
+    AddTensorListOps(&list);
+    UpdateList("CLEARLIST", &list);
+    return list;
+  }
+};
+
 }  // end namespace grappler
 }  // end namespace tensorflow
 
@@ -13,9 +13,6 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM || \
-    (INTEL_MKL && defined(ENABLE_INTEL_MKL_BFLOAT16))
-
 #include "tensorflow/core/grappler/optimizers/auto_mixed_precision.h"
 
 #include <utility>
@@ -67,6 +64,8 @@ Tensor GenerateRandomTensorInRange(const TensorShape& shape, double minval,
   return tensor;
 }
 
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM || \
+    (INTEL_MKL && defined(ENABLE_INTEL_MKL_BFLOAT16))
 void VerifyGraphsEquivalent(const GraphDef& original_graph,
                             const GraphDef& optimized_graph,
                             const string& func) {
@@ -85,6 +84,7 @@ void VerifyGraphsEquivalent(const GraphDef& original_graph,
     }
   }
 }
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM || INTEL_MKL
 
 // Currently, this test suite only passes when TensorFlow passes with CUDA,
 // because otherwise the optimizer will not turn clearlist nodes to float16.
@@ -1357,9 +1357,156 @@ TEST_F(AutoMixedPrecisionMklTest, TensorListSetGet) {
 #endif  // ENABLE_INTEL_MKL_BFLOAT16
 #endif  // INTEL_MKL
 
+class AutoMixedPrecisionCpuTest : public GrapplerTest {
+ protected:
+  void SetUp() override {
+    virtual_cluster_.reset(new SingleMachine(/* timeout_s = */ 10, 1, 0));
+    TF_CHECK_OK(virtual_cluster_->Provision());
+    // The CPU allow list is empty by default.
+    setenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_ALLOWLIST_ADD",
+           "Conv2D,MatMul", /*overwrite=*/1);
+  }
+  void TearDown() override {
+    unsetenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_ALLOWLIST_ADD");
+    TF_CHECK_OK(virtual_cluster_->Shutdown());
+  }
+
+  std::unique_ptr<Cluster> virtual_cluster_;
+};
+
+TEST_F(AutoMixedPrecisionCpuTest, NothingAllowedByDefault) {
+  unsetenv("TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_ALLOWLIST_ADD");
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {32, 32});
+  Output allow1 = ops::MatMul(s.WithOpName("allow1"), input, input);
+  Output clr1 = ops::Relu(s.WithOpName("clr1"), allow1);
+  Output fetch = ops::Identity(s.WithOpName("fetch"), clr1);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  AutoMixedPrecision optimizer{AutoMixedPrecisionMode::CPU};
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  GraphView output_view(&output);
+  EXPECT_EQ(output.node_size(), item.graph.node_size());
+  EXPECT_EQ(output_view.GetNode("allow1")->attr().at("T").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("clr1")->attr().at("T").type(), DT_FLOAT);
+}
+
+TEST_F(AutoMixedPrecisionCpuTest, Simple) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {32, 32});
+  Output deny1 = ops::Exp(s.WithOpName("deny1"), input);
+  Output clr1 = ops::Relu(s.WithOpName("clr1"), deny1);
+  Output allow1 = ops::MatMul(s.WithOpName("allow1"), clr1, clr1);
+  Output infer1 = ops::AddV2(s.WithOpName("infer1"), allow1, allow1);
+  Output clr2 = ops::Relu(s.WithOpName("clr2"), infer1);
+  Output allow2 = ops::MatMul(s.WithOpName("allow2"), clr2, clr2);
+  Output deny2 = ops::Softmax(s.WithOpName("deny2"), allow2);
+  Output fetch = ops::Identity(s.WithOpName("fetch"), deny2);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+
+  AutoMixedPrecision optimizer{AutoMixedPrecisionMode::CPU};
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  VLOG(1) << output.DebugString();
+
+  GraphView output_view(&output);
+  EXPECT_EQ(output.node_size(), item.graph.node_size() + 2);
+  EXPECT_EQ(output_view.GetNode("deny1")->attr().at("T").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("clr1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("allow1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("infer1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("clr2")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("allow2")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("deny2")->attr().at("T").type(), DT_FLOAT);
+
+  auto tensors = EvaluateNodes(output, item.fetch);
+  EXPECT_EQ(tensors.size(), tensors_expected.size());
+  EXPECT_EQ(tensors.size(), item.fetch.size());
+  for (int i = 0; i < item.fetch.size(); ++i) {
+    test::ExpectClose(tensors_expected[i], tensors[i], -1, 1e-2);
+  }
+}
+
+TEST_F(AutoMixedPrecisionCpuTest, Conv2D) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {8, 16, 16, 8});
+  Output filter = ops::Const(s.WithOpName("filter"), 1.f / 32, {3, 3, 8, 8});
+  Output bias = ops::Const(s.WithOpName("bias"), 1.f / 8, {8});
+  Output allow1 = ops::Conv2D(s.WithOpName("allow1"), input, filter,
+                              {1, 1, 1, 1}, "SAME");
+  Output infer1 = ops::BiasAdd(s.WithOpName("infer1"), allow1, bias);
+  Output clr1 = ops::Relu(s.WithOpName("clr1"), infer1);
+  Output allow2 = ops::Conv2D(s.WithOpName("allow2"), clr1, filter,
+                              {1, 1, 1, 1}, "SAME");
+  Output fetch = ops::Identity(s.WithOpName("fetch"), allow2);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+
+  AutoMixedPrecision optimizer{AutoMixedPrecisionMode::CPU};
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  VLOG(1) << output.DebugString();
+
+  GraphView output_view(&output);
+  // Casts of input, filter and bias to bfloat16, and of allow2 to float.
+  EXPECT_EQ(output.node_size(), item.graph.node_size() + 4);
+  EXPECT_EQ(output_view.GetNode("allow1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("infer1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("clr1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("allow2")->attr().at("T").type(), DT_BFLOAT16);
+  // The filter is only cast once for both convolutions.
+  EXPECT_EQ(output_view.GetNode("allow1")->input(1),
+            output_view.GetNode("allow2")->input(1));
+
+  auto tensors = EvaluateNodes(output, item.fetch);
+  EXPECT_EQ(tensors.size(), tensors_expected.size());
+  EXPECT_EQ(tensors.size(), item.fetch.size());
+  for (int i = 0; i < item.fetch.size(); ++i) {
+    test::ExpectClose(tensors_expected[i], tensors[i], -1, 1e-2);
+  }
+}
+
+TEST_F(AutoMixedPrecisionCpuTest, ReusesExistingCast) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {32, 32});
+  Output cst1 = ops::Cast(s.WithOpName("cst1"), input, DT_BFLOAT16);
+  Output allow1 = ops::MatMul(s.WithOpName("allow1"), input, input);
+  Output fetch1 = ops::Identity(s.WithOpName("fetch1"), cst1);
+  Output fetch2 = ops::Identity(s.WithOpName("fetch2"), allow1);
+
+  GrapplerItem item;
+  item.fetch = {"fetch1", "fetch2"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  AutoMixedPrecision optimizer{AutoMixedPrecisionMode::CPU};
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  VLOG(1) << output.DebugString();
+
+  GraphView output_view(&output);
+  // Only the cast of allow1 back to float is added.
+  EXPECT_EQ(output.node_size(), item.graph.node_size() + 1);
+  const NodeDef* allow1_node = output_view.GetNode("allow1");
+  EXPECT_EQ(allow1_node->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(allow1_node->input(0), "cst1");
+  EXPECT_EQ(allow1_node->input(1), "cst1");
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
-
-#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM || (INTEL_MKL &&
-        // defined(ENABLE_INTEL_MKL_BFLOAT16))
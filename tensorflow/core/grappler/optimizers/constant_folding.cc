@@ -2079,6 +2079,8 @@ Status ConstantFolding::SimplifyNode(bool use_shape_info, NodeDef* node,
       SimplifyReduction(optimized_graph, *properties, node));
   SET_AND_RETURN_IF_MODIFIED(
       SimplifyReshape(*properties, use_shape_info, node));
+  SET_AND_RETURN_IF_MODIFIED(SimplifyShapeProd(*properties, use_shape_info,
+                                               optimized_graph, node));
   RETURN_IF_ERROR_OR_MODIFIED(SimplifyArithmeticOperations(
       *properties, use_shape_info, optimized_graph, node));
   SET_AND_RETURN_IF_MODIFIED(ReduceDivToReciprocalMul(optimized_graph, node));
@@ -2903,6 +2905,227 @@ bool ConstantFolding::SimplifyReshape(const GraphProperties& properties,
   return true;
 }
 
+bool ConstantFolding::GetSelectedShapeDims(const NodeDef& node,
+                                           const GraphProperties& properties,
+                                           const NodeDef** shape_node,
+                                           std::vector<int>* dims) {
+  const NodeDef* shape = &node;
+  if (!IsShape(node)) {
+    if (!IsSlice(node) && !IsStridedSlice(node)) return false;
+    shape = node_map_->GetNode(node.input(0));
+    if (shape == nullptr || !IsShape(*shape)) return false;
+  }
+  const std::vector<OpInfo::TensorProperties>& shape_input =
+      properties.GetInputProperties(shape->name());
+  if (shape_input.size() != 1 || shape_input[0].shape().unknown_rank()) {
+    return false;
+  }
+  const int64 rank = shape_input[0].shape().dim_size();
+
+  // Returns the single value of the constant vector `input` of `node`.
+  auto get_index = [this, &node](int input, int64* value) {
+    Tensor tensor;
+    if (!GetTensorFromConstNode(node.input(input), &tensor) ||
+        tensor.dims() != 1 || tensor.NumElements() != 1) {
+      return false;
+    }
+    *value = tensor.dtype() == DT_INT32 ? tensor.flat<int32>()(0)
+                                        : tensor.flat<int64>()(0);
+    return true;
+  };
+
+  int64 begin = 0;
+  int64 end = rank;
+  if (IsSlice(node)) {
+    int64 size;
+    if (!get_index(1, &begin) || !get_index(2, &size)) return false;
+    if (begin < 0 || begin > rank) return false;
+    end = size == -1 ? rank : begin + size;
+    if (size < -1 || end > rank) return false;
+  } else if (IsStridedSlice(node)) {
+    for (const char* mask : {"ellipsis_mask", "new_axis_mask",
+                             "shrink_axis_mask"}) {
+      if (node.attr().count(mask) > 0 && node.attr().at(mask).i() != 0) {
+        return false;
+      }
+    }
+    const int begin_mask =
+        node.attr().count("begin_mask") ? node.attr().at("begin_mask").i() : 0;
+    const int end_mask =
+        node.attr().count("end_mask") ? node.attr().at("end_mask").i() : 0;
+    int64 stride;
+    if (!get_index(1, &begin) || !get_index(2, &end) ||
+        !get_index(3, &stride) || stride != 1) {
+      return false;
+    }
+    if (begin_mask & 1) {
+      begin = 0;
+    } else if (begin < 0) {
+      begin += rank;
+    }
+    if (end_mask & 1) {
+      end = rank;
+    } else if (end < 0) {
+      end += rank;
+    }
+    begin = std::min(std::max<int64>(begin, 0), rank);
+    end = std::min(std::max<int64>(end, 0), rank);
+  }
+
+  *shape_node = shape;
+  dims->clear();
+  for (int64 i = begin; i < end; ++i) {
+    dims->push_back(i);
+  }
+  return true;
+}
+
+bool ConstantFolding::SimplifyShapeProd(const GraphProperties& properties,
+                                        bool use_shape_info,
+                                        GraphDef* optimized_graph,
+                                        NodeDef* node) {
+  // Look for Prod(Shape(x)[begin:end], 0) with keep_dims = false.
+  if (!use_shape_info || !IsProd(*node) || node->input_size() < 2) {
+    return false;
+  }
+  if (node->attr().count("keep_dims") > 0 &&
+      node->attr().at("keep_dims").b()) {
+    return false;
+  }
+  Tensor indices;
+  if (!GetTensorFromConstNode(node->input(1), &indices) ||
+      indices.NumElements() != 1) {
+    return false;
+  }
+  const int64 axis = indices.dtype() == DT_INT32 ? indices.flat<int32>()(0)
+                                                 : indices.flat<int64>()(0);
+  if (axis != 0 && axis != -1) return false;
+
+  const NodeDef* input = node_map_->GetNode(node->input(0));
+  const NodeDef* shape_node = nullptr;
+  std::vector<int> dims;
+  if (input == nullptr ||
+      !GetSelectedShapeDims(*input, properties, &shape_node, &dims)) {
+    return false;
+  }
+  const DataType type = node->attr().at("T").type();
+  if ((type != DT_INT32 && type != DT_INT64) ||
+      shape_node->attr().count("T") == 0) {
+    return false;
+  }
+
+  const TensorShapeProto& shape =
+      properties.GetInputProperties(shape_node->name())[0].shape();
+  int64 selected_product = 1;
+  bool selected_known = true;
+  std::vector<bool> is_selected(shape.dim_size(), false);
+  for (int dim : dims) {
+    is_selected[dim] = true;
+    const int64 size = shape.dim(dim).size();
+    if (size < 0) {
+      selected_known = false;
+    } else {
+      selected_product *= size;
+    }
+  }
+  int64 unselected_product = 1;
+  bool unselected_known = true;
+  for (int i = 0; i < shape.dim_size(); ++i) {
+    if (is_selected[i]) continue;
+    const int64 size = shape.dim(i).size();
+    if (size < 0) {
+      unselected_known = false;
+    } else {
+      unselected_product *= size;
+    }
+  }
+
+  const string x = shape_node->input(0);
+  if (selected_known) {
+    // The product only depends on known dimensions.
+    Tensor value(type, TensorShape({}));
+    if (type == DT_INT32) {
+      if (selected_product > std::numeric_limits<int32>::max()) return false;
+      value.scalar<int32>()() = selected_product;
+    } else {
+      value.scalar<int64>()() = selected_product;
+    }
+    // Only depend on `x`, to preserve the execution frame of the node.
+    const string ctrl_dep =
+        AddControlDependency(x, optimized_graph, node_map_.get());
+    node_map_->RemoveOutput(NodeName(node->input(0)), node->name());
+    node_map_->RemoveOutput(NodeName(node->input(1)), node->name());
+    node->mutable_input()->DeleteSubrange(0, 2);
+    node->add_input(ctrl_dep);
+    node_map_->AddOutput(NodeName(ctrl_dep), node->name());
+    DedupControlInputs(node);
+
+    node->set_op("Const");
+    EraseRegularNodeAttributes(node);
+    (*node->mutable_attr())["dtype"].set_type(type);
+    value.AsProtoTensorContent(
+        (*node->mutable_attr())["value"].mutable_tensor());
+    return true;
+  }
+  if (!unselected_known || unselected_product == 0) {
+    return false;
+  }
+  // Size(x) can overflow an int32 even when the product of the selected
+  // dimensions fits, e.g. Prod(Shape(x)[:-1]) for a [1000000, 4096] tensor,
+  // and the element count of `x` isn't statically known here. Only use it
+  // when it equals the product, so it can't overflow where the Prod didn't.
+  if (type == DT_INT32 && unselected_product != 1) {
+    return false;
+  }
+
+  // The product of the selected dimensions is the number of elements of `x`
+  // divided by the product of the other (known) dimensions.
+  NodeDef* size_node = node;
+  if (unselected_product != 1) {
+    const string size_name = OptimizedNodeName(*node, "_size");
+    const string divisor_name = OptimizedNodeName(*node, "_divisor");
+    if (node_map_->NodeExists(size_name) ||
+        node_map_->NodeExists(divisor_name)) {
+      return false;
+    }
+    size_node = optimized_graph->add_node();
+    size_node->set_name(size_name);
+    size_node->set_device(node->device());
+    size_node->add_input(x);
+    node_map_->AddNode(size_name, size_node);
+    node_map_->AddOutput(NodeName(x), size_name);
+
+    Tensor divisor(type, TensorShape({}));
+    divisor.scalar<int64>()() = unselected_product;
+    NodeDef* divisor_node = optimized_graph->add_node();
+    TF_CHECK_OK(CreateNodeDef(divisor_name, TensorValue(&divisor),
+                              divisor_node));
+    divisor_node->set_device(node->device());
+    *divisor_node->add_input() = AsControlDependency(size_name);
+    node_map_->AddNode(divisor_name, divisor_node);
+    node_map_->AddOutput(size_name, divisor_name);
+
+    node->set_op("FloorDiv");
+    EraseRegularNodeAttributes(node);
+    (*node->mutable_attr())["T"].set_type(type);
+    node_map_->UpdateInput(node->name(), node->input(0), size_name);
+    node_map_->UpdateInput(node->name(), node->input(1), divisor_name);
+    node->set_input(0, size_name);
+    node->set_input(1, divisor_name);
+  } else {
+    node_map_->UpdateInput(node->name(), node->input(0), x);
+    node_map_->RemoveOutput(NodeName(node->input(1)), node->name());
+    node->set_input(0, x);
+    node->mutable_input()->SwapElements(1, node->input_size() - 1);
+    node->mutable_input()->RemoveLast();
+  }
+  size_node->set_op("Size");
+  EraseRegularNodeAttributes(size_node);
+  (*size_node->mutable_attr())["T"] = shape_node->attr().at("T");
+  (*size_node->mutable_attr())["out_type"].set_type(type);
+  return true;
+}
+
 Status ConstantFolding::SimplifyArithmeticOperations(
     const GraphProperties& properties, bool use_shape_info,
     GraphDef* optimized_graph, NodeDef* node) {
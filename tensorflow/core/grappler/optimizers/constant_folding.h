@@ -218,6 +218,20 @@ class ConstantFolding : public GraphOptimizer {
   bool SimplifyReshape(const GraphProperties& properties, bool use_shape_info,
                        NodeDef* node);
 
+  // Returns the dimensions of the input of a Shape node selected by `node`,
+  // which must be either that Shape node or a constant Slice or StridedSlice of
+  // it. Sets *shape_node to the Shape node.
+  bool GetSelectedShapeDims(const NodeDef& node,
+                            const GraphProperties& properties,
+                            const NodeDef** shape_node,
+                            std::vector<int>* dims);
+
+  // Simplifies the product of (a slice of) the shape of a tensor with a
+  // partially known shape, e.g. Prod(StridedSlice(Shape(x), 1, 0)) to a
+  // constant, Size(x) or, for int64 shapes, Size(x) divided by a constant.
+  bool SimplifyShapeProd(const GraphProperties& properties, bool use_shape_info,
+                         GraphDef* optimized_graph, NodeDef* node);
+
   // Returns true iff the node is a reduction and its reduction indices are
   // constant. Sets *indices_is_empty to true if the set of dimensions to reduce
   // along is empty (this happens often in the gradient graphs).
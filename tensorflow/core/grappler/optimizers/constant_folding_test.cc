@@ -1765,6 +1765,130 @@ TEST_F(ConstantFoldingTest, ShapeMaterializationShapeN_MultipleOutputs) {
     test::ExpectTensorEqual<int>(tensors_expected[i], tensors[i]);
 }
 
+TEST_F(ConstantFoldingTest, SymbolicShapeProd) {
+  tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(scope.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({-1, 4, 8}));
+  Output shape = ops::Shape(scope.WithOpName("shape"), x);
+  Output axis = ops::Const(scope.WithOpName("axis"), 0);
+  // Product of the known inner dimensions.
+  Output inner = ops::StridedSlice(scope.WithOpName("inner"), shape, {1}, {0},
+                                   {1}, ops::StridedSlice::EndMask(1));
+  Output p1 = ops::Prod(scope.WithOpName("p1"), inner, axis);
+  // Product of all dimensions.
+  Output p2 = ops::Prod(scope.WithOpName("p2"), shape, axis);
+  // Product of the unknown batch and one known dimension.
+  Output shape64 = ops::Shape(scope.WithOpName("shape64"), x,
+                              ops::Shape::OutType(DT_INT64));
+  Output outer = ops::StridedSlice(scope.WithOpName("outer"), shape64, {0},
+                                   {2}, {1});
+  Output p3 = ops::Prod(scope.WithOpName("p3"), outer, axis);
+
+  GrapplerItem item;
+  item.fetch = {"p1", "p2", "p3"};
+  TF_CHECK_OK(scope.ToGraphDef(&item.graph));
+
+  ConstantFolding optimizer(/*cpu_device=*/nullptr);
+  GraphDef output;
+  Status status = optimizer.Optimize(/*cluster=*/nullptr, item, &output);
+  TF_EXPECT_OK(status);
+
+  int found = 0;
+  for (const auto& node : output.node()) {
+    if (node.name() == "p1") {
+      ++found;
+      EXPECT_EQ("Const", node.op());
+      Tensor value;
+      CHECK(value.FromProto(node.attr().at("value").tensor()));
+      EXPECT_EQ(32, value.scalar<int>()());
+    } else if (node.name() == "p2") {
+      ++found;
+      EXPECT_EQ("Size", node.op());
+      ASSERT_EQ(1, node.input_size());
+      EXPECT_EQ("x", node.input(0));
+    } else if (node.name() == "p3") {
+      ++found;
+      EXPECT_EQ("FloorDiv", node.op());
+      ASSERT_EQ(2, node.input_size());
+      EXPECT_EQ(AddPrefixToNodeName("p3_size", kConstantFoldingConst),
+                node.input(0));
+      EXPECT_EQ(AddPrefixToNodeName("p3_divisor", kConstantFoldingConst),
+                node.input(1));
+    } else if (node.name() ==
+               AddPrefixToNodeName("p3_size", kConstantFoldingConst)) {
+      ++found;
+      EXPECT_EQ("Size", node.op());
+      EXPECT_EQ("x", node.input(0));
+    }
+  }
+  EXPECT_EQ(4, found);
+
+  auto x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({3, 4, 8}));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, {{"x", x_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", x_t}});
+  ASSERT_EQ(3, tensors.size());
+  for (int i = 0; i < 2; ++i) {
+    test::ExpectTensorEqual<int>(tensors_expected[i], tensors[i]);
+  }
+  test::ExpectTensorEqual<int64>(tensors_expected[2], tensors[2]);
+}
+
+TEST_F(ConstantFoldingTest, SymbolicShapeProdLargeShape) {
+  // A [1000000, 4096] tensor has more elements than fit in an int32, although
+  // the product of its outer dimensions does.
+  tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(scope.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({-1, 4096}));
+  Output axis = ops::Const(scope.WithOpName("axis"), 0);
+  Output shape = ops::Shape(scope.WithOpName("shape"), x);
+  Output outer = ops::StridedSlice(scope.WithOpName("outer"), shape, {0}, {-1},
+                                   {1});
+  Output p32 = ops::Prod(scope.WithOpName("p32"), outer, axis);
+  Output shape64 = ops::Shape(scope.WithOpName("shape64"), x,
+                              ops::Shape::OutType(DT_INT64));
+  Output outer64 = ops::StridedSlice(scope.WithOpName("outer64"), shape64, {0},
+                                     {-1}, {1});
+  Output p64 = ops::Prod(scope.WithOpName("p64"), outer64, axis);
+
+  GrapplerItem item;
+  item.fetch = {"p32", "p64"};
+  TF_CHECK_OK(scope.ToGraphDef(&item.graph));
+
+  ConstantFolding optimizer(/*cpu_device=*/nullptr);
+  GraphDef output;
+  Status status = optimizer.Optimize(/*cluster=*/nullptr, item, &output);
+  TF_EXPECT_OK(status);
+
+  int found = 0;
+  for (const auto& node : output.node()) {
+    if (node.name() == "p32") {
+      ++found;
+      // Size(x) would overflow the int32 output.
+      EXPECT_EQ("Prod", node.op());
+    } else if (node.name() == "p64") {
+      ++found;
+      EXPECT_EQ("FloorDiv", node.op());
+    } else if (node.name() ==
+               AddPrefixToNodeName("p64_size", kConstantFoldingConst)) {
+      ++found;
+      EXPECT_EQ("Size", node.op());
+      EXPECT_EQ(DT_INT64, node.attr().at("out_type").type());
+    }
+  }
+  EXPECT_EQ(3, found);
+  for (const auto& node : output.node()) {
+    EXPECT_NE(AddPrefixToNodeName("p32_size", kConstantFoldingConst),
+              node.name());
+  }
+
+  auto x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({3, 4096}));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, {{"x", x_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", x_t}});
+  ASSERT_EQ(2, tensors.size());
+  test::ExpectTensorEqual<int>(tensors_expected[0], tensors[0]);
+  test::ExpectTensorEqual<int64>(tensors_expected[1], tensors[1]);
+}
+
 TEST_F(ConstantFoldingTest, SwitchNodesEmptyFetch) {
   tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
   ops::Variable v_in(scope.WithOpName("v_in"), {3}, DT_FLOAT);
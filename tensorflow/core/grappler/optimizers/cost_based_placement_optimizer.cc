@@ -0,0 +1,284 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/cost_based_placement_optimizer.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/costs/analytical_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/calibrated_op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/grappler/costs/virtual_placer.h"
+#include "tensorflow/core/grappler/costs/virtual_scheduler.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/grappler/utils/tpu.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+// Fixed overhead of a Send/Recv pair between two devices.
+constexpr double kTransferLatencyNs = 5000.0;
+
+// Placements that are predicted to be less than this fraction faster than the
+// original one are not worth the extra cross-device traffic.
+constexpr double kMinImprovement = 0.05;
+
+bool IsPlaceableDeviceType(const string& type) {
+  return type == DEVICE_CPU || type == DEVICE_GPU;
+}
+
+bool HasRefOrResource(const std::vector<OpInfo::TensorProperties>& props) {
+  for (const auto& prop : props) {
+    if (IsRefType(prop.dtype()) || prop.dtype() == DT_RESOURCE) return true;
+  }
+  return false;
+}
+
+// Returns the device requested for `node`, as opposed to the one assigned to
+// it by the placer.
+const string& RequestedDevice(const NodeDef& node, const GrapplerItem& item) {
+  auto it = item.requested_devices.find(node.name());
+  return it == item.requested_devices.end() ? node.device() : it->second;
+}
+
+// Returns true if the placement of `node` is left to the placer, and the node
+// can safely run on any device that has a kernel for it.
+bool IsMovable(const NodeDef& node, const GrapplerItem& item,
+               const GraphProperties& properties,
+               const std::unordered_set<string>& nodes_to_preserve) {
+  if (nodes_to_preserve.count(node.name()) > 0) return false;
+  if (IsControlFlow(node) || IsCollective(node) || IsNoOp(node) ||
+      IsSend(node) || IsRecv(node) || IsStateful(node)) {
+    return false;
+  }
+  if (node.attr().count(kColocationAttrName) > 0) return false;
+  // Convolutions, pooling, BiasAdd and FusedBatchNorm only support channels
+  // last layouts on CPU, so nodes in any other layout must stay on the device
+  // that was picked for them.
+  auto data_format = node.attr().find("data_format");
+  if (data_format != node.attr().end() && data_format->second.s() != "NHWC" &&
+      data_format->second.s() != "NDHWC") {
+    return false;
+  }
+  const string& requested_device = RequestedDevice(node, item);
+  if (!requested_device.empty()) {
+    // Respect the device type requested by the user.
+    DeviceNameUtils::ParsedName parsed;
+    if (!DeviceNameUtils::ParseFullName(requested_device, &parsed) ||
+        parsed.has_type) {
+      return false;
+    }
+  }
+  return !HasRefOrResource(properties.GetInputProperties(node.name())) &&
+         !HasRefOrResource(properties.GetOutputProperties(node.name()));
+}
+
+// Returns the time in nanoseconds needed to copy `bytes` from `src` to `dst`.
+double TransferTimeNs(int64 bytes, const DeviceProperties& src,
+                      const DeviceProperties& dst) {
+  // Bandwidth is in KB/s, which is conveniently 1e-6 bytes per nanosecond.
+  const int64 bandwidth = std::min(src.bandwidth(), dst.bandwidth());
+  if (bandwidth <= 0) return kTransferLatencyNs;
+  return kTransferLatencyNs + 1e6 * static_cast<double>(bytes) / bandwidth;
+}
+
+}  // namespace
+
+Status CostBasedPlacementOptimizer::Optimize(Cluster* cluster,
+                                             const GrapplerItem& item,
+                                             GraphDef* optimized_graph) {
+  if (cluster == nullptr) {
+    return errors::Aborted("cluster == nullptr.");
+  }
+  if (IsTPUGraphDef(item.graph)) {
+    return errors::Aborted("Nothing to do.");
+  }
+
+  // All devices of the cluster in a deterministic order, and the indices of
+  // the ones we are allowed to place nodes on.
+  std::vector<std::pair<string, DeviceProperties>> devices(
+      cluster->GetDevices().begin(), cluster->GetDevices().end());
+  std::sort(devices.begin(), devices.end(),
+            [](const std::pair<string, DeviceProperties>& a,
+               const std::pair<string, DeviceProperties>& b) {
+              return a.first < b.first;
+            });
+  absl::flat_hash_map<string, int> device_index;
+  std::vector<int> placeable_devices;
+  for (int i = 0; i < devices.size(); ++i) {
+    device_index[devices[i].first] = i;
+    if (IsPlaceableDeviceType(devices[i].second.type())) {
+      placeable_devices.push_back(i);
+    }
+  }
+  if (placeable_devices.size() < 2) {
+    return errors::Aborted("Nothing to do.");
+  }
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(
+      /*assume_valid_feeds=*/false,
+      /*aggressive_shape_inference=*/false,
+      /*include_input_tensor_values=*/false,
+      /*include_output_tensor_values=*/false));
+
+  std::vector<const NodeDef*> topo_order;
+  TF_RETURN_IF_ERROR(ComputeTopologicalOrder(item.graph, &topo_order));
+
+  std::unordered_map<string, const NodeDef*> name_to_node;
+  for (const NodeDef& node : item.graph.node()) {
+    name_to_node[node.name()] = &node;
+  }
+
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  const VirtualPlacer placer(cluster->GetDevices());
+  std::unique_ptr<OpLevelCostEstimator> node_estimator =
+      CreateOpLevelCostEstimator(op_cost_table_);
+
+  // Simulated per device timelines, and for each node its assigned device and
+  // the time at which its outputs become available there.
+  std::vector<double> device_ready(devices.size(), 0.0);
+  absl::flat_hash_map<string, int> node_device;
+  absl::flat_hash_map<string, double> node_finish;
+  node_device.reserve(topo_order.size());
+  node_finish.reserve(topo_order.size());
+  int num_moved = 0;
+
+  for (const NodeDef* node : topo_order) {
+    GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+    auto it = device_index.find(placer.get_canonical_device_name(*node));
+    if (it == device_index.end()) {
+      return errors::Aborted("Could not find device of node ", node->name());
+    }
+    const int original_device = it->second;
+
+    std::vector<int> options;
+    if (IsMovable(*node, item, properties, nodes_to_preserve)) {
+      for (int device : placeable_devices) {
+        const KernelDef* kernel = nullptr;
+        if (FindKernelDef(DeviceType(devices[device].second.type()), *node,
+                          &kernel, nullptr)
+                .ok()) {
+          options.push_back(device);
+        }
+      }
+    }
+    if (options.empty()) options.push_back(original_device);
+
+    OpContext op_context;
+    op_context.name = node->name();
+    op_context.op_info = BuildOpInfoWithoutDevice(
+        *node, name_to_node, properties.GetInputProperties(node->name()));
+    for (const auto& output : properties.GetOutputProperties(node->name())) {
+      *op_context.op_info.add_outputs() = output;
+    }
+
+    int best_device = original_device;
+    double best_finish = std::numeric_limits<double>::infinity();
+    for (int device : options) {
+      double start = device_ready[device];
+      for (const string& input : node->input()) {
+        const TensorId tensor = ParseTensorName(input);
+        const string input_node(tensor.node());
+        auto finish_it = node_finish.find(input_node);
+        if (finish_it == node_finish.end()) continue;
+        double ready = finish_it->second;
+        const int input_device = node_device[input_node];
+        if (input_device != device) {
+          const int64 bytes = CalculateOutputSize(
+              properties.GetOutputProperties(input_node), tensor.index());
+          ready += TransferTimeNs(bytes, devices[input_device].second,
+                                  devices[device].second);
+        }
+        start = std::max(start, ready);
+      }
+
+      op_context.device_name = devices[device].first;
+      *op_context.op_info.mutable_device() = devices[device].second;
+      const double finish =
+          start + static_cast<double>(
+                      node_estimator->PredictCosts(op_context)
+                          .execution_time.count());
+      // Prefer the original device on ties to avoid needless transfers.
+      if (finish < best_finish ||
+          (finish == best_finish && device == original_device)) {
+        best_finish = finish;
+        best_device = device;
+      }
+    }
+
+    device_ready[best_device] = best_finish;
+    node_device[node->name()] = best_device;
+    node_finish[node->name()] = best_finish;
+    if (best_device != original_device) ++num_moved;
+  }
+
+  if (num_moved == 0) {
+    return errors::Aborted("Nothing to do.");
+  }
+
+  *optimized_graph = item.graph;
+  for (NodeDef& node : *optimized_graph->mutable_node()) {
+    auto it = node_device.find(node.name());
+    if (it == node_device.end()) continue;
+    const string& device = devices[it->second].first;
+    if (placer.get_canonical_device_name(node) != device) {
+      VLOG(2) << "Moving node " << node.name() << " to device " << device;
+      node.set_device(device);
+    }
+  }
+
+  // The greedy schedule above ignores memory and the limited parallelism of
+  // the runtime, so validate the new placement with the VirtualScheduler and
+  // keep the original placement unless the predicted step time improves.
+  AnalyticalCostEstimator estimator(
+      cluster, CreateOpLevelCostEstimator(op_cost_table_),
+      ReadyNodeManagerFactory("FirstReady"), /*use_static_shapes=*/true,
+      /*use_aggressive_shape_inference=*/false);
+  TF_RETURN_IF_ERROR(estimator.Initialize(item));
+  Costs original_costs;
+  Costs placed_costs;
+  TF_RETURN_IF_ERROR(estimator.PredictCosts(
+      item.graph, /*run_metadata=*/nullptr, &original_costs));
+  TF_RETURN_IF_ERROR(estimator.PredictCosts(
+      *optimized_graph, /*run_metadata=*/nullptr, &placed_costs));
+  const double original_time = original_costs.execution_time.count();
+  const double placed_time = placed_costs.execution_time.count();
+  VLOG(1) << "Cost based placement moved " << num_moved
+          << " nodes, predicted step time " << original_time << "ns -> "
+          << placed_time << "ns";
+  if (placed_time > original_time * (1.0 - kMinImprovement)) {
+    *optimized_graph = item.graph;
+    return errors::Aborted("Placement does not improve predicted step time.");
+  }
+  return Status::OK();
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
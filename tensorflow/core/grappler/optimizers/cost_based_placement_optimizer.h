@@ -0,0 +1,67 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COST_BASED_PLACEMENT_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COST_BASED_PLACEMENT_OPTIMIZER_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Assigns ops without a user specified device type to the devices of the
+// cluster (e.g. one CPU device per NUMA node, and accelerators), so as to
+// minimize the makespan predicted by the analytical cost model. When the graph
+// was already placed (as in a session), the device types assigned by the
+// placer can be changed, only the ones in GrapplerItem::requested_devices are
+// respected.
+//
+// Nodes are placed greedily in topological order on the device where they
+// would finish earliest, taking into account the time needed to transfer
+// their inputs from other devices. The resulting placement is kept only if
+// the VirtualScheduler predicts a shorter step time than for the original
+// placement.
+//
+// Stateful ops, ops consuming or producing resources or references, and ops
+// with colocation constraints are never moved.
+class CostBasedPlacementOptimizer : public GraphOptimizer {
+ public:
+  CostBasedPlacementOptimizer() {}
+  explicit CostBasedPlacementOptimizer(RewriterConfig::Toggle opt_level,
+                                       const string& op_cost_table = "")
+      : op_cost_table_(op_cost_table) {}
+
+  ~CostBasedPlacementOptimizer() override {}
+
+  string name() const override { return "cost_based_placement_optimizer"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+
+ private:
+  // Path of the measured op costs, see RewriterConfig.op_cost_table.
+  const string op_cost_table_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COST_BASED_PLACEMENT_OPTIMIZER_H_
@@ -0,0 +1,185 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/cost_based_placement_optimizer.h"
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kCpu0[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+constexpr char kCpu1[] = "/job:localhost/replica:0/task:0/device:CPU:1";
+
+class CostBasedPlacementOptimizerTest : public GrapplerTest {
+ protected:
+  // Returns a cluster with one CPU device per socket.
+  static std::unique_ptr<VirtualCluster> CreateVirtualCluster(int num_cpus) {
+    DeviceProperties cpu_device;
+    cpu_device.set_type("CPU");
+    cpu_device.set_frequency(1000);
+    cpu_device.set_num_cores(4);
+    cpu_device.set_bandwidth(100 * 1000 * 1000);
+    cpu_device.set_memory_size(1024 * 1024 * 1024);
+    std::unordered_map<string, DeviceProperties> devices;
+    devices[kCpu0] = cpu_device;
+    if (num_cpus > 1) devices[kCpu1] = cpu_device;
+    return absl::make_unique<VirtualCluster>(devices);
+  }
+
+  // Builds two independent chains of matrix multiplications.
+  static GrapplerItem CreateTwoChains() {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    auto x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({1024, 1024}));
+    auto y = ops::Placeholder(s.WithOpName("y"), DT_FLOAT,
+                              ops::Placeholder::Shape({1024, 1024}));
+    auto a1 = ops::MatMul(s.WithOpName("a1"), x, x);
+    auto a2 = ops::MatMul(s.WithOpName("a2"), a1, a1);
+    auto a3 = ops::MatMul(s.WithOpName("a3"), a2, a2);
+    auto b1 = ops::MatMul(s.WithOpName("b1"), y, y);
+    auto b2 = ops::MatMul(s.WithOpName("b2"), b1, b1);
+    auto b3 = ops::MatMul(s.WithOpName("b3"), b2, b2);
+    auto sum = ops::Add(s.WithOpName("sum"), a3, b3);
+
+    GrapplerItem item;
+    item.fetch = {"sum"};
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+    return item;
+  }
+
+  static string DeviceOf(const GraphDef& graph, const string& name) {
+    for (const NodeDef& node : graph.node()) {
+      if (node.name() == name) {
+        return node.device().empty() ? kCpu0 : node.device();
+      }
+    }
+    return "";
+  }
+};
+
+TEST_F(CostBasedPlacementOptimizerTest, SpreadsIndependentChains) {
+  GrapplerItem item = CreateTwoChains();
+  std::unique_ptr<VirtualCluster> cluster = CreateVirtualCluster(2);
+
+  CostBasedPlacementOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  EXPECT_EQ(output.node_size(), item.graph.node_size());
+  EXPECT_NE(DeviceOf(output, "a1"), DeviceOf(output, "b1"));
+  EXPECT_EQ(DeviceOf(output, "a1"), DeviceOf(output, "a2"));
+  EXPECT_EQ(DeviceOf(output, "b1"), DeviceOf(output, "b2"));
+  // Fetch nodes keep their placement.
+  EXPECT_EQ(DeviceOf(output, "sum"), kCpu0);
+}
+
+TEST_F(CostBasedPlacementOptimizerTest, RespectsRequestedDeviceType) {
+  GrapplerItem item = CreateTwoChains();
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    node.set_device("/device:CPU:0");
+  }
+  std::unique_ptr<VirtualCluster> cluster = CreateVirtualCluster(2);
+
+  CostBasedPlacementOptimizer optimizer;
+  GraphDef output;
+  Status status = optimizer.Optimize(cluster.get(), item, &output);
+  EXPECT_EQ(status.code(), error::ABORTED);
+}
+
+TEST_F(CostBasedPlacementOptimizerTest, MovesNodesPlacedByThePlacer) {
+  // As in a session, where the graph is placed before being optimized.
+  GrapplerItem item = CreateTwoChains();
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    node.set_device(kCpu0);
+    item.requested_devices[node.name()] = "";
+  }
+  std::unique_ptr<VirtualCluster> cluster = CreateVirtualCluster(2);
+
+  CostBasedPlacementOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+  EXPECT_NE(DeviceOf(output, "a1"), DeviceOf(output, "b1"));
+  EXPECT_EQ(DeviceOf(output, "sum"), kCpu0);
+}
+
+TEST_F(CostBasedPlacementOptimizerTest, RespectsRequestedDeviceTypeOfPlaced) {
+  GrapplerItem item = CreateTwoChains();
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    node.set_device(kCpu0);
+    item.requested_devices[node.name()] = "/device:CPU:0";
+  }
+  std::unique_ptr<VirtualCluster> cluster = CreateVirtualCluster(2);
+
+  CostBasedPlacementOptimizer optimizer;
+  GraphDef output;
+  Status status = optimizer.Optimize(cluster.get(), item, &output);
+  EXPECT_EQ(status.code(), error::ABORTED);
+}
+
+TEST_F(CostBasedPlacementOptimizerTest, KeepsChannelsFirstNodes) {
+  // Two independent chains of convolutions in the NCHW layout, which the CPU
+  // kernels do not support.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  auto filter = ops::Placeholder(s.WithOpName("filter"), DT_FLOAT,
+                                 ops::Placeholder::Shape({3, 3, 64, 64}));
+  auto conv_attrs = ops::Conv2D::DataFormat("NCHW");
+  Output chains[2];
+  for (int i = 0; i < 2; ++i) {
+    const string prefix = i == 0 ? "a" : "b";
+    Output x = ops::Placeholder(s.WithOpName(prefix + "_input"), DT_FLOAT,
+                                ops::Placeholder::Shape({8, 64, 128, 128}));
+    for (int j = 1; j <= 3; ++j) {
+      x = ops::Conv2D(s.WithOpName(strings::StrCat(prefix, j)), x, filter,
+                      {1, 1, 1, 1}, "SAME", conv_attrs);
+    }
+    chains[i] = x;
+  }
+  auto sum = ops::Add(s.WithOpName("sum"), chains[0], chains[1]);
+
+  GrapplerItem item;
+  item.fetch = {"sum"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  std::unique_ptr<VirtualCluster> cluster = CreateVirtualCluster(2);
+
+  // None of the convolutions can move, and moving only the placeholders would
+  // just add transfers, so the placement is left unchanged.
+  CostBasedPlacementOptimizer optimizer;
+  GraphDef output;
+  Status status = optimizer.Optimize(cluster.get(), item, &output);
+  EXPECT_EQ(status.code(), error::ABORTED);
+}
+
+TEST_F(CostBasedPlacementOptimizerTest, SingleDevice) {
+  GrapplerItem item = CreateTwoChains();
+  std::unique_ptr<VirtualCluster> cluster = CreateVirtualCluster(1);
+
+  CostBasedPlacementOptimizer optimizer;
+  GraphDef output;
+  Status status = optimizer.Optimize(cluster.get(), item, &output);
+  EXPECT_EQ(status.code(), error::ABORTED);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,207 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/decode_and_resize_fusion.h"
+
+#include <array>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/utils.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kFusedOpName[] = "_DecodeAndResizeJpeg";
+
+// Attributes of DecodeJpeg which are forwarded to the fused op.
+constexpr std::array<const char*, 5> kDecodeAttrs = {
+    "channels", "fancy_upscaling", "try_recover_truncated",
+    "acceptable_fraction", "dct_method"};
+
+// Returns the node producing the `i`-th input of `node` if it is its first
+// output, and `node` is its only consumer.
+NodeDef* GetSingleUseInputNode(const NodeDef& node, int i,
+                               const MutableGraphView& graph) {
+  if (i >= node.input_size() || IsControlInput(node.input(i)) ||
+      ParseTensorName(node.input(i)).index() != 0) {
+    return nullptr;
+  }
+  NodeDef* input = graph_utils::GetInputNode(node, graph, i);
+  if (input == nullptr || HasControlInputs(*input) ||
+      graph.NumFanouts(*input, /*include_controlled_nodes=*/true) != 1) {
+    return nullptr;
+  }
+  return input;
+}
+
+bool IsConstZero(const NodeDef* node) {
+  if (node == nullptr || !IsConstant(*node)) return false;
+  Tensor value;
+  if (!value.FromProto(node->attr().at("value").tensor()) ||
+      value.NumElements() != 1) {
+    return false;
+  }
+  if (value.dtype() == DT_INT32) return value.flat<int32>()(0) == 0;
+  if (value.dtype() == DT_INT64) return value.flat<int64>()(0) == 0;
+  return false;
+}
+
+// The nodes of a fusable chain.
+struct DecodeAndResize {
+  const NodeDef* decode = nullptr;
+  // Null if the whole image is resized.
+  const NodeDef* slice = nullptr;
+  const NodeDef* expand_dims = nullptr;
+  const NodeDef* resize = nullptr;
+};
+
+bool FindDecodeAndResize(const NodeDef& resize, const MutableGraphView& graph,
+                         DecodeAndResize* chain) {
+  if (resize.op() != "ResizeBilinear" || resize.input_size() < 2 ||
+      resize.attr().at("T").type() != DT_UINT8 ||
+      !(resize.device().empty() || NodeIsOnCpu(&resize))) {
+    return false;
+  }
+  chain->resize = &resize;
+  chain->expand_dims = GetSingleUseInputNode(resize, 0, graph);
+  if (chain->expand_dims == nullptr ||
+      chain->expand_dims->op() != "ExpandDims" ||
+      !IsConstZero(graph_utils::GetInputNode(*chain->expand_dims, graph, 1))) {
+    return false;
+  }
+  const NodeDef* image = GetSingleUseInputNode(*chain->expand_dims, 0, graph);
+  if (image != nullptr && IsSlice(*image) &&
+      image->attr().at("Index").type() == DT_INT32) {
+    chain->slice = image;
+    image = GetSingleUseInputNode(*chain->slice, 0, graph);
+  }
+  if (image == nullptr || image->op() != "DecodeJpeg") return false;
+  const auto ratio = image->attr().find("ratio");
+  if (ratio != image->attr().end() && ratio->second.i() != 1) return false;
+  chain->decode = image;
+  return true;
+}
+
+NodeDef MakeFusedNode(const DecodeAndResize& chain,
+                      const string& empty_crop_window,
+                      MutableGraphView* graph) {
+  NodeDef fused;
+  fused.set_op(kFusedOpName);
+  graph_utils::SetUniqueGraphNodeName(chain.resize->name(), graph->graph(),
+                                      &fused);
+  fused.set_device(chain.resize->device());
+  fused.add_input(chain.decode->input(0));
+  if (chain.slice != nullptr) {
+    fused.add_input(chain.slice->input(1));
+    fused.add_input(chain.slice->input(2));
+  } else {
+    fused.add_input(empty_crop_window);
+    fused.add_input(empty_crop_window);
+  }
+  fused.add_input(chain.resize->input(1));
+  for (int i = 2; i < chain.resize->input_size(); ++i) {
+    fused.add_input(chain.resize->input(i));
+  }
+  for (const char* attr : kDecodeAttrs) {
+    if (chain.decode->attr().contains(attr)) {
+      graph_utils::CopyAttribute(attr, *chain.decode, &fused);
+    }
+  }
+  for (const char* attr : {"align_corners", "half_pixel_centers"}) {
+    if (chain.resize->attr().contains(attr)) {
+      graph_utils::CopyAttribute(attr, *chain.resize, &fused);
+    }
+  }
+  return fused;
+}
+
+}  // namespace
+
+Status DecodeAndResizeFusion::OptimizeAndCollectStats(
+    Cluster* cluster, const GrapplerItem& item, GraphDef* output,
+    OptimizationStats* stats) {
+  *output = item.graph;
+  MutableGraphView graph(output);
+  const auto nodes_to_preserve = item.NodesToPreserve();
+
+  std::vector<DecodeAndResize> chains;
+  for (const NodeDef& node : output->node()) {
+    DecodeAndResize chain;
+    if (nodes_to_preserve.count(node.name()) == 0 &&
+        FindDecodeAndResize(node, graph, &chain) &&
+        nodes_to_preserve.count(chain.decode->name()) == 0 &&
+        nodes_to_preserve.count(chain.expand_dims->name()) == 0 &&
+        (chain.slice == nullptr ||
+         nodes_to_preserve.count(chain.slice->name()) == 0)) {
+      chains.push_back(chain);
+    }
+  }
+  if (chains.empty()) return Status::OK();
+
+  // All the resizes of the whole image share the same empty crop window.
+  string empty_crop_window;
+  for (const DecodeAndResize& chain : chains) {
+    if (chain.slice != nullptr) continue;
+    NodeDef empty;
+    empty.set_op("Const");
+    graph_utils::SetUniqueGraphNodeName("empty_crop_window", output, &empty);
+    empty.set_device(chain.resize->device());
+    (*empty.mutable_attr())["dtype"].set_type(DT_INT32);
+    Tensor(DT_INT32, TensorShape({0}))
+        .AsProtoTensorContent(
+            (*empty.mutable_attr())["value"].mutable_tensor());
+    empty_crop_window = graph.AddNode(std::move(empty))->name();
+    break;
+  }
+
+  absl::flat_hash_set<string> nodes_to_delete;
+  for (const DecodeAndResize& chain : chains) {
+    NodeDef* fused =
+        graph.AddNode(MakeFusedNode(chain, empty_crop_window, &graph));
+    TF_RETURN_IF_ERROR(
+        graph.UpdateFanouts(chain.resize->name(), fused->name()));
+    nodes_to_delete.insert(chain.resize->name());
+    nodes_to_delete.insert(chain.expand_dims->name());
+    if (chain.slice != nullptr) nodes_to_delete.insert(chain.slice->name());
+    nodes_to_delete.insert(chain.decode->name());
+    stats->num_changes++;
+  }
+  TF_RETURN_IF_ERROR(graph.DeleteNodes(nodes_to_delete));
+  return Status::OK();
+}
+
+void DecodeAndResizeFusion::Feedback(Cluster* cluster,
+                                     const GrapplerItem& item,
+                                     const GraphDef& optimize_output,
+                                     double result) {
+  // no-op
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(DecodeAndResizeFusion, "decode_and_resize_fusion");
+
+}  // namespace grappler
+}  // namespace tensorflow
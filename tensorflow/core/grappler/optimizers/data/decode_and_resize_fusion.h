@@ -0,0 +1,56 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_DECODE_AND_RESIZE_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_DECODE_AND_RESIZE_FUSION_H_
+
+#include "tensorflow/core/grappler/optimizers/data/optimizer_base.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// This optimization fuses the `DecodeJpeg -> [Slice ->] ExpandDims ->
+// ResizeBilinear` chains of the tf.data functions, as built by
+// `tf.image.resize(tf.io.decode_jpeg(...), size)` with an optional crop in
+// between, into a `_DecodeAndResizeJpeg` op. The fused op decodes the JPEG
+// images (or their crop window) at a reduced scale whenever the resize
+// downsamples them, so its results differ slightly from the unfused ops, and
+// it only decodes JPEG images, whereas DecodeJpeg also decodes PNG and GIF.
+class DecodeAndResizeFusion : public TFDataOptimizerBase {
+ public:
+  DecodeAndResizeFusion() = default;
+  ~DecodeAndResizeFusion() override = default;
+
+  string name() const override { return "decode_and_resize_fusion"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Init(
+      const tensorflow::RewriterConfig_CustomGraphOptimizer* config) override {
+    return Status::OK();
+  }
+
+  Status OptimizeAndCollectStats(Cluster* cluster, const GrapplerItem& item,
+                                 GraphDef* output,
+                                 OptimizationStats* stats) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimize_output, double result) override;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_DECODE_AND_RESIZE_FUSION_H_
@@ -0,0 +1,146 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/decode_and_resize_fusion.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using test::function::NDef;
+
+NodeDef MakeResizeNode(const string& name, const string& input) {
+  return NDef(name, "ResizeBilinear", {input, "size"},
+              {{"T", DT_UINT8},
+               {"align_corners", false},
+               {"half_pixel_centers", true}});
+}
+
+TEST(DecodeAndResizeFusionTest, FuseDecodeAndResize) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("contents", "Placeholder", {}, {{"dtype", DT_STRING}}),
+       NDef("decode", "DecodeJpeg", {"contents"},
+            {{"channels", 3}, {"dct_method", "INTEGER_ACCURATE"}}),
+       NDef("zero", "Const", {}, {{"value", 0}, {"dtype", DT_INT32}}),
+       NDef("expand_dims", "ExpandDims", {"decode", "zero"},
+            {{"T", DT_UINT8}, {"Tdim", DT_INT32}}),
+       NDef("size", "Const", {},
+            {{"value", test::AsTensor<int32>({224, 224})},
+             {"dtype", DT_INT32}}),
+       MakeResizeNode("resize", "expand_dims"),
+       NDef("squeeze", "Squeeze", {"resize"}, {{"T", DT_FLOAT}})});
+  item.fetch.push_back("squeeze");
+
+  DecodeAndResizeFusion optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("decode", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("expand_dims", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("resize", output));
+  const int fused_index =
+      graph_utils::FindGraphNodeWithOp("_DecodeAndResizeJpeg", output);
+  ASSERT_GE(fused_index, 0);
+  const NodeDef& fused = output.node(fused_index);
+  ASSERT_EQ(fused.input_size(), 4);
+  EXPECT_EQ(fused.input(0), "contents");
+  EXPECT_EQ(fused.input(1), fused.input(2));
+  EXPECT_EQ(fused.input(3), "size");
+  EXPECT_EQ(fused.attr().at("channels").i(), 3);
+  EXPECT_EQ(fused.attr().at("dct_method").s(), "INTEGER_ACCURATE");
+  EXPECT_TRUE(fused.attr().at("half_pixel_centers").b());
+
+  const NodeDef& empty = output.node(
+      graph_utils::FindGraphNodeWithName(fused.input(1), output));
+  Tensor empty_value;
+  ASSERT_TRUE(empty_value.FromProto(empty.attr().at("value").tensor()));
+  EXPECT_EQ(empty_value.NumElements(), 0);
+
+  const NodeDef& squeeze =
+      output.node(graph_utils::FindGraphNodeWithName("squeeze", output));
+  EXPECT_EQ(squeeze.input(0), fused.name());
+}
+
+TEST(DecodeAndResizeFusionTest, FuseDecodeCropAndResize) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("contents", "Placeholder", {}, {{"dtype", DT_STRING}}),
+       NDef("decode", "DecodeJpeg", {"contents"}, {{"channels", 3}}),
+       NDef("begin", "Placeholder", {}, {{"dtype", DT_INT32}}),
+       NDef("crop_size", "Placeholder", {}, {{"dtype", DT_INT32}}),
+       NDef("slice", "Slice", {"decode", "begin", "crop_size"},
+            {{"T", DT_UINT8}, {"Index", DT_INT32}}),
+       NDef("zero", "Const", {}, {{"value", 0}, {"dtype", DT_INT32}}),
+       NDef("expand_dims", "ExpandDims", {"slice", "zero"},
+            {{"T", DT_UINT8}, {"Tdim", DT_INT32}}),
+       NDef("size", "Const", {},
+            {{"value", test::AsTensor<int32>({224, 224})},
+             {"dtype", DT_INT32}}),
+       MakeResizeNode("resize", "expand_dims"),
+       NDef("squeeze", "Squeeze", {"resize"}, {{"T", DT_FLOAT}})});
+  item.fetch.push_back("squeeze");
+
+  DecodeAndResizeFusion optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("slice", output));
+  const int fused_index =
+      graph_utils::FindGraphNodeWithOp("_DecodeAndResizeJpeg", output);
+  ASSERT_GE(fused_index, 0);
+  const NodeDef& fused = output.node(fused_index);
+  ASSERT_EQ(fused.input_size(), 4);
+  EXPECT_EQ(fused.input(0), "contents");
+  EXPECT_EQ(fused.input(1), "begin");
+  EXPECT_EQ(fused.input(2), "crop_size");
+  EXPECT_EQ(fused.input(3), "size");
+}
+
+TEST(DecodeAndResizeFusionTest, KeepDecodeWithOtherConsumers) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("contents", "Placeholder", {}, {{"dtype", DT_STRING}}),
+       NDef("decode", "DecodeJpeg", {"contents"}, {{"channels", 3}}),
+       NDef("zero", "Const", {}, {{"value", 0}, {"dtype", DT_INT32}}),
+       NDef("expand_dims", "ExpandDims", {"decode", "zero"},
+            {{"T", DT_UINT8}, {"Tdim", DT_INT32}}),
+       NDef("size", "Const", {},
+            {{"value", test::AsTensor<int32>({224, 224})},
+             {"dtype", DT_INT32}}),
+       MakeResizeNode("resize", "expand_dims"),
+       NDef("squeeze", "Squeeze", {"resize"}, {{"T", DT_FLOAT}}),
+       NDef("shape", "Shape", {"decode"}, {{"T", DT_UINT8}})});
+  item.fetch = {"squeeze", "shape"};
+
+  DecodeAndResizeFusion optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(graph_utils::FindGraphNodeWithOp("_DecodeAndResizeJpeg", output),
+            -1);
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("decode", output));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -41,6 +41,7 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/control_flow.h"
@@ -677,6 +678,305 @@ string SpecializedFunctionName(const FunctionOptimizerContext& ctx,
       absl::StrReplaceAll(func_node.name(), {{"/", "_"}}), ctx.item().id);
 }
 
+// -------------------------------------------------------------------------- //
+// A function specialized to its call site can be pruned further, by removing
+// the parts of the function body that do not contribute to the function
+// outputs used at that call site:
+//
+// 1) If nodes with a constant predicate are replaced with a call of the branch
+//    that is always taken.
+// 2) Nodes that do not feed into the function outputs, control outputs or
+//    nodes with side effects are removed.
+// 3) Unused outputs of the nested function calls (PartitionedCall, If) are
+//    removed, and the functions they call (including While bodies) are pruned
+//    recursively.
+
+// Nested function calls deeper than this are not pruned.
+constexpr int kMaxFunctionPruningDepth = 8;
+
+// Returns the names of the function valued attributes of a nested function
+// call that can be pruned in place, or an empty vector for other nodes.
+std::vector<string> NestedFunctionAttrs(const NodeDef& node) {
+  if (IsPartitionedCall(node) || IsStatefulPartitionedCall(node)) {
+    return {kFuncAttr};
+  } else if (IsIf(node)) {
+    return {"then_branch", "else_branch"};
+  } else if (IsWhile(node)) {
+    return {"cond", "body"};
+  }
+  return {};
+}
+
+// Returns true if `node` must be kept even if none of its outputs are used.
+// Function calls and functional control flow ops are stateful, but they only
+// have side effects if one of the functions they call is stateful.
+bool HasSideEffects(const NodeDef& node,
+                    const FunctionLibraryDefinition& flib) {
+  const OpDef* op_def = nullptr;
+  if (!flib.LookUpOpDef(node.op(), &op_def).ok()) return true;
+  if (!op_def->is_stateful()) return false;
+
+  const std::vector<string> func_attrs = NestedFunctionAttrs(node);
+  if (func_attrs.empty()) return true;
+  for (const string& func_attr : func_attrs) {
+    const AttrValue* attr = AttrSlice(node).Find(func_attr);
+    const FunctionDef* func =
+        attr == nullptr ? nullptr : flib.Find(attr->func().name());
+    if (func == nullptr || func->signature().is_stateful()) return true;
+  }
+  return false;
+}
+
+// Replaces If nodes with a constant boolean predicate with a call of the branch
+// that is always taken. Returns true if the function body was modified.
+bool FoldConstantIfPredicates(GrapplerFunctionItem* item) {
+  absl::flat_hash_map<string, const NodeDef*> consts;
+  for (const NodeDef& node : item->graph.node()) {
+    if (IsConstant(node)) consts.emplace(node.name(), &node);
+  }
+
+  bool modified = false;
+  for (NodeDef& node : *item->graph.mutable_node()) {
+    if (!IsIf(node) || node.input_size() == 0) continue;
+    auto it = consts.find(NodeName(node.input(0)));
+    if (it == consts.end()) continue;
+
+    Tensor pred;
+    const AttrValue* value = AttrSlice(*it->second).Find("value");
+    if (value == nullptr || !pred.FromProto(value->tensor()) ||
+        pred.dtype() != DT_BOOL || pred.NumElements() != 1) {
+      continue;
+    }
+    const string branch = pred.flat<bool>()(0) ? "then_branch" : "else_branch";
+    VLOG(3) << "Replace If node with a constant predicate with a call of its "
+            << branch << ": " << node.name();
+
+    auto* attr = node.mutable_attr();
+    const AttrValue func = attr->at(branch);
+    for (const char* name :
+         {"then_branch", "else_branch", "Tcond", "output_shapes"}) {
+      attr->erase(name);
+    }
+    (*attr)[kFuncAttr] = func;
+    node.set_op(node.op() == "If" ? "StatefulPartitionedCall"
+                                  : "PartitionedCall");
+    node.mutable_input()->erase(node.mutable_input()->begin());
+    modified = true;
+  }
+  return modified;
+}
+
+// Removes the nodes that do not feed into the function outputs, control outputs
+// or nodes with side effects. Returns true if the function body was modified.
+bool RemoveDeadFunctionBodyNodes(const FunctionLibraryDefinition& flib,
+                                 GrapplerFunctionItem* item) {
+  const GraphDef& graph = item->graph;
+  absl::flat_hash_map<string, int> node_index;
+  node_index.reserve(graph.node_size());
+  for (int i = 0; i < graph.node_size(); ++i) {
+    node_index.emplace(graph.node(i).name(), i);
+  }
+
+  std::vector<bool> live(graph.node_size(), false);
+  std::vector<int> ready;
+  const auto mark_live = [&](const string& node_name) {
+    auto it = node_index.find(node_name);
+    if (it == node_index.end() || live[it->second]) return;
+    live[it->second] = true;
+    ready.push_back(it->second);
+  };
+
+  for (const OutputArgInstantiation& output : item->outputs()) {
+    mark_live(output.node_name);
+  }
+  for (const ControlOutput& control_output : item->control_outputs()) {
+    mark_live(control_output.node_name);
+  }
+  for (const NodeDef& node : graph.node()) {
+    if (IsArg(node) || HasSideEffects(node, flib)) mark_live(node.name());
+  }
+  while (!ready.empty()) {
+    const NodeDef& node = graph.node(ready.back());
+    ready.pop_back();
+    for (const string& input : node.input()) mark_live(NodeName(input));
+  }
+
+  std::vector<int> dead_nodes;
+  for (int i = 0; i < graph.node_size(); ++i) {
+    if (!live[i]) dead_nodes.push_back(i);
+  }
+  if (dead_nodes.empty()) return false;
+
+  VLOG(3) << "Remove " << dead_nodes.size()
+          << " dead nodes from the function body: " << item->id;
+  EraseNodesFromGraph(std::move(dead_nodes), &item->graph);
+  return true;
+}
+
+Status PruneFunctionBody(const string& func_name, int depth,
+                         const FunctionLibraryDefinition& flib,
+                         int graph_version, GrapplerFunctionItem* item,
+                         std::vector<FunctionDef>* pruned_funcs, bool* pruned);
+
+// Prunes the functions called by the nested function call `node`, removing
+// the outputs that are not in `used_outputs`. Updates `node` to call the
+// pruned functions, and returns the mapping of the output ports that moved in
+// `output_mapping`. The pruned functions are appended to `pruned_funcs`, and
+// must be added to the function library by the caller once the function
+// calling them is added too.
+Status PruneNestedFunctionCall(const absl::flat_hash_set<int>& used_outputs,
+                               const string& parent_func_name, int depth,
+                               const FunctionLibraryDefinition& flib,
+                               int graph_version, NodeDef* node,
+                               std::vector<std::pair<int, int>>* output_mapping,
+                               std::vector<FunctionDef>* pruned_funcs,
+                               bool* pruned) {
+  *pruned = false;
+
+  // While loop outputs are also the loop variables, so they can't be removed.
+  absl::flat_hash_set<int> remove;
+  if (!IsWhile(*node)) {
+    const AttrValue* tout = AttrSlice(*node).Find("Tout");
+    if (tout == nullptr) {
+      return errors::InvalidArgument("Missing Tout attribute: ", node->name());
+    }
+    for (int i = 0; i < tout->list().type_size(); ++i) {
+      if (!used_outputs.contains(i)) remove.insert(i);
+    }
+  }
+
+  // Functions pruned for this call, and for the calls nested in their bodies.
+  std::vector<std::pair<string, FunctionDef>> node_funcs;
+  std::vector<FunctionDef> nested_funcs;
+  bool modified = !remove.empty();
+  for (const string& func_attr : NestedFunctionAttrs(*node)) {
+    const AttrValue* attr = AttrSlice(*node).Find(func_attr);
+    if (attr == nullptr || !attr->has_func()) {
+      return errors::InvalidArgument("Missing ", func_attr,
+                                     " attribute: ", node->name());
+    }
+    const NameAttrList& func = attr->func();
+    const FunctionDef* fdef = flib.Find(func.name());
+    if (fdef == nullptr) {
+      return errors::NotFound("Function not found: ", func.name());
+    }
+
+    GrapplerFunctionItem func_item;
+    TF_RETURN_IF_ERROR(MakeGrapplerFunctionItem(
+        *fdef, AttrSlice(&func.attr()), flib, graph_version, &func_item));
+    output_mapping->clear();
+    TF_RETURN_IF_ERROR(
+        RemoveFunctionOutputs(remove, &func_item, output_mapping));
+
+    const string pruned_func_name = absl::Substitute(
+        "$0_pruned_for_$1_in_$2", func.name(),
+        absl::StrReplaceAll(node->name(), {{"/", "_"}}), parent_func_name);
+    bool body_pruned = false;
+    TF_RETURN_IF_ERROR(PruneFunctionBody(pruned_func_name, depth + 1, flib,
+                                         graph_version, &func_item,
+                                         &nested_funcs, &body_pruned));
+    modified |= body_pruned;
+
+    FunctionDef pruned_func;
+    TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &pruned_func));
+    pruned_func.mutable_signature()->set_name(pruned_func_name);
+    node_funcs.emplace_back(func_attr, std::move(pruned_func));
+  }
+  if (!modified) return Status::OK();
+
+  for (auto& node_func : node_funcs) {
+    (*node->mutable_attr())[node_func.first].mutable_func()->set_name(
+        node_func.second.signature().name());
+    pruned_funcs->push_back(std::move(node_func.second));
+  }
+  for (FunctionDef& nested_func : nested_funcs) {
+    pruned_funcs->push_back(std::move(nested_func));
+  }
+
+  // Keep the output types and shapes in sync with the pruned signature.
+  if (!remove.empty()) {
+    for (const char* name : {"Tout", "output_shapes", "_output_shapes"}) {
+      auto it = node->mutable_attr()->find(name);
+      if (it == node->mutable_attr()->end()) continue;
+      AttrValue::ListValue* list = it->second.mutable_list();
+      AttrValue::ListValue pruned_list;
+      for (int i = 0; i < list->type_size(); ++i) {
+        if (!remove.contains(i)) pruned_list.add_type(list->type(i));
+      }
+      for (int i = 0; i < list->shape_size(); ++i) {
+        if (!remove.contains(i)) *pruned_list.add_shape() = list->shape(i);
+      }
+      list->Swap(&pruned_list);
+    }
+  }
+
+  VLOG(3) << "Pruned nested function call: " << SummarizeNodeDef(*node);
+  *pruned = true;
+  return Status::OK();
+}
+
+// Prunes the body of the function `func_name` instantiated into `item`, after
+// its unused outputs were removed (see comment above). Sets `pruned` to true if
+// the function body was modified, and appends the functions pruned for its
+// nested function calls to `pruned_funcs`.
+Status PruneFunctionBody(const string& func_name, int depth,
+                         const FunctionLibraryDefinition& flib,
+                         int graph_version, GrapplerFunctionItem* item,
+                         std::vector<FunctionDef>* pruned_funcs, bool* pruned) {
+  *pruned = FoldConstantIfPredicates(item);
+  *pruned |= RemoveDeadFunctionBodyNodes(flib, item);
+  if (depth >= kMaxFunctionPruningDepth) return Status::OK();
+
+  // Output ports of the function body nodes used by other nodes.
+  absl::flat_hash_map<string, absl::flat_hash_set<int>> used_outputs;
+  for (const NodeDef& node : item->graph.node()) {
+    for (const string& input : node.input()) {
+      if (IsControlInput(input)) break;
+      const TensorId tensor = ParseTensorName(input);
+      used_outputs[tensor.node()].insert(tensor.index());
+    }
+  }
+
+  absl::flat_hash_map<string, std::vector<std::pair<int, int>>>
+      output_mappings;
+  for (NodeDef& node : *item->graph.mutable_node()) {
+    if (NestedFunctionAttrs(node).empty()) continue;
+    std::vector<std::pair<int, int>> output_mapping;
+    bool node_pruned = false;
+    Status status = PruneNestedFunctionCall(
+        used_outputs[node.name()], func_name, depth, flib, graph_version, &node,
+        &output_mapping, pruned_funcs, &node_pruned);
+    if (!status.ok()) {
+      VLOG(3) << "Skip pruning of nested function call " << node.name() << ": "
+              << status.error_message();
+      continue;
+    }
+    if (!node_pruned) continue;
+    *pruned = true;
+    if (!output_mapping.empty()) {
+      output_mappings.emplace(node.name(), std::move(output_mapping));
+    }
+  }
+  if (output_mappings.empty()) return Status::OK();
+
+  // Update the consumers of the nested function call outputs that moved.
+  for (NodeDef& node : *item->graph.mutable_node()) {
+    for (string& input : *node.mutable_input()) {
+      if (IsControlInput(input)) break;
+      const TensorId tensor = ParseTensorName(input);
+      auto it = output_mappings.find(tensor.node());
+      if (it == output_mappings.end()) continue;
+      for (const auto& mapping : it->second) {
+        if (tensor.index() == mapping.first) {
+          input = absl::StrCat(tensor.node(), ":", mapping.second);
+          break;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
 Status SpecializeFunction(const NodeDef& func_node, const FunctionDef& func,
                           FunctionOptimizerContext* ctx,
                           GraphDef* optimized_graph) {
@@ -740,10 +1040,6 @@ Status SpecializeFunction(const NodeDef& func_node, const FunctionDef& func,
     TF_RETURN_IF_ERROR(RemoveFunctionOutputs(remove, &item, &output_mapping));
   }
 
-  // TODO(ezhulenev): Push down known input shapes.
-  FunctionDef specialized_func;
-  TF_RETURN_IF_ERROR(MakeFunctionDef(item, flib, &specialized_func));
-
   // Find a name for specialized function.
   const string specialized_func_name =
       SpecializedFunctionName(*ctx, func, func_node);
@@ -753,12 +1049,33 @@ Status SpecializeFunction(const NodeDef& func_node, const FunctionDef& func,
     return errors::Internal("Created duplicate function specialization");
   }
 
+  // Remove the parts of the function body (including nested function calls)
+  // that are dead at this call site.
+  bool pruned = false;
+  std::vector<FunctionDef> pruned_funcs;
+  TF_RETURN_IF_ERROR(PruneFunctionBody(specialized_func_name, /*depth=*/0,
+                                       flib, ctx->graph_version(), &item,
+                                       &pruned_funcs, &pruned));
+  for (const FunctionDef& pruned_func : pruned_funcs) {
+    if (flib.Contains(pruned_func.signature().name())) {
+      return errors::Internal("Created duplicate function specialization");
+    }
+  }
+
+  // TODO(ezhulenev): Push down known input shapes.
+  FunctionDef specialized_func;
+  TF_RETURN_IF_ERROR(MakeFunctionDef(item, flib, &specialized_func));
+
   specialized_func.mutable_signature()->set_name(specialized_func_name);
   auto* specialized_attr = specialized_func.mutable_attr();
   (*specialized_attr)[kGrapplerSpecializedFuncAttr].set_b(true);
 
-  // Add specialized function to the library.
+  // Add specialized function to the library, with the functions pruned for
+  // its nested function calls.
   TF_RETURN_IF_ERROR(ctx->function_library().AddFunctionDef(specialized_func));
+  for (const FunctionDef& pruned_func : pruned_funcs) {
+    TF_RETURN_IF_ERROR(ctx->function_library().AddFunctionDef(pruned_func));
+  }
 
   // Add a function call node for the specialized function.
   NodeDef* specialized_func_node = optimized_graph->add_node();
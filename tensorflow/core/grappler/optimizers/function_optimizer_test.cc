@@ -2071,6 +2071,264 @@ TEST_F(FunctionOptimizerTest, SpecializeIndirectFunctionForUsedOutputTensors) {
   }
 }
 
+TEST_F(FunctionOptimizerTest, PruneNestedFunctionCallForUsedOutputTensors) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  FunctionDef mul_and_add = FDH::Create(
+      "MulAndAdd", {"x:float", "y:float"}, {"m:float", "a:float"}, {},
+      {{{"mul"}, "Mul", {"x", "y"}, {{"T", DT_FLOAT}}},
+       {{"add"}, "Add", {"x", "y"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"m", "mul:z:0"}, {"a", "add:z:0"}});
+
+  // MyFunc returns both outputs of a nested MulAndAdd function call.
+  FunctionDef my_func = FDH::Create(
+      "MyFunc", {"x:float", "y:float"}, {"z1:float", "z2:float"}, {},
+      {{{"call"},
+        "PartitionedCall",
+        {"x", "y"},
+        {{"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+         {"Tout", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+         {"f", FDH::FunctionRef("MulAndAdd")}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z1", "call:output:0"}, {"z2", "call:output:1"}});
+  (*my_func.mutable_attr())["_noinline"].set_b(true);
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.fetch = {"use_fn_0"};
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("y", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("fn", "PartitionedCall", {"x", "y"},
+            {{"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+             {"Tout", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+             {"f", FDH::FunctionRef("MyFunc")}},
+            kDevice),
+       NDef("use_fn_0", "Identity", {"fn:0"}, {{"T", DT_FLOAT}}, kDevice)},
+      {my_func, mul_and_add});
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // MyFunc was specialized for its single used output, and the nested
+  // MulAndAdd call was pruned to the only output that is still used.
+  const string specialized_name = "MyFunc_specialized_for_fn_at_tf_graph";
+  const string pruned_name =
+      "MulAndAdd_pruned_for_call_in_MyFunc_specialized_for_fn_at_tf_graph";
+  ASSERT_EQ(2, output.library().function_size());
+
+  int found = 0;
+  for (const FunctionDef& func : output.library().function()) {
+    if (func.signature().name() == specialized_name && ++found) {
+      ASSERT_EQ(1, func.signature().output_arg_size());
+      ASSERT_EQ(1, func.node_def_size());
+      const NodeDef& call = func.node_def(0);
+      EXPECT_EQ(pruned_name, AttrSlice(call).Find("f")->func().name());
+      EXPECT_EQ(1, AttrSlice(call).Find("Tout")->list().type_size());
+      EXPECT_EQ("call:output:0", func.ret().at("z1"));
+    } else if (func.signature().name() == pruned_name && ++found) {
+      ASSERT_EQ(1, func.signature().output_arg_size());
+      ASSERT_EQ(1, func.node_def_size());
+      EXPECT_EQ("Mul", func.node_def(0).op());
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  Tensor three = test::AsScalar<float>(3.0f);
+  Tensor four = test::AsScalar<float>(4.0f);
+  item.feed = {{"x", three}, {"y", four}};
+
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
+TEST_F(FunctionOptimizerTest, PruneNestedWhileLoopBody) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  FunctionDef cond = FDH::Create(
+      "LessThanTen", {"x:float", "y:float"}, {"z:bool"}, {},
+      {{{"ten"},
+        "Const",
+        {},
+        {{"dtype", DT_FLOAT}, {"value", test::AsScalar<float>(10.0f)}}},
+       {{"less"}, "Less", {"x", "ten:output:0"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "less:z:0"}});
+
+  // The product computed by the loop body is never used.
+  FunctionDef body = FDH::Create(
+      "AddY", {"x:float", "y:float"}, {"x_out:float", "y_out:float"}, {},
+      {{{"add"}, "Add", {"x", "y"}, {{"T", DT_FLOAT}}},
+       {{"unused"}, "Mul", {"x", "y"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"x_out", "add:z:0"}, {"y_out", "y"}});
+
+  FunctionDef my_func = FDH::Create(
+      "MyFunc", {"x:float", "y:float"}, {"z:float"}, {},
+      {{{"while"},
+        "While",
+        {"x", "y"},
+        {{"T", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+         {"cond", FDH::FunctionRef("LessThanTen")},
+         {"body", FDH::FunctionRef("AddY")}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "while:output:0"}});
+  (*my_func.mutable_attr())["_noinline"].set_b(true);
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.fetch = {"use_fn"};
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("y", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("fn", "PartitionedCall", {"x", "y"},
+            {{"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+             {"Tout", DataTypeSlice{DT_FLOAT}},
+             {"f", FDH::FunctionRef("MyFunc")}},
+            kDevice),
+       NDef("use_fn", "Identity", {"fn"}, {{"T", DT_FLOAT}}, kDevice)},
+      {my_func, cond, body});
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The loop keeps all of its outputs, but the dead node of its body is
+  // removed, and the loop calls the pruned body and condition.
+  const string specialized_name = "MyFunc_specialized_for_fn_at_tf_graph";
+  const string pruned_cond_name =
+      "LessThanTen_pruned_for_while_in_MyFunc_specialized_for_fn_at_tf_graph";
+  const string pruned_body_name =
+      "AddY_pruned_for_while_in_MyFunc_specialized_for_fn_at_tf_graph";
+  ASSERT_EQ(3, output.library().function_size());
+
+  int found = 0;
+  for (const FunctionDef& func : output.library().function()) {
+    if (func.signature().name() == specialized_name && ++found) {
+      ASSERT_EQ(1, func.node_def_size());
+      const NodeDef& loop = func.node_def(0);
+      EXPECT_EQ("While", loop.op());
+      EXPECT_EQ(pruned_cond_name, AttrSlice(loop).Find("cond")->func().name());
+      EXPECT_EQ(pruned_body_name, AttrSlice(loop).Find("body")->func().name());
+      EXPECT_EQ(2, AttrSlice(loop).Find("T")->list().type_size());
+    } else if (func.signature().name() == pruned_cond_name && ++found) {
+      EXPECT_EQ(2, func.node_def_size());
+    } else if (func.signature().name() == pruned_body_name && ++found) {
+      ASSERT_EQ(2, func.signature().output_arg_size());
+      ASSERT_EQ(1, func.node_def_size());
+      EXPECT_EQ("Add", func.node_def(0).op());
+    }
+  }
+  EXPECT_EQ(3, found);
+
+  Tensor one = test::AsScalar<float>(1.0f);
+  Tensor four = test::AsScalar<float>(4.0f);
+  item.feed = {{"x", one}, {"y", four}};
+
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
+TEST_F(FunctionOptimizerTest, SpecializeFunctionWithConstantIfPredicate) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  FunctionDef add_func = FDH::Create(
+      "MyAdd", {"x:float", "y:float"}, {"z:float"}, {},
+      {{{"add"}, "Add", {"x", "y"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "add:z:0"}});
+
+  FunctionDef mul_func = FDH::Create(
+      "MyMul", {"x:float", "y:float"}, {"z:float"}, {},
+      {{{"mul"}, "Mul", {"x", "y"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "mul:z:0"}});
+
+  // Compute: return cond ? a + b : a * b
+  FunctionDef add_or_mul_func = FDH::Create(
+      "AddOrMul", {"cond:bool", "x:float", "y:float"}, {"z:float"}, {},
+      {{{"if_node"},
+        "If",
+        {"cond", "x", "y"},
+        {{"Tcond", DT_BOOL},
+         {"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+         {"Tout", DataTypeSlice{DT_FLOAT}},
+         {"then_branch", FDH::FunctionRef("MyAdd")},
+         {"else_branch", FDH::FunctionRef("MyMul")}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "if_node:output:0"}});
+  (*add_or_mul_func.mutable_attr())["_noinline"].set_b(true);
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.fetch = {"d"};
+  item.graph = test::function::GDef(
+      {NDef("is_add", "Const", {},
+            {{"dtype", DT_BOOL}, {"value", test::AsScalar<bool>(true)}},
+            kDevice),
+       NDef("a", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("b", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("c", "PartitionedCall", {"is_add", "a", "b"},
+            {{"Tin", DataTypeSlice{DT_BOOL, DT_FLOAT, DT_FLOAT}},
+             {"Tout", DataTypeSlice{DT_FLOAT}},
+             {"f", FDH::FunctionRef("AddOrMul")}},
+            kDevice),
+       NDef("d", "Identity", {"c"}, {{"T", DT_FLOAT}}, kDevice)},
+      {add_or_mul_func, add_func, mul_func});
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The If node in the specialized function body was replaced with a call of
+  // its then branch, and the else branch is no longer reachable.
+  const FunctionDef* specialized = nullptr;
+  for (const FunctionDef& func : output.library().function()) {
+    EXPECT_NE("MyMul", func.signature().name());
+    if (func.signature().name() == "AddOrMul_specialized_for_c_at_tf_graph") {
+      specialized = &func;
+    }
+  }
+  ASSERT_NE(nullptr, specialized);
+  int found = 0;
+  for (const NodeDef& node : specialized->node_def()) {
+    EXPECT_NE("If", node.op());
+    if (node.name() == "if_node" && ++found) {
+      EXPECT_EQ("StatefulPartitionedCall", node.op());
+      EXPECT_EQ("MyAdd", AttrSlice(node).Find("f")->func().name());
+      ASSERT_EQ(2, node.input_size());
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  Tensor three = test::AsScalar<float>(3.0f);
+  Tensor four = test::AsScalar<float>(4.0f);
+  item.feed = {{"a", three}, {"b", four}};
+
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
 TEST_F(FunctionOptimizerTest, PruningUselessLibraryFunctions) {
   using test::function::NDef;
   FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
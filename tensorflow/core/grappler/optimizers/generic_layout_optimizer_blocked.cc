@@ -0,0 +1,299 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/generic_layout_optimizer_blocked.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/symbolic_shapes.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/platform/cpu_info.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kOptimizedSuffix[] = "LayoutOptimizer";
+constexpr char kToBlockedLayout[] = "_ToBlockedLayout";
+constexpr char kFromBlockedLayout[] = "_FromBlockedLayout";
+constexpr char kToBlockedFilter[] = "_ToBlockedFilter";
+constexpr char kAttrOutputShape[] = "_output_shapes";
+
+bool IsFloat(const NodeDef& node) {
+  DataType type;
+  return GetNodeAttr(node, "T", &type).ok() && type == DT_FLOAT;
+}
+
+bool IsFloatNhwc(const NodeDef& node) {
+  string data_format;
+  return IsFloat(node) &&
+         (!GetNodeAttr(node, "data_format", &data_format).ok() ||
+          data_format == "NHWC");
+}
+
+bool HasSupportedPadding(const NodeDef& node) {
+  string padding;
+  return GetNodeAttr(node, "padding", &padding).ok() &&
+         (padding == "SAME" || padding == "VALID");
+}
+
+// Returns true if the list attribute `attr_name` (e.g. strides) of `node` only
+// spans the height and width dimensions.
+bool IsSpatialWindow(const NodeDef& node, const string& attr_name) {
+  std::vector<int32> values;
+  return GetNodeAttr(node, attr_name, &values).ok() && values.size() == 4 &&
+         values[0] == 1 && values[3] == 1;
+}
+
+bool IsBlockableConv2D(const NodeDef& node) {
+  if (!IsConv2D(node) || !IsFloatNhwc(node) || !HasSupportedPadding(node) ||
+      !IsSpatialWindow(node, "strides")) {
+    return false;
+  }
+  std::vector<int32> dilations;
+  if (GetNodeAttr(node, "dilations", &dilations).ok()) {
+    for (int32 dilation : dilations) {
+      if (dilation != 1) return false;
+    }
+  }
+  return true;
+}
+
+bool IsBlockableBiasAdd(const NodeDef& node) {
+  return IsBiasAddV2(node) && IsFloatNhwc(node);
+}
+
+bool IsBlockablePool(const NodeDef& node) {
+  return (node.op() == "MaxPool" || node.op() == "AvgPool") &&
+         IsFloatNhwc(node) && HasSupportedPadding(node) &&
+         IsSpatialWindow(node, "ksize") && IsSpatialWindow(node, "strides");
+}
+
+// Layout agnostic ops, which work as is on blocked tensors. They all map zeros
+// to zeros, so the padding channels of the last block stay zero.
+bool IsBlockableElementwise(const NodeDef& node) {
+  return IsFloat(node) && (IsRelu(node) || IsRelu6(node) ||
+                           node.op() == "Identity" || IsAdd(node));
+}
+
+// Returns the number of inputs of a node of a region that are blocked tensors.
+int NumBlockedInputs(const NodeDef& node) { return IsAdd(node) ? 2 : 1; }
+
+// Keeps only the attributes of `node` listed in `attr_names`.
+void KeepAttrs(const std::vector<string>& attr_names, NodeDef* node) {
+  auto* attrs = node->mutable_attr();
+  for (auto it = attrs->begin(); it != attrs->end();) {
+    if (std::find(attr_names.begin(), attr_names.end(), it->first) ==
+        attr_names.end()) {
+      it = attrs->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Replaces a layout sensitive node of a region by its blocked counterpart.
+void RewriteToBlockedOp(NodeDef* node) {
+  if (IsConv2D(*node)) {
+    node->set_op("_BlockedConv2D");
+    KeepAttrs({"T", "strides", "padding"}, node);
+  } else if (IsBiasAddV2(*node)) {
+    node->set_op("_BlockedBiasAdd");
+    KeepAttrs({"T"}, node);
+  } else if (node->op() == "MaxPool" || node->op() == "AvgPool") {
+    node->set_op(absl::StrCat("_Blocked", node->op()));
+    KeepAttrs({"T", "ksize", "strides", "padding"}, node);
+  } else {
+    node->mutable_attr()->erase(kAttrOutputShape);
+  }
+}
+
+// Returns the number of output channels of `node`, or -1 if it isn't known.
+int64 NumOutputChannels(const GraphProperties& properties,
+                        const NodeDef& node) {
+  if (!properties.HasOutputProperties(node.name())) return -1;
+  const auto& outputs = properties.GetOutputProperties(node.name());
+  if (outputs.empty()) return -1;
+  const TensorShapeProto& shape = outputs[0].shape();
+  if (shape.unknown_rank() || shape.dim_size() != 4) return -1;
+  return shape.dim(3).size() > 0 ? shape.dim(3).size() : -1;
+}
+
+}  // namespace
+
+int CpuBlockedLayoutBlockSize() {
+  return port::TestCPUFeature(port::CPUFeature::AVX512F) ? 16 : 8;
+}
+
+Status ConvertToCpuBlockedLayout(const GrapplerItem& item, int block_size,
+                                 GraphDef* output) {
+  *output = item.graph;
+  if (block_size != 8 && block_size != 16) {
+    return errors::InvalidArgument("Unsupported block size: ", block_size);
+  }
+  // Regions are grown from producers to consumers.
+  Status status = TopologicalSort(output);
+  if (!status.ok()) {
+    VLOG(1) << "Skipping the blocked layout conversion: " << status;
+    return Status::OK();
+  }
+  GraphProperties properties(item);
+  status = properties.InferStatically(/*assume_valid_feeds=*/false);
+  if (!status.ok()) {
+    VLOG(1) << "Skipping the blocked layout conversion: " << status;
+    return Status::OK();
+  }
+  const auto nodes_to_preserve = item.NodesToPreserve();
+
+  // Output channels of the nodes of the regions, keyed by node name.
+  absl::flat_hash_map<string, int64> region;
+  auto is_blocked_tensor = [&region](const string& input) {
+    const TensorId tensor = ParseTensorName(input);
+    return tensor.index() == 0 && region.contains(tensor.node());
+  };
+  for (const NodeDef& node : output->node()) {
+    if (nodes_to_preserve.count(node.name()) > 0 ||
+        !(node.device().empty() || NodeIsOnCpu(&node))) {
+      continue;
+    }
+    const int64 num_channels = NumOutputChannels(properties, node);
+    if (num_channels < 0) continue;
+    bool in_region = IsBlockableConv2D(node);
+    if (!in_region && (IsBlockableBiasAdd(node) || IsBlockablePool(node) ||
+                       IsBlockableElementwise(node))) {
+      const int num_inputs = NumBlockedInputs(node);
+      in_region = node.input_size() >= num_inputs;
+      for (int i = 0; in_region && i < num_inputs; ++i) {
+        in_region = is_blocked_tensor(node.input(i));
+      }
+      // Broadcasting adds are left alone.
+      if (in_region && IsAdd(node)) {
+        const auto& inputs = properties.GetInputProperties(node.name());
+        in_region = inputs.size() == 2 &&
+                    ShapesSymbolicallyEqual(inputs[0], inputs[1]);
+      }
+    }
+    if (in_region) region[node.name()] = num_channels;
+  }
+  if (region.empty()) return Status::OK();
+  VLOG(1) << "Converting " << region.size()
+          << " nodes to the blocked layout with blocks of " << block_size
+          << " channels.";
+
+  NodeMap node_map(output);
+  std::vector<NodeDef> conversions;
+  // Conversions to the blocked layout, keyed by the converted tensor.
+  absl::flat_hash_map<string, string> to_blocked;
+  absl::flat_hash_map<string, string> to_blocked_filter;
+  for (NodeDef& node : *output->mutable_node()) {
+    const auto it = region.find(node.name());
+    if (it == region.end()) continue;
+
+    for (int i = 0; i < NumBlockedInputs(node); ++i) {
+      if (is_blocked_tensor(node.input(i))) continue;
+      const string tensor = ParseTensorName(node.input(i)).ToString();
+      auto inserted = to_blocked.emplace(tensor, "");
+      if (inserted.second) {
+        NodeDef conversion;
+        conversion.set_name(absl::StrCat(node.name(), "-", i,
+                                         "-ToBlockedLayout-",
+                                         kOptimizedSuffix));
+        conversion.set_op(kToBlockedLayout);
+        conversion.set_device(node.device());
+        conversion.add_input(node.input(i));
+        SetAttrValue(DT_FLOAT, &(*conversion.mutable_attr())["T"]);
+        SetAttrValue(block_size,
+                     &(*conversion.mutable_attr())["block_size"]);
+        inserted.first->second = conversion.name();
+        conversions.push_back(std::move(conversion));
+      }
+      node.set_input(i, inserted.first->second);
+    }
+
+    // The filters are blocked by a separate op, which constant folding
+    // replaces by a blocked constant when the filter is a constant, so that
+    // they are not blocked again at every step.
+    if (IsConv2D(node)) {
+      const string filter = ParseTensorName(node.input(1)).ToString();
+      auto inserted = to_blocked_filter.emplace(filter, "");
+      if (inserted.second) {
+        NodeDef conversion;
+        conversion.set_name(absl::StrCat(node.name(), "-1-ToBlockedFilter-",
+                                         kOptimizedSuffix));
+        conversion.set_op(kToBlockedFilter);
+        conversion.set_device(node.device());
+        conversion.add_input(node.input(1));
+        SetAttrValue(DT_FLOAT, &(*conversion.mutable_attr())["T"]);
+        SetAttrValue(block_size,
+                     &(*conversion.mutable_attr())["block_size"]);
+        inserted.first->second = conversion.name();
+        conversions.push_back(std::move(conversion));
+      }
+      node.set_input(1, inserted.first->second);
+    }
+
+    // Consumers outside of the region, or consuming the output as anything
+    // but a blocked input (e.g. as a filter), read a converted tensor.
+    string from_blocked;
+    for (NodeDef* consumer : node_map.GetOutputs(node.name())) {
+      const bool consumer_in_region = region.contains(consumer->name());
+      for (int i = 0; i < consumer->input_size(); ++i) {
+        const TensorId tensor = ParseTensorName(consumer->input(i));
+        if (tensor.node() != node.name() || tensor.index() != 0) continue;
+        if (consumer_in_region && i < NumBlockedInputs(*consumer)) continue;
+        if (from_blocked.empty()) {
+          NodeDef conversion;
+          conversion.set_name(absl::StrCat(node.name(),
+                                           "-0-FromBlockedLayout-",
+                                           kOptimizedSuffix));
+          conversion.set_op(kFromBlockedLayout);
+          conversion.set_device(node.device());
+          conversion.add_input(node.name());
+          SetAttrValue(DT_FLOAT, &(*conversion.mutable_attr())["T"]);
+          SetAttrValue(it->second,
+                       &(*conversion.mutable_attr())["num_channels"]);
+          from_blocked = conversion.name();
+          conversions.push_back(std::move(conversion));
+        }
+        consumer->set_input(i, from_blocked);
+      }
+    }
+  }
+
+  // Rewrites the ops once all the inputs are updated, since the blocked ops
+  // don't match the predicates above anymore.
+  for (NodeDef& node : *output->mutable_node()) {
+    if (region.contains(node.name())) RewriteToBlockedOp(&node);
+  }
+  for (NodeDef& conversion : conversions) {
+    *output->add_node() = std::move(conversion);
+  }
+  return TopologicalSort(output);
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,50 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GENERIC_LAYOUT_OPTIMIZER_BLOCKED_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GENERIC_LAYOUT_OPTIMIZER_BLOCKED_H_
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Returns the number of channels per block of the blocked layout best suited
+// to the host CPU: 16 floats (a 512 bit vector) with AVX-512, and 8 otherwise.
+int CpuBlockedLayoutBlockSize();
+
+// Converts the float NHWC convolutions of `item` on CPU to the blocked
+// NCHW[x]c layout, where the channels are split in blocks of `block_size`
+// contiguous values: [batch, channels / block_size, height, width, block_size].
+//
+// Each eligible Conv2D starts a region, which is extended (in topological
+// order) through the BiasAdd, MaxPool, AvgPool, Relu, Relu6, Identity and Add
+// nodes consuming it. The nodes of a region are replaced by their _Blocked*
+// counterparts, or kept as is for the layout agnostic ones, and layout
+// conversions (_ToBlockedLayout and _FromBlockedLayout) are only inserted at
+// the region boundaries, so chains of convolutions don't pay a conversion
+// between each other. The convolution filters are converted by
+// _ToBlockedFilter, which constant folding evaluates once for constant filters
+// instead of the kernels re-blocking them on every step. Nodes to preserve are
+// never rewritten.
+Status ConvertToCpuBlockedLayout(const GrapplerItem& item, int block_size,
+                                 GraphDef* output);
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GENERIC_LAYOUT_OPTIMIZER_BLOCKED_H_
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
 #include "tensorflow/core/grappler/devices.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/constant_folding.h"
 #include "tensorflow/core/grappler/utils/graph_view.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -701,6 +702,117 @@ TEST_F(GenericLayoutOptimizerTest, PreserveInputShapes) {
   EXPECT_TRUE(arg->HasAttr("_output_shapes"));
 }
 
+#if !(GOOGLE_CUDA || TENSORFLOW_USE_ROCM)
+TEST_F(GenericLayoutOptimizerTest, BlockedLayoutOnCpu) {
+  Scope s = Scope::NewRootScope().WithDevice("/CPU:0");
+  auto input = ops::Const(s.WithOpName("Input"),
+                          GenerateRandomTensor<DT_FLOAT>({2, 9, 9, 3}));
+  auto filter1 = ops::Const(s.WithOpName("Filter1"),
+                            GenerateRandomTensor<DT_FLOAT>({3, 3, 3, 12}));
+  auto bias = ops::Const(s.WithOpName("Bias"),
+                         GenerateRandomTensor<DT_FLOAT>({12}));
+  auto filter2 = ops::Const(s.WithOpName("Filter2"),
+                            GenerateRandomTensor<DT_FLOAT>({1, 1, 12, 5}));
+  auto conv1 = ops::Conv2D(s.WithOpName("Conv1"), input, filter1,
+                           {1, 1, 1, 1}, "SAME");
+  auto bias_add = ops::BiasAdd(s.WithOpName("BiasAdd"), conv1, bias);
+  auto relu = ops::Relu(s.WithOpName("Relu"), bias_add);
+  auto pool = ops::MaxPool(s.WithOpName("MaxPool"), relu, {1, 3, 3, 1},
+                           {1, 2, 2, 1}, "VALID");
+  auto conv2 = ops::Conv2D(s.WithOpName("Conv2"), pool, filter2,
+                           {1, 1, 1, 1}, "VALID");
+  // Relu is also consumed outside of the region.
+  auto shape = ops::Shape(s.WithOpName("Shape"), relu);
+  auto fetch = ops::Identity(s.WithOpName("Fetch"), conv2);
+
+  GrapplerItem item;
+  item.fetch = {"Fetch", "Shape"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  GenericLayoutOptimizer optimizer(RewriterConfig::DEFAULT,
+                                   RewriterConfig::NHWC_TO_NCHW_BLOCKED);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  Status status;
+  utils::GraphView graph_view(&output, &status);
+  TF_ASSERT_OK(status);
+  EXPECT_EQ(graph_view.GetNode("Conv1")->GetOp(), "_BlockedConv2D");
+  EXPECT_EQ(graph_view.GetNode("BiasAdd")->GetOp(), "_BlockedBiasAdd");
+  EXPECT_EQ(graph_view.GetNode("Relu")->GetOp(), "Relu");
+  EXPECT_EQ(graph_view.GetNode("MaxPool")->GetOp(), "_BlockedMaxPool");
+  EXPECT_EQ(graph_view.GetNode("Conv2")->GetOp(), "_BlockedConv2D");
+  EXPECT_EQ(graph_view.GetNode("Fetch")->GetOp(), "Identity");
+
+  // Layout conversions are only inserted at the region boundaries.
+  int num_to_blocked = 0;
+  int num_from_blocked = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.op() == "_ToBlockedLayout") ++num_to_blocked;
+    if (node.op() == "_FromBlockedLayout") ++num_from_blocked;
+  }
+  EXPECT_EQ(num_to_blocked, 1);
+  EXPECT_EQ(num_from_blocked, 2);
+  VerifyRegularFaninMatch(graph_view.GetNode("Conv1"), 0,
+                          "Conv1-0-ToBlockedLayout-LayoutOptimizer", 0);
+  VerifyRegularFaninMatch(graph_view.GetNode("Conv1"), 1,
+                          "Conv1-1-ToBlockedFilter-LayoutOptimizer", 0);
+  VerifyRegularFaninMatch(
+      graph_view.GetNode("Conv1-1-ToBlockedFilter-LayoutOptimizer"), 0,
+      "Filter1", 0);
+  VerifyRegularFaninMatch(graph_view.GetNode("MaxPool"), 0, "Relu", 0);
+  VerifyRegularFaninMatch(graph_view.GetNode("Shape"), 0,
+                          "Relu-0-FromBlockedLayout-LayoutOptimizer", 0);
+  VerifyRegularFaninMatch(graph_view.GetNode("Fetch"), 0,
+                          "Conv2-0-FromBlockedLayout-LayoutOptimizer", 0);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(tensors.size(), 2);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-4);
+  test::ExpectTensorEqual<int32>(tensors[1], tensors_expected[1]);
+
+  // The constant filters are blocked once, by constant folding.
+  GrapplerItem optimized_item = item.WithGraph(std::move(output));
+  ConstantFolding fold(/*cpu_device=*/nullptr);
+  GraphDef folded;
+  TF_ASSERT_OK(fold.Optimize(virtual_cluster_.get(), optimized_item, &folded));
+  for (const NodeDef& node : folded.node()) {
+    EXPECT_NE(node.op(), "_ToBlockedFilter") << node.name();
+    if (node.name() == "Conv1") {
+      EXPECT_EQ(node.input(1), "Conv1-1-ToBlockedFilter-LayoutOptimizer");
+    }
+    if (node.name() == "Conv1-1-ToBlockedFilter-LayoutOptimizer") {
+      EXPECT_EQ(node.op(), "Const");
+    }
+  }
+  tensors = EvaluateNodes(folded, item.fetch);
+  ASSERT_EQ(tensors.size(), 2);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-4);
+}
+
+TEST_F(GenericLayoutOptimizerTest, BlockedLayoutSkipsUnsupportedConv2D) {
+  Scope s = Scope::NewRootScope().WithDevice("/CPU:0");
+  auto input = ops::Const(s.WithOpName("Input"),
+                          GenerateRandomTensor<DT_FLOAT>({2, 9, 9, 3}));
+  auto filter = ops::Const(s.WithOpName("Filter"),
+                           GenerateRandomTensor<DT_FLOAT>({3, 3, 3, 4}));
+  auto conv = ops::Conv2D(s.WithOpName("Conv2D"), input, filter, {1, 1, 1, 1},
+                          "SAME", ops::Conv2D::Dilations({1, 2, 2, 1}));
+  auto fetch = ops::Identity(s.WithOpName("Fetch"), conv);
+
+  GrapplerItem item;
+  item.fetch = {"Fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  GenericLayoutOptimizer optimizer(RewriterConfig::DEFAULT,
+                                   RewriterConfig::NHWC_TO_NCHW_BLOCKED);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+  CompareGraphs(item.graph, output);
+}
+#endif  // !(GOOGLE_CUDA || TENSORFLOW_USE_ROCM)
+
 // TODO(yanzha): Add more complex Graph for test.
 
 }  // namespace grappler
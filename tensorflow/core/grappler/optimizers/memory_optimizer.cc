@@ -440,6 +440,18 @@ void RecomputeSubgraph(
   }
 }
 
+// Returns true for nodes whose inputs we may want to recompute. This matches
+// node names that contain recomputation_targets_name_scope as a name scope,
+// meaning it either begins with or contains the name scope. Defaults to
+// "gradients/" which will match any node names that begins with "gradients/" or
+// contains "/gradients/".
+bool IsRecomputationTarget(const NodeDef& node,
+                           const string& recomputation_targets_name_scope) {
+  return absl::StartsWith(node.name(), recomputation_targets_name_scope) ||
+         static_cast<int>(
+             node.name().find("/" + recomputation_targets_name_scope)) != -1;
+}
+
 void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
                                 const string& recomputation_targets_name_scope,
                                 GraphDef* graph, const GrapplerItem& item) {
@@ -461,15 +473,7 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
   std::function<bool(const NodeDef&)> is_target =
       [&recomputation_targets_name_scope](const NodeDef& node) {
-        // Nodes whose inputs we may want to recompute. This matches node names
-        // that contain recomputation_targets_name_scope as a name scope,
-        // meaning it either begins with or contains the name scope.
-        // Defaults to "gradients/" which will match any node names that begins
-        // with "gradients/" or contains "/gradients/".
-        return absl::StartsWith(node.name(),
-                                recomputation_targets_name_scope) ||
-               static_cast<int>(node.name().find(
-                   "/" + recomputation_targets_name_scope)) != -1;
+        return IsRecomputationTarget(node, recomputation_targets_name_scope);
       };
 
   if (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
@@ -512,6 +516,151 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
 }
 
+// Upper bound on the number of rounds of the budgeted recomputation pass. Each
+// round re-estimates the memory usage, since recomputing a tensor can move the
+// peak to a different point of the schedule.
+constexpr int kMaxBudgetedRecomputationRounds = 10;
+
+// Budget driven variant of RecomputationRewritingPass, along the lines of XLA's
+// HloRematerialization: rather than recomputing every cheap op feeding into a
+// target node, only recompute the ones whose outputs are live at the estimated
+// peak memory usage of a device exceeding its budget, preferring the ones that
+// save the most memory once the inputs they keep alive are accounted for.
+// Returns true if the graph was modified.
+bool BudgetedRecomputationPass(Cluster* cluster, int64 budget,
+                               const string& recomputation_targets_name_scope,
+                               GrapplerItem* item) {
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item->feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+  const std::unordered_set<string> cheap_to_recompute_ops =
+      GetCheapToRecomputeOps();
+  const string recomputed_scope = strings::StrCat(kRecomputedNodePrefix, "/");
+  std::function<bool(const NodeDef&)> is_target =
+      [&recomputation_targets_name_scope](const NodeDef& node) {
+        return IsRecomputationTarget(node, recomputation_targets_name_scope);
+      };
+  std::function<bool(const NodeDef&)> is_candidate =
+      [&](const NodeDef& node) {
+        return !is_target(node) && feeds.count(node.name()) == 0 &&
+               !absl::StartsWith(node.name(), recomputed_scope) &&
+               (cheap_to_recompute_ops.count(node.op()) > 0 ||
+                node.attr().count(kRecomputeHint) > 0);
+      };
+
+  bool updated_graph = false;
+  for (int round = 0; round < kMaxBudgetedRecomputationRounds; ++round) {
+    GraphMemory memory(*item);
+    Status s = memory.InferStatically(cluster->GetDevices());
+    if (!s.ok()) {
+      VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+      break;
+    }
+    GraphProperties properties(*item);
+    if (!properties
+             .InferStatically(/*assume_valid_feeds=*/true,
+                              /*aggressive_shape_inference=*/false,
+                              /*include_tensor_values=*/false)
+             .ok()) {
+      break;
+    }
+    // This invalidates all NodeDef pointers, so it needs to be done before we
+    // start collecting those.
+    if (!TopologicalSort(&item->graph).ok()) break;
+    NodeMap node_map(&item->graph);
+    const std::unordered_set<const NodeDef*> candidates =
+        FindCandidateRecomputeNodes(node_map, &item->graph, is_candidate,
+                                    is_target);
+    if (candidates.empty()) break;
+
+    std::vector<const NodeDef*> nodes_to_recompute;
+    std::unordered_set<const NodeDef*> selected;
+    for (const auto& device : cluster->GetDevices()) {
+      const int64 device_budget =
+          budget > 0 ? budget : device.second.memory_size();
+      if (device_budget <= 0) {
+        VLOG(1) << "Memory budget unknown for device " << device.first;
+        continue;
+      }
+      const GraphMemory::MemoryUsage& mem_usage =
+          memory.GetPeakMemoryUsage(device.first);
+      if (mem_usage.used_memory <= device_budget) {
+        continue;
+      }
+      int64 required_savings = mem_usage.used_memory - device_budget;
+
+      std::unordered_set<string> live_tensors;
+      std::unordered_map<const NodeDef*, int64> live_bytes;
+      for (const auto& live_tensor : mem_usage.live_tensors) {
+        live_tensors.insert(
+            strings::StrCat(live_tensor.node, ":", live_tensor.output_id));
+        const NodeDef* node = node_map.GetNode(live_tensor.node);
+        if (node != nullptr && candidates.count(node) > 0 &&
+            selected.count(node) == 0) {
+          live_bytes[node] += live_tensor.memory_used;
+        }
+      }
+
+      // Recomputing a node frees its outputs at the peak, but keeps its inputs
+      // alive until the recomputation, so only count the net savings.
+      std::vector<std::pair<int64, const NodeDef*>> savings;
+      for (const auto& node_bytes : live_bytes) {
+        const NodeDef* node = node_bytes.first;
+        const std::vector<OpInfo::TensorProperties>& input_props =
+            properties.GetInputProperties(node->name());
+        int64 net_savings = node_bytes.second;
+        for (int i = 0; i < node->input_size(); ++i) {
+          if (IsControlInput(node->input(i))) break;
+          const TensorId input = ParseTensorName(node->input(i));
+          const string input_tensor =
+              strings::StrCat(input.node(), ":", input.index());
+          if (i < input_props.size() && live_tensors.count(input_tensor) == 0) {
+            net_savings -= CalculateTensorSize(input_props[i]);
+          }
+        }
+        if (net_savings > 0) {
+          savings.emplace_back(net_savings, node);
+        }
+      }
+      std::sort(savings.begin(), savings.end(),
+                [](const std::pair<int64, const NodeDef*>& a,
+                   const std::pair<int64, const NodeDef*>& b) {
+                  if (a.first != b.first) return a.first > b.first;
+                  return a.second->name() < b.second->name();
+                });
+      for (const auto& candidate : savings) {
+        if (required_savings <= 0) break;
+        VLOG(1) << "Recomputing " << candidate.second->name() << " to save "
+                << candidate.first << " bytes on " << device.first;
+        selected.insert(candidate.second);
+        nodes_to_recompute.push_back(candidate.second);
+        required_savings -= candidate.first;
+      }
+    }
+    if (nodes_to_recompute.empty()) break;
+
+    std::unordered_map<const NodeDef*, int> topological_numbering;
+    for (int node_number = 0; node_number < item->graph.node().size();
+         ++node_number) {
+      topological_numbering[item->graph.mutable_node(node_number)] =
+          item->graph.node().size() - node_number - 1;
+    }
+    for (const NodeDef* node : nodes_to_recompute) {
+      std::unordered_set<NodeDef*> target_nodes;
+      for (NodeDef* output : node_map.GetOutputs(node->name())) {
+        if (is_target(*output)) {
+          target_nodes.insert(output);
+        }
+      }
+      RecomputeSubgraph({node}, target_nodes, node_map, topological_numbering,
+                        &item->graph);
+    }
+    updated_graph = true;
+  }
+  return updated_graph;
+}
+
 bool SchedulingPass(Cluster* cluster, std::unique_ptr<GraphMemory>* memory_ptr,
                     GrapplerItem* item) {
   // Look for AddN nodes (and equivalent) and record input names.
@@ -1395,9 +1544,19 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   RelaxAssignNodes(nodes_to_relax, &optimized_item.graph);
 
   if (run_recomputation_pass) {
-    RecomputationRewritingPass(optimization_level_,
-                               recomputation_targets_name_scope_,
-                               &optimized_item.graph, item);
+    // The budgeted recomputation heuristics rely on defined fetches in order to
+    // infer the memory usage.
+    if (recomputation_budget_ != 0 &&
+        optimization_level_ != RewriterConfig::MANUAL && cluster != nullptr &&
+        !item.fetch.empty()) {
+      BudgetedRecomputationPass(cluster, recomputation_budget_,
+                                recomputation_targets_name_scope_,
+                                &optimized_item);
+    } else {
+      RecomputationRewritingPass(optimization_level_,
+                                 recomputation_targets_name_scope_,
+                                 &optimized_item.graph, item);
+    }
   }
 
   std::unordered_set<string> skip_list;
@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
@@ -448,6 +449,184 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, BudgetedRecomputation) {
+  // A stack of residual layers whose activations are all kept alive until the
+  // backward pass, which is where the peak memory usage happens.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  const int kNumLayers = 6;
+  const auto seed = ops::RandomNormal::Seed(1).Seed2(2);
+  Output h = ops::RandomNormal(s.WithOpName("x"), {64, 256}, DT_FLOAT, seed);
+  std::vector<Output> pre_activations;
+  std::vector<Output> activations;
+  for (int i = 0; i < kNumLayers; ++i) {
+    Output w = ops::RandomNormal(s.WithOpName(strings::StrCat("w", i)),
+                                 {256, 256}, DT_FLOAT, seed);
+    pre_activations.push_back(
+        ops::MatMul(s.WithOpName(strings::StrCat("matmul", i)), h, w));
+    activations.push_back(ops::Relu(s.WithOpName(strings::StrCat("relu", i)),
+                                    pre_activations.back()));
+    h = ops::Add(s.WithOpName(strings::StrCat("add", i)), h,
+                 activations.back());
+  }
+  Output grad = ops::Square(s.WithOpName("gradients/square"), h);
+  for (int i = kNumLayers - 1; i >= 0; --i) {
+    grad = ops::Mul(s.WithOpName(strings::StrCat("gradients/relu_grad", i)),
+                    grad, activations[i]);
+    grad = ops::Mul(s.WithOpName(strings::StrCat("gradients/matmul_grad", i)),
+                    grad, pre_activations[i]);
+  }
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {grad.node()->name()};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  const string device = "/job:localhost/replica:0/task:0/cpu:0";
+  GraphMemory original_memory(item);
+  TF_ASSERT_OK(original_memory.InferStatically(cluster->GetDevices()));
+  const int64 original_peak =
+      original_memory.GetPeakMemoryUsage(device).used_memory;
+  // Only two of the activations need to be recomputed to fit in the budget.
+  const int64 activation_size = 64 * 256 * sizeof(float);
+  const int64 budget = original_peak - 2 * activation_size;
+
+  MemoryOptimizer optimizer(RewriterConfig::RECOMPUTATION_HEURISTICS,
+                            "gradients/", budget);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  int num_recomputed = 0;
+  for (const auto& node : output.node()) {
+    if (absl::StartsWith(node.name(), "Recomputed/")) {
+      EXPECT_EQ("Relu", node.op());
+      ++num_recomputed;
+    }
+  }
+  EXPECT_GT(num_recomputed, 0);
+  EXPECT_LT(num_recomputed, kNumLayers);
+
+  GrapplerItem optimized_item = item.WithGraph(std::move(output));
+  GraphMemory optimized_memory(optimized_item);
+  TF_ASSERT_OK(optimized_memory.InferStatically(cluster->GetDevices()));
+  const int64 optimized_peak =
+      optimized_memory.GetPeakMemoryUsage(device).used_memory;
+  EXPECT_LT(optimized_peak, original_peak)
+      << "Peak memory usage: " << original_peak << " bytes -> "
+      << optimized_peak << " bytes with a budget of " << budget << " bytes";
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(optimized_item.graph, item.fetch);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-4);
+}
+
+TEST_F(MemoryOptimizerTest, BudgetedRecomputationOfAttention) {
+  // A stack of self-attention layers with attention dropout. The backward pass
+  // needs the attention weights both before and after the dropout, as well as
+  // the dropout mask, so the [batch, length, length] tensors dominate the peak
+  // memory usage. Only the dropout can be recomputed from the live tensors.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  const int kNumLayers = 3;
+  const int kBatch = 4;
+  const int kLength = 128;
+  const int kDepth = 64;
+  const auto seed = ops::RandomUniform::Seed(1).Seed2(2);
+  Output h = ops::RandomUniform(s.WithOpName("x"), {kBatch, kLength, kDepth},
+                                DT_FLOAT, seed);
+  std::vector<Output> inputs;
+  std::vector<Output> weights;
+  std::vector<Output> masks;
+  std::vector<Output> dropped_weights;
+  for (int i = 0; i < kNumLayers; ++i) {
+    Output w = ops::RandomUniform(s.WithOpName(strings::StrCat("w", i)),
+                                  {kDepth, kDepth}, DT_FLOAT, seed);
+    Output query =
+        ops::BatchMatMulV2(s.WithOpName(strings::StrCat("query", i)), h, w);
+    Output scores =
+        ops::BatchMatMulV2(s.WithOpName(strings::StrCat("scores", i)), query,
+                           h, ops::BatchMatMulV2::AdjY(true));
+    inputs.push_back(h);
+    weights.push_back(
+        ops::Softmax(s.WithOpName(strings::StrCat("softmax", i)), scores));
+    masks.push_back(
+        ops::RandomUniform(s.WithOpName(strings::StrCat("mask", i)),
+                           {kBatch, kLength, kLength}, DT_FLOAT, seed));
+    dropped_weights.push_back(
+        ops::Mul(s.WithOpName(strings::StrCat("dropout", i)), weights.back(),
+                 masks.back()));
+    Output context = ops::BatchMatMulV2(
+        s.WithOpName(strings::StrCat("context", i)), dropped_weights.back(), h);
+    h = ops::Add(s.WithOpName(strings::StrCat("residual", i)), h, context);
+  }
+  Output grad = ops::Square(s.WithOpName("gradients/square"), h);
+  for (int i = kNumLayers - 1; i >= 0; --i) {
+    const string prefix = strings::StrCat("gradients/layer", i, "/");
+    Output value_grad =
+        ops::BatchMatMulV2(s.WithOpName(prefix + "value_grad"),
+                           dropped_weights[i], grad,
+                           ops::BatchMatMulV2::AdjX(true));
+    Output dropped_grad = ops::BatchMatMulV2(
+        s.WithOpName(prefix + "dropped_grad"), grad, inputs[i],
+        ops::BatchMatMulV2::AdjY(true));
+    Output weights_grad =
+        ops::Mul(s.WithOpName(prefix + "weights_grad"), dropped_grad, masks[i]);
+    Output scores_grad =
+        ops::Mul(s.WithOpName(prefix + "scores_grad"), weights_grad,
+                 weights[i]);
+    Output input_grad = ops::BatchMatMulV2(
+        s.WithOpName(prefix + "input_grad"), scores_grad, inputs[i]);
+    grad = ops::AddN(s.WithOpName(prefix + "grad"),
+                     {grad, value_grad, input_grad});
+  }
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {grad.node()->name()};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  const string device = "/job:localhost/replica:0/task:0/cpu:0";
+  GraphMemory original_memory(item);
+  TF_ASSERT_OK(original_memory.InferStatically(cluster->GetDevices()));
+  const int64 original_peak =
+      original_memory.GetPeakMemoryUsage(device).used_memory;
+  // Recomputing two of the dropouts fits in the budget.
+  const int64 weights_size = kBatch * kLength * kLength * sizeof(float);
+  const int64 budget = original_peak - 2 * weights_size;
+
+  MemoryOptimizer optimizer(RewriterConfig::RECOMPUTATION_HEURISTICS,
+                            "gradients/", budget);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  int num_recomputed = 0;
+  for (const auto& node : output.node()) {
+    if (absl::StartsWith(node.name(), "Recomputed/")) {
+      EXPECT_TRUE(absl::StartsWith(node.name(), "Recomputed/dropout"))
+          << node.name();
+      ++num_recomputed;
+    }
+  }
+  EXPECT_GT(num_recomputed, 0);
+  EXPECT_LT(num_recomputed, kNumLayers);
+
+  GrapplerItem optimized_item = item.WithGraph(std::move(output));
+  GraphMemory optimized_memory(optimized_item);
+  TF_ASSERT_OK(optimized_memory.InferStatically(cluster->GetDevices()));
+  const int64 optimized_peak =
+      optimized_memory.GetPeakMemoryUsage(device).used_memory;
+  EXPECT_LT(optimized_peak, original_peak)
+      << "Peak memory usage: " << original_peak << " bytes -> "
+      << optimized_peak << " bytes with a budget of " << budget << " bytes";
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(optimized_item.graph, item.fetch);
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectClose(tensors_expected[0], tensors[0], /*atol=*/1e-4,
+                    /*rtol=*/1e-4);
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
 
+#include <algorithm>
+#include <map>
+
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/substitute.h"
@@ -32,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/auto_parallel.h"
 #include "tensorflow/core/grappler/optimizers/common_subgraph_elimination.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
+#include "tensorflow/core/grappler/optimizers/cost_based_placement_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
 #include "tensorflow/core/grappler/optimizers/debug_stripper.h"
 #include "tensorflow/core/grappler/optimizers/dependency_optimizer.h"
@@ -52,7 +56,15 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/tpu.h"
 #include "tensorflow/core/grappler/verifiers/structure_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/public/version.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tensorflow/core/util/ptr_util.h"
 #include "tensorflow/core/util/xla_config_registry.h"
@@ -90,7 +102,9 @@ int NumIterations(const RewriterConfig& cfg) {
 bool IsRunOnceOptimizer(const string& name) {
   return name == "layout" || name == "memory_optimizer" ||
          name == "loop_optimizer" || name == "auto_mixed_precision" ||
-         name == "auto_mixed_precision_mkl";
+         name == "auto_mixed_precision_mkl" ||
+         name == "auto_mixed_precision_cpu" ||
+         name == "cost_based_placement_optimizer";
 }
 
 // Creates a function library stub from a real function library: copy only
@@ -165,6 +179,71 @@ bool MemoryOptimizerEnabled(
   return mem_opt_type != RewriterConfig::NO_MEM_OPT;
 }
 
+// Returns the name of the optimization cache entry for "item".  It is a
+// fingerprint of everything the optimized graph depends on: the item, the
+// session config, the devices of the cluster and the TensorFlow version.
+string OptimizationCacheKey(const ConfigProto& config_proto,
+                            bool has_cpu_device, const Cluster* cluster,
+                            const GrapplerItem& item) {
+  string serialized;
+  SerializeToStringDeterministic(item.graph, &serialized);
+  uint64 fingerprint = Fingerprint64(serialized);
+
+  // The cache location and the deadline do not change the optimized graph.
+  ConfigProto config = config_proto;
+  RewriterConfig* rewrite_options =
+      config.mutable_graph_options()->mutable_rewrite_options();
+  rewrite_options->clear_meta_optimizer_cache_dir();
+  rewrite_options->clear_meta_optimizer_timeout_ms();
+  SerializeToStringDeterministic(config, &serialized);
+  fingerprint = FingerprintCat64(fingerprint, Fingerprint64(serialized));
+
+  string key = absl::StrCat(TF_VERSION_STRING, "/", tf_git_version(), "/",
+                            TF_GRAPH_DEF_VERSION, "/", has_cpu_device);
+  for (const auto& feed : item.feed) {
+    absl::StrAppend(&key, "/feed:", feed.first, ":",
+                    DataTypeString(feed.second.dtype()),
+                    feed.second.shape().DebugString());
+  }
+  absl::StrAppend(&key, "/fetch:", absl::StrJoin(item.fetch, ","));
+  absl::StrAppend(&key, "/init:", absl::StrJoin(item.init_ops, ","));
+  absl::StrAppend(&key, "/keep:", absl::StrJoin(item.keep_ops, ","));
+  absl::StrAppend(&key, "/save:", item.save_op, ",", item.restore_op, ",",
+                  item.save_restore_loc_tensor);
+  const GrapplerItem::OptimizationOptions& options =
+      item.optimization_options();
+  absl::StrAppend(&key, "/options:", options.allow_non_differentiable_rewrites,
+                  options.allow_pruning_stateful_and_dataset_ops,
+                  options.optimize_function_library, options.is_eager_mode);
+  std::vector<string> devices(item.devices().begin(), item.devices().end());
+  std::sort(devices.begin(), devices.end());
+  absl::StrAppend(&key, "/devices:", absl::StrJoin(devices, ","));
+  if (cluster != nullptr) {
+    std::map<string, DeviceProperties> cluster_devices(
+        cluster->GetDevices().begin(), cluster->GetDevices().end());
+    for (const auto& device : cluster_devices) {
+      SerializeToStringDeterministic(device.second, &serialized);
+      absl::StrAppend(&key, "/cluster_device:", device.first, ":",
+                      Fingerprint64(serialized));
+    }
+  }
+  fingerprint = FingerprintCat64(fingerprint, Fingerprint64(key));
+  return absl::StrCat(strings::FpToString(fingerprint), ".pb");
+}
+
+// Writes "graph" to the optimization cache entry "path".  The graph is written
+// to a temporary file first, which is then renamed, so that concurrent readers
+// never observe a partially written entry.
+Status WriteCachedGraph(const string& path, const GraphDef& graph) {
+  Env* env = Env::Default();
+  const string tmp_path =
+      absl::StrCat(path, ".tmp", strings::FpToString(random::New64()));
+  Status s = WriteBinaryProto(env, tmp_path, graph);
+  if (s.ok()) s = env->RenameFile(tmp_path, path);
+  if (!s.ok()) env->DeleteFile(tmp_path).IgnoreError();
+  return s;
+}
+
 }  // namespace
 
 #define MK_OPT(NAME, VALUE) \
@@ -199,6 +278,8 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
          new AutoMixedPrecision(AutoMixedPrecisionMode::CUDA));
   MK_OPT("auto_mixed_precision_mkl",
          new AutoMixedPrecision(AutoMixedPrecisionMode::MKL));
+  MK_OPT("auto_mixed_precision_cpu",
+         new AutoMixedPrecision(AutoMixedPrecisionMode::CPU));
   MK_OPT("memory", new MemoryOptimizer(RewriterConfig::MANUAL));
   MK_OPT("common_subgraph_elimination",
          new CommonSubgraphElimination(cfg_.common_subgraph_elimination()));
@@ -212,6 +293,9 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
                                       cfg_.scoped_allocator_opts()));
   MK_OPT("pin_to_host",
          new PinToHostOptimizer(cfg_.pin_to_host_optimization()));
+  MK_OPT("cost_based_placement",
+         new CostBasedPlacementOptimizer(cfg_.cost_based_placement(),
+                                         cfg_.op_cost_table()));
 
   return std::unique_ptr<GraphOptimizer>();
 }
@@ -266,6 +350,10 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->push_back(
         MakeUnique<AutoMixedPrecision>(AutoMixedPrecisionMode::MKL));
   }
+  if (AutoMixedPrecisionEnabled(cfg_.auto_mixed_precision_cpu())) {
+    optimizers->push_back(
+        MakeUnique<AutoMixedPrecision>(AutoMixedPrecisionMode::CPU));
+  }
   if (cfg_.pin_to_host_optimization() == RewriterConfig::ON) {
     optimizers->push_back(MakeUnique<PinToHostOptimizer>());
   }
@@ -295,11 +383,14 @@ Status MetaOptimizer::InitializeOptimizers(
     if (cfg_.memory_optimizer_target_node_name_scope().empty()) {
       optimizers->push_back(
           // Use the default target node name prefix "gradients/"
-          MakeUnique<MemoryOptimizer>(cfg_.memory_optimization()));
+          MakeUnique<MemoryOptimizer>(
+              cfg_.memory_optimization(), "gradients/",
+              cfg_.memory_optimizer_recomputation_budget()));
     } else {
       optimizers->push_back(MakeUnique<MemoryOptimizer>(
           cfg_.memory_optimization(),
-          cfg_.memory_optimizer_target_node_name_scope()));
+          cfg_.memory_optimizer_target_node_name_scope(),
+          cfg_.memory_optimizer_recomputation_budget()));
     }
   }
   if (cfg_.auto_parallel().enable()) {
@@ -310,6 +401,10 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->push_back(MakeUnique<ScopedAllocatorOptimizer>(
         cfg_.scoped_allocator_optimization(), cfg_.scoped_allocator_opts()));
   }
+  if (cfg_.cost_based_placement() == RewriterConfig::ON) {
+    optimizers->push_back(MakeUnique<CostBasedPlacementOptimizer>(
+        cfg_.cost_based_placement(), cfg_.op_cost_table()));
+  }
   return InitializeCustomGraphOptimizers(std::set<string>(), optimizers);
 }
 
@@ -403,6 +498,13 @@ void MetaOptimizer::InitializeVerifiers(
 
 Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
                                     GraphDef* optimized_graph) {
+  return OptimizeGraph(cluster, std::move(item), optimized_graph,
+                       &optimization_results_);
+}
+
+Status MetaOptimizer::OptimizeGraph(
+    Cluster* cluster, GrapplerItem&& item, GraphDef* optimized_graph,
+    std::vector<GraphOptimizationResult>* optimization_results) {
   int min_graph_nodes = cfg_.min_graph_nodes() == 0 ? kDefaultMinGraphNodes
                                                     : cfg_.min_graph_nodes();
   if (item.graph.node_size() < min_graph_nodes) {
@@ -534,7 +636,7 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
                                    }) != optimization_result.results.end();
 
   // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+  optimization_results->push_back(optimization_result);
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -702,6 +804,31 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       "Deleted $0 unreachable functions from the graph (library size = $1)",
       old_library_size - new_library_size, new_library_size);
 
+  // Reuse the result of an earlier optimization of the same graph, possibly
+  // by another process, if an optimization cache is configured.
+  string cache_path;
+  if (!cfg_.meta_optimizer_cache_dir().empty()) {
+    cache_path = io::JoinPath(
+        cfg_.meta_optimizer_cache_dir(),
+        OptimizationCacheKey(config_proto_, cpu_device_ != nullptr, cluster,
+                             item));
+    Status s = errors::NotFound(cache_path);
+    if (Env::Default()->FileExists(cache_path).ok()) {
+      s = ReadBinaryProto(Env::Default(), cache_path, optimized_graph);
+      if (!s.ok()) {
+        LOG(WARNING) << "Ignoring the cached optimized graph " << cache_path
+                     << ": " << s;
+      }
+    }
+    metrics::RecordGrapplerCacheLookup(s.ok());
+    if (s.ok()) {
+      VLOG(1) << "Read optimized graph from " << cache_path;
+      metrics::UpdateGrapplerPassTime("*",
+                                      Env::Default()->NowMicros() - start_us);
+      return Status::OK();
+    }
+  }
+
   // Save a few small fields from item before we move it.
   bool optimize_function_library =
       item.optimization_options().optimize_function_library;
@@ -788,7 +915,8 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
   while (optimize_function_library) {
     optimize_function_library = false;
 
-    int function_idx = 0;
+    // Functions to optimize in this pass, in library order.
+    std::vector<const FunctionDef*> funcs_to_optimize;
     for (const FunctionDef& func : optimized_graph->library().function()) {
       GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
 
@@ -811,17 +939,33 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       // and in function instantiation.
       if (data::IsTFDataFunction(func)) continue;
 
-      VLOG(3) << "Optimize function: function=" << func_name << " ["
-              << function_idx++ << " of "
-              << optimized_graph->library().function_size() << "]";
-
       // Function optimization might specialize nested function calls, so we
       // have to reset the flag and do at least one more pass over the library.
       optimize_function_library = true;
       optimized_funcs.insert(func_name);
+      funcs_to_optimize.push_back(&func);
+    }
+
+    // Function bodies are optimized independently of each other, so they are
+    // optimized concurrently. All of them see the library as it was at the
+    // start of the pass, and the results are merged below in library order,
+    // so the optimized library does not depend on thread scheduling.
+    struct FunctionOptimization {
+      GrapplerFunctionItem item;
+      GraphDef optimized_graph;
+      std::vector<GraphOptimizationResult> results;
+      Status status;
+    };
+    std::vector<FunctionOptimization> function_optimizations(
+        funcs_to_optimize.size());
+    const auto optimize_function = [&](int i) -> Status {
+      const FunctionDef& func = *funcs_to_optimize[i];
+      const string& func_name = func.signature().name();
+      VLOG(3) << "Optimize function: function=" << func_name << " [" << i
+              << " of " << funcs_to_optimize.size() << "]";
 
       // Make a GrapplerItem from a FunctionDef.
-      GrapplerFunctionItem func_item;
+      GrapplerFunctionItem& func_item = function_optimizations[i].item;
       TF_RETURN_IF_ERROR(
           MakeGrapplerFunctionItem(func, flib, producer, &func_item));
 
@@ -846,7 +990,8 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
           false;
 
       // Optimize function body graph.
-      GraphDef optimized_func_graph;
+      GraphDef* optimized_func_graph =
+          &function_optimizations[i].optimized_graph;
       if (IsTPUGraphDef(*optimized_graph)) {
         // Skip optimizing functions if this is a TPU graph. Currently, Grappler
         // passes do not handle TPU functions correctly in a variety of ways
@@ -868,18 +1013,42 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
         *func_item.graph.mutable_library() =
             GetFunctionDefLibraryStub(func_item_function_library);
 
-        TF_RETURN_IF_ERROR(implementation_selector.Optimize(
-            cluster, func_item, &optimized_func_graph));
-      } else {
-        GrapplerFunctionItem func_item_copy = func_item;
-        TF_RETURN_IF_ERROR(OptimizeGraph(cluster, std::move(func_item_copy),
-                                         &optimized_func_graph));
+        return implementation_selector.Optimize(cluster, func_item,
+                                                optimized_func_graph);
+      }
+      GrapplerFunctionItem func_item_copy = func_item;
+      return OptimizeGraph(cluster, std::move(func_item_copy),
+                           optimized_func_graph,
+                           &function_optimizations[i].results);
+    };
+
+    const int num_threads = std::min<int>(funcs_to_optimize.size(),
+                                          port::MaxParallelism());
+    if (num_threads > 1) {
+      thread::ThreadPool pool(Env::Default(), "optimize_function_library",
+                              num_threads);
+      for (int i = 0; i < funcs_to_optimize.size(); ++i) {
+        pool.Schedule([&function_optimizations, &optimize_function, i]() {
+          function_optimizations[i].status = optimize_function(i);
+        });
+      }
+    } else {
+      for (int i = 0; i < funcs_to_optimize.size(); ++i) {
+        function_optimizations[i].status = optimize_function(i);
+      }
+    }
+
+    for (int i = 0; i < funcs_to_optimize.size(); ++i) {
+      FunctionOptimization& function_optimization = function_optimizations[i];
+      TF_RETURN_IF_ERROR(function_optimization.status);
+      for (GraphOptimizationResult& result : function_optimization.results) {
+        optimization_results_.push_back(std::move(result));
       }
 
       // Function body optimization might have created new specialized
       // functions for each instantiation context. Add them to the library.
       for (const FunctionDef& func_def :
-           optimized_func_graph.library().function()) {
+           function_optimization.optimized_graph.library().function()) {
         if (flib.Find(func_def.signature().name()) == nullptr) {
           TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
         }
@@ -887,11 +1056,14 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
 
       // Convert optimized graph back to FunctionDef.
       FunctionDef optimized_func;
-      func_item.SwapFunctionBody(std::move(optimized_func_graph));
+      GrapplerFunctionItem& func_item = function_optimization.item;
+      func_item.SwapFunctionBody(
+          std::move(function_optimization.optimized_graph));
       TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
 
       // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
+      TF_RETURN_IF_ERROR(flib.ReplaceFunction(
+          funcs_to_optimize[i]->signature().name(), optimized_func));
     }
 
     // If optimized at least one function, update the graph library.
@@ -910,6 +1082,29 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
         *optimized_graph);
   }
 
+  // Optimizer failures and timeouts are swallowed unless
+  // fail_on_optimizer_errors is set, but the graph they leave behind must not
+  // be served to later sessions from the cache.
+  const bool all_optimizers_succeeded = std::all_of(
+      optimization_results_.begin(), optimization_results_.end(),
+      [](const GraphOptimizationResult& graph_result) {
+        return std::all_of(graph_result.results.begin(),
+                           graph_result.results.end(),
+                           [](const OptimizerResult& result) {
+                             return result.status.ok();
+                           });
+      });
+  if (!cache_path.empty() && !all_optimizers_succeeded) {
+    VLOG(1) << "Not caching the optimized graph in " << cache_path
+            << " because some optimizers failed.";
+  } else if (!cache_path.empty()) {
+    Status s = WriteCachedGraph(cache_path, *optimized_graph);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to cache the optimized graph in " << cache_path
+                   << ": " << s;
+    }
+  }
+
   const uint64 end_us = Env::Default()->NowMicros();
   metrics::UpdateGrapplerPassTime("*", end_us - start_us);
 
@@ -952,8 +1147,10 @@ bool MetaOptimizerEnabled(const ConfigProto& cfg) {
          rewrite_cfg.debug_stripper() == RewriterConfig::ON ||
          rewrite_cfg.scoped_allocator_optimization() == RewriterConfig::ON ||
          rewrite_cfg.pin_to_host_optimization() == RewriterConfig::ON ||
+         rewrite_cfg.cost_based_placement() == RewriterConfig::ON ||
          AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision()) ||
          AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision_mkl()) ||
+         AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision_cpu()) ||
          !rewrite_cfg.optimizers().empty() ||
          !rewrite_cfg.custom_optimizers().empty();
 }
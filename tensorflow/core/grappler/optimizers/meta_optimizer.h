@@ -109,6 +109,13 @@ class MetaOptimizer : public GraphOptimizer {
                       GrapplerItem* optimized_item, GraphDef* optimized_graph,
                       GraphOptimizationResult* optimization_result);
 
+  // Same as OptimizeGraph() above, but appends the optimization results to
+  // "optimization_results" instead of "optimization_results_", so that items
+  // can be optimized concurrently.
+  Status OptimizeGraph(
+      Cluster* cluster, GrapplerItem&& item, GraphDef* optimized_graph,
+      std::vector<GraphOptimizationResult>* optimization_results);
+
   std::vector<GraphOptimizationResult> optimization_results_;
 };
 
@@ -18,6 +18,7 @@ limitations under the License.
 #include <atomic>
 
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -32,6 +33,8 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/config.pb.h"
@@ -74,6 +77,18 @@ bool TestOptimizer::optimized_;
 
 REGISTER_GRAPH_OPTIMIZER(TestOptimizer);
 
+class FailingOptimizer : public TestOptimizer {
+ public:
+  string name() const override { return "failing_optimizer"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    return errors::Internal("FailingOptimizer always fails");
+  }
+};
+
+REGISTER_GRAPH_OPTIMIZER(FailingOptimizer);
+
 class TestGraphOptimizer : public TestOptimizer {
  public:
   string name() const override { return "test_graph_optimizer"; }
@@ -237,6 +252,98 @@ TEST_F(MetaOptimizerTest, RunToggleOptimizersAndCustomGraphOptimizerTwice) {
   EXPECT_TRUE(TestGraphOptimizer::IsOptimized());
 }
 
+TEST_F(MetaOptimizerTest, OptimizationCache) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  ASSERT_TRUE(fake_input.NextItem(&item));
+
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "meta_optimizer_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(cache_dir));
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_custom_optimizers()->set_name("TestOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_cache_dir(cache_dir);
+
+  // The first optimization fills the cache.
+  GraphDef output;
+  {
+    TestOptimizer::SetOptimized(false);
+    MetaOptimizer optimizer(nullptr, config_proto);
+    TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+    EXPECT_TRUE(TestOptimizer::IsOptimized());
+  }
+  std::vector<string> entries;
+  TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+  EXPECT_EQ(1, entries.size());
+
+  // The second one reads the optimized graph from the cache.
+  {
+    TestOptimizer::SetOptimized(false);
+    MetaOptimizer optimizer(nullptr, config_proto);
+    GraphDef cached_output;
+    TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &cached_output));
+    EXPECT_FALSE(TestOptimizer::IsOptimized());
+    CompareGraphs(output, cached_output);
+  }
+
+  // A different configuration misses the cache.
+  {
+    rewriter_config.set_constant_folding(RewriterConfig::OFF);
+    TestOptimizer::SetOptimized(false);
+    MetaOptimizer optimizer(nullptr, config_proto);
+    GraphDef uncached_output;
+    TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &uncached_output));
+    EXPECT_TRUE(TestOptimizer::IsOptimized());
+  }
+  TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+  EXPECT_EQ(2, entries.size());
+}
+
+TEST_F(MetaOptimizerTest, OptimizationCacheSkipsFailedOptimizations) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  ASSERT_TRUE(fake_input.NextItem(&item));
+
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "meta_optimizer_failed_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(cache_dir));
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_custom_optimizers()->set_name("TestOptimizer");
+  rewriter_config.add_custom_optimizers()->set_name("FailingOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_cache_dir(cache_dir);
+
+  // The failure is swallowed, but the result must not be cached.
+  MetaOptimizer optimizer(nullptr, config_proto);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  std::vector<string> entries;
+  TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+  EXPECT_TRUE(entries.empty());
+
+  // Without the failing optimizer the graph is cached again.
+  rewriter_config.mutable_custom_optimizers()->RemoveLast();
+  MetaOptimizer succeeding_optimizer(nullptr, config_proto);
+  TF_EXPECT_OK(succeeding_optimizer.Optimize(nullptr, item, &output));
+  TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+  EXPECT_EQ(1, entries.size());
+}
+
 TEST_F(MetaOptimizerTest, OptimizeFunctionLibrary) {
   using test::function::NDef;
 
@@ -402,6 +509,82 @@ TEST_F(MetaOptimizerTest, OptimizeFunctionLibrary) {
   test::ExpectTensorEqual<int>(tensors_expected[1], tensors[1]);
 }
 
+TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryConcurrently) {
+  using test::function::NDef;
+
+  // Enable only function optimization.
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.set_function_optimization(RewriterConfig::ON);
+  rewriter_config.add_optimizers("function");
+  rewriter_config.set_min_graph_nodes(-1);
+
+  // Define a library of independent functions, each called from the graph:
+  //
+  //  *MySquare_i(x) = MySquare_{i-1}(x) * x
+  //  *MySquare_0(x) = x * x
+  //
+  //  * - marked as noinline
+  const int kNumFunctions = 16;
+  std::vector<FunctionDef> funcs;
+  std::vector<NodeDef> nodes = {
+      NDef("a", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice)};
+  for (int i = 0; i < kNumFunctions; ++i) {
+    const string name = absl::StrCat("MySquare_", i);
+    if (i == 0) {
+      funcs.push_back(FunctionDefHelper::Create(
+          name, {"x:T"}, {"z:T"}, {"T: {float, double}"},
+          {{{"mul"}, "Mul", {"x", "x"}, {{"T", "$T"}}}},
+          /*ret_def=*/
+          {{"z", "mul:z:0"}}));
+    } else {
+      funcs.push_back(FunctionDefHelper::Create(
+          name, {"x:T"}, {"z:T"}, {"T: {float, double}"},
+          {{{"prev"}, absl::StrCat("MySquare_", i - 1), {"x"}, {{"T", "$T"}}},
+           {{"mul"}, "Mul", {"prev:z", "x"}, {{"T", "$T"}}}},
+          /*ret_def=*/
+          {{"z", "mul:z:0"}}));
+    }
+    (*funcs.back().mutable_attr())["_noinline"].set_b(true);
+    nodes.push_back(NDef(absl::StrCat("call_", i), name, {"a"},
+                         {{"T", DT_FLOAT}}, kDevice));
+  }
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(nodes, funcs);
+
+  // The optimized library does not depend on the order in which functions
+  // are optimized.
+  GraphDef output;
+  {
+    MetaOptimizer optimizer(nullptr, config_proto);
+    TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  }
+  for (int run = 0; run < 3; ++run) {
+    MetaOptimizer optimizer(nullptr, config_proto);
+    GraphDef other_output;
+    TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &other_output));
+    CompareGraphs(output, other_output);
+    ASSERT_EQ(output.library().function_size(),
+              other_output.library().function_size());
+    for (int i = 0; i < output.library().function_size(); ++i) {
+      CompareFunctions(output.library().function(i),
+                       other_output.library().function(i));
+    }
+  }
+
+  // Every call in the graph was specialized.
+  FunctionLibraryDefinition optimized_flib(OpRegistry::Global(),
+                                           output.library());
+  for (int i = 0; i < kNumFunctions; ++i) {
+    const string specialized =
+        absl::Substitute("MySquare_$0_specialized_for_call_$0_at_tf_graph", i);
+    EXPECT_NE(optimized_flib.Find(specialized), nullptr) << specialized;
+  }
+}
+
 TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryPruneUnusedOutputs) {
   using test::function::NDef;
 
@@ -61,6 +61,21 @@ namespace grappler {
 //
 // In all cases, the supported activation functions are Relu, Relu6, and Elu.
 //
+// BatchMatMul + ... -> _FusedScaledDotProductAttention:
+//   (1) BatchMatMul(Q, K^T) + <Scale> + <Mask> + Softmax + <Dropout> +
+//       BatchMatMul(V)
+//   (2) Einsum(K, Q) + <Scale> + <Mask> + Softmax + <Dropout> + Einsum(V)
+//
+// where the scale is a Mul or RealDiv by a scalar constant of either the
+// scores or the queries, and the mask is an Add of a tensor that broadcasts to
+// the attention scores. The Einsum pattern is the one of Keras
+// MultiHeadAttention, with the equations "aecd,abcd->acbe" and
+// "acbe,aecd->abcd" on [batch, length, heads, depth] tensors; the queries, keys
+// and values are transposed to [batch, heads, length, depth] for the fused op,
+// and its output back. The dropout can only be the Identity of an inference
+// graph: a training dropout multiplies the weights by a random mask, and the
+// pattern is not fused.
+//
 // Both Conv2D and MatMul implemented as Tensor contraction (on CPU), so all the
 // patterns are "ContractionWith...".
 namespace {
@@ -69,6 +84,8 @@ constexpr char kFusedConv2D[] = "_FusedConv2D";
 constexpr char kFusedMatMul[] = "_FusedMatMul";
 constexpr char kFusedDepthwiseConv2dNative[] = "_FusedDepthwiseConv2dNative";
 constexpr char kFusedBatchNormEx[] = "_FusedBatchNormEx";
+constexpr char kFusedScaledDotProductAttention[] =
+    "_FusedScaledDotProductAttention";
 
 constexpr char kDataFormat[] = "data_format";
 constexpr char kIsTraining[] = "is_training";
@@ -171,6 +188,29 @@ struct ContractionWithBatchNormAndActivation {
   float epsilon = 0.0;
 };
 
+// BatchMatMul (or Einsum) of queries and keys, followed by an optional scale
+// and mask, a Softmax, an optional Identity dropout and a BatchMatMul (or
+// Einsum) with the values.
+struct ScaledDotProductAttention {
+  ScaledDotProductAttention() = default;
+
+  int query_key = kMissingIndex;
+  int scale = kMissingIndex;
+  int add = kMissingIndex;
+  int softmax = kMissingIndex;
+  int dropout = kMissingIndex;
+  int attention_value = kMissingIndex;
+  // Mul or RealDiv of the queries by the scale, instead of the scores.
+  int query_scale = kMissingIndex;
+  // Input port of the Add that reads the mask.
+  int mask_port = 0;
+  // Input port of the `query_scale` node that reads the queries.
+  int query_scale_port = 0;
+  float scale_value = 1.0;
+  // The matmuls are the Einsums of Keras MultiHeadAttention.
+  bool einsum = false;
+};
+
 #ifdef INTEL_MKL
 // Contraction node followed by a BiasAdd and Add.
 struct ContractionWithBiasAddAndAdd {
@@ -962,6 +1002,222 @@ bool FindFusedBatchNormEx(const RemapperContext& ctx, int node_index,
   return false;
 }
 
+// Returns the value of a scalar float Const node.
+bool GetScalarConstValue(const NodeDef& node, float* value) {
+  if (!IsConstant(node) || !HasDataType(&node, DT_FLOAT, "dtype")) {
+    return false;
+  }
+  if (node.attr().count("value") == 0) return false;
+  Tensor tensor;
+  if (!tensor.FromProto(node.attr().at("value").tensor())) return false;
+  if (tensor.dims() != 0) return false;
+  *value = tensor.scalar<float>()();
+  return true;
+}
+
+// Returns true if both shapes have the same known rank of at least 3, and
+// symbolically equal batch dimensions (all but the two inner dimensions).
+bool HaveSameBatchDimensions(const TensorShapeProto& lhs,
+                             const TensorShapeProto& rhs) {
+  const int rank = Rank(lhs);
+  if (rank < 3 || Rank(rhs) != rank) return false;
+  TensorShapeProto lhs_batch;
+  TensorShapeProto rhs_batch;
+  for (int i = 0; i < rank - 2; ++i) {
+    *lhs_batch.add_dim() = lhs.dim(i);
+    *rhs_batch.add_dim() = rhs.dim(i);
+  }
+  return ShapesSymbolicallyEqual(lhs_batch, rhs_batch);
+}
+
+// Equations of the attention scores and output of Keras MultiHeadAttention.
+constexpr char kAttentionScoresEquation[] = "aecd,abcd->acbe";
+constexpr char kAttentionOutputEquation[] = "acbe,aecd->abcd";
+
+bool IsEinsum(const NodeDef& node, const string& equation) {
+  string node_equation;
+  return node.op() == "Einsum" &&
+         TryGetNodeAttr(node, "equation", &node_equation) &&
+         node_equation == equation;
+}
+
+// Returns true if the node is a Mul or RealDiv by a scalar constant, and
+// returns the input port of the scaled tensor and the scale as a multiplier.
+bool GetScalarScale(const utils::MutableNodeView& node_view, int* port,
+                    float* scale) {
+  const NodeDef* node_def = node_view.node();
+  if (!(IsMul(*node_def) || IsRealDiv(*node_def)) ||
+      node_view.NumRegularFanins() != 2 ||
+      !HasDataType(node_def, DT_FLOAT)) {
+    return false;
+  }
+  float value;
+  if (GetScalarConstValue(*node_view.GetRegularFanin(1).node_view()->node(),
+                          &value)) {
+    *port = 0;
+  } else if (IsMul(*node_def) &&
+             GetScalarConstValue(
+                 *node_view.GetRegularFanin(0).node_view()->node(), &value)) {
+    *port = 1;
+  } else {
+    return false;
+  }
+  if (IsRealDiv(*node_def)) {
+    if (value == 0.0f) return false;
+    value = 1.0f / value;
+  }
+  *scale = value;
+  return true;
+}
+
+bool FindScaledDotProductAttention(const RemapperContext& ctx, int node_index,
+                                   ScaledDotProductAttention* matched) {
+  const auto is_attention_matmul = [](const NodeDef& node,
+                                      bool adj_y) -> bool {
+    if (!IsAnyBatchMatMul(node) || !HasDataType(&node, DT_FLOAT)) {
+      return false;
+    }
+    bool node_adj_x = false;
+    bool node_adj_y = false;
+    TryGetNodeAttr(node, "adj_x", &node_adj_x);
+    TryGetNodeAttr(node, "adj_y", &node_adj_y);
+    return !node_adj_x && node_adj_y == adj_y;
+  };
+  // Intermediate nodes of the pattern are only read by the next node.
+  const auto is_fusable = [&ctx](const utils::MutableNodeView& node_view) {
+    return !HasControlFaninOrFanout(node_view) &&
+           HasAtMostOneFanoutAtPort0(node_view) &&
+           !IsInPreserveSet(ctx, node_view.node());
+  };
+
+  // Root of the pattern must be a BatchMatMul (or Einsum) of the Softmax and
+  // the values.
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  if (HasControlFaninOrFanout(*node_view)) return false;
+  const auto* node_def = node_view->node();
+  const bool einsum = IsEinsum(*node_def, kAttentionOutputEquation);
+  const bool is_output =
+      einsum ? HasDataType(node_def, DT_FLOAT)
+             : is_attention_matmul(*node_def, /*adj_y=*/false);
+  if (!is_output) return false;
+  if (!NodeIsOnCpu(node_def) || node_view->NumRegularFanins() != 2) {
+    return false;
+  }
+
+  ScaledDotProductAttention pattern;
+  pattern.attention_value = node_index;
+  pattern.einsum = einsum;
+
+  // The dropout of the attention weights is an Identity in inference graphs.
+  const auto* softmax_view = node_view->GetRegularFanin(0).node_view();
+  if (IsIdentity(*softmax_view->node())) {
+    if (!is_fusable(*softmax_view) || softmax_view->NumRegularFanins() != 1) {
+      return false;
+    }
+    pattern.dropout = softmax_view->node_index();
+    softmax_view = softmax_view->GetRegularFanin(0).node_view();
+  }
+  if (!IsSoftmax(*softmax_view->node()) || !is_fusable(*softmax_view) ||
+      !HasDataType(softmax_view->node(), DT_FLOAT) ||
+      softmax_view->NumRegularFanins() != 1) {
+    return false;
+  }
+  pattern.softmax = softmax_view->node_index();
+
+  // Matches the attention scores: BatchMatMul(Q, K^T) or Einsum(K, Q) with an
+  // optional scale of the scores or of the queries.
+  const auto match_scores = [&](const utils::MutableNodeView& view) -> bool {
+    pattern.scale = kMissingIndex;
+    pattern.query_scale = kMissingIndex;
+    pattern.scale_value = 1.0f;
+    const auto* scores_view = &view;
+    int scores_port;
+    float value;
+    if (GetScalarScale(view, &scores_port, &value)) {
+      if (!is_fusable(view)) return false;
+      pattern.scale = view.node_index();
+      pattern.scale_value = value;
+      scores_view = view.GetRegularFanin(scores_port).node_view();
+    }
+    const NodeDef* scores_def = scores_view->node();
+    const bool is_scores =
+        einsum ? IsEinsum(*scores_def, kAttentionScoresEquation) &&
+                     HasDataType(scores_def, DT_FLOAT)
+               : is_attention_matmul(*scores_def, /*adj_y=*/true);
+    if (!is_scores) return false;
+    if (!is_fusable(*scores_view) || scores_view->NumRegularFanins() != 2) {
+      return false;
+    }
+    pattern.query_key = scores_view->node_index();
+
+    // Keras MultiHeadAttention scales the queries rather than the scores.
+    const auto* query_view =
+        scores_view->GetRegularFanin(einsum ? 1 : 0).node_view();
+    int query_port;
+    if (pattern.scale == kMissingIndex &&
+        GetScalarScale(*query_view, &query_port, &value) &&
+        is_fusable(*query_view)) {
+      pattern.query_scale = query_view->node_index();
+      pattern.query_scale_port = query_port;
+      pattern.scale_value = value;
+    }
+    return true;
+  };
+
+  const auto* input_view = softmax_view->GetRegularFanin(0).node_view();
+  if (IsAdd(*input_view->node())) {
+    // The mask can be added on either side of the scores.
+    if (!is_fusable(*input_view) || input_view->NumRegularFanins() != 2 ||
+        !HasDataType(input_view->node(), DT_FLOAT)) {
+      return false;
+    }
+    pattern.add = input_view->node_index();
+    if (match_scores(*input_view->GetRegularFanin(0).node_view())) {
+      pattern.mask_port = 1;
+    } else if (match_scores(*input_view->GetRegularFanin(1).node_view())) {
+      pattern.mask_port = 0;
+    } else {
+      return false;
+    }
+  } else if (!match_scores(*input_view)) {
+    return false;
+  }
+
+  // The fused kernel does not broadcast the batch dimensions of the queries,
+  // keys and values, and broadcasts the mask only to the shape of the scores.
+  // The Einsum equations have no broadcasting.
+  const NodeDef& query_key = ctx.graph_view.graph()->node(pattern.query_key);
+  if (!einsum) {
+    const auto& query_key_props =
+        ctx.graph_properties.GetInputProperties(query_key.name());
+    const auto& value_props =
+        ctx.graph_properties.GetInputProperties(node_def->name());
+    if (query_key_props.size() != 2 || value_props.size() != 2) return false;
+    const TensorShapeProto& query_shape = query_key_props[0].shape();
+    if (!HaveSameBatchDimensions(query_shape, query_key_props[1].shape()) ||
+        !HaveSameBatchDimensions(query_shape, value_props[1].shape())) {
+      return false;
+    }
+  }
+  if (pattern.add != kMissingIndex) {
+    const NodeDef& add = ctx.graph_view.graph()->node(pattern.add);
+    const auto& add_props = ctx.graph_properties.GetInputProperties(add.name());
+    const auto& add_output_props =
+        ctx.graph_properties.GetOutputProperties(add.name());
+    if (add_props.size() != 2 || add_output_props.empty()) return false;
+    const TensorShapeProto& scores_shape =
+        add_props[1 - pattern.mask_port].shape();
+    const int mask_rank = Rank(add_props[pattern.mask_port].shape());
+    if (mask_rank < 0 || mask_rank > Rank(scores_shape) ||
+        !ShapesSymbolicallyEqual(add_output_props[0].shape(), scores_shape)) {
+      return false;
+    }
+  }
+
+  *matched = pattern;
+  return true;
+}
+
 void CopyConv2DAttributes(const NodeDef& conv2d, NodeDef* fused_conv2d,
                           const NodeDef* activation = nullptr) {
   DCHECK(IsConv2D(conv2d)) << "Input node must be a Conv2D";
@@ -1441,6 +1697,133 @@ Status AddFusedBatchNormExNode(RemapperContext* ctx,
   return Status::OK();
 }
 
+Status AddFusedScaledDotProductAttentionNode(
+    RemapperContext* ctx, const ScaledDotProductAttention& matched,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& attention_value = graph->node(matched.attention_value);
+  const NodeDef& query_key = graph->node(matched.query_key);
+
+  VLOG(2) << "Fuse scaled dot-product attention:"
+          << " attention_value=" << attention_value.name() << " dropout="
+          << (matched.dropout != kMissingIndex
+                  ? graph->node(matched.dropout).name()
+                  : "<none>")
+          << " softmax=" << graph->node(matched.softmax).name() << " mask="
+          << (matched.add != kMissingIndex ? graph->node(matched.add).name()
+                                           : "<none>")
+          << " scale="
+          << (matched.scale != kMissingIndex
+                  ? graph->node(matched.scale).name()
+                  : "<none>")
+          << " query_scale="
+          << (matched.query_scale != kMissingIndex
+                  ? graph->node(matched.query_scale).name()
+                  : "<none>")
+          << " query_key=" << query_key.name();
+
+  // Einsum(K, Q) reads the keys first.
+  string query = query_key.input(matched.einsum ? 1 : 0);
+  string key = query_key.input(matched.einsum ? 0 : 1);
+  string value = attention_value.input(1);
+  if (matched.query_scale != kMissingIndex) {
+    query = graph->node(matched.query_scale).input(matched.query_scale_port);
+  }
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+
+  // Swaps the length and heads dimensions of the Einsum operands and output.
+  const string perm_name =
+      AddPrefixToNodeName("AttentionPerm", attention_value.name());
+  const auto add_transpose = [&](const string& name,
+                                 const string& input) -> Status {
+    NodeDef transpose;
+    transpose.set_name(name);
+    transpose.set_op("Transpose");
+    transpose.set_device(attention_value.device());
+    transpose.add_input(input);
+    transpose.add_input(perm_name);
+    (*transpose.mutable_attr())["T"] = attention_value.attr().at("T");
+    (*transpose.mutable_attr())["Tperm"].set_type(DT_INT32);
+    Status transpose_status;
+    mutation->AddNode(std::move(transpose), &transpose_status);
+    return transpose_status;
+  };
+
+  NodeDef fused_op;
+  fused_op.set_op(kFusedScaledDotProductAttention);
+  fused_op.set_device(attention_value.device());
+  if (matched.einsum) {
+    NodeDef perm;
+    perm.set_name(perm_name);
+    perm.set_op("Const");
+    perm.set_device(attention_value.device());
+    *perm.add_input() = AsControlDependency(NodeName(query));
+    (*perm.mutable_attr())["dtype"].set_type(DT_INT32);
+    Tensor t(DT_INT32, {4});
+    t.flat<int32>()(0) = 0;
+    t.flat<int32>()(1) = 2;
+    t.flat<int32>()(2) = 1;
+    t.flat<int32>()(3) = 3;
+    t.AsProtoTensorContent((*perm.mutable_attr())["value"].mutable_tensor());
+    mutation->AddNode(std::move(perm), &status);
+    TF_RETURN_IF_ERROR(status);
+
+    const string& name = attention_value.name();
+    TF_RETURN_IF_ERROR(add_transpose(
+        AddPrefixToNodeName("TransposedQuery", name), query));
+    TF_RETURN_IF_ERROR(
+        add_transpose(AddPrefixToNodeName("TransposedKey", name), key));
+    TF_RETURN_IF_ERROR(
+        add_transpose(AddPrefixToNodeName("TransposedValue", name), value));
+    query = AddPrefixToNodeName("TransposedQuery", name);
+    key = AddPrefixToNodeName("TransposedKey", name);
+    value = AddPrefixToNodeName("TransposedValue", name);
+    fused_op.set_name(AddPrefixToNodeName("FusedAttention", name));
+  } else {
+    fused_op.set_name(attention_value.name());
+  }
+
+  fused_op.add_input(query);  // 0: query
+  fused_op.add_input(key);    // 1: key
+  fused_op.add_input(value);  // 2: value
+
+  auto* attrs = fused_op.mutable_attr();
+  (*attrs)["T"] = attention_value.attr().at("T");
+  SetAttrValue(matched.scale_value, &(*attrs)["scale"]);
+  if (matched.add != kMissingIndex) {
+    const NodeDef& add = graph->node(matched.add);
+    fused_op.add_input(add.input(matched.mask_port));  // 3: mask
+    SetAttrValue(1, &(*attrs)["num_args"]);
+  } else {
+    SetAttrValue(0, &(*attrs)["num_args"]);
+  }
+
+  const string fused_name = fused_op.name();
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  if (matched.einsum) {
+    // Takes the name of the output Einsum, which is replaced.
+    TF_RETURN_IF_ERROR(add_transpose(attention_value.name(), fused_name));
+  }
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.attention_value] = true;
+  (*nodes_to_delete)[matched.softmax] = true;
+  (*nodes_to_delete)[matched.query_key] = true;
+  if (matched.dropout != kMissingIndex) {
+    (*nodes_to_delete)[matched.dropout] = true;
+  }
+  if (matched.add != kMissingIndex) (*nodes_to_delete)[matched.add] = true;
+  if (matched.scale != kMissingIndex) (*nodes_to_delete)[matched.scale] = true;
+  if (matched.query_scale != kMissingIndex) {
+    (*nodes_to_delete)[matched.query_scale] = true;
+  }
+
+  return Status::OK();
+}
+
 Status AddBatchNormNodes(RemapperContext* ctx, const FusedBatchNorm& matched) {
   const GraphDef* graph = ctx->graph_view.graph();
   const NodeDef& fused_node = graph->node(matched.fused_batch_norm);
@@ -1688,6 +2071,7 @@ bool IsContractionWithAdd(const RemapperContext& ctx, int node_index) {
 //   (2) Fusing side input and/or activation into FusedBatchNorm.
 //   (3) Fusing Conv2D biasadd and relu on GPU
 //   (4) INTEL_MKL specific: Conv2D -> Add or Conv2D -> BiasAdd -> Add.
+//   (5) Fusing scaled dot-product attention.
 bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
   // Candidate for a FusedBatchNorm splitting.
   const auto* node_view = ctx.graph_view.GetNode(node_index);
@@ -1758,13 +2142,29 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
     return false;
   };
 
+  // Candidate for a scaled dot-product attention fusion.
+  const auto is_attention_candidate = [&]() -> bool {
+    if (!IsAnyBatchMatMul(*node_def) && node_def->op() != "Einsum") {
+      return false;
+    }
+    if (GetDataTypeFromAttr(*node_def, "T") != DT_FLOAT) return false;
+
+    if (node_view->NumRegularFanins() < 1) return false;
+    const auto* weights_view = node_view->GetRegularFanin(0).node_view();
+    if (IsIdentity(*weights_view->node())) {
+      if (weights_view->NumRegularFanins() < 1) return false;
+      weights_view = weights_view->GetRegularFanin(0).node_view();
+    }
+    return IsSoftmax(*weights_view->node());
+  };
+
 #ifdef INTEL_MKL
   (void)is_relu_biasadd_conv2d_candidate;  // To fix unused variable error.
   return is_batch_norm_candidate() || is_batch_norm_fusion_candidate() ||
-         IsContractionWithAdd(ctx, node_index);
+         is_attention_candidate() || IsContractionWithAdd(ctx, node_index);
 #else
   return is_relu_biasadd_conv2d_candidate() || is_batch_norm_candidate() ||
-         is_batch_norm_fusion_candidate();
+         is_batch_norm_fusion_candidate() || is_attention_candidate();
 #endif  // INTEL_MKL
 }
 
@@ -1907,6 +2307,17 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
 #endif  // !INTEL_MKL
 
+    // Remap BatchMatMul+<Scale>+<Mask>+Softmax+<Dropout>+BatchMatMul, or the
+    // same Einsums, into the _FusedScaledDotProductAttention.
+    ScaledDotProductAttention scaled_dot_product_attention;
+    if (allow_non_differentiable_rewrites &&
+        FindScaledDotProductAttention(ctx, i, &scaled_dot_product_attention)) {
+      TF_RETURN_IF_ERROR(AddFusedScaledDotProductAttentionNode(
+          &ctx, scaled_dot_product_attention, &invalidated_nodes,
+          &nodes_to_delete));
+      continue;
+    }
+
     // Remap FusedBatchNorm+<SideInput>+<Activation> into the _FusedBatchNormEx.
     FusedBatchNormEx fused_batch_norm_ex;
     if (allow_non_differentiable_rewrites &&
@@ -1005,5 +1005,258 @@ TEST_F(RemapperTest, FuseConv2DWithSqueezeAndBias) {
 }
 #endif  // !INTEL_MKL
 
+class RemapperFuseScaledDotProductAttentionTest : public RemapperTest {
+ protected:
+  // Builds the attention of the transformer models:
+  //   softmax(matmul(query, key, adj_y=true) * scale + mask) * value
+  // with the scale computed by a Mul or a RealDiv, and an optional mask.
+  void RunTest(bool real_div, bool with_mask) {
+    using ::tensorflow::ops::Placeholder;
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto query_shape = Placeholder::Shape({2, 4, 70, 16});
+    auto key_shape = Placeholder::Shape({2, 4, 300, 16});
+    auto value_shape = Placeholder::Shape({2, 4, 300, 8});
+    auto mask_shape = Placeholder::Shape({2, 1, 1, 300});
+
+    auto query = Placeholder(s.WithOpName("query"), DT_FLOAT, query_shape);
+    auto key = Placeholder(s.WithOpName("key"), DT_FLOAT, key_shape);
+    auto value = Placeholder(s.WithOpName("value"), DT_FLOAT, value_shape);
+
+    auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                     ops::BatchMatMulV2::AdjY(true));
+    Output scaled;
+    if (real_div) {
+      auto depth = ops::Const(s.WithOpName("depth"), 4.0f);
+      scaled = ops::RealDiv(s.WithOpName("scaled"), scores, depth);
+    } else {
+      auto scale = ops::Const(s.WithOpName("scale"), 0.25f);
+      scaled = ops::Mul(s.WithOpName("scaled"), scale, scores);
+    }
+    Output logits = scaled;
+    if (with_mask) {
+      auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT, mask_shape);
+      logits = ops::AddV2(s.WithOpName("masked"), scaled, mask);
+    }
+    auto weights = ops::Softmax(s.WithOpName("weights"), logits);
+    auto attention = ops::BatchMatMulV2(s.WithOpName("attention"), weights,
+                                        value);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+    auto query_t = GenerateRandomTensor<DT_FLOAT>({2, 4, 70, 16});
+    auto key_t = GenerateRandomTensor<DT_FLOAT>({2, 4, 300, 16});
+    auto value_t = GenerateRandomTensor<DT_FLOAT>({2, 4, 300, 8});
+    auto mask_t = GenerateRandomTensor<DT_FLOAT>({2, 1, 1, 300});
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"query", query_t}, {"key", key_t}, {"value", value_t}};
+    if (with_mask) item.feed.emplace_back("mask", mask_t);
+    TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+    // Place all nodes on CPU.
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::AGGRESSIVE);  // trust placeholders shape
+    GraphDef output;
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.op(), "Softmax");
+      if (node.name() == "attention") {
+        EXPECT_EQ(node.op(), "_FusedScaledDotProductAttention");
+        ASSERT_EQ(node.input_size(), with_mask ? 4 : 3);
+        EXPECT_EQ(node.input(0), "query");
+        EXPECT_EQ(node.input(1), "key");
+        EXPECT_EQ(node.input(2), "value");
+        if (with_mask) EXPECT_EQ(node.input(3), "mask");
+
+        EXPECT_EQ(node.attr().at("num_args").i(), with_mask ? 1 : 0);
+        EXPECT_FLOAT_EQ(node.attr().at("scale").f(), 0.25f);
+        found++;
+      }
+    }
+    EXPECT_EQ(found, 1);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+  }
+};
+
+TEST_F(RemapperFuseScaledDotProductAttentionTest, MulAndMask) {
+  RunTest(/*real_div=*/false, /*with_mask=*/true);
+}
+
+TEST_F(RemapperFuseScaledDotProductAttentionTest, RealDiv) {
+  RunTest(/*real_div=*/true, /*with_mask=*/false);
+}
+
+// Builds the attention of Keras MultiHeadAttention on [batch, length, heads,
+// depth] tensors, with the queries scaled before the Einsum of the scores and
+// an optional inference dropout.
+TEST_F(RemapperTest, FuseEinsumAttention) {
+  for (bool with_dropout : {false, true}) {
+    using ::tensorflow::ops::Placeholder;
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto query_shape = Placeholder::Shape({2, 70, 4, 16});
+    auto key_shape = Placeholder::Shape({2, 300, 4, 16});
+    auto value_shape = Placeholder::Shape({2, 300, 4, 8});
+    auto mask_shape = Placeholder::Shape({2, 1, 1, 300});
+
+    auto query = Placeholder(s.WithOpName("query"), DT_FLOAT, query_shape);
+    auto key = Placeholder(s.WithOpName("key"), DT_FLOAT, key_shape);
+    auto value = Placeholder(s.WithOpName("value"), DT_FLOAT, value_shape);
+    auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT, mask_shape);
+
+    auto scale = ops::Const(s.WithOpName("scale"), 0.25f);
+    auto scaled_query = ops::Mul(s.WithOpName("scaled_query"), query, scale);
+    auto scores = ops::Einsum(s.WithOpName("scores"), {key, scaled_query},
+                              "aecd,abcd->acbe");
+    auto masked = ops::AddV2(s.WithOpName("masked"), scores, mask);
+    Output weights = ops::Softmax(s.WithOpName("weights"), masked);
+    if (with_dropout) {
+      weights = ops::Identity(s.WithOpName("dropout"), weights);
+    }
+    auto attention = ops::Einsum(s.WithOpName("attention"), {weights, value},
+                                 "acbe,aecd->abcd");
+    auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+    auto query_t = GenerateRandomTensor<DT_FLOAT>({2, 70, 4, 16});
+    auto key_t = GenerateRandomTensor<DT_FLOAT>({2, 300, 4, 16});
+    auto value_t = GenerateRandomTensor<DT_FLOAT>({2, 300, 4, 8});
+    auto mask_t = GenerateRandomTensor<DT_FLOAT>({2, 1, 1, 300});
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"query", query_t},
+                 {"key", key_t},
+                 {"value", value_t},
+                 {"mask", mask_t}};
+    TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::AGGRESSIVE);
+    GraphDef output;
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.op(), "Softmax");
+      EXPECT_NE(node.op(), "Einsum");
+      EXPECT_NE(node.name(), "scaled_query");
+      EXPECT_NE(node.name(), "dropout");
+      if (node.name() == "attention") {
+        EXPECT_EQ(node.op(), "Transpose");
+        ASSERT_EQ(node.input_size(), 2);
+        EXPECT_EQ(node.input(0), "attention/FusedAttention");
+        found++;
+      } else if (node.name() == "attention/FusedAttention") {
+        EXPECT_EQ(node.op(), "_FusedScaledDotProductAttention");
+        ASSERT_EQ(node.input_size(), 4);
+        EXPECT_EQ(node.input(0), "attention/TransposedQuery");
+        EXPECT_EQ(node.input(1), "attention/TransposedKey");
+        EXPECT_EQ(node.input(2), "attention/TransposedValue");
+        EXPECT_EQ(node.input(3), "mask");
+        EXPECT_EQ(node.attr().at("num_args").i(), 1);
+        EXPECT_FLOAT_EQ(node.attr().at("scale").f(), 0.25f);
+        found++;
+      } else if (node.name() == "attention/TransposedQuery") {
+        EXPECT_EQ(node.op(), "Transpose");
+        ASSERT_EQ(node.input_size(), 2);
+        EXPECT_EQ(node.input(0), "query");
+        found++;
+      }
+    }
+    EXPECT_EQ(found, 3);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+  }
+}
+
+TEST_F(RemapperTest, DoNotFuseAttentionWithTrainingDropout) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto shape = Placeholder::Shape({2, 32, 4, 16});
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT, shape);
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT, shape);
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT, shape);
+  auto keep = Placeholder(s.WithOpName("keep"), DT_FLOAT,
+                          Placeholder::Shape({2, 4, 32, 32}));
+
+  auto scores =
+      ops::Einsum(s.WithOpName("scores"), {key, query}, "aecd,abcd->acbe");
+  auto weights = ops::Softmax(s.WithOpName("weights"), scores);
+  // A training dropout multiplies the weights by a random mask.
+  auto dropout = ops::Mul(s.WithOpName("dropout"), weights, keep);
+  auto attention = ops::Einsum(s.WithOpName("attention"), {dropout, value},
+                               "acbe,aecd->abcd");
+  auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::AGGRESSIVE);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.op(), "_FusedScaledDotProductAttention");
+  }
+}
+
+TEST_F(RemapperTest, DoNotFuseAttentionWithFetchedWeights) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto shape = Placeholder::Shape({2, 32, 16});
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT, shape);
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT, shape);
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT, shape);
+
+  auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::AdjY(true));
+  auto weights = ops::Softmax(s.WithOpName("weights"), scores);
+  auto attention =
+      ops::BatchMatMulV2(s.WithOpName("attention"), weights, value);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+  GrapplerItem item;
+  // The attention weights are fetched, and cannot be fused.
+  item.fetch = {"fetch", "weights"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::AGGRESSIVE);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.op(), "_FusedScaledDotProductAttention");
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -0,0 +1,692 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// CPU kernels for the tensors in the blocked NCHW[x]c layout created by the
+// Grappler layout optimizer. A blocked tensor has the shape
+// [batch, channel_blocks, height, width, block_size], so the innermost loops of
+// the kernels below run over a block of channels with a compile time size,
+// which the compiler vectorizes.
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/kernel_shape_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/padding.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Runs `fn(start, limit)` over [0, total) on the intra op thread pool.
+void ParallelFor(OpKernelContext* context, int64 total, int64 cost_per_unit,
+                 const std::function<void(int64, int64)>& fn) {
+  context->device()->tensorflow_cpu_worker_threads()->workers->ParallelFor(
+      total, cost_per_unit, fn);
+}
+
+int64 ChannelBlocks(int64 channels, int64 block_size) {
+  return (channels + block_size - 1) / block_size;
+}
+
+// Validates a blocked input tensor, and returns its dimensions.
+Status GetBlockedDims(const Tensor& input, int64* batch, int64* blocks,
+                      int64* rows, int64* cols, int64* block_size) {
+  if (input.dims() != 5) {
+    return errors::InvalidArgument("Blocked input must be 5-dimensional: ",
+                                   input.shape().DebugString());
+  }
+  *batch = input.dim_size(0);
+  *blocks = input.dim_size(1);
+  *rows = input.dim_size(2);
+  *cols = input.dim_size(3);
+  *block_size = input.dim_size(4);
+  if (*block_size != 8 && *block_size != 16) {
+    return errors::Unimplemented("Unsupported block size: ", *block_size);
+  }
+  return Status::OK();
+}
+
+// Window of the blocked convolution and pooling ops.
+struct BlockedWindow {
+  int64 rows;
+  int64 cols;
+  int64 row_stride;
+  int64 col_stride;
+  int64 out_rows;
+  int64 out_cols;
+  int64 pad_top;
+  int64 pad_left;
+};
+
+Status ComputeBlockedWindow(int64 in_rows, int64 in_cols, int64 window_rows,
+                            int64 window_cols,
+                            const std::vector<int32>& strides,
+                            Padding padding, BlockedWindow* window) {
+  if (strides.size() != 4 || strides[0] != 1 || strides[3] != 1) {
+    return errors::Unimplemented(
+        "Blocked ops only support strides in the height and width "
+        "dimensions.");
+  }
+  window->rows = window_rows;
+  window->cols = window_cols;
+  window->row_stride = strides[1];
+  window->col_stride = strides[2];
+  int64 pad_bottom, pad_right;
+  TF_RETURN_IF_ERROR(GetWindowedOutputSizeVerbose(
+      in_rows, window_rows, window->row_stride, padding, &window->out_rows,
+      &window->pad_top, &pad_bottom));
+  TF_RETURN_IF_ERROR(GetWindowedOutputSizeVerbose(
+      in_cols, window_cols, window->col_stride, padding, &window->out_cols,
+      &window->pad_left, &pad_right));
+  return Status::OK();
+}
+
+// Calls `fn(i)` for i in [0, N), unrolled at compile time, so that the arrays
+// indexed by `i` are kept in registers.
+template <int N>
+struct Unrolled {
+  template <typename Fn>
+  static EIGEN_ALWAYS_INLINE void Run(const Fn& fn) {
+    Unrolled<N - 1>::Run(fn);
+    fn(N - 1);
+  }
+};
+
+template <>
+struct Unrolled<0> {
+  template <typename Fn>
+  static EIGEN_ALWAYS_INLINE void Run(const Fn& fn) {}
+};
+
+// A block of B channels is held in kPackets packets, and the convolution
+// computes kTile output columns at once, so that each filter packet loaded is
+// used for several input pixels. The accumulators of a tile take 12 registers.
+template <int B>
+struct BlockedConvTraits {
+  using Packet = typename Eigen::internal::find_best_packet<float, B>::type;
+  static constexpr int kPacketSize =
+      Eigen::internal::unpacket_traits<Packet>::size;
+  static constexpr int kPackets = B / kPacketSize;
+  static constexpr int kTile = kPackets >= 12 ? 1 : 12 / kPackets;
+};
+
+// Computes `kCols` output columns starting at `out_col`, for one output row of
+// a block of output channels. The input columns must be padded, so that the
+// windows never read past the left or right edge. `filter` is blocked as
+// [in_blocks, rows, cols, B (in), B (out)].
+template <int B, int kCols>
+void BlockedConvTile(const float* input, const float* filter, int64 in_blocks,
+                     int64 in_rows, int64 in_cols, const BlockedWindow& window,
+                     int64 out_row, int64 out_col, float* output) {
+  using Traits = BlockedConvTraits<B>;
+  using Packet = typename Traits::Packet;
+  constexpr int kPacketSize = Traits::kPacketSize;
+  constexpr int kPackets = Traits::kPackets;
+
+  Packet acc[kCols][kPackets];
+  Unrolled<kCols>::Run([&](int t) {
+    Unrolled<kPackets>::Run([&](int p) {
+      acc[t][p] = Eigen::internal::pset1<Packet>(0.0f);
+    });
+  });
+  const int64 in_row_start = out_row * window.row_stride - window.pad_top;
+  const int64 in_col_start = out_col * window.col_stride;
+  const int64 x_stride = window.col_stride * B;
+  for (int64 in_block = 0; in_block < in_blocks; ++in_block) {
+    const float* in_plane = input + in_block * in_rows * in_cols * B;
+    const float* filter_block =
+        filter + in_block * window.rows * window.cols * B * B;
+    for (int64 r = 0; r < window.rows; ++r) {
+      const int64 in_row = in_row_start + r;
+      if (in_row < 0 || in_row >= in_rows) continue;
+      for (int64 c = 0; c < window.cols; ++c) {
+        const float* x = in_plane + (in_row * in_cols + in_col_start + c) * B;
+        const float* w = filter_block + (r * window.cols + c) * B * B;
+        for (int ci = 0; ci < B; ++ci) {
+          Packet w_row[kPackets];
+          Unrolled<kPackets>::Run([&](int p) {
+            w_row[p] =
+                Eigen::internal::ploadu<Packet>(w + ci * B + p * kPacketSize);
+          });
+          Unrolled<kCols>::Run([&](int t) {
+            const Packet value =
+                Eigen::internal::pset1<Packet>(x[t * x_stride + ci]);
+            Unrolled<kPackets>::Run([&](int p) {
+              acc[t][p] = Eigen::internal::pmadd(value, w_row[p], acc[t][p]);
+            });
+          });
+        }
+      }
+    }
+  }
+  Unrolled<kCols>::Run([&](int t) {
+    Unrolled<kPackets>::Run([&](int p) {
+      Eigen::internal::pstoreu(output + (out_col + t) * B + p * kPacketSize,
+                               acc[t][p]);
+    });
+  });
+}
+
+// Computes the last `count` <= kCols output columns of a row.
+template <int B, int kCols>
+struct BlockedConvRemainder {
+  static void Run(const float* input, const float* filter, int64 in_blocks,
+                  int64 in_rows, int64 in_cols, const BlockedWindow& window,
+                  int64 out_row, int64 out_col, int64 count, float* output) {
+    if (count == kCols) {
+      BlockedConvTile<B, kCols>(input, filter, in_blocks, in_rows, in_cols,
+                                window, out_row, out_col, output);
+    } else {
+      BlockedConvRemainder<B, kCols - 1>::Run(input, filter, in_blocks,
+                                              in_rows, in_cols, window,
+                                              out_row, out_col, count, output);
+    }
+  }
+};
+
+template <int B>
+struct BlockedConvRemainder<B, 0> {
+  static void Run(const float* input, const float* filter, int64 in_blocks,
+                  int64 in_rows, int64 in_cols, const BlockedWindow& window,
+                  int64 out_row, int64 out_col, int64 count, float* output) {}
+};
+
+// Computes one output row of a blocked convolution, with padded input columns.
+template <int B>
+void BlockedConvRow(const float* input, const float* filter, int64 in_blocks,
+                    int64 in_rows, int64 in_cols, const BlockedWindow& window,
+                    int64 out_row, float* output) {
+  constexpr int kTile = BlockedConvTraits<B>::kTile;
+  int64 out_col = 0;
+  for (; out_col + kTile <= window.out_cols; out_col += kTile) {
+    BlockedConvTile<B, kTile>(input, filter, in_blocks, in_rows, in_cols,
+                              window, out_row, out_col, output);
+  }
+  BlockedConvRemainder<B, kTile - 1>::Run(input, filter, in_blocks, in_rows,
+                                          in_cols, window, out_row, out_col,
+                                          window.out_cols - out_col, output);
+}
+
+// Computes one output row of a blocked max or average pooling.
+template <int B, bool kMax>
+void BlockedPoolRow(const float* input, int64 in_rows, int64 in_cols,
+                    const BlockedWindow& window, int64 out_row,
+                    float* output) {
+  const int64 row_start =
+      std::max<int64>(out_row * window.row_stride - window.pad_top, 0);
+  const int64 row_end = std::min<int64>(
+      out_row * window.row_stride - window.pad_top + window.rows, in_rows);
+  for (int64 out_col = 0; out_col < window.out_cols; ++out_col) {
+    const int64 col_start =
+        std::max<int64>(out_col * window.col_stride - window.pad_left, 0);
+    const int64 col_end = std::min<int64>(
+        out_col * window.col_stride - window.pad_left + window.cols, in_cols);
+    float acc[B];
+    std::fill(acc, acc + B,
+              kMax ? std::numeric_limits<float>::lowest() : 0.0f);
+    for (int64 r = row_start; r < row_end; ++r) {
+      for (int64 c = col_start; c < col_end; ++c) {
+        const float* x = input + (r * in_cols + c) * B;
+        for (int i = 0; i < B; ++i) {
+          acc[i] = kMax ? std::max(acc[i], x[i]) : acc[i] + x[i];
+        }
+      }
+    }
+    if (!kMax) {
+      const float scale =
+          1.0f / std::max<int64>((row_end - row_start) * (col_end - col_start),
+                                 1);
+      for (int i = 0; i < B; ++i) acc[i] *= scale;
+    }
+    std::copy(acc, acc + B, output + out_col * B);
+  }
+}
+
+}  // namespace
+
+class ToBlockedLayoutOp : public OpKernel {
+ public:
+  explicit ToBlockedLayoutOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("block_size", &block_size_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    OP_REQUIRES(context, input.dims() == 4,
+                errors::InvalidArgument("Input must be 4-dimensional: ",
+                                        input.shape().DebugString()));
+    const int64 batch = input.dim_size(0);
+    const int64 rows = input.dim_size(1);
+    const int64 cols = input.dim_size(2);
+    const int64 channels = input.dim_size(3);
+    const int64 blocks = ChannelBlocks(channels, block_size_);
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, {batch, blocks, rows, cols, block_size_},
+                                &output));
+    const float* in = input.flat<float>().data();
+    float* out = output->flat<float>().data();
+    const int64 block_size = block_size_;
+
+    // One unit of work per output row.
+    ParallelFor(context, batch * blocks * rows, cols * block_size,
+                [&](int64 start, int64 limit) {
+                  for (int64 i = start; i < limit; ++i) {
+                    const int64 row = i % rows;
+                    const int64 block = (i / rows) % blocks;
+                    const int64 n = i / (rows * blocks);
+                    const float* src = in + (n * rows + row) * cols * channels;
+                    float* dst = out + i * cols * block_size;
+                    const int64 c_start = block * block_size;
+                    const int64 c_size =
+                        std::min(block_size, channels - c_start);
+                    for (int64 col = 0; col < cols; ++col) {
+                      const float* x = src + col * channels + c_start;
+                      float* y = dst + col * block_size;
+                      std::copy(x, x + c_size, y);
+                      std::fill(y + c_size, y + block_size, 0.0f);
+                    }
+                  }
+                });
+  }
+
+ private:
+  int64 block_size_;
+};
+
+class FromBlockedLayoutOp : public OpKernel {
+ public:
+  explicit FromBlockedLayoutOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_channels", &num_channels_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    OP_REQUIRES(context, input.dims() == 5,
+                errors::InvalidArgument("Input must be 5-dimensional: ",
+                                        input.shape().DebugString()));
+    const int64 batch = input.dim_size(0);
+    const int64 blocks = input.dim_size(1);
+    const int64 rows = input.dim_size(2);
+    const int64 cols = input.dim_size(3);
+    const int64 block_size = input.dim_size(4);
+    const int64 channels = num_channels_;
+    OP_REQUIRES(context, ChannelBlocks(channels, block_size) == blocks,
+                errors::InvalidArgument("Input with ", blocks, " blocks of ",
+                                        block_size, " channels can't hold ",
+                                        channels, " channels."));
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, {batch, rows, cols, channels}, &output));
+    const float* in = input.flat<float>().data();
+    float* out = output->flat<float>().data();
+
+    // One unit of work per output row.
+    ParallelFor(
+        context, batch * rows, cols * channels, [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            const int64 row = i % rows;
+            const int64 n = i / rows;
+            float* dst = out + i * cols * channels;
+            for (int64 block = 0; block < blocks; ++block) {
+              const float* src =
+                  in + ((n * blocks + block) * rows + row) * cols * block_size;
+              const int64 c_start = block * block_size;
+              const int64 c_size = std::min(block_size, channels - c_start);
+              for (int64 col = 0; col < cols; ++col) {
+                const float* x = src + col * block_size;
+                std::copy(x, x + c_size, dst + col * channels + c_start);
+              }
+            }
+          }
+        });
+  }
+
+ private:
+  int64 num_channels_;
+};
+
+class ToBlockedFilterOp : public OpKernel {
+ public:
+  explicit ToBlockedFilterOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("block_size", &block_size_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& filter = context->input(0);
+    OP_REQUIRES(context, filter.dims() == 4,
+                errors::InvalidArgument("Filter must be 4-dimensional: ",
+                                        filter.shape().DebugString()));
+    const int64 rows = filter.dim_size(0);
+    const int64 cols = filter.dim_size(1);
+    const int64 in_channels = filter.dim_size(2);
+    const int64 out_channels = filter.dim_size(3);
+    const int64 in_blocks = ChannelBlocks(in_channels, block_size_);
+    const int64 out_blocks = ChannelBlocks(out_channels, block_size_);
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0,
+                       {out_blocks, in_blocks, rows, cols, block_size_,
+                        block_size_},
+                       &output));
+    const float* in = filter.flat<float>().data();
+    float* out = output->flat<float>().data();
+    const int64 block_size = block_size_;
+    const int64 block_elements = rows * cols * block_size * block_size;
+
+    // One unit of work per pair of input and output channel blocks.
+    ParallelFor(
+        context, out_blocks * in_blocks, block_elements,
+        [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            const int64 ci_start = (i % in_blocks) * block_size;
+            const int64 co_start = (i / in_blocks) * block_size;
+            const int64 ci_size = std::min(block_size, in_channels - ci_start);
+            const int64 co_size =
+                std::min(block_size, out_channels - co_start);
+            float* dst = out + i * block_elements;
+            // Padding channels are zero.
+            std::fill(dst, dst + block_elements, 0.0f);
+            for (int64 p = 0; p < rows * cols; ++p) {
+              for (int64 ci = 0; ci < ci_size; ++ci) {
+                const float* w =
+                    in + (p * in_channels + ci_start + ci) * out_channels +
+                    co_start;
+                std::copy(w, w + co_size,
+                          dst + (p * block_size + ci) * block_size);
+              }
+            }
+          }
+        });
+  }
+
+ private:
+  int64 block_size_;
+};
+
+class BlockedConv2DOp : public OpKernel {
+ public:
+  explicit BlockedConv2DOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    const Tensor& filter = context->input(1);
+    int64 batch, in_blocks, in_rows, in_cols, block_size;
+    OP_REQUIRES_OK(context, GetBlockedDims(input, &batch, &in_blocks, &in_rows,
+                                           &in_cols, &block_size));
+    OP_REQUIRES(context, filter.dims() == 6,
+                errors::InvalidArgument("Filter must be 6-dimensional: ",
+                                        filter.shape().DebugString()));
+    OP_REQUIRES(context,
+                filter.dim_size(1) == in_blocks &&
+                    filter.dim_size(4) == block_size &&
+                    filter.dim_size(5) == block_size,
+                errors::InvalidArgument(
+                    "Filter of shape ", filter.shape().DebugString(),
+                    " doesn't match an input with ", in_blocks, " blocks of ",
+                    block_size, " channels."));
+    BlockedWindow window;
+    OP_REQUIRES_OK(context,
+                   ComputeBlockedWindow(in_rows, in_cols, filter.dim_size(2),
+                                        filter.dim_size(3), strides_, padding_,
+                                        &window));
+
+    const int64 out_blocks = filter.dim_size(0);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0,
+                                {batch, out_blocks, window.out_rows,
+                                 window.out_cols, block_size},
+                                &output));
+    if (output->NumElements() == 0) return;
+
+    // Pads the input columns with zeros, so that the windows never read past
+    // the left or right edge.
+    const int64 padded_cols =
+        std::max(in_cols + window.pad_left,
+                 (window.out_cols - 1) * window.col_stride + window.cols);
+    const Tensor* padded = &input;
+    Tensor padded_input;
+    if (padded_cols > in_cols) {
+      OP_REQUIRES_OK(context, context->allocate_temp(
+                                  DT_FLOAT,
+                                  {batch, in_blocks, in_rows, padded_cols,
+                                   block_size},
+                                  &padded_input));
+      PadColumns(context, input, window.pad_left, &padded_input);
+      padded = &padded_input;
+    }
+    window.pad_left = 0;
+
+    if (block_size == 8) {
+      Compute<8>(context, *padded, filter, window, output);
+    } else {
+      Compute<16>(context, *padded, filter, window, output);
+    }
+  }
+
+ private:
+  static void PadColumns(OpKernelContext* context, const Tensor& input,
+                         int64 pad_left, Tensor* padded) {
+    const int64 in_row_size = input.dim_size(3) * input.dim_size(4);
+    const int64 padded_row_size = padded->dim_size(3) * padded->dim_size(4);
+    const int64 left_size = pad_left * input.dim_size(4);
+    const float* in = input.flat<float>().data();
+    float* out = padded->flat<float>().data();
+    ParallelFor(context, padded->NumElements() / padded_row_size,
+                padded_row_size, [&](int64 start, int64 limit) {
+                  for (int64 i = start; i < limit; ++i) {
+                    const float* src = in + i * in_row_size;
+                    float* dst = out + i * padded_row_size;
+                    std::fill(dst, dst + left_size, 0.0f);
+                    std::copy(src, src + in_row_size, dst + left_size);
+                    std::fill(dst + left_size + in_row_size,
+                              dst + padded_row_size, 0.0f);
+                  }
+                });
+  }
+
+  template <int B>
+  void Compute(OpKernelContext* context, const Tensor& input,
+               const Tensor& filter, const BlockedWindow& window,
+               Tensor* output) {
+    const int64 in_blocks = input.dim_size(1);
+    const int64 in_rows = input.dim_size(2);
+    const int64 in_cols = input.dim_size(3);
+    const int64 out_blocks = output->dim_size(1);
+    const float* in = input.flat<float>().data();
+    const float* filter_data = filter.flat<float>().data();
+    float* out = output->flat<float>().data();
+    const int64 filter_block_size =
+        in_blocks * window.rows * window.cols * B * B;
+
+    // One unit of work per output row of a block of output channels.
+    const int64 cost_per_row =
+        window.out_cols * in_blocks * window.rows * window.cols * B * B * 2;
+    ParallelFor(context, output->dim_size(0) * out_blocks * window.out_rows,
+                cost_per_row, [&](int64 start, int64 limit) {
+                  for (int64 i = start; i < limit; ++i) {
+                    const int64 out_row = i % window.out_rows;
+                    const int64 out_block = (i / window.out_rows) % out_blocks;
+                    const int64 n = i / (window.out_rows * out_blocks);
+                    BlockedConvRow<B>(
+                        in + n * in_blocks * in_rows * in_cols * B,
+                        filter_data + out_block * filter_block_size, in_blocks,
+                        in_rows, in_cols, window, out_row,
+                        out + i * window.out_cols * B);
+                  }
+                });
+  }
+
+  std::vector<int32> strides_;
+  Padding padding_;
+};
+
+class BlockedBiasAddOp : public OpKernel {
+ public:
+  explicit BlockedBiasAddOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    const Tensor& bias = context->input(1);
+    int64 batch, blocks, rows, cols, block_size;
+    OP_REQUIRES_OK(context, GetBlockedDims(input, &batch, &blocks, &rows,
+                                           &cols, &block_size));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(bias.shape()),
+                errors::InvalidArgument("Biases must be 1D: ",
+                                        bias.shape().DebugString()));
+    const int64 channels = bias.dim_size(0);
+    OP_REQUIRES(context, ChannelBlocks(channels, block_size) == blocks,
+                errors::InvalidArgument(
+                    "Bias with ", channels, " channels doesn't match ", blocks,
+                    " blocks of ", block_size, " channels."));
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                {0}, 0, input.shape(), &output));
+    // Padded with zeros, so that padding channels stay zero.
+    std::vector<float> padded_bias(blocks * block_size, 0.0f);
+    std::copy_n(bias.flat<float>().data(), channels, padded_bias.begin());
+
+    const float* in = input.flat<float>().data();
+    float* out = output->flat<float>().data();
+    const int64 plane_size = rows * cols;
+    ParallelFor(context, batch * blocks, plane_size * block_size,
+                [&](int64 start, int64 limit) {
+                  for (int64 i = start; i < limit; ++i) {
+                    const float* b = padded_bias.data() +
+                                     (i % blocks) * block_size;
+                    const float* x = in + i * plane_size * block_size;
+                    float* y = out + i * plane_size * block_size;
+                    for (int64 p = 0; p < plane_size; ++p) {
+                      for (int64 c = 0; c < block_size; ++c) {
+                        y[c] = x[c] + b[c];
+                      }
+                      x += block_size;
+                      y += block_size;
+                    }
+                  }
+                });
+  }
+};
+
+template <bool kMax>
+class BlockedPoolOp : public OpKernel {
+ public:
+  explicit BlockedPoolOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("ksize", &ksize_));
+    OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+    OP_REQUIRES(context,
+                ksize_.size() == 4 && ksize_[0] == 1 && ksize_[3] == 1,
+                errors::Unimplemented(
+                    "Blocked pooling only supports windows in the height and "
+                    "width dimensions."));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& input = context->input(0);
+    int64 batch, blocks, in_rows, in_cols, block_size;
+    OP_REQUIRES_OK(context, GetBlockedDims(input, &batch, &blocks, &in_rows,
+                                           &in_cols, &block_size));
+    BlockedWindow window;
+    OP_REQUIRES_OK(context, ComputeBlockedWindow(in_rows, in_cols, ksize_[1],
+                                                 ksize_[2], strides_, padding_,
+                                                 &window));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0,
+                                {batch, blocks, window.out_rows,
+                                 window.out_cols, block_size},
+                                &output));
+    if (block_size == 8) {
+      Compute<8>(context, input, window, output);
+    } else {
+      Compute<16>(context, input, window, output);
+    }
+  }
+
+ private:
+  template <int B>
+  void Compute(OpKernelContext* context, const Tensor& input,
+               const BlockedWindow& window, Tensor* output) {
+    const int64 in_rows = input.dim_size(2);
+    const int64 in_cols = input.dim_size(3);
+    const float* in = input.flat<float>().data();
+    float* out = output->flat<float>().data();
+
+    // One unit of work per output row of a block of channels.
+    const int64 planes = input.dim_size(0) * input.dim_size(1);
+    ParallelFor(context, planes * window.out_rows,
+                window.out_cols * window.rows * window.cols * B,
+                [&](int64 start, int64 limit) {
+                  for (int64 i = start; i < limit; ++i) {
+                    const int64 plane = i / window.out_rows;
+                    BlockedPoolRow<B, kMax>(
+                        in + plane * in_rows * in_cols * B, in_rows, in_cols,
+                        window, i % window.out_rows,
+                        out + i * window.out_cols * B);
+                  }
+                });
+  }
+
+  std::vector<int32> ksize_;
+  std::vector<int32> strides_;
+  Padding padding_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("_ToBlockedLayout").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ToBlockedLayoutOp);
+REGISTER_KERNEL_BUILDER(
+    Name("_FromBlockedLayout").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    FromBlockedLayoutOp);
+REGISTER_KERNEL_BUILDER(
+    Name("_ToBlockedFilter").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ToBlockedFilterOp);
+REGISTER_KERNEL_BUILDER(
+    Name("_BlockedConv2D").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    BlockedConv2DOp);
+REGISTER_KERNEL_BUILDER(
+    Name("_BlockedBiasAdd").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    BlockedBiasAddOp);
+REGISTER_KERNEL_BUILDER(
+    Name("_BlockedMaxPool").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    BlockedPoolOp</*kMax=*/true>);
+REGISTER_KERNEL_BUILDER(
+    Name("_BlockedAvgPool").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    BlockedPoolOp</*kMax=*/false>);
+
+}  // namespace tensorflow
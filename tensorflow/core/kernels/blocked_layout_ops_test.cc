@@ -0,0 +1,354 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// A float NHWC tensor with deterministic, non trivial values.
+Tensor MakeNhwc(int64 n, int64 h, int64 w, int64 c) {
+  Tensor t(DT_FLOAT, {n, h, w, c});
+  auto flat = t.flat<float>();
+  for (int64 i = 0; i < flat.size(); ++i) {
+    flat(i) = static_cast<float>((i * 7) % 13) / 13.0f - 0.5f;
+  }
+  return t;
+}
+
+// Reference conversion from NHWC to the blocked layout.
+Tensor Block(const Tensor& nhwc, int64 block_size) {
+  const int64 n = nhwc.dim_size(0), h = nhwc.dim_size(1),
+              w = nhwc.dim_size(2), c = nhwc.dim_size(3);
+  const int64 blocks = (c + block_size - 1) / block_size;
+  Tensor blocked(DT_FLOAT, {n, blocks, h, w, block_size});
+  auto in = nhwc.tensor<float, 4>();
+  auto out = blocked.tensor<float, 5>();
+  out.setZero();
+  for (int64 b = 0; b < n; ++b)
+    for (int64 y = 0; y < h; ++y)
+      for (int64 x = 0; x < w; ++x)
+        for (int64 ch = 0; ch < c; ++ch)
+          out(b, ch / block_size, y, x, ch % block_size) = in(b, y, x, ch);
+  return blocked;
+}
+
+// Reference conversion from the blocked layout to NHWC.
+Tensor Unblock(const Tensor& blocked, int64 channels) {
+  const int64 n = blocked.dim_size(0), h = blocked.dim_size(2),
+              w = blocked.dim_size(3), block_size = blocked.dim_size(4);
+  Tensor nhwc(DT_FLOAT, {n, h, w, channels});
+  auto in = blocked.tensor<float, 5>();
+  auto out = nhwc.tensor<float, 4>();
+  for (int64 b = 0; b < n; ++b)
+    for (int64 y = 0; y < h; ++y)
+      for (int64 x = 0; x < w; ++x)
+        for (int64 ch = 0; ch < channels; ++ch)
+          out(b, y, x, ch) = in(b, ch / block_size, y, x, ch % block_size);
+  return nhwc;
+}
+
+// Reference conversion from an HWIO filter to the blocked filter layout
+// [out_blocks, in_blocks, height, width, in_block, out_block].
+Tensor BlockFilter(const Tensor& hwio, int64 block_size) {
+  const int64 h = hwio.dim_size(0), w = hwio.dim_size(1),
+              ci = hwio.dim_size(2), co = hwio.dim_size(3);
+  const int64 in_blocks = (ci + block_size - 1) / block_size;
+  const int64 out_blocks = (co + block_size - 1) / block_size;
+  Tensor blocked(DT_FLOAT,
+                 {out_blocks, in_blocks, h, w, block_size, block_size});
+  auto in = hwio.tensor<float, 4>();
+  auto out = blocked.tensor<float, 6>();
+  out.setZero();
+  for (int64 y = 0; y < h; ++y)
+    for (int64 x = 0; x < w; ++x)
+      for (int64 i = 0; i < ci; ++i)
+        for (int64 o = 0; o < co; ++o)
+          out(o / block_size, i / block_size, y, x, i % block_size,
+              o % block_size) = in(y, x, i, o);
+  return blocked;
+}
+
+int64 PadBefore(int64 in, int64 window, int64 stride, bool same,
+                int64* out) {
+  if (!same) {
+    *out = (in - window + stride) / stride;
+    return 0;
+  }
+  *out = (in + stride - 1) / stride;
+  return std::max<int64>((*out - 1) * stride + window - in, 0) / 2;
+}
+
+// Reference NHWC convolution with an HWIO filter.
+Tensor ReferenceConv(const Tensor& input, const Tensor& filter, int stride,
+                     bool same) {
+  const int64 n = input.dim_size(0), h = input.dim_size(1),
+              w = input.dim_size(2), ci = input.dim_size(3);
+  const int64 kh = filter.dim_size(0), kw = filter.dim_size(1),
+              co = filter.dim_size(3);
+  int64 oh, ow;
+  const int64 pad_top = PadBefore(h, kh, stride, same, &oh);
+  const int64 pad_left = PadBefore(w, kw, stride, same, &ow);
+  Tensor output(DT_FLOAT, {n, oh, ow, co});
+  auto in = input.tensor<float, 4>();
+  auto f = filter.tensor<float, 4>();
+  auto out = output.tensor<float, 4>();
+  out.setZero();
+  for (int64 b = 0; b < n; ++b)
+    for (int64 y = 0; y < oh; ++y)
+      for (int64 x = 0; x < ow; ++x)
+        for (int64 r = 0; r < kh; ++r)
+          for (int64 c = 0; c < kw; ++c) {
+            const int64 iy = y * stride - pad_top + r;
+            const int64 ix = x * stride - pad_left + c;
+            if (iy < 0 || iy >= h || ix < 0 || ix >= w) continue;
+            for (int64 i = 0; i < ci; ++i)
+              for (int64 o = 0; o < co; ++o)
+                out(b, y, x, o) += in(b, iy, ix, i) * f(r, c, i, o);
+          }
+  return output;
+}
+
+// Reference NHWC max or average pooling.
+Tensor ReferencePool(const Tensor& input, int window, int stride, bool same,
+                     bool max) {
+  const int64 n = input.dim_size(0), h = input.dim_size(1),
+              w = input.dim_size(2), ch = input.dim_size(3);
+  int64 oh, ow;
+  const int64 pad_top = PadBefore(h, window, stride, same, &oh);
+  const int64 pad_left = PadBefore(w, window, stride, same, &ow);
+  Tensor output(DT_FLOAT, {n, oh, ow, ch});
+  auto in = input.tensor<float, 4>();
+  auto out = output.tensor<float, 4>();
+  for (int64 b = 0; b < n; ++b)
+    for (int64 y = 0; y < oh; ++y)
+      for (int64 x = 0; x < ow; ++x)
+        for (int64 c = 0; c < ch; ++c) {
+          float acc = max ? std::numeric_limits<float>::lowest() : 0.0f;
+          int count = 0;
+          for (int64 r = 0; r < window; ++r)
+            for (int64 s = 0; s < window; ++s) {
+              const int64 iy = y * stride - pad_top + r;
+              const int64 ix = x * stride - pad_left + s;
+              if (iy < 0 || iy >= h || ix < 0 || ix >= w) continue;
+              acc = max ? std::max(acc, in(b, iy, ix, c))
+                        : acc + in(b, iy, ix, c);
+              ++count;
+            }
+          out(b, y, x, c) = max ? acc : acc / count;
+        }
+  return output;
+}
+
+class BlockedLayoutOpsTest : public OpsTestBase {
+ protected:
+  void AddInput(const Tensor& t) {
+    AddInputFromArray<float>(
+        t.shape(), gtl::ArraySlice<float>(t.flat<float>().data(),
+                                          t.NumElements()));
+  }
+
+  void RunConv(int64 channels, int64 filters, int kernel, int stride,
+               bool same, int64 block_size, int64 width = 7) {
+    const Tensor input = MakeNhwc(2, 9, width, channels);
+    const Tensor filter = MakeNhwc(kernel, kernel, channels, filters);
+    TF_ASSERT_OK(NodeDefBuilder("conv", "_BlockedConv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", same ? "SAME" : "VALID")
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    AddInput(Block(input, block_size));
+    AddInput(BlockFilter(filter, block_size));
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectClose(ReferenceConv(input, filter, stride, same),
+                      Unblock(*GetOutput(0), filters), 1e-4);
+  }
+
+  void RunPool(const string& op, int window, int stride, bool same,
+               int64 block_size) {
+    const Tensor input = MakeNhwc(2, 8, 7, 19);
+    TF_ASSERT_OK(NodeDefBuilder("pool", op)
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("ksize", {1, window, window, 1})
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", same ? "SAME" : "VALID")
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    AddInput(Block(input, block_size));
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectClose(
+        ReferencePool(input, window, stride, same, op == "_BlockedMaxPool"),
+        Unblock(*GetOutput(0), 19));
+  }
+};
+
+TEST_F(BlockedLayoutOpsTest, ToBlockedLayout) {
+  const Tensor input = MakeNhwc(2, 3, 5, 11);
+  TF_ASSERT_OK(NodeDefBuilder("to_blocked", "_ToBlockedLayout")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("block_size", 8)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput(input);
+  TF_ASSERT_OK(RunOpKernel());
+  // The padding channels are zero filled.
+  test::ExpectTensorEqual<float>(Block(input, 8), *GetOutput(0));
+}
+
+TEST_F(BlockedLayoutOpsTest, FromBlockedLayout) {
+  const Tensor input = MakeNhwc(2, 3, 5, 21);
+  TF_ASSERT_OK(NodeDefBuilder("from_blocked", "_FromBlockedLayout")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("num_channels", 21)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput(Block(input, 16));
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<float>(input, *GetOutput(0));
+}
+
+TEST_F(BlockedLayoutOpsTest, FromBlockedLayoutChannelMismatch) {
+  TF_ASSERT_OK(NodeDefBuilder("from_blocked", "_FromBlockedLayout")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("num_channels", 21)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput(Block(MakeNhwc(1, 2, 2, 21), 8));
+  EXPECT_TRUE(errors::IsInvalidArgument(RunOpKernel()));
+}
+
+TEST_F(BlockedLayoutOpsTest, ToBlockedFilter) {
+  const Tensor filter = MakeNhwc(3, 2, 11, 19);
+  TF_ASSERT_OK(NodeDefBuilder("to_blocked_filter", "_ToBlockedFilter")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("block_size", 8)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput(filter);
+  TF_ASSERT_OK(RunOpKernel());
+  // The padding channels are zero filled.
+  test::ExpectTensorEqual<float>(BlockFilter(filter, 8), *GetOutput(0));
+}
+
+TEST_F(BlockedLayoutOpsTest, Conv2DFilterBlockMismatch) {
+  TF_ASSERT_OK(NodeDefBuilder("conv", "_BlockedConv2D")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("strides", {1, 1, 1, 1})
+                   .Attr("padding", "SAME")
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput(Block(MakeNhwc(1, 4, 4, 8), 8));
+  // A filter blocked by 16 for an input blocked by 8.
+  AddInput(BlockFilter(MakeNhwc(3, 3, 8, 8), 16));
+  EXPECT_TRUE(errors::IsInvalidArgument(RunOpKernel()));
+}
+
+TEST_F(BlockedLayoutOpsTest, Conv1x1Block8) {
+  RunConv(/*channels=*/13, /*filters=*/17, /*kernel=*/1, /*stride=*/1,
+          /*same=*/false, /*block_size=*/8);
+}
+
+TEST_F(BlockedLayoutOpsTest, Conv3x3SameBlock8) {
+  RunConv(/*channels=*/8, /*filters=*/16, /*kernel=*/3, /*stride=*/1,
+          /*same=*/true, /*block_size=*/8);
+}
+
+TEST_F(BlockedLayoutOpsTest, Conv3x3StridedValidBlock16) {
+  RunConv(/*channels=*/5, /*filters=*/20, /*kernel=*/3, /*stride=*/2,
+          /*same=*/false, /*block_size=*/16);
+}
+
+TEST_F(BlockedLayoutOpsTest, Conv5x5StridedSameBlock16) {
+  RunConv(/*channels=*/19, /*filters=*/3, /*kernel=*/5, /*stride=*/2,
+          /*same=*/true, /*block_size=*/16);
+}
+
+// Wide enough for full column tiles followed by a partial one.
+TEST_F(BlockedLayoutOpsTest, Conv3x3SameWideBlock8) {
+  RunConv(/*channels=*/11, /*filters=*/9, /*kernel=*/3, /*stride=*/1,
+          /*same=*/true, /*block_size=*/8, /*width=*/31);
+}
+
+TEST_F(BlockedLayoutOpsTest, Conv3x3StridedSameWideBlock16) {
+  RunConv(/*channels=*/21, /*filters=*/18, /*kernel=*/3, /*stride=*/2,
+          /*same=*/true, /*block_size=*/16, /*width=*/35);
+}
+
+TEST_F(BlockedLayoutOpsTest, BiasAdd) {
+  const Tensor input = MakeNhwc(2, 3, 4, 11);
+  Tensor bias(DT_FLOAT, {11});
+  for (int i = 0; i < 11; ++i) bias.flat<float>()(i) = i;
+  TF_ASSERT_OK(NodeDefBuilder("bias_add", "_BlockedBiasAdd")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput(Block(input, 8));
+  AddInput(bias);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(DT_FLOAT, input.shape());
+  expected.tensor<float, 4>() =
+      input.tensor<float, 4>() +
+      bias.tensor<float, 1>()
+          .reshape(Eigen::array<int64, 4>{1, 1, 1, 11})
+          .broadcast(Eigen::array<int64, 4>{2, 3, 4, 1});
+  // The padding channels stay zero.
+  test::ExpectTensorEqual<float>(Block(expected, 8), *GetOutput(0));
+}
+
+TEST_F(BlockedLayoutOpsTest, MaxPoolSame) {
+  RunPool("_BlockedMaxPool", /*window=*/3, /*stride=*/2, /*same=*/true,
+          /*block_size=*/8);
+}
+
+TEST_F(BlockedLayoutOpsTest, MaxPoolValid) {
+  RunPool("_BlockedMaxPool", /*window=*/2, /*stride=*/2, /*same=*/false,
+          /*block_size=*/16);
+}
+
+TEST_F(BlockedLayoutOpsTest, AvgPoolSame) {
+  RunPool("_BlockedAvgPool", /*window=*/3, /*stride=*/1, /*same=*/true,
+          /*block_size=*/16);
+}
+
+TEST_F(BlockedLayoutOpsTest, AvgPoolValid) {
+  RunPool("_BlockedAvgPool", /*window=*/3, /*stride=*/2, /*same=*/false,
+          /*block_size=*/8);
+}
+
+}  // namespace
+}  // namespace tensorflow
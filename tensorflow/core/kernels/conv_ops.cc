@@ -176,6 +176,41 @@ struct LaunchConv2DOp<CPUDevice, T> {
   }
 };
 
+// Eigen would accumulate the products of a bfloat16 convolution in bfloat16,
+// so the convolution runs in float between vectorized conversions, which use
+// the AVX512-BF16 conversion instructions when the build enables them. This
+// keeps the activations in bfloat16 between the ops of a mixed precision graph.
+template <>
+struct LaunchConv2DOp<CPUDevice, bfloat16> {
+  void operator()(OpKernelContext* ctx, bool use_cudnn, bool cudnn_use_autotune,
+                  const Tensor& input, const Tensor& filter, int row_dilation,
+                  int col_dilation, int row_stride, int col_stride,
+                  const Padding& padding,
+                  const std::vector<int64>& explicit_paddings, Tensor* output,
+                  TensorFormat data_format) {
+    const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+    Tensor input_float, filter_float, output_float;
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_temp(DT_FLOAT, input.shape(), &input_float));
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_temp(DT_FLOAT, filter.shape(), &filter_float));
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_FLOAT, output->shape(), &output_float));
+    input_float.flat<float>().device(d) =
+        input.flat<bfloat16>().template cast<float>();
+    filter_float.flat<float>().device(d) =
+        filter.flat<bfloat16>().template cast<float>();
+
+    LaunchConv2DOp<CPUDevice, float>()(
+        ctx, use_cudnn, cudnn_use_autotune, input_float, filter_float,
+        row_dilation, col_dilation, row_stride, col_stride, padding,
+        explicit_paddings, &output_float, data_format);
+    if (!ctx->status().ok()) return;
+    output->flat<bfloat16>().device(d) =
+        output_float.flat<float>().template cast<bfloat16>();
+  }
+};
+
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 template <>
 struct LaunchConv2DOp<GPUDevice, int32> {
@@ -605,6 +640,7 @@ class Conv2DOp : public BinaryOp<T> {
 // CPU implementation, don't register this EigenTensor-based version.
 #if !defined(USE_GEMM_FOR_CONV)
 TF_CALL_half(REGISTER_CPU);
+TF_CALL_bfloat16(REGISTER_CPU);
 TF_CALL_float(REGISTER_CPU);
 TF_CALL_double(REGISTER_CPU);
 TF_CALL_int32(REGISTER_CPU);
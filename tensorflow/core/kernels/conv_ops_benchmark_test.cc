@@ -296,6 +296,36 @@ static Graph* FusedConv2DWithBatchNorm(
   return graph;
 }
 
+// Creates a tensorflow graph with a single _BlockedConv2D node, with the input
+// already converted to the blocked layout with `block_size` channels per block.
+static Graph* BlockedConv2D(int batch, int height, int width, int in_depth,
+                            int filter_w, int filter_h, int out_depth,
+                            int block_size) {
+  Graph* graph = new Graph(OpRegistry::Global());
+
+  const int in_blocks = (in_depth + block_size - 1) / block_size;
+  const int out_blocks = (out_depth + block_size - 1) / block_size;
+  Tensor images_t = MakeRandomTensor<float>(
+      {batch, in_blocks, height, width, block_size});
+  // Filter is already blocked, as it is after constant folding.
+  Tensor filter_t = MakeRandomTensor<float>(
+      {out_blocks, in_blocks, filter_h, filter_w, block_size, block_size});
+
+  Node* images = test::graph::Constant(graph, images_t, "images");
+  Node* filter = test::graph::Constant(graph, filter_t, "filter");
+
+  Node* conv;
+  TF_CHECK_OK(NodeBuilder(graph->NewName("conv"), "_BlockedConv2D")
+                  .Input(images)
+                  .Input(filter)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("strides", {1, 1, 1, 1})
+                  .Attr("padding", "SAME")
+                  .Finalize(graph, &conv));
+
+  return graph;
+}
+
 // Macro arguments names: --------------------------------------------------- //
 //    N: batch size
 //    H: height
@@ -531,6 +561,66 @@ BM_FusedConv2DWithBatchNormAndRelu(16, 32, 32, 128, 3, 3, 1024, cpu,
 BM_FusedConv2DWithBatchNormAndRelu(32, 32, 32, 128, 3, 3, 1024, cpu,
                                    "3x3 /b 32");
 
+// -------------------------------------------------------------------------- //
+// Blocked layout convolutions (NCHW[x]c), compared with the NHWC Conv2D above
+// and with ResNet50-ish shapes. The input is already in the blocked layout, as
+// it is inside a region rewritten by the layout optimizer.
+// -------------------------------------------------------------------------- //
+
+#define BM_BLOCKED_NAME(type, N, H, W, C, FW, FH, FC, B) \
+  BM_BlockedConv2D_##type##_##N##_##H##_##W##_##C##_##FW##_##FH##_##FC##_##B
+
+#define BM_BlockedConv2D(N, H, W, C, FW, FH, FC, B, type, LABEL)               \
+  static void BM_BLOCKED_NAME(type, N, H, W, C, FW, FH, FC,                    \
+                              B)(::testing::benchmark::State & state) {        \
+    test::Benchmark(#type, BlockedConv2D(N, H, W, C, FW, FH, FC, B),           \
+                    /*old_benchmark_api=*/false)                               \
+        .Run(state);                                                           \
+    BM_SET_INFO(N, H, W, C, type, LABEL, BlockedConv2D);                       \
+  }                                                                            \
+  BENCHMARK(BM_BLOCKED_NAME(type, N, H, W, C, FW, FH, FC, B))                  \
+      ->Arg(/*unused arg*/ 1);
+
+BM_BlockedConv2D(8, 32, 32, 128, 1, 1, 1024, 8, cpu, "1x1 /b 8 /c 8");
+BM_BlockedConv2D(8, 32, 32, 128, 1, 1, 1024, 16, cpu, "1x1 /b 8 /c 16");
+BM_BlockedConv2D(8, 32, 32, 128, 3, 3, 1024, 8, cpu, "3x3 /b 8 /c 8");
+BM_BlockedConv2D(8, 32, 32, 128, 3, 3, 1024, 16, cpu, "3x3 /b 8 /c 16");
+
+BM_Conv2D(8, 56, 56, 64, 1, 1, 256, cpu, "resnet 1x1 /b 8");
+BM_Conv2D(8, 56, 56, 64, 3, 3, 64, cpu, "resnet 3x3 /b 8");
+BM_Conv2D(8, 28, 28, 128, 3, 3, 128, cpu, "resnet 3x3 /b 8");
+BM_Conv2D(8, 14, 14, 256, 1, 1, 1024, cpu, "resnet 1x1 /b 8");
+BM_Conv2D(8, 14, 14, 256, 3, 3, 256, cpu, "resnet 3x3 /b 8");
+BM_Conv2D(8, 7, 7, 512, 3, 3, 512, cpu, "resnet 3x3 /b 8");
+
+BM_BlockedConv2D(8, 56, 56, 64, 1, 1, 256, 16, cpu, "resnet 1x1 /b 8");
+BM_BlockedConv2D(8, 56, 56, 64, 3, 3, 64, 16, cpu, "resnet 3x3 /b 8");
+BM_BlockedConv2D(8, 28, 28, 128, 3, 3, 128, 16, cpu, "resnet 3x3 /b 8");
+BM_BlockedConv2D(8, 14, 14, 256, 1, 1, 1024, 16, cpu, "resnet 1x1 /b 8");
+BM_BlockedConv2D(8, 14, 14, 256, 3, 3, 256, 16, cpu, "resnet 3x3 /b 8");
+BM_BlockedConv2D(8, 7, 7, 512, 3, 3, 512, 16, cpu, "resnet 3x3 /b 8");
+
+// -------------------------------------------------------------------------- //
+// The bfloat16 CPU Conv2D casts to float around the float kernel, compared with
+// the float Conv2D above (see AutoMixedPrecisionListsCpu).
+// -------------------------------------------------------------------------- //
+
+#define BM_Conv2DBf16(N, H, W, C, FW, FH, FC, type, LABEL)                 \
+  static void BM_NAME(BM_Conv2DBf16, type, N, H, W, C, FW, FH,             \
+                      FC)(::testing::benchmark::State & state) {           \
+    test::Benchmark(#type, Conv2D<bfloat16>(N, H, W, C, FW, FH, FC).graph, \
+                    /*old_benchmark_api=*/false)                           \
+        .Run(state);                                                       \
+    BM_SET_INFO(N, H, W, C, type, LABEL, Conv2D);                          \
+  }                                                                        \
+  BENCHMARK(BM_NAME(BM_Conv2DBf16, type, N, H, W, C, FW, FH, FC))          \
+      ->Arg(/*unused arg*/ 1);
+
+BM_Conv2DBf16(8, 56, 56, 64, 3, 3, 64, cpu, "resnet 3x3 /b 8");
+BM_Conv2DBf16(8, 28, 28, 128, 3, 3, 128, cpu, "resnet 3x3 /b 8");
+BM_Conv2DBf16(8, 14, 14, 256, 1, 1, 1024, cpu, "resnet 1x1 /b 8");
+BM_Conv2DBf16(8, 7, 7, 512, 3, 3, 512, cpu, "resnet 3x3 /b 8");
+
 #if GOOGLE_CUDA
 // -------------------------------------------------------------------------- //
 // 1x1 Convolution
@@ -530,6 +530,35 @@ TEST_F(ConvOpTest, HandwrittenConv) { HandwrittenConv(); }
 
 TEST_F(ConvOpTest, AnisotropicStride) { AnisotropicStrides(); }
 
+TEST_F(ConvOpTest, HandwrittenConvBfloat16) {
+  TF_EXPECT_OK(NodeDefBuilder("conv_op", "Conv2D")
+                   .Input(FakeInput(DT_BFLOAT16))
+                   .Input(FakeInput(DT_BFLOAT16))
+                   .Attr("T", DT_BFLOAT16)
+                   .Attr("strides", {1, 1, 1, 1})
+                   .Attr("padding", "SAME")
+                   .Finalize(node_def()));
+  TF_EXPECT_OK(InitOp());
+  // Same convolution as in HandwrittenConv.
+  Tensor image(DT_BFLOAT16, {1, 3, 4, 1});
+  test::FillValues<bfloat16>(&image, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12});
+  Tensor filter(DT_BFLOAT16, {3, 3, 1, 1});
+  test::FillValues<bfloat16>(&filter, {1, 4, 7, 2, 5, 8, 3, 6, 9});
+  AddInputFromArray<bfloat16>(image.shape(), image.flat<bfloat16>());
+  AddInputFromArray<bfloat16>(filter.shape(), filter.flat<bfloat16>());
+  TF_ASSERT_OK(RunOpKernel());
+
+  // The products are accumulated in float, so the outputs are only off by the
+  // final rounding to bfloat16: less than one for values below 512.
+  Tensor expected(DT_FLOAT, TensorShape({1, 3, 4, 1}));
+  test::FillValues<float>(
+      &expected, {105, 150, 183, 95, 235, 312, 357, 178, 187, 234, 261, 121});
+  const Tensor& output = *GetOutput(0);
+  Tensor output_float(DT_FLOAT, output.shape());
+  output_float.flat<float>() = output.flat<bfloat16>().cast<float>();
+  test::ExpectTensorNear<float>(expected, output_float, 1.0);
+}
+
 template <typename T>
 class FusedConv2DOpTest : public OpsTestBase {
  protected:
@@ -15,17 +15,24 @@ limitations under the License.
 
 // See docs in ../ops/data_flow_ops.cc.
 
+#include <algorithm>
+#include <functional>
 #include <vector>
+
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
-#include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+// Inputs are partitioned in parallel in blocks of at least this many partition
+// ids, each block copying its rows to a disjoint range of each output.
+constexpr int64 kMinPartitionBlockSize = 32 * 1024;
+
 // Shared code that is not dependent on the type of T.  We do this to reduce
 // code size by not duplicating all this for all T (float, double, int32, etc.)
 class DynamicPartitionOp_Shared : public OpKernel {
@@ -39,9 +46,14 @@ class DynamicPartitionOp_Shared : public OpKernel {
     //   in the graph?
   }
 
+  // Also returns in `block_offsets` the first row of each output written by
+  // each block of `num_blocks` consecutive partition ids, indexed by
+  // block * num_partitions + partition, so that the blocks can be copied in
+  // parallel while keeping the order of the rows of each partition.
   void ValidateAndAllocateOutputs(OpKernelContext* c, const Tensor** data,
                                   const Tensor** partitions,
-                                  OpOutputList* Tout) {
+                                  OpOutputList* Tout, int64* num_blocks,
+                                  std::vector<int64>* block_offsets) {
     OP_REQUIRES_OK(c, c->input("data", data));
     OP_REQUIRES_OK(c, c->input("partitions", partitions));
     OP_REQUIRES(
@@ -52,24 +64,46 @@ class DynamicPartitionOp_Shared : public OpKernel {
             "got data.shape = ", (*data)->shape().DebugString(),
             ", partitions.shape = ", (*partitions)->shape().DebugString()));
 
-    // Count how many occurrences of each partition id we have in partitions
-    gtl::InlinedVector<int, 32> partition_count(num_partitions_);
+    // Count how many occurrences of each partition id we have in each block
+    // of partitions.
     auto e_partitions = (*partitions)->flat<int32>();
     const int64 N = e_partitions.dimension(0);
-    for (int64 i = 0; i < N; i++) {
-      const int32 p = internal::SubtleMustCopy(e_partitions(i));
-      OP_REQUIRES(c, FastBoundsCheck(p, num_partitions_),
+    *num_blocks = NumBlocks(c, N);
+    block_offsets->assign(*num_blocks * num_partitions_, 0);
+    // First invalid partition id of each block, if any.
+    std::vector<int64> bad_index(*num_blocks, -1);
+    ForEachBlock(c, *num_blocks, N, [&](int64 block, int64 start, int64 end) {
+      int64* partition_count = block_offsets->data() + block * num_partitions_;
+      for (int64 i = start; i < end; i++) {
+        const int32 p = internal::SubtleMustCopy(e_partitions(i));
+        if (!FastBoundsCheck(p, num_partitions_)) {
+          bad_index[block] = i;
+          return;
+        }
+        partition_count[p]++;
+      }
+    });
+    for (int64 i : bad_index) {
+      OP_REQUIRES(c, i < 0,
                   errors::InvalidArgument(
                       "partitions", SliceDebugString((*partitions)->shape(), i),
-                      " = ", p, " is not in [0, ", num_partitions_, ")"));
-      partition_count[p]++;
+                      " = ", e_partitions(i), " is not in [0, ",
+                      num_partitions_, ")"));
     }
 
-    // Allocate output tensors of the right size
+    // Turn the counts into offsets, and allocate output tensors of the right
+    // size.
     OP_REQUIRES_OK(c, c->output_list("outputs", Tout));
     for (int p = 0; p < num_partitions_; p++) {
+      int64 partition_count = 0;
+      for (int64 block = 0; block < *num_blocks; block++) {
+        int64& offset = (*block_offsets)[block * num_partitions_ + p];
+        const int64 count = offset;
+        offset = partition_count;
+        partition_count += count;
+      }
       TensorShape shape;
-      shape.AddDim(partition_count[p]);
+      shape.AddDim(partition_count);
       for (int i = (*partitions)->dims(); i < (*data)->dims(); i++) {
         shape.AddDim((*data)->dim_size(i));
       }
@@ -79,6 +113,35 @@ class DynamicPartitionOp_Shared : public OpKernel {
   }
 
  protected:
+  // Returns the number of blocks the N partition ids are split into: one per
+  // worker thread for large inputs, and a single one otherwise.
+  static int64 NumBlocks(OpKernelContext* c, int64 N) {
+    const int64 num_threads =
+        c->device()->tensorflow_cpu_worker_threads()->num_threads;
+    return std::max<int64>(
+        1, std::min<int64>(num_threads, N / kMinPartitionBlockSize));
+  }
+
+  // Calls `fn(block, start, end)` for each of the `num_blocks` consecutive
+  // blocks [start, end) of [0, N), in parallel when there are several.
+  static void ForEachBlock(
+      OpKernelContext* c, int64 num_blocks, int64 N,
+      const std::function<void(int64, int64, int64)>& fn) {
+    if (num_blocks == 1) {
+      fn(0, 0, N);
+      return;
+    }
+    const auto* worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    // Large enough for every block to get its own shard.
+    const int64 cost_per_block = 10 * N / num_blocks;
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          cost_per_block, [&fn, num_blocks, N](int64 first, int64 last) {
+            for (int64 block = first; block < last; block++) {
+              fn(block, N * block / num_blocks, N * (block + 1) / num_blocks);
+            }
+          });
+  }
+
   int num_partitions_;
 };
 
@@ -91,13 +154,16 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
     const Tensor* data;
     const Tensor* partitions;
     OpOutputList outputs;
-    ValidateAndAllocateOutputs(c, &data, &partitions, &outputs);
+    int64 num_blocks;
+    std::vector<int64> block_offsets;
+    ValidateAndAllocateOutputs(c, &data, &partitions, &outputs, &num_blocks,
+                               &block_offsets);
     if (!c->status().ok()) return;
     if (num_partitions_ == 0 || data->NumElements() == 0) return;
 
     auto e_partitions = partitions->flat<int32>();
     const int64 N = e_partitions.dimension(0);
-    gtl::InlinedVector<int, 32> output_index(num_partitions_);
+    std::vector<Status> block_status(num_blocks);
 
     if (partitions->dims() == data->dims()) {
       // Walk through data and copy the data to the appropriate output tensor
@@ -109,19 +175,26 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
       for (int p = 0; p < num_partitions_; p++) {
         out_vec.push_back(outputs[p]->vec<T>());
       }
-      for (int64 i = 0; i < N; i++) {
-        const int32 p = internal::SubtleMustCopy(e_partitions(i));
-        OP_REQUIRES(
-            c, FastBoundsCheck(p, num_partitions_),
-            errors::InvalidArgument("indices[", i, "] is out of range"));
-        auto oi = output_index[p];
-        OP_REQUIRES(c, FastBoundsCheck(oi, out_vec[p].size()),
-                    errors::InvalidArgument(
-                        "out_vec[", p, "] size: ", out_vec[p].size(),
-                        " is not LTE output_index[", p, "] : ", oi));
-        out_vec[p](oi) = data_flat(i);
-        output_index[p]++;
-      }
+      ForEachBlock(c, num_blocks, N, [&](int64 block, int64 start, int64 end) {
+        int64* output_index = block_offsets.data() + block * num_partitions_;
+        for (int64 i = start; i < end; i++) {
+          const int32 p = internal::SubtleMustCopy(e_partitions(i));
+          if (!FastBoundsCheck(p, num_partitions_)) {
+            block_status[block] =
+                errors::InvalidArgument("indices[", i, "] is out of range");
+            return;
+          }
+          auto oi = output_index[p];
+          if (!FastBoundsCheck(oi, out_vec[p].size())) {
+            block_status[block] = errors::InvalidArgument(
+                "out_vec[", p, "] size: ", out_vec[p].size(),
+                " is not LTE output_index[", p, "] : ", oi);
+            return;
+          }
+          out_vec[p](oi) = data_flat(i);
+          output_index[p]++;
+        }
+      });
     } else {
       // If data has extra dimensions, use Eigen slices
       std::vector<Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
@@ -136,24 +209,34 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
       const int64 slice_size = data->NumElements() / N;
       const auto data_flat = data->shaped<T, 2>({N, slice_size});
       Eigen::DSizes<Eigen::DenseIndex, 2> sizes(1, slice_size);
-      for (int64 i = 0; i < N; i++) {
-        // outputs[p][output_index[p]++] = data[i]
-        const int32 p = internal::SubtleMustCopy(e_partitions(i));
-        OP_REQUIRES(
-            c, FastBoundsCheck(p, num_partitions_),
-            errors::InvalidArgument("indices[", i,
-                                    "] has been asynchronously overwritten and "
-                                    "is no longer in range!"));
-        auto oi = output_index[p];
-        OP_REQUIRES(c, FastBoundsCheck(oi, out_flat[p].dimension(0)),
-                    errors::InvalidArgument("Size of output_index: ", oi,
-                                            " is no longer in range."));
-        Eigen::DSizes<Eigen::DenseIndex, 2> out_indices(oi, 0);
-        Eigen::DSizes<Eigen::DenseIndex, 2> data_indices(i, 0);
-        out_flat[p].slice(out_indices, sizes) =
-            data_flat.slice(data_indices, sizes);
-        output_index[p]++;
-      }
+      ForEachBlock(c, num_blocks, N, [&](int64 block, int64 start, int64 end) {
+        int64* output_index = block_offsets.data() + block * num_partitions_;
+        for (int64 i = start; i < end; i++) {
+          // outputs[p][output_index[p]++] = data[i]
+          const int32 p = internal::SubtleMustCopy(e_partitions(i));
+          if (!FastBoundsCheck(p, num_partitions_)) {
+            block_status[block] = errors::InvalidArgument(
+                "indices[", i,
+                "] has been asynchronously overwritten and is no longer in "
+                "range!");
+            return;
+          }
+          auto oi = output_index[p];
+          if (!FastBoundsCheck(oi, out_flat[p].dimension(0))) {
+            block_status[block] = errors::InvalidArgument(
+                "Size of output_index: ", oi, " is no longer in range.");
+            return;
+          }
+          Eigen::DSizes<Eigen::DenseIndex, 2> out_indices(oi, 0);
+          Eigen::DSizes<Eigen::DenseIndex, 2> data_indices(i, 0);
+          out_flat[p].slice(out_indices, sizes) =
+              data_flat.slice(data_indices, sizes);
+          output_index[p]++;
+        }
+      });
+    }
+    for (const Status& status : block_status) {
+      OP_REQUIRES_OK(c, status);
     }
   }
 };
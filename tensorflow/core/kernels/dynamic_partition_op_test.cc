@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -22,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/node_builder.h"
@@ -159,6 +161,37 @@ TEST_F(DynamicPartitionOpTest, Error_IndexOutOfRange) {
       << s;
 }
 
+TEST_F(DynamicPartitionOpTest, Large_TwoD) {
+  MakeOp();
+
+  // Large enough to be partitioned in parallel.
+  const int kRows = 200 * 1000;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> data(2 * kRows);
+  std::vector<int32> partitions(kRows);
+  std::vector<std::vector<float>> expected(4);
+  for (int i = 0; i < kRows; i++) {
+    data[2 * i] = i;
+    data[2 * i + 1] = -i;
+    // Skewed towards the first partition.
+    partitions[i] = rnd.OneIn(2) ? 0 : rnd.Uniform(4);
+    expected[partitions[i]].push_back(i);
+    expected[partitions[i]].push_back(-i);
+  }
+  AddInputFromArray<float>(TensorShape({kRows, 2}), data);
+  AddInputFromArray<int32>(TensorShape({kRows}), partitions);
+  TF_ASSERT_OK(RunOpKernel());
+
+  // The rows of each partition keep their order.
+  for (int p = 0; p < 4; p++) {
+    const int64 num_rows = expected[p].size() / 2;
+    test::ExpectTensorEqual<float>(
+        test::AsTensor<float>(expected[p], TensorShape({num_rows, 2})),
+        *GetOutput(p));
+  }
+}
+
 Node* DynamicPartitionNode(Graph* g, Node* in0, Node* in1, int num_partitions) {
   Node* ret;
   TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DynamicPartition")
@@ -208,6 +241,8 @@ BM_DYNAMIC_PARTITION(cpu, double, 2);
 BM_DYNAMIC_PARTITION(cpu, double, 100);
 BM_DYNAMIC_PARTITION(cpu, complex64, 2);
 BM_DYNAMIC_PARTITION(cpu, complex64, 100);
+BM_DYNAMIC_PARTITION(cpu, int64, 8);
+BM_DYNAMIC_PARTITION(cpu, int64, 64);
 
 BM_DYNAMIC_PARTITION(gpu, float, 2);
 BM_DYNAMIC_PARTITION(gpu, float, 100);
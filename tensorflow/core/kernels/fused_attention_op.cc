@@ -0,0 +1,300 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// CPU kernel for the _FusedScaledDotProductAttention op created by the Grappler
+// remapper, which computes softmax(query * key^T * scale + mask) * value
+// without materializing the [..., query_length, key_length] attention scores.
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    Matrix;
+typedef Eigen::Map<const Matrix> ConstMatrixMap;
+typedef Eigen::Map<Matrix> MatrixMap;
+
+// Number of queries and keys of the blocks of attention scores. A block of
+// scores fits in the L2 cache.
+constexpr int64 kQueryBlockSize = 64;
+constexpr int64 kKeyBlockSize = 256;
+
+// The inputs and output of an attention, with the batch dimensions flattened:
+// query is [batch, query_length, depth], key is [batch, key_length, depth],
+// value is [batch, key_length, value_depth] and output is
+// [batch, query_length, value_depth].
+struct AttentionArgs {
+  const float* query;
+  const float* key;
+  const float* value;
+  float* output;
+  int64 query_length;
+  int64 key_length;
+  int64 depth;
+  int64 value_depth;
+  float scale;
+  // The mask of scores (b, i, j) is mask[mask_offsets[b] + i * mask_row_stride
+  // + j * mask_col_stride], where strides are 0 for broadcast dimensions.
+  const float* mask = nullptr;
+  std::vector<int64> mask_offsets;
+  int64 mask_row_stride = 0;
+  int64 mask_col_stride = 0;
+};
+
+// Computes the attention of a block of queries, one block of keys at a time.
+// The maximum score of each query and the sum of the exponentials of its
+// scores relative to that maximum are updated with each block of keys, and the
+// output accumulated so far is rescaled when the maximum increases (an online
+// softmax).
+class AttentionQueryBlock {
+ public:
+  explicit AttentionQueryBlock(const AttentionArgs& args)
+      : args_(args),
+        scores_(kQueryBlockSize, kKeyBlockSize),
+        output_(kQueryBlockSize, args.value_depth),
+        max_(kQueryBlockSize),
+        sum_(kQueryBlockSize) {}
+
+  // Computes the output for the queries [begin, begin + rows) of `batch`.
+  void Compute(int64 batch, int64 begin, int64 rows) {
+    const ConstMatrixMap query(
+        args_.query + (batch * args_.query_length + begin) * args_.depth, rows,
+        args_.depth);
+    auto output = output_.topRows(rows);
+    output.setZero();
+    max_.head(rows).setConstant(-std::numeric_limits<float>::infinity());
+    sum_.head(rows).setZero();
+
+    for (int64 key_begin = 0; key_begin < args_.key_length;
+         key_begin += kKeyBlockSize) {
+      const int64 cols = std::min(kKeyBlockSize, args_.key_length - key_begin);
+      const int64 key_offset = batch * args_.key_length + key_begin;
+      const ConstMatrixMap key(args_.key + key_offset * args_.depth, cols,
+                               args_.depth);
+      const ConstMatrixMap value(args_.value + key_offset * args_.value_depth,
+                                 cols, args_.value_depth);
+      auto scores = scores_.topLeftCorner(rows, cols);
+      scores.noalias() = query * key.transpose();
+      scores *= args_.scale;
+      if (args_.mask != nullptr) AddMask(batch, begin, key_begin, &scores);
+
+      for (int64 i = 0; i < rows; ++i) {
+        const float max = std::max(max_(i), scores.row(i).maxCoeff());
+        if (max == -std::numeric_limits<float>::infinity()) {
+          // No key has contributed to this query yet.
+          scores.row(i).setZero();
+          continue;
+        }
+        const float correction = std::exp(max_(i) - max);
+        scores.row(i) = (scores.row(i).array() - max).exp().matrix();
+        sum_(i) = sum_(i) * correction + scores.row(i).sum();
+        output.row(i) *= correction;
+        max_(i) = max;
+      }
+      output.noalias() += scores * value;
+    }
+
+    MatrixMap(
+        args_.output + (batch * args_.query_length + begin) * args_.value_depth,
+        rows, args_.value_depth) =
+        output.array().colwise() / sum_.head(rows).array();
+  }
+
+ private:
+  template <typename Scores>
+  void AddMask(int64 batch, int64 query_begin, int64 key_begin,
+               Scores* scores) const {
+    const float* mask = args_.mask + args_.mask_offsets[batch] +
+                        query_begin * args_.mask_row_stride +
+                        key_begin * args_.mask_col_stride;
+    for (int64 i = 0; i < scores->rows(); ++i) {
+      const float* row = mask + i * args_.mask_row_stride;
+      if (args_.mask_col_stride == 0) {
+        scores->row(i).array() += *row;
+      } else {
+        scores->row(i) += Eigen::Map<const Eigen::RowVectorXf, 0,
+                                     Eigen::InnerStride<>>(
+            row, scores->cols(), Eigen::InnerStride<>(args_.mask_col_stride));
+      }
+    }
+  }
+
+  const AttentionArgs& args_;
+  Matrix scores_;
+  Matrix output_;
+  Eigen::VectorXf max_;
+  Eigen::VectorXf sum_;
+};
+
+}  // namespace
+
+class FusedScaledDotProductAttentionOp : public OpKernel {
+ public:
+  explicit FusedScaledDotProductAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale_));
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+    OP_REQUIRES(context, num_args <= 1,
+                errors::InvalidArgument(
+                    "Attention supports at most one mask, got num_args=",
+                    num_args));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& query = context->input(0);
+    const Tensor& key = context->input(1);
+    const Tensor& value = context->input(2);
+    const int rank = query.dims();
+    OP_REQUIRES(context, rank >= 3,
+                errors::InvalidArgument("query must be at least 3-D, got ",
+                                        query.shape().DebugString()));
+    OP_REQUIRES(
+        context, key.dims() == rank && value.dims() == rank,
+        errors::InvalidArgument("query, key and value must have the same rank, "
+                                "got ",
+                                query.shape().DebugString(), ", ",
+                                key.shape().DebugString(), " and ",
+                                value.shape().DebugString()));
+    int64 batch = 1;
+    for (int i = 0; i < rank - 2; ++i) {
+      OP_REQUIRES(context,
+                  key.dim_size(i) == query.dim_size(i) &&
+                      value.dim_size(i) == query.dim_size(i),
+                  errors::InvalidArgument(
+                      "query, key and value must have the same batch "
+                      "dimensions, got ",
+                      query.shape().DebugString(), ", ",
+                      key.shape().DebugString(), " and ",
+                      value.shape().DebugString()));
+      batch *= query.dim_size(i);
+    }
+    AttentionArgs args;
+    args.query_length = query.dim_size(rank - 2);
+    args.key_length = key.dim_size(rank - 2);
+    args.depth = query.dim_size(rank - 1);
+    args.value_depth = value.dim_size(rank - 1);
+    args.scale = scale_;
+    OP_REQUIRES(context, key.dim_size(rank - 1) == args.depth,
+                errors::InvalidArgument(
+                    "query and key must have the same depth, got ",
+                    query.shape().DebugString(), " and ",
+                    key.shape().DebugString()));
+    OP_REQUIRES(context, value.dim_size(rank - 2) == args.key_length,
+                errors::InvalidArgument(
+                    "key and value must have the same length, got ",
+                    key.shape().DebugString(), " and ",
+                    value.shape().DebugString()));
+
+    TensorShape scores_shape = query.shape();
+    scores_shape.set_dim(rank - 1, args.key_length);
+    if (context->num_inputs() > 3) {
+      const Tensor& mask = context->input(3);
+      OP_REQUIRES_OK(context, GetMaskStrides(mask, scores_shape, batch, &args));
+      args.mask = mask.flat<float>().data();
+    }
+
+    TensorShape output_shape = query.shape();
+    output_shape.set_dim(rank - 1, args.value_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+    if (args.key_length == 0) {
+      // The product of the empty attention weights and values.
+      output->flat<float>().setZero();
+      return;
+    }
+    args.query = query.flat<float>().data();
+    args.key = key.flat<float>().data();
+    args.value = value.flat<float>().data();
+    args.output = output->flat<float>().data();
+
+    const int64 num_query_blocks =
+        (args.query_length + kQueryBlockSize - 1) / kQueryBlockSize;
+    auto compute = [&args, num_query_blocks](int64 start, int64 limit) {
+      AttentionQueryBlock block(args);
+      for (int64 i = start; i < limit; ++i) {
+        const int64 begin = (i % num_query_blocks) * kQueryBlockSize;
+        block.Compute(i / num_query_blocks, begin,
+                      std::min(kQueryBlockSize, args.query_length - begin));
+      }
+    };
+    const int64 cost_per_block =
+        kQueryBlockSize * args.key_length *
+        (2 * (args.depth + args.value_depth) +
+         Eigen::internal::functor_traits<
+             Eigen::internal::scalar_exp_op<float>>::Cost);
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          batch * num_query_blocks, cost_per_block, compute);
+  }
+
+ private:
+  // Computes the offsets and strides of the mask broadcast to the scores.
+  static Status GetMaskStrides(const Tensor& mask,
+                               const TensorShape& scores_shape, int64 batch,
+                               AttentionArgs* args) {
+    const int rank = scores_shape.dims();
+    const auto broadcast_error = [&]() {
+      return errors::InvalidArgument(
+          "mask of shape ", mask.shape().DebugString(),
+          " cannot be broadcast to the attention scores of shape ",
+          scores_shape.DebugString());
+    };
+    if (mask.dims() > rank) return broadcast_error();
+    std::vector<int64> strides(rank, 0);
+    int64 stride = 1;
+    for (int i = rank - 1, j = mask.dims() - 1; j >= 0; --i, --j) {
+      const int64 size = mask.dim_size(j);
+      if (size != 1 && size != scores_shape.dim_size(i)) {
+        return broadcast_error();
+      }
+      if (size != 1) strides[i] = stride;
+      stride *= size;
+    }
+    args->mask_offsets.resize(batch);
+    for (int64 b = 0; b < batch; ++b) {
+      int64 offset = 0;
+      for (int64 i = rank - 3, index = b; i >= 0; --i) {
+        offset += (index % scores_shape.dim_size(i)) * strides[i];
+        index /= scores_shape.dim_size(i);
+      }
+      args->mask_offsets[b] = offset;
+    }
+    args->mask_row_stride = strides[rank - 2];
+    args->mask_col_stride = strides[rank - 1];
+    return Status::OK();
+  }
+
+  float scale_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("_FusedScaledDotProductAttention")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<float>("T"),
+                        FusedScaledDotProductAttentionOp);
+
+}  // namespace tensorflow
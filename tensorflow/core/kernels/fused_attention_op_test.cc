@@ -0,0 +1,272 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Computes softmax(query * key^T * scale + mask) * value one query at a time,
+// for query, key and value of shape [batch, length, depth] and a mask of shape
+// [batch, query_length, key_length] (or an empty tensor).
+Tensor ReferenceAttention(const Tensor& query, const Tensor& key,
+                          const Tensor& value, const Tensor& mask,
+                          float scale) {
+  const int64 batch = query.dim_size(0);
+  const int64 query_length = query.dim_size(1);
+  const int64 key_length = key.dim_size(1);
+  const int64 depth = query.dim_size(2);
+  const int64 value_depth = value.dim_size(2);
+  const auto q = query.tensor<float, 3>();
+  const auto k = key.tensor<float, 3>();
+  const auto v = value.tensor<float, 3>();
+  Tensor output(DT_FLOAT, TensorShape({batch, query_length, value_depth}));
+  auto out = output.tensor<float, 3>();
+  out.setZero();
+  std::vector<double> scores(key_length);
+  for (int64 b = 0; b < batch; ++b) {
+    for (int64 i = 0; i < query_length; ++i) {
+      double max = -std::numeric_limits<double>::infinity();
+      for (int64 j = 0; j < key_length; ++j) {
+        double score = 0;
+        for (int64 d = 0; d < depth; ++d) score += q(b, i, d) * k(b, j, d);
+        score *= scale;
+        if (mask.NumElements() > 0) score += mask.tensor<float, 3>()(b, i, j);
+        scores[j] = score;
+        max = std::max(max, score);
+      }
+      double sum = 0;
+      for (int64 j = 0; j < key_length; ++j) {
+        scores[j] = std::exp(scores[j] - max);
+        sum += scores[j];
+      }
+      for (int64 d = 0; d < value_depth; ++d) {
+        double result = 0;
+        for (int64 j = 0; j < key_length; ++j) result += scores[j] * v(b, j, d);
+        out(b, i, d) = result / sum;
+      }
+    }
+  }
+  return output;
+}
+
+class FusedAttentionOpTest : public OpsTestBase {
+ protected:
+  // Runs the attention with a mask of `mask_shape` that is broadcast to the
+  // scores, if any, and compares it with the reference.
+  void Check(int64 batch, int64 query_length, int64 key_length, int64 depth,
+             int64 value_depth, const std::vector<int64>& mask_shape,
+             bool causal = false) {
+    const bool has_mask = !mask_shape.empty();
+    TF_ASSERT_OK(
+        NodeDefBuilder("attention", "_FusedScaledDotProductAttention")
+            .Input(FakeInput(DT_FLOAT))
+            .Input(FakeInput(DT_FLOAT))
+            .Input(FakeInput(DT_FLOAT))
+            .Input(FakeInput(has_mask ? 1 : 0, DT_FLOAT))
+            .Attr("num_args", has_mask ? 1 : 0)
+            .Attr("scale", 0.125f)
+            .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+
+    Tensor query(DT_FLOAT, TensorShape({batch, query_length, depth}));
+    Tensor key(DT_FLOAT, TensorShape({batch, key_length, depth}));
+    Tensor value(DT_FLOAT, TensorShape({batch, key_length, value_depth}));
+    query.flat<float>().setRandom();
+    key.flat<float>().setRandom();
+    value.flat<float>().setRandom();
+    query.flat<float>() = query.flat<float>() * 8.0f - 4.0f;
+    key.flat<float>() = key.flat<float>() * 8.0f - 4.0f;
+    AddInputFromArray<float>(query.shape(), query.flat<float>());
+    AddInputFromArray<float>(key.shape(), key.flat<float>());
+    AddInputFromArray<float>(value.shape(), value.flat<float>());
+
+    Tensor full_mask(DT_FLOAT, TensorShape({0}));
+    if (has_mask) {
+      Tensor mask(DT_FLOAT, TensorShape(mask_shape));
+      mask.flat<float>().setRandom();
+      if (causal) {
+        auto m = mask.flat_inner_dims<float, 2>();
+        for (int64 i = 0; i < m.dimension(0); ++i) {
+          for (int64 j = 0; j < m.dimension(1); ++j) {
+            if (j > i % query_length) {
+              m(i, j) = -std::numeric_limits<float>::infinity();
+            }
+          }
+        }
+      }
+      AddInputFromArray<float>(mask.shape(), mask.flat<float>());
+      // Broadcasts the mask to the scores for the reference.
+      full_mask =
+          Tensor(DT_FLOAT, TensorShape({batch, query_length, key_length}));
+      auto full = full_mask.tensor<float, 3>();
+      std::vector<int64> shape(3 - mask_shape.size(), 1);
+      shape.insert(shape.end(), mask_shape.begin(), mask_shape.end());
+      const auto m = mask.shaped<float, 3>(shape);
+      for (int64 b = 0; b < batch; ++b) {
+        for (int64 i = 0; i < query_length; ++i) {
+          for (int64 j = 0; j < key_length; ++j) {
+            full(b, i, j) = m(shape[0] == 1 ? 0 : b, shape[1] == 1 ? 0 : i,
+                              shape[2] == 1 ? 0 : j);
+          }
+        }
+      }
+    }
+
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorNear<float>(
+        ReferenceAttention(query, key, value, full_mask, 0.125f),
+        *GetOutput(0), 1e-5);
+  }
+};
+
+TEST_F(FusedAttentionOpTest, NoMask) { Check(2, 70, 300, 16, 24, {}); }
+
+TEST_F(FusedAttentionOpTest, SingleKeyBlock) { Check(3, 5, 7, 4, 4, {}); }
+
+TEST_F(FusedAttentionOpTest, PaddingMask) {
+  Check(2, 70, 300, 16, 16, {2, 1, 300});
+}
+
+TEST_F(FusedAttentionOpTest, QueryMask) { Check(2, 70, 300, 16, 8, {70, 1}); }
+
+TEST_F(FusedAttentionOpTest, CausalMask) {
+  // Whole blocks of keys are masked out for the first queries.
+  Check(2, 300, 300, 16, 16, {300, 300}, /*causal=*/true);
+}
+
+TEST_F(FusedAttentionOpTest, BatchCausalMask) {
+  Check(2, 129, 300, 8, 8, {2, 129, 300}, /*causal=*/true);
+}
+
+TEST_F(FusedAttentionOpTest, EmptyKeys) {
+  TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedScaledDotProductAttention")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(0, DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({1, 2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({1, 0, 3}), {});
+  AddInputFromArray<float>(TensorShape({1, 0, 2}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_FLOAT, TensorShape({1, 2, 2}));
+  test::FillValues<float>(&expected, {0, 0, 0, 0});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedAttentionOpTest, InvalidMask) {
+  TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedScaledDotProductAttention")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(1, DT_FLOAT))
+                   .Attr("num_args", 1)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({1, 2, 1}), {1, 2});
+  AddInputFromArray<float>(TensorShape({1, 3, 1}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({1, 3, 1}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({2, 2}), {0, 0, 0, 0});
+  const Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+// Self-attention of 16 heads of depth 64 over a sequence of `length` with a
+// padding mask, with or without the fused op.
+Graph* AttentionGraph(int64 length, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({1, 16, length, 64}));
+  input.flat<float>().setRandom();
+  Tensor mask(DT_FLOAT, TensorShape({1, 1, 1, length}));
+  mask.flat<float>().setZero();
+  Node* query = test::graph::Constant(g, input);
+  Node* key = test::graph::Constant(g, input);
+  Node* value = test::graph::Constant(g, input);
+  Node* attention;
+  if (fused) {
+    const std::vector<NodeBuilder::NodeOut> args = {
+        test::graph::Constant(g, mask)};
+    TF_CHECK_OK(NodeBuilder(g->NewName("attention"),
+                            "_FusedScaledDotProductAttention")
+                    .Input(query)
+                    .Input(key)
+                    .Input(value)
+                    .Input(args)
+                    .Attr("num_args", 1)
+                    .Attr("scale", 0.125f)
+                    .Finalize(g, &attention));
+  } else {
+    Node* scores;
+    TF_CHECK_OK(NodeBuilder(g->NewName("scores"), "BatchMatMulV2")
+                    .Input(query)
+                    .Input(key)
+                    .Attr("adj_y", true)
+                    .Finalize(g, &scores));
+    Node* scaled;
+    TF_CHECK_OK(
+        NodeBuilder(g->NewName("scaled"), "Mul")
+            .Input(scores)
+            .Input(test::graph::Constant(g, test::AsScalar<float>(0.125f)))
+            .Finalize(g, &scaled));
+    Node* masked;
+    TF_CHECK_OK(NodeBuilder(g->NewName("masked"), "AddV2")
+                    .Input(scaled)
+                    .Input(test::graph::Constant(g, mask))
+                    .Finalize(g, &masked));
+    Node* weights;
+    TF_CHECK_OK(NodeBuilder(g->NewName("weights"), "Softmax")
+                    .Input(masked)
+                    .Finalize(g, &weights));
+    TF_CHECK_OK(NodeBuilder(g->NewName("attention"), "BatchMatMulV2")
+                    .Input(weights)
+                    .Input(value)
+                    .Finalize(g, &attention));
+  }
+  return g;
+}
+
+void BM_ScaledDotProductAttention(::testing::benchmark::State& state) {
+  const int64 length = state.range(0);
+  const bool fused = state.range(1);
+  test::Benchmark("cpu", AttentionGraph(length, fused),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * 16 * length * length);
+}
+BENCHMARK(BM_ScaledDotProductAttention)
+    ->UseRealTime()
+    ->ArgPair(512, 0)
+    ->ArgPair(512, 1)
+    ->ArgPair(2048, 0)
+    ->ArgPair(2048, 1);
+
+}  // namespace
+}  // namespace tensorflow
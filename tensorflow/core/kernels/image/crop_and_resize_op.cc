@@ -19,8 +19,11 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/image/crop_and_resize_op.h"
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -203,6 +206,39 @@ class CropAndResizeOp : public AsyncOpKernel {
   string method_;
 };
 
+namespace {
+
+// The horizontal interpolation of a column of a crop, computed once per box.
+struct CachedInterpolation {
+  // Offsets of the left and right source pixels in an image row, or of the
+  // closest one in both for the "nearest" method.
+  int64 left;
+  int64 right;
+  float lerp;
+  // Whether the column lies outside of the image.
+  bool extrapolate;
+};
+
+// Interpolates the image row `in_row` at the cached columns `xs`. The values
+// of the columns to extrapolate are left unspecified.
+template <typename T>
+void InterpolateRow(const T* const in_row,
+                    const std::vector<CachedInterpolation>& xs,
+                    const int depth, float* out_row) {
+  for (int x = 0; x < xs.size(); ++x) {
+    if (xs[x].extrapolate) continue;
+    const T* const left = in_row + xs[x].left;
+    const T* const right = in_row + xs[x].right;
+    for (int d = 0; d < depth; ++d) {
+      const float left_d(static_cast<float>(left[d]));
+      const float right_d(static_cast<float>(right[d]));
+      out_row[x * depth + d] = left_d + (right_d - left_d) * xs[x].lerp;
+    }
+  }
+}
+
+}  // namespace
+
 // Partial specialization of CropAndResize functor for a CPUDevice.
 namespace functor {
 template <typename T>
@@ -233,9 +269,26 @@ struct CropAndResize<CPUDevice, T> {
       return false;
     }
 
-    // Sharding across boxes.
-    auto CropAndResizePerBox = [&](int64 start_box, int64 limit_box) {
-      for (int b = start_box; b < limit_box; ++b) {
+    // Sharding across the rows of the crops, so that a few large crops are
+    // also resized in parallel.
+    auto CropAndResizePerRow = [&](int64 start_row, int64 limit_row) {
+      const bool bilinear = method_name == "bilinear";
+      const int64 in_row_size = image_width * depth;
+      const int64 out_row_size = crop_width * depth;
+      // The columns of the box of the current row.
+      std::vector<CachedInterpolation> xs(crop_width);
+      int64 xs_box = -1;
+      // When consecutive rows of a crop are less than a pixel apart, they
+      // mostly share their source rows: the last two source rows interpolated
+      // horizontally are cached, indexed over all boxes, and the output rows
+      // are interpolated vertically between them.
+      std::vector<float> buffer(2 * out_row_size);
+      float* cached[2] = {buffer.data(), buffer.data() + out_row_size};
+      int64 cached_index[2] = {-1, -1};
+
+      for (int64 row = start_row; row < limit_row; ++row) {
+        const int b = row / crop_height;
+        const int y = row % crop_height;
         const float y1 = boxes(b, 0);
         const float x1 = boxes(b, 1);
         const float y2 = boxes(b, 2);
@@ -254,70 +307,110 @@ struct CropAndResize<CPUDevice, T> {
             (crop_width > 1) ? (x2 - x1) * (image_width - 1) / (crop_width - 1)
                              : 0;
 
-        for (int y = 0; y < crop_height; ++y) {
-          const float in_y = (crop_height > 1)
-                                 ? y1 * (image_height - 1) + y * height_scale
-                                 : 0.5 * (y1 + y2) * (image_height - 1);
-          if (in_y < 0 || in_y > image_height - 1) {
-            for (int x = 0; x < crop_width; ++x) {
-              for (int d = 0; d < depth; ++d) {
-                crops(b, y, x, d) = extrapolation_value;
-              }
-            }
-            continue;
-          }
-          if (method_name == "bilinear") {
-            const int top_y_index = floorf(in_y);
-            const int bottom_y_index = ceilf(in_y);
-            const float y_lerp = in_y - top_y_index;
+        float* crop_row = &crops(b, y, 0, 0);
+        const float in_y = (crop_height > 1)
+                               ? y1 * (image_height - 1) + y * height_scale
+                               : 0.5 * (y1 + y2) * (image_height - 1);
+        if (in_y < 0 || in_y > image_height - 1) {
+          std::fill_n(crop_row, out_row_size, extrapolation_value);
+          continue;
+        }
 
-            for (int x = 0; x < crop_width; ++x) {
-              const float in_x = (crop_width > 1)
-                                     ? x1 * (image_width - 1) + x * width_scale
-                                     : 0.5 * (x1 + x2) * (image_width - 1);
-              if (in_x < 0 || in_x > image_width - 1) {
-                for (int d = 0; d < depth; ++d) {
-                  crops(b, y, x, d) = extrapolation_value;
-                }
-                continue;
-              }
+        if (b != xs_box) {
+          for (int x = 0; x < crop_width; ++x) {
+            const float in_x = (crop_width > 1)
+                                   ? x1 * (image_width - 1) + x * width_scale
+                                   : 0.5 * (x1 + x2) * (image_width - 1);
+            CachedInterpolation& column = xs[x];
+            column.extrapolate = in_x < 0 || in_x > image_width - 1;
+            if (column.extrapolate) continue;
+            if (bilinear) {
               const int left_x_index = floorf(in_x);
               const int right_x_index = ceilf(in_x);
-              const float x_lerp = in_x - left_x_index;
+              column.left = left_x_index * depth;
+              column.right = right_x_index * depth;
+              column.lerp = in_x - left_x_index;
+            } else {
+              const int closest_x_index = roundf(in_x);
+              column.left = closest_x_index * depth;
+              column.right = column.left;
+              column.lerp = 0;
+            }
+          }
+          xs_box = b;
+        }
 
-              for (int d = 0; d < depth; ++d) {
-                const float top_left(static_cast<float>(
-                    image(b_in, top_y_index, left_x_index, d)));
-                const float top_right(static_cast<float>(
-                    image(b_in, top_y_index, right_x_index, d)));
-                const float bottom_left(static_cast<float>(
-                    image(b_in, bottom_y_index, left_x_index, d)));
-                const float bottom_right(static_cast<float>(
-                    image(b_in, bottom_y_index, right_x_index, d)));
-                const float top = top_left + (top_right - top_left) * x_lerp;
-                const float bottom =
-                    bottom_left + (bottom_right - bottom_left) * x_lerp;
-                crops(b, y, x, d) = top + (bottom - top) * y_lerp;
+        const T* const image_ptr = &image(b_in, 0, 0, 0);
+        if (bilinear) {
+          const int top_y_index = floorf(in_y);
+          const int bottom_y_index = ceilf(in_y);
+          const float y_lerp = in_y - top_y_index;
+
+          if (std::abs(height_scale) < 1) {
+            // Returns the horizontal interpolation of the source row `y_index`
+            // of the current box, without evicting the source row `keep`.
+            auto interpolated_row = [&](int y_index, int keep) {
+              const int64 index = static_cast<int64>(b) * image_height;
+              for (int i = 0; i < 2; ++i) {
+                if (cached_index[i] == index + y_index) return cached[i];
               }
-            }
-          } else {  // method == "nearest"
+              const int i = cached_index[0] == index + keep ? 1 : 0;
+              InterpolateRow(image_ptr + y_index * in_row_size, xs, depth,
+                             cached[i]);
+              cached_index[i] = index + y_index;
+              return cached[i];
+            };
+            const float* top = interpolated_row(top_y_index, bottom_y_index);
+            const float* bottom =
+                interpolated_row(bottom_y_index, top_y_index);
+            TTypes<float>::UnalignedConstFlat top_row(top, out_row_size);
+            TTypes<float>::UnalignedConstFlat bottom_row(bottom, out_row_size);
+            TTypes<float>::UnalignedFlat out_row(crop_row, out_row_size);
+            out_row = top_row + (bottom_row - top_row) * y_lerp;
             for (int x = 0; x < crop_width; ++x) {
-              const float in_x = (crop_width > 1)
-                                     ? x1 * (image_width - 1) + x * width_scale
-                                     : 0.5 * (x1 + x2) * (image_width - 1);
-              if (in_x < 0 || in_x > image_width - 1) {
-                for (int d = 0; d < depth; ++d) {
-                  crops(b, y, x, d) = extrapolation_value;
-                }
-                continue;
-              }
-              const int closest_x_index = roundf(in_x);
-              const int closest_y_index = roundf(in_y);
-              for (int d = 0; d < depth; ++d) {
-                crops(b, y, x, d) = static_cast<float>(
-                    image(b_in, closest_y_index, closest_x_index, d));
+              if (xs[x].extrapolate) {
+                std::fill_n(crop_row + x * depth, depth, extrapolation_value);
               }
             }
+            continue;
+          }
+
+          const T* const top_row = image_ptr + top_y_index * in_row_size;
+          const T* const bottom_row = image_ptr + bottom_y_index * in_row_size;
+          for (int x = 0; x < crop_width; ++x) {
+            if (xs[x].extrapolate) {
+              std::fill_n(crop_row + x * depth, depth, extrapolation_value);
+              continue;
+            }
+            const int64 left = xs[x].left;
+            const int64 right = xs[x].right;
+            const float x_lerp = xs[x].lerp;
+            for (int d = 0; d < depth; ++d) {
+              const float top_left(static_cast<float>(top_row[left + d]));
+              const float top_right(static_cast<float>(top_row[right + d]));
+              const float bottom_left(
+                  static_cast<float>(bottom_row[left + d]));
+              const float bottom_right(
+                  static_cast<float>(bottom_row[right + d]));
+              const float top = top_left + (top_right - top_left) * x_lerp;
+              const float bottom =
+                  bottom_left + (bottom_right - bottom_left) * x_lerp;
+              crop_row[x * depth + d] = top + (bottom - top) * y_lerp;
+            }
+          }
+        } else {  // method == "nearest"
+          const int closest_y_index = roundf(in_y);
+          const T* const closest_row =
+              image_ptr + closest_y_index * in_row_size;
+          for (int x = 0; x < crop_width; ++x) {
+            if (xs[x].extrapolate) {
+              std::fill_n(crop_row + x * depth, depth, extrapolation_value);
+              continue;
+            }
+            for (int d = 0; d < depth; ++d) {
+              crop_row[x * depth + d] =
+                  static_cast<float>(closest_row[xs[x].left + d]);
+            }
           }
         }
       }
@@ -335,12 +428,13 @@ struct CropAndResize<CPUDevice, T> {
                        Eigen::TensorOpCost::AddCost<float>() * 4 +
                        Eigen::TensorOpCost::MulCost<float>() * 4;
     }
-    const double cost_per_box = crop_height * crop_width * cost_per_pixel;
+    const double cost_per_row = crop_width * cost_per_pixel;
 
     const DeviceBase::CpuWorkerThreads& worker_threads =
         *(context->device()->tensorflow_cpu_worker_threads());
-    Shard(worker_threads.num_threads, worker_threads.workers, num_boxes,
-          cost_per_box, CropAndResizePerBox);
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          static_cast<int64>(num_boxes) * crop_height, cost_per_row,
+          CropAndResizePerRow);
 
     return true;
   }
@@ -21,11 +21,13 @@ limitations under the License.
 
 namespace tensorflow {
 
+template <typename T>
 static Graph* CropAndResize(int batches, int width, int height, int depth,
                             int crop_height, int crop_width) {
   Graph* g = new Graph(OpRegistry::Global());
-  Tensor in(DT_FLOAT, TensorShape({batches, height, width, depth}));
-  in.flat<float>().setRandom();
+  Tensor in(DataTypeToEnum<T>::value,
+            TensorShape({batches, height, width, depth}));
+  in.flat<T>().setRandom();
   Tensor boxes(DT_FLOAT, TensorShape({batches, 4}));
   auto boxes_tensor = boxes.matrix<float>();
   Tensor box_ind(DT_INT32, TensorShape({batches}));
@@ -54,7 +56,7 @@ static Graph* CropAndResize(int batches, int width, int height, int depth,
 #define BM_CropAndResizeDev(DEVICE, B, W, H, D, CH, CW)                        \
   static void BM_CropAndResize_##DEVICE##_##B##_##W##_##H##_##D##_##CH##_##CW( \
       ::testing::benchmark::State& state) {                                    \
-    test::Benchmark(#DEVICE, CropAndResize(B, W, H, D, CH, CW),                \
+    test::Benchmark(#DEVICE, CropAndResize<float>(B, W, H, D, CH, CW),         \
                     /*old_benchmark_api*/ false)                               \
         .Run(state);                                                           \
     state.SetItemsProcessed(state.iterations() * B * W * H * D);               \
@@ -71,4 +73,21 @@ BM_CropAndResizeDev(cpu, 1, 640, 640, 3, 512, 512);
 BM_CropAndResizeDev(cpu, 1, 640, 640, 1, 512, 512);
 BM_CropAndResizeDev(cpu, 1, 80, 80, 512, 7, 7);
 
+// Crops and resizes uint8 images, as decoded from image files.
+#define BM_CropAndResizeUint8Dev(DEVICE, B, W, H, D, CH, CW)                   \
+  static void                                                                  \
+      BM_CropAndResizeUint8_##DEVICE##_##B##_##W##_##H##_##D##_##CH##_##CW(    \
+          ::testing::benchmark::State& state) {                                \
+    test::Benchmark(#DEVICE, CropAndResize<uint8>(B, W, H, D, CH, CW),         \
+                    /*old_benchmark_api*/ false)                               \
+        .Run(state);                                                           \
+    state.SetItemsProcessed(state.iterations() * B * W * H * D);               \
+  }                                                                            \
+  BENCHMARK(                                                                   \
+      BM_CropAndResizeUint8_##DEVICE##_##B##_##W##_##H##_##D##_##CH##_##CW);
+
+BM_CropAndResizeUint8Dev(cpu, 1, 640, 640, 3, 512, 512);
+BM_CropAndResizeUint8Dev(cpu, 1, 1024, 768, 3, 224, 224);
+BM_CropAndResizeUint8Dev(cpu, 8, 1024, 768, 3, 224, 224);
+
 }  // namespace tensorflow
@@ -0,0 +1,308 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/image_ops.cc
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/image_resizer_state.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+// Source pixels and weight of an output pixel of the bilinear resize, along
+// one dimension.
+struct Interpolation {
+  int64 lower;
+  int64 upper;
+  float lerp;
+};
+
+// Computes the interpolation of the `out_size` output pixels of the bilinear
+// resize of the `in_size` pixels starting at `in_offset` in the full
+// resolution image, read from the `decoded_size` pixels starting at
+// `decoded_offset` in the image decoded at 1/`ratio` scale. With a ratio of 1,
+// this is the interpolation of ResizeBilinear.
+template <typename Scaler>
+void ComputeInterpolation(const Scaler scaler, int64 out_size, int64 in_size,
+                          bool align_corners, int64 in_offset, int ratio,
+                          int64 decoded_offset, int64 decoded_size,
+                          std::vector<Interpolation>* interpolation) {
+  const float scale = CalculateResizeScale(in_size, out_size, align_corners);
+  interpolation->resize(out_size);
+  for (int64 i = 0; i < out_size; ++i) {
+    float in = scaler(i, scale);
+    if (ratio > 1) {
+      // Pixel k of the scaled image covers the full resolution pixels
+      // [k * ratio, (k + 1) * ratio), so its center is k * ratio +
+      // (ratio - 1) / 2 in the full resolution image.
+      in = (in + in_offset - 0.5f * (ratio - 1)) / ratio - decoded_offset;
+    }
+    const float in_f = std::floor(in);
+    Interpolation& interp = (*interpolation)[i];
+    interp.lower = std::min(std::max(static_cast<int64>(in_f), int64{0}),
+                            decoded_size - 1);
+    interp.upper = std::min(
+        std::max(static_cast<int64>(std::ceil(in)), int64{0}),
+        decoded_size - 1);
+    interp.lerp = in - in_f;
+  }
+}
+
+inline float ComputeLerp(const float top_left, const float top_right,
+                         const float bottom_left, const float bottom_right,
+                         const float x_lerp, const float y_lerp) {
+  const float top = top_left + (top_right - top_left) * x_lerp;
+  const float bottom = bottom_left + (bottom_right - bottom_left) * x_lerp;
+  return top + (bottom - top) * y_lerp;
+}
+
+}  // namespace
+
+class DecodeAndResizeJpegOp : public OpKernel {
+ public:
+  explicit DecodeAndResizeJpegOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("channels", &channels_));
+    OP_REQUIRES(context, channels_ == 0 || channels_ == 1 || channels_ == 3,
+                errors::InvalidArgument("channels must be 0, 1, or 3, got ",
+                                        channels_));
+    OP_REQUIRES_OK(context, context->GetAttr("fancy_upscaling",
+                                             &flags_.fancy_upscaling));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("try_recover_truncated",
+                                    &flags_.try_recover_truncated_jpeg));
+    OP_REQUIRES_OK(context, context->GetAttr("acceptable_fraction",
+                                             &flags_.min_acceptable_fraction));
+    string dct_method;
+    OP_REQUIRES_OK(context, context->GetAttr("dct_method", &dct_method));
+    OP_REQUIRES(
+        context,
+        (dct_method.empty() || dct_method == "INTEGER_FAST" ||
+         dct_method == "INTEGER_ACCURATE"),
+        errors::InvalidArgument("dct_method must be one of "
+                                "{'', 'INTEGER_FAST', 'INTEGER_ACCURATE'}"));
+    // Same default as DecodeJpeg.
+    flags_.dct_method =
+        dct_method == "INTEGER_ACCURATE" ? JDCT_ISLOW : JDCT_IFAST;
+    flags_.components = channels_;
+    OP_REQUIRES_OK(context, context->GetAttr("align_corners", &align_corners_));
+    OP_REQUIRES_OK(
+        context, context->GetAttr("half_pixel_centers", &half_pixel_centers_));
+    OP_REQUIRES(context, !half_pixel_centers_ || !align_corners_,
+                errors::InvalidArgument("If half_pixel_centers is True, "
+                                        "align_corners must be False."));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& contents = context->input(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(contents.shape()),
+                errors::InvalidArgument("contents must be scalar, got shape ",
+                                        contents.shape().DebugString()));
+    const StringPiece input = contents.scalar<tstring>()();
+    OP_REQUIRES(context, input.size() <= std::numeric_limits<int>::max(),
+                errors::InvalidArgument("JPEG contents are too large for int: ",
+                                        input.size()));
+
+    const Tensor& size = context->input(3);
+    OP_REQUIRES(context, size.dims() == 1 && size.NumElements() == 2,
+                errors::InvalidArgument("size must be 1-D with two elements, "
+                                        "got shape ",
+                                        size.shape().DebugString()));
+    const int64 out_height = size.vec<int32>()(0);
+    const int64 out_width = size.vec<int32>()(1);
+    OP_REQUIRES(context, out_height > 0 && out_width > 0,
+                errors::InvalidArgument("output dimensions must be positive"));
+
+    int width, height, components;
+    OP_REQUIRES(context,
+                jpeg::GetImageInfo(input.data(), input.size(), &width,
+                                   &height, &components),
+                errors::InvalidArgument(
+                    "_DecodeAndResizeJpeg can only decode JPEG images."));
+    const int64 num_channels = channels_ == 0 ? components : channels_;
+
+    // Crop window in the full resolution image.
+    int64 crop_y = 0;
+    int64 crop_x = 0;
+    int64 crop_height = height;
+    int64 crop_width = width;
+    const Tensor& crop_begin = context->input(1);
+    const Tensor& crop_size = context->input(2);
+    OP_REQUIRES(
+        context,
+        crop_begin.NumElements() == crop_size.NumElements() &&
+            (crop_begin.NumElements() == 0 || crop_begin.NumElements() == 3),
+        errors::InvalidArgument("crop_begin and crop_size must both be empty "
+                                "or have 3 elements, got shapes ",
+                                crop_begin.shape().DebugString(), " and ",
+                                crop_size.shape().DebugString()));
+    if (crop_begin.NumElements() == 3) {
+      const auto begin = crop_begin.flat<int32>();
+      const auto slice_size = crop_size.flat<int32>();
+      crop_y = begin(0);
+      crop_x = begin(1);
+      crop_height = slice_size(0) == -1 ? height - crop_y : slice_size(0);
+      crop_width = slice_size(1) == -1 ? width - crop_x : slice_size(1);
+      OP_REQUIRES(
+          context,
+          begin(2) == 0 &&
+              (slice_size(2) == -1 || slice_size(2) == num_channels),
+          errors::Unimplemented("The crop window must span all the channels"));
+      OP_REQUIRES(
+          context,
+          crop_y >= 0 && crop_x >= 0 && crop_height > 0 && crop_width > 0 &&
+              crop_y + crop_height <= height && crop_x + crop_width <= width,
+          errors::InvalidArgument("Invalid crop window: y=", crop_y,
+                                  ", x=", crop_x, ", h=", crop_height,
+                                  ", w=", crop_width, " for an image of ",
+                                  height, "x", width));
+    }
+
+    // The scaled IDCT of libjpeg decodes at 1/2, 1/4 or 1/8 of the full
+    // resolution for a fraction of the cost. The largest ratio which doesn't
+    // make the crop window smaller than the output is used, so that the image
+    // is never upsampled more than the unfused resize would.
+    int ratio = 8;
+    while (ratio > 1 && (crop_height / ratio < out_height ||
+                         crop_width / ratio < out_width)) {
+      ratio /= 2;
+    }
+    jpeg::UncompressFlags flags = flags_;
+    flags.ratio = ratio;
+    // Region of the scaled image (whose size is rounded up by libjpeg)
+    // covering the crop window.
+    const int64 scaled_height = (height + ratio - 1) / ratio;
+    const int64 scaled_width = (width + ratio - 1) / ratio;
+    const int64 decoded_y = crop_y / ratio;
+    const int64 decoded_x = crop_x / ratio;
+    const int64 decoded_height =
+        std::min(scaled_height, (crop_y + crop_height + ratio - 1) / ratio) -
+        decoded_y;
+    const int64 decoded_width =
+        std::min(scaled_width, (crop_x + crop_width + ratio - 1) / ratio) -
+        decoded_x;
+    if (decoded_height != scaled_height || decoded_width != scaled_width) {
+      flags.crop = true;
+      flags.crop_y = decoded_y;
+      flags.crop_x = decoded_x;
+      flags.crop_height = decoded_height;
+      flags.crop_width = decoded_width;
+    }
+
+    Tensor decoded;
+    uint8* buffer = jpeg::Uncompress(
+        input.data(), input.size(), flags, nullptr /* nwarn */,
+        [&](int w, int h, int c) -> uint8* {
+          Status status = context->allocate_temp(
+              DT_UINT8, TensorShape({h, w, c}), &decoded);
+          if (!status.ok()) {
+            VLOG(1) << status;
+            context->SetStatus(status);
+            return nullptr;
+          }
+          return decoded.flat<uint8>().data();
+        });
+    OP_REQUIRES(
+        context, buffer,
+        errors::InvalidArgument(
+            "jpeg::Uncompress failed. Invalid JPEG data or crop window."));
+    OP_REQUIRES(context,
+                decoded.dim_size(0) == decoded_height &&
+                    decoded.dim_size(1) == decoded_width &&
+                    decoded.dim_size(2) == num_channels,
+                errors::Internal("Unexpected decoded image shape ",
+                                 decoded.shape().DebugString()));
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({1, out_height, out_width, num_channels}),
+                       &output));
+
+    std::vector<Interpolation> ys;
+    std::vector<Interpolation> xs;
+    if (half_pixel_centers_) {
+      ComputeInterpolation(HalfPixelScaler(), out_height, crop_height,
+                           align_corners_, crop_y, ratio, decoded_y,
+                           decoded_height, &ys);
+      ComputeInterpolation(HalfPixelScaler(), out_width, crop_width,
+                           align_corners_, crop_x, ratio, decoded_x,
+                           decoded_width, &xs);
+    } else {
+      ComputeInterpolation(LegacyScaler(), out_height, crop_height,
+                           align_corners_, crop_y, ratio, decoded_y,
+                           decoded_height, &ys);
+      ComputeInterpolation(LegacyScaler(), out_width, crop_width,
+                           align_corners_, crop_x, ratio, decoded_x,
+                           decoded_width, &xs);
+    }
+    // Scale the column indices by the number of channels.
+    for (Interpolation& x : xs) {
+      x.lower *= num_channels;
+      x.upper *= num_channels;
+    }
+
+    const uint8* decoded_data = decoded.flat<uint8>().data();
+    float* output_data = output->flat<float>().data();
+    const int64 in_row_size = decoded_width * num_channels;
+    const int64 out_row_size = out_width * num_channels;
+    auto resize_rows = [&](int64 start, int64 end) {
+      for (int64 y = start; y < end; ++y) {
+        const uint8* lower_row = decoded_data + ys[y].lower * in_row_size;
+        const uint8* upper_row = decoded_data + ys[y].upper * in_row_size;
+        const float y_lerp = ys[y].lerp;
+        float* out = output_data + y * out_row_size;
+        for (int64 x = 0; x < out_width; ++x) {
+          const Interpolation& interp = xs[x];
+          for (int64 c = 0; c < num_channels; ++c) {
+            *out++ = ComputeLerp(lower_row[interp.lower + c],
+                                 lower_row[interp.upper + c],
+                                 upper_row[interp.lower + c],
+                                 upper_row[interp.upper + c], interp.lerp,
+                                 y_lerp);
+          }
+        }
+      }
+    };
+    const auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, out_height,
+          /*cost_per_unit=*/out_row_size * 10, resize_rows);
+  }
+
+ private:
+  int channels_;
+  bool align_corners_;
+  bool half_pixel_centers_;
+  jpeg::UncompressFlags flags_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("_DecodeAndResizeJpeg").Device(DEVICE_CPU),
+                        DecodeAndResizeJpegOp);
+
+}  // namespace tensorflow
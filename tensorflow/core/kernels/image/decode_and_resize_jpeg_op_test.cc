@@ -0,0 +1,219 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a JPEG encoded RGB image of smooth gradients, which the scaled IDCT
+// decodes close to a box filtering of the full resolution image.
+tstring GradientJpeg(int width, int height) {
+  std::vector<uint8> pixels(width * height * 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8* pixel = &pixels[(y * width + x) * 3];
+      pixel[0] = x * 255 / (width - 1);
+      pixel[1] = y * 255 / (height - 1);
+      pixel[2] = (x + y) * 255 / (width + height - 2);
+    }
+  }
+  jpeg::CompressFlags flags;
+  flags.format = jpeg::FORMAT_RGB;
+  flags.quality = 100;
+  flags.chroma_downsampling = false;
+  return jpeg::Compress(pixels.data(), width, height, flags);
+}
+
+// Decodes `contents` at full resolution, like DecodeJpeg, and resizes the
+// given crop window like ResizeBilinear with half pixel centers.
+Tensor DecodeCropAndResize(const tstring& contents, int crop_y, int crop_x,
+                           int crop_height, int crop_width, int out_height,
+                           int out_width) {
+  jpeg::UncompressFlags flags;
+  flags.components = 3;
+  flags.dct_method = JDCT_IFAST;
+  int width, height, channels;
+  std::unique_ptr<uint8[]> image(
+      jpeg::Uncompress(contents.data(), contents.size(), flags, &width,
+                       &height, &channels, nullptr /* nwarn */));
+  CHECK(image != nullptr);
+  auto pixel = [&](int64 y, int64 x, int c) -> float {
+    return image[((crop_y + y) * width + crop_x + x) * 3 + c];
+  };
+
+  Tensor output(DT_FLOAT, TensorShape({1, out_height, out_width, 3}));
+  auto out = output.tensor<float, 4>();
+  const float height_scale = crop_height / static_cast<float>(out_height);
+  const float width_scale = crop_width / static_cast<float>(out_width);
+  for (int64 y = 0; y < out_height; ++y) {
+    const float in_y = (y + 0.5f) * height_scale - 0.5f;
+    const int64 top = std::max(static_cast<int64>(std::floor(in_y)), int64{0});
+    const int64 bottom =
+        std::min(static_cast<int64>(std::ceil(in_y)), int64{crop_height - 1});
+    const float y_lerp = in_y - std::floor(in_y);
+    for (int64 x = 0; x < out_width; ++x) {
+      const float in_x = (x + 0.5f) * width_scale - 0.5f;
+      const int64 left =
+          std::max(static_cast<int64>(std::floor(in_x)), int64{0});
+      const int64 right =
+          std::min(static_cast<int64>(std::ceil(in_x)), int64{crop_width - 1});
+      const float x_lerp = in_x - std::floor(in_x);
+      for (int c = 0; c < 3; ++c) {
+        const float top_value =
+            pixel(top, left, c) +
+            (pixel(top, right, c) - pixel(top, left, c)) * x_lerp;
+        const float bottom_value =
+            pixel(bottom, left, c) +
+            (pixel(bottom, right, c) - pixel(bottom, left, c)) * x_lerp;
+        out(0, y, x, c) = top_value + (bottom_value - top_value) * y_lerp;
+      }
+    }
+  }
+  return output;
+}
+
+class DecodeAndResizeJpegOpTest : public OpsTestBase {
+ protected:
+  void MakeOp() {
+    TF_ASSERT_OK(NodeDefBuilder("decode_and_resize", "_DecodeAndResizeJpeg")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("channels", 3)
+                     .Attr("half_pixel_centers", true)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  Status Run(const tstring& contents, const std::vector<int32>& crop_begin,
+             const std::vector<int32>& crop_size, int out_height,
+             int out_width) {
+    AddInputFromArray<tstring>(TensorShape({}), {contents});
+    AddInputFromArray<int32>(
+        TensorShape({static_cast<int64>(crop_begin.size())}), crop_begin);
+    AddInputFromArray<int32>(
+        TensorShape({static_cast<int64>(crop_size.size())}), crop_size);
+    AddInputFromArray<int32>(TensorShape({2}), {out_height, out_width});
+    return RunOpKernel();
+  }
+};
+
+TEST_F(DecodeAndResizeJpegOpTest, FullResolution) {
+  // The output is larger than half of the image, which is thus decoded at
+  // full resolution, as DecodeJpeg does.
+  const tstring contents = GradientJpeg(64, 48);
+  MakeOp();
+  TF_ASSERT_OK(Run(contents, {}, {}, 30, 40));
+  test::ExpectTensorNear<float>(
+      DecodeCropAndResize(contents, 0, 0, 48, 64, 30, 40), *GetOutput(0),
+      1e-4);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, ScaledDecode) {
+  // Decoded at 1/8 scale.
+  const tstring contents = GradientJpeg(256, 192);
+  MakeOp();
+  TF_ASSERT_OK(Run(contents, {}, {}, 24, 32));
+  test::ExpectTensorNear<float>(
+      DecodeCropAndResize(contents, 0, 0, 192, 256, 24, 32), *GetOutput(0),
+      6.0);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, ScaledDecodeOfCropWindow) {
+  // The crop window is decoded at 1/4 scale.
+  const tstring contents = GradientJpeg(256, 192);
+  MakeOp();
+  TF_ASSERT_OK(Run(contents, {13, 7, 0}, {150, -1, -1}, 37, 50));
+  test::ExpectTensorNear<float>(
+      DecodeCropAndResize(contents, 13, 7, 150, 249, 37, 50), *GetOutput(0),
+      6.0);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, InvalidCropWindow) {
+  const tstring contents = GradientJpeg(64, 48);
+  MakeOp();
+  const Status status = Run(contents, {40, 0, 0}, {16, 16, -1}, 8, 8);
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+// Decodes a 1024x768 image and resizes it to 224x224, with or without the
+// fused op.
+Graph* DecodeAndResizeGraph(bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor contents(DT_STRING, TensorShape({}));
+  contents.scalar<tstring>()() = GradientJpeg(1024, 768);
+  Tensor size(DT_INT32, TensorShape({2}));
+  size.flat<int32>().setConstant(224);
+  Node* resize;
+  if (fused) {
+    Tensor empty(DT_INT32, TensorShape({0}));
+    TF_CHECK_OK(NodeBuilder(g->NewName("decode_and_resize"),
+                            "_DecodeAndResizeJpeg")
+                    .Input(test::graph::Constant(g, contents))
+                    .Input(test::graph::Constant(g, empty))
+                    .Input(test::graph::Constant(g, empty))
+                    .Input(test::graph::Constant(g, size))
+                    .Attr("channels", 3)
+                    .Attr("half_pixel_centers", true)
+                    .Finalize(g, &resize));
+  } else {
+    Node* decode;
+    TF_CHECK_OK(NodeBuilder(g->NewName("decode"), "DecodeJpeg")
+                    .Input(test::graph::Constant(g, contents))
+                    .Attr("channels", 3)
+                    .Finalize(g, &decode));
+    Node* expand_dims;
+    TF_CHECK_OK(NodeBuilder(g->NewName("expand_dims"), "ExpandDims")
+                    .Input(decode)
+                    .Input(test::graph::Constant(g, test::AsScalar<int32>(0)))
+                    .Finalize(g, &expand_dims));
+    TF_CHECK_OK(NodeBuilder(g->NewName("resize"), "ResizeBilinear")
+                    .Input(expand_dims)
+                    .Input(test::graph::Constant(g, size))
+                    .Attr("half_pixel_centers", true)
+                    .Finalize(g, &resize));
+  }
+  return g;
+}
+
+void BM_DecodeJpegAndResize(::testing::benchmark::State& state) {
+  const bool fused = state.range(0);
+  test::Benchmark("cpu", DecodeAndResizeGraph(fused),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  // Images per second.
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeJpegAndResize)->UseRealTime()->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace tensorflow
@@ -27,6 +27,7 @@ limitations under the License.
 #endif
 
 #include <memory>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -218,16 +219,93 @@ void ResizeLine3ChannelsVector(const T* const ys_input_lower_ptr,
 }
 #endif
 
+template <typename T>
+void ResizeLine(const T* const ys_input_lower_ptr,
+                const T* const ys_input_upper_ptr,
+                const CachedInterpolation* const xs, const float ys_lerp,
+                const int64 out_width, const int channels, float* out_y) {
+  for (int64 x = 0; x < out_width; ++x) {
+    auto xs_lower = xs[x].lower;
+    auto xs_upper = xs[x].upper;
+    auto xs_lerp = xs[x].lerp;
+    for (int c = 0; c < channels; ++c) {
+      const float top_left(ys_input_lower_ptr[xs_lower + c]);
+      const float top_right(ys_input_lower_ptr[xs_upper + c]);
+      const float bottom_left(ys_input_upper_ptr[xs_lower + c]);
+      const float bottom_right(ys_input_upper_ptr[xs_upper + c]);
+      out_y[x * channels + c] = compute_lerp(top_left, top_right, bottom_left,
+                                             bottom_right, xs_lerp, ys_lerp);
+    }
+  }
+}
+
+// Interpolates the input row `in_row` at the cached horizontal positions `xs`:
+// out_row[x * channels + c] is the linear interpolation between the values of
+// channel c at xs[x].lower and xs[x].upper.
+template <typename T>
+void InterpolateRow(const T* const in_row, const CachedInterpolation* const xs,
+                    const int64 out_width, const int channels,
+                    float* out_row) {
+  if (channels == 3) {
+    int64 x = 0;
+#ifdef __SSE4_1__
+    // Each vector store overflows into the next pixel, which is written
+    // afterwards, so the last pixel of the row is interpolated in a
+    // non-vectorized way.
+    for (; x < out_width - 1; ++x) {
+      const __m128 left_v = load_3xfloat_v(in_row + xs[x].lower);
+      const __m128 right_v = load_3xfloat_v(in_row + xs[x].upper);
+      const __m128 lerp_v = _mm_set1_ps(xs[x].lerp);
+      _mm_storeu_ps(out_row + x * 3,
+                    _mm_add_ps(left_v, _mm_mul_ps(_mm_sub_ps(right_v, left_v),
+                                                  lerp_v)));
+    }
+#endif
+    for (; x < out_width; ++x) {
+      const T* const left = in_row + xs[x].lower;
+      const T* const right = in_row + xs[x].upper;
+      const float lerp = xs[x].lerp;
+      for (int c = 0; c < 3; ++c) {
+        const float left_c(left[c]);
+        const float right_c(right[c]);
+        out_row[x * 3 + c] = left_c + (right_c - left_c) * lerp;
+      }
+    }
+  } else {
+    for (int64 x = 0; x < out_width; ++x) {
+      const T* const left = in_row + xs[x].lower;
+      const T* const right = in_row + xs[x].upper;
+      const float lerp = xs[x].lerp;
+      for (int c = 0; c < channels; ++c) {
+        const float left_c(left[c]);
+        const float right_c(right[c]);
+        out_row[x * channels + c] = left_c + (right_c - left_c) * lerp;
+      }
+    }
+  }
+}
+
+// Interpolates vertically between two horizontally interpolated rows.
+inline void InterpolateColumns(const float* const top,
+                               const float* const bottom, const float lerp,
+                               const int64 size, float* out) {
+  TTypes<float>::UnalignedConstFlat top_row(top, size);
+  TTypes<float>::UnalignedConstFlat bottom_row(bottom, size);
+  TTypes<float>::UnalignedFlat out_row(out, size);
+  out_row = top_row + (bottom_row - top_row) * lerp;
+}
+
 template <typename T>
 void resize_image(
-    typename TTypes<T, 4>::ConstTensor images, const int batch_size,
-    const int64 in_height, const int64 in_width, const int64 out_height,
-    const int64 out_width, const int channels,
+    const CPUDevice& d, typename TTypes<T, 4>::ConstTensor images,
+    const int batch_size, const int64 in_height, const int64 in_width,
+    const int64 out_height, const int64 out_width, const int channels,
     const std::vector<CachedInterpolation>& xs,
     const std::vector<CachedInterpolation>& ys,
     typename TTypes<float, 4>::Tensor output) TF_ATTRIBUTE_NOINLINE;
 template <typename T>
-void resize_image(typename TTypes<T, 4>::ConstTensor images,
+void resize_image(const CPUDevice& d,
+                  typename TTypes<T, 4>::ConstTensor images,
                   const int batch_size, const int64 in_height,
                   const int64 in_width, const int64 out_height,
                   const int64 out_width, const int channels,
@@ -235,18 +313,51 @@ void resize_image(typename TTypes<T, 4>::ConstTensor images,
                   const std::vector<CachedInterpolation>& ys,
                   typename TTypes<float, 4>::Tensor output) {
   const int64 in_row_size = in_width * channels;
-  const int64 in_batch_num_values = in_height * in_row_size;
   const int64 out_row_size = out_width * channels;
 
-  const T* input_b_ptr = images.data();
+  const T* input_ptr = images.data();
+  float* output_ptr = output.data();
   const CachedInterpolation* xs = xs_vec.data();
 
-  if (channels == 3) {
-    float* output_y_ptr = output.data();
-    for (int b = 0; b < batch_size; ++b) {
-      for (int64 y = 0; y < out_height; ++y) {
-        const T* ys_input_lower_ptr = input_b_ptr + ys[y].lower * in_row_size;
-        const T* ys_input_upper_ptr = input_b_ptr + ys[y].upper * in_row_size;
+  // When upscaling, consecutive output rows share their input rows. The
+  // interpolation is then done in two passes: each input row is interpolated
+  // horizontally once, and each output row is interpolated vertically between
+  // its two horizontally interpolated rows. Each shard caches the last two of
+  // them, indexed over the whole batch. Otherwise, each output row is
+  // interpolated directly from its input rows.
+  const bool separable = out_height > in_height;
+  auto resize_rows = [&](int64 start, int64 limit) {
+    std::vector<float> buffer(2 * out_row_size);
+    float* cached[2] = {buffer.data(), buffer.data() + out_row_size};
+    int64 cached_index[2] = {-1, -1};
+    // Returns the horizontal interpolation of the input row `index`, without
+    // evicting the row `keep` from the cache.
+    auto interpolated_row = [&](int64 index, int64 keep) -> const float* {
+      for (int i = 0; i < 2; ++i) {
+        if (cached_index[i] == index) return cached[i];
+      }
+      const int i = cached_index[0] == keep ? 1 : 0;
+      InterpolateRow(input_ptr + index * in_row_size, xs, out_width, channels,
+                     cached[i]);
+      cached_index[i] = index;
+      return cached[i];
+    };
+    for (int64 i = start; i < limit; ++i) {
+      const int64 b = i / out_height;
+      const int64 y = i % out_height;
+      const int64 lower = b * in_height + ys[y].lower;
+      const int64 upper = b * in_height + ys[y].upper;
+      float* output_y_ptr = output_ptr + i * out_row_size;
+      if (separable) {
+        const float* top = interpolated_row(lower, upper);
+        const float* bottom = interpolated_row(upper, lower);
+        InterpolateColumns(top, bottom, ys[y].lerp, out_row_size,
+                           output_y_ptr);
+        continue;
+      }
+      const T* ys_input_lower_ptr = input_ptr + lower * in_row_size;
+      const T* ys_input_upper_ptr = input_ptr + upper * in_row_size;
+      if (channels == 3) {
 #ifdef __SSE4_1__
         ResizeLine3ChannelsVector(ys_input_lower_ptr, ys_input_upper_ptr, xs,
                                   ys[y].lerp, out_width, output_y_ptr);
@@ -254,36 +365,18 @@ void resize_image(typename TTypes<T, 4>::ConstTensor images,
         ResizeLine3Channels(ys_input_lower_ptr, ys_input_upper_ptr, xs,
                             ys[y].lerp, out_width, output_y_ptr);
 #endif
-        output_y_ptr += out_row_size;
+      } else {
+        ResizeLine(ys_input_lower_ptr, ys_input_upper_ptr, xs, ys[y].lerp,
+                   out_width, channels, output_y_ptr);
       }
-      input_b_ptr += in_batch_num_values;
     }
-  } else {
-    float* output_y_ptr = output.data();
-    for (int b = 0; b < batch_size; ++b) {
-      for (int64 y = 0; y < out_height; ++y) {
-        const T* ys_input_lower_ptr = input_b_ptr + ys[y].lower * in_row_size;
-        const T* ys_input_upper_ptr = input_b_ptr + ys[y].upper * in_row_size;
-        const float ys_lerp = ys[y].lerp;
-        for (int64 x = 0; x < out_width; ++x) {
-          auto xs_lower = xs[x].lower;
-          auto xs_upper = xs[x].upper;
-          auto xs_lerp = xs[x].lerp;
-          for (int c = 0; c < channels; ++c) {
-            const float top_left(ys_input_lower_ptr[xs_lower + c]);
-            const float top_right(ys_input_lower_ptr[xs_upper + c]);
-            const float bottom_left(ys_input_upper_ptr[xs_lower + c]);
-            const float bottom_right(ys_input_upper_ptr[xs_upper + c]);
-            output_y_ptr[x * channels + c] =
-                compute_lerp(top_left, top_right, bottom_left, bottom_right,
-                             xs_lerp, ys_lerp);
-          }
-        }
-        output_y_ptr += out_row_size;
-      }
-      input_b_ptr += in_batch_num_values;
-    }
-  }
+  };
+  const Eigen::TensorOpCost cost(
+      2 * out_row_size * sizeof(T), out_row_size * sizeof(float),
+      out_row_size * (2 * Eigen::TensorOpCost::CastCost<T, float>() +
+                      3 * Eigen::TensorOpCost::AddCost<float>() +
+                      2 * Eigen::TensorOpCost::MulCost<float>()));
+  d.parallelFor(batch_size * out_height, cost, resize_rows);
 }
 
 // Casts from float16 to T.
@@ -352,7 +445,7 @@ struct ResizeBilinear<CPUDevice, T> {
       xs[i].upper *= channels;
     }
 
-    resize_image<T>(images, batch_size, in_height, in_width, out_height,
+    resize_image<T>(d, images, batch_size, in_height, in_width, out_height,
                     out_width, channels, xs, ys, output);
   }
 };
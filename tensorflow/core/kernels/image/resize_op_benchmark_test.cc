@@ -21,16 +21,17 @@ limitations under the License.
 
 namespace tensorflow {
 
-static Graph* Resize(const char* algorithm, int batches, int width,
-                     int height) {
+template <typename T>
+static Graph* Resize(const char* algorithm, int batches, int width, int height,
+                     int out_width, int out_height) {
   Graph* g = new Graph(OpRegistry::Global());
-  Tensor in(DT_FLOAT, TensorShape({batches, width, height, 3}));
-  in.flat<float>().setRandom();
+  Tensor in(DataTypeToEnum<T>::value, TensorShape({batches, width, height, 3}));
+  in.flat<T>().setRandom();
 
   Tensor out_size(DT_INT32, TensorShape({2}));
   auto out_size_flat = out_size.flat<int32>();
-  out_size_flat(0) = width * 2;
-  out_size_flat(1) = height * 2;
+  out_size_flat(0) = out_width;
+  out_size_flat(1) = out_height;
 
   Node* ret;
   Status s = NodeBuilder(g->NewName("n"), algorithm)
@@ -41,6 +42,13 @@ static Graph* Resize(const char* algorithm, int batches, int width,
   return g;
 }
 
+// Upscales float images by 2.
+static Graph* Resize(const char* algorithm, int batches, int width,
+                     int height) {
+  return Resize<float>(algorithm, batches, width, height, width * 2,
+                       height * 2);
+}
+
 #define BM_ResizeDev(DEVICE, ALGORITHM, B, W, H)                  \
   static void BM_Resize_##ALGORITHM##_##DEVICE##_##B##_##W##_##H( \
       ::testing::benchmark::State& state) {                       \
@@ -59,4 +67,22 @@ BM_ResizeDev(gpu, ResizeNearestNeighbor, 10, 499, 499);
 BM_ResizeDev(gpu, ResizeBilinear, 10, 499, 499);
 #endif
 
+// Resizes uint8 images, as decoded from image files, to an arbitrary size.
+#define BM_ResizeUint8Dev(DEVICE, ALGORITHM, B, W, H, OW, OH)                 \
+  static void                                                                 \
+      BM_ResizeUint8_##ALGORITHM##_##DEVICE##_##B##_##W##_##H##_##OW##_##OH(  \
+          ::testing::benchmark::State& state) {                               \
+    test::Benchmark(#DEVICE, Resize<uint8>(#ALGORITHM, B, W, H, OW, OH),      \
+                    /*old_benchmark_api*/ false)                              \
+        .Run(state);                                                          \
+    state.SetItemsProcessed(state.iterations() * B * W * H * 3);              \
+  }                                                                           \
+  BENCHMARK(                                                                  \
+      BM_ResizeUint8_##ALGORITHM##_##DEVICE##_##B##_##W##_##H##_##OW##_##OH)
+
+BM_ResizeUint8Dev(cpu, ResizeBilinear, 10, 499, 499, 998, 998);
+BM_ResizeUint8Dev(cpu, ResizeBilinear, 10, 224, 224, 299, 299);
+BM_ResizeUint8Dev(cpu, ResizeBilinear, 10, 1024, 768, 224, 224);
+BM_ResizeUint8Dev(cpu, ResizeBilinear, 1, 1024, 768, 224, 224);
+
 }  // namespace tensorflow
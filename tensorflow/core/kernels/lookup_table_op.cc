@@ -16,25 +16,135 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
+#include "absl/hash/hash.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
 
-// Lookup table that wraps an unordered_map, where the key and value data type
-// is specified. Each individual value must be a scalar. If vector values are
-// required, use MutableHashTableOfTensors.
+namespace {
+
+// Number of independently locked shards backing MutableHashTableOfScalars and
+// MutableHashTableOfTensors. Concurrent Find calls only contend on the shared
+// side of a shard lock, and Insert/Remove calls only block the shards that
+// own the keys they touch.
+constexpr int kNumMutableHashTableShards = 16;
+
+// Number of keys whose value rows are resolved and prefetched together by
+// MutableHashTableOfTensors::Find before the rows are copied out.
+constexpr int kMutableHashTablePrefetchBatch = 8;
+
+// Approximate number of cycles spent per key on a hash table probe. Used to
+// decide how many worker threads a batch of keys is spread over.
+constexpr int64 kMutableHashTableCostPerKey = 100;
+
+// Hash function used for the mutable hash tables. absl::Hash does not support
+// tstring, which is hashed with the same function as the rest of TensorFlow.
+template <typename K>
+struct MutableHashTableHash {
+  size_t operator()(const K& key) const { return absl::Hash<K>()(key); }
+};
+
+template <>
+struct MutableHashTableHash<tstring> {
+  size_t operator()(const tstring& key) const {
+    return static_cast<size_t>(Hash64(key.data(), key.size()));
+  }
+};
+
+// Returns the shard owning `key`. The hash is remixed so that the shard index
+// is independent of the bits the per-shard table uses to place the key.
+template <typename K>
+inline int MutableHashTableShard(const K& key) {
+  const uint64 hash = MutableHashTableHash<K>()(key);
+  return static_cast<int>((hash * 0x9E3779B97F4A7C15ULL) >> 60) &
+         (kNumMutableHashTableShards - 1);
+}
+
+// Positions of a batch of keys, grouped by the shard that owns them. The
+// positions of the keys owned by shard `s` are
+// `order[offsets[s]] ... order[offsets[s + 1] - 1]`, in increasing order so
+// that the last of several duplicate keys in an Insert wins, as it would if
+// the keys were inserted sequentially.
+struct KeysByShard {
+  std::vector<int64> order;
+  std::array<int64, kNumMutableHashTableShards + 1> offsets;
+};
+
+template <typename K>
+void GroupKeysByShard(typename TTypes<K>::ConstFlat keys,
+                      KeysByShard* grouping) {
+  const int64 num_keys = keys.size();
+  std::vector<uint8> shard_of(num_keys);
+  grouping->offsets.fill(0);
+  for (int64 i = 0; i < num_keys; ++i) {
+    shard_of[i] = MutableHashTableShard<K>(keys(i));
+    ++grouping->offsets[shard_of[i] + 1];
+  }
+  for (int s = 0; s < kNumMutableHashTableShards; ++s) {
+    grouping->offsets[s + 1] += grouping->offsets[s];
+  }
+  std::array<int64, kNumMutableHashTableShards> next;
+  std::copy_n(grouping->offsets.begin(), kNumMutableHashTableShards,
+              next.begin());
+  grouping->order.resize(num_keys);
+  for (int64 i = 0; i < num_keys; ++i) {
+    grouping->order[next[shard_of[i]]++] = i;
+  }
+}
+
+// Calls `fn(s)` for every shard `s`, in parallel on the CPU worker threads of
+// `ctx` when the batch is large enough to amortize the scheduling overhead.
+void ForEachMutableHashTableShard(OpKernelContext* ctx, int64 num_keys,
+                                  int64 cost_per_key,
+                                  const std::function<void(int)>& fn) {
+  auto work = [&fn](int64 begin, int64 end) {
+    for (int64 s = begin; s < end; ++s) {
+      fn(static_cast<int>(s));
+    }
+  };
+  if (ctx == nullptr || ctx->device() == nullptr ||
+      ctx->device()->tensorflow_cpu_worker_threads() == nullptr) {
+    work(0, kNumMutableHashTableShards);
+    return;
+  }
+  const auto* worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  const int64 cost_per_shard = std::max<int64>(
+      1, num_keys / kNumMutableHashTableShards * cost_per_key);
+  Shard(worker_threads->num_threads, worker_threads->workers,
+        kNumMutableHashTableShards, cost_per_shard, work);
+}
+
+}  // namespace
+
+// Lookup table backed by a sharded open-addressing hash map, where the key and
+// value data type is specified. Each individual value must be a scalar. If
+// vector values are required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
+// Every shard is protected by its own reader-writer lock, so lookups never
+// block each other and updates only block the shards they modify. Batches of
+// keys are processed shard by shard on the device's worker threads. Updates of
+// a batch of keys are therefore only atomic within each shard: a concurrent
+// Find may observe some keys of an Insert or Remove already updated and
+// others not yet.
 //
 // Sample use case:
 //
@@ -50,8 +160,12 @@ class MutableHashTableOfScalars final : public LookupInterface {
   MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
 
   size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
+    size_t total = 0;
+    for (const TableShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      total += shard.table.size();
+    }
+    return total;
   }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
@@ -64,60 +178,101 @@ class MutableHashTableOfScalars final : public LookupInterface {
     int64 default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      // is_full_size_default is true:
-      //   Each key has an independent default value, key_values(i)
-      //   corresponding uses default_flat(i) as its default value.
-      //
-      // is_full_size_default is false:
-      //   All keys will share the default_flat(0) as default value.
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)),
-          is_full_size_default ? default_flat(i) : default_flat(0));
-    }
+    KeysByShard grouping;
+    GroupKeysByShard<K>(key_values, &grouping);
+    ForEachMutableHashTableShard(
+        ctx, key_values.size(), kMutableHashTableCostPerKey, [&](int s) {
+          const TableShard& shard = shards_[s];
+          tf_shared_lock l(shard.mu);
+          for (int64 k = grouping.offsets[s]; k < grouping.offsets[s + 1];
+               ++k) {
+            const int64 i = grouping.order[k];
+            // is_full_size_default is true:
+            //   Each key has an independent default value, key_values(i)
+            //   corresponding uses default_flat(i) as its default value.
+            //
+            // is_full_size_default is false:
+            //   All keys will share the default_flat(0) as default value.
+            value_values(i) = gtl::FindWithDefault(
+                shard.table, SubtleMustCopyIfIntegral(key_values(i)),
+                is_full_size_default ? default_flat(i) : default_flat(0));
+          }
+        });
 
     return Status::OK();
   }
 
-  Status DoInsert(bool clear, const Tensor& keys, const Tensor& values) {
+  Status DoInsert(OpKernelContext* ctx, bool clear, const Tensor& keys,
+                  const Tensor& values) {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          SubtleMustCopyIfIntegral(value_values(i)));
-    }
+    KeysByShard grouping;
+    GroupKeysByShard<K>(key_values, &grouping);
+    ForEachMutableHashTableShard(
+        ctx, key_values.size(), kMutableHashTableCostPerKey, [&](int s) {
+          TableShard& shard = shards_[s];
+          mutex_lock l(shard.mu);
+          if (clear) {
+            shard.table.clear();
+          }
+          for (int64 k = grouping.offsets[s]; k < grouping.offsets[s + 1];
+               ++k) {
+            const int64 i = grouping.order[k];
+            gtl::InsertOrUpdate(&shard.table,
+                                SubtleMustCopyIfIntegral(key_values(i)),
+                                SubtleMustCopyIfIntegral(value_values(i)));
+          }
+        });
     return Status::OK();
   }
 
   Status Insert(OpKernelContext* ctx, const Tensor& keys,
                 const Tensor& values) override {
-    return DoInsert(false, keys, values);
+    return DoInsert(ctx, false, keys, values);
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    KeysByShard grouping;
+    GroupKeysByShard<K>(key_values, &grouping);
+    ForEachMutableHashTableShard(
+        ctx, key_values.size(), kMutableHashTableCostPerKey, [&](int s) {
+          TableShard& shard = shards_[s];
+          mutex_lock l(shard.mu);
+          for (int64 k = grouping.offsets[s]; k < grouping.offsets[s + 1];
+               ++k) {
+            shard.table.erase(
+                SubtleMustCopyIfIntegral(key_values(grouping.order[k])));
+          }
+        });
     return Status::OK();
   }
 
   Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
                       const Tensor& values) override {
-    return DoInsert(true, keys, values);
+    return DoInsert(ctx, true, keys, values);
   }
 
-  Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64 size = table_.size();
+  Status ExportValues(OpKernelContext* ctx) override
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    // All shards stay locked while they are streamed out in parallel, so that
+    // the exported keys and values form a consistent snapshot.
+    for (TableShard& shard : shards_) {
+      shard.mu.lock_shared();
+    }
+    auto unlock = gtl::MakeCleanup([this]() TF_NO_THREAD_SAFETY_ANALYSIS {
+      for (TableShard& shard : shards_) {
+        shard.mu.unlock_shared();
+      }
+    });
+    std::array<int64, kNumMutableHashTableShards + 1> offsets;
+    offsets[0] = 0;
+    for (int s = 0; s < kNumMutableHashTableShards; ++s) {
+      offsets[s + 1] = offsets[s] + shards_[s].table.size();
+    }
+    int64 size = offsets[kNumMutableHashTableShards];
 
     Tensor* keys;
     Tensor* values;
@@ -128,11 +283,16 @@ class MutableHashTableOfScalars final : public LookupInterface {
 
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
-    }
+    ForEachMutableHashTableShard(
+        ctx, size, kMutableHashTableCostPerKey,
+        [&](int s) TF_NO_THREAD_SAFETY_ANALYSIS {
+          int64 i = offsets[s];
+          for (const auto& entry : shards_[s].table) {
+            keys_data(i) = entry.first;
+            values_data(i) = entry.second;
+            ++i;
+          }
+        });
     return Status::OK();
   }
 
@@ -146,25 +306,27 @@ class MutableHashTableOfScalars final : public LookupInterface {
 
   int64 MemoryUsed() const override {
     int64 ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
+    for (const TableShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      // One control byte per slot in addition to the slot itself.
+      ret += shard.table.capacity() * (sizeof(std::pair<K, V>) + 1);
     }
     return sizeof(MutableHashTableOfScalars) + ret;
   }
 
  private:
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  struct TableShard {
+    mutable mutex mu;
+    absl::flat_hash_map<K, V, MutableHashTableHash<K>> table
+        TF_GUARDED_BY(mu);
+  };
+  std::array<TableShard, kNumMutableHashTableShards> shards_;
 };
 
-// Lookup table that wraps an unordered_map. Behaves identical to
-// MutableHashTableOfScalars except that each value must be a vector.
+// Lookup table backed by a sharded open-addressing hash map. Behaves identical
+// to MutableHashTableOfScalars except that each value must be a vector. The
+// values of every shard are stored contiguously, one row per key, and the
+// hash map only holds the row index of each key.
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
  public:
@@ -178,8 +340,12 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
+    size_t total = 0;
+    for (const TableShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      total += shard.table.size();
+    }
+    return total;
   }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
@@ -193,55 +359,349 @@ class MutableHashTableOfTensors final : public LookupInterface {
     int64 default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
-      if (value_vec != nullptr) {
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) = value_vec->at(j);
-        }
-      } else {
-        // is_full_size_default is true:
-        //   Each key has an independent default value, key_values(i)
-        //   corresponding uses default_flat(i) as its default value.
-        //
-        // is_full_size_default is false:
-        //   All keys will share the default_flat(0) as default value.
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) =
-              is_full_size_default ? default_flat(i, j) : default_flat(0, j);
-        }
-      }
-    }
+    KeysByShard grouping;
+    GroupKeysByShard<K>(key_values, &grouping);
+    ForEachMutableHashTableShard(
+        ctx, key_values.size(), kMutableHashTableCostPerKey + value_dim,
+        [&](int s) {
+          const TableShard& shard = shards_[s];
+          tf_shared_lock l(shard.mu);
+          const V* rows = shard.values.data();
+          int64 found_rows[kMutableHashTablePrefetchBatch];
+          for (int64 batch_begin = grouping.offsets[s];
+               batch_begin < grouping.offsets[s + 1];
+               batch_begin += kMutableHashTablePrefetchBatch) {
+            const int64 batch_end =
+                std::min(batch_begin + kMutableHashTablePrefetchBatch,
+                         grouping.offsets[s + 1]);
+            // Resolve the rows of the whole batch first and prefetch them, so
+            // that the copies below overlap the cache misses of several rows.
+            for (int64 k = batch_begin; k < batch_end; ++k) {
+              const int64* row = gtl::FindOrNull(
+                  shard.table,
+                  SubtleMustCopyIfIntegral(key_values(grouping.order[k])));
+              found_rows[k - batch_begin] = row == nullptr ? -1 : *row;
+              if (row != nullptr) {
+                port::prefetch<port::PREFETCH_HINT_T0>(rows +
+                                                       *row * value_dim);
+              }
+            }
+            for (int64 k = batch_begin; k < batch_end; ++k) {
+              const int64 i = grouping.order[k];
+              const int64 row = found_rows[k - batch_begin];
+              if (row >= 0) {
+                const V* value_row = rows + row * value_dim;
+                for (int64 j = 0; j < value_dim; j++) {
+                  value_values(i, j) = value_row[j];
+                }
+              } else {
+                // is_full_size_default is true:
+                //   Each key has an independent default value, key_values(i)
+                //   corresponding uses default_flat(i) as its default value.
+                //
+                // is_full_size_default is false:
+                //   All keys will share the default_flat(0) as default value.
+                for (int64 j = 0; j < value_dim; j++) {
+                  value_values(i, j) = is_full_size_default
+                                           ? default_flat(i, j)
+                                           : default_flat(0, j);
+                }
+              }
+            }
+          }
+        });
 
     return Status::OK();
   }
 
-  Status DoInsert(bool clear, const Tensor& keys, const Tensor& values) {
+  Status DoInsert(OpKernelContext* ctx, bool clear, const Tensor& keys,
+                  const Tensor& values) {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64 value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
+    KeysByShard grouping;
+    GroupKeysByShard<K>(key_values, &grouping);
+    ForEachMutableHashTableShard(
+        ctx, key_values.size(), kMutableHashTableCostPerKey + value_dim,
+        [&](int s) {
+          TableShard& shard = shards_[s];
+          mutex_lock l(shard.mu);
+          if (clear) {
+            shard.table.clear();
+            shard.values.clear();
+            shard.free_rows.clear();
+          }
+          for (int64 k = grouping.offsets[s]; k < grouping.offsets[s + 1];
+               ++k) {
+            const int64 i = grouping.order[k];
+            auto inserted = shard.table.emplace(
+                SubtleMustCopyIfIntegral(key_values(i)), 0);
+            if (inserted.second) {
+              if (value_dim == 0) {
+                // Empty values all share the empty row 0.
+                inserted.first->second = 0;
+              } else if (shard.free_rows.empty()) {
+                inserted.first->second = shard.values.size() / value_dim;
+                shard.values.resize(shard.values.size() + value_dim);
+              } else {
+                inserted.first->second = shard.free_rows.back();
+                shard.free_rows.pop_back();
+              }
+            }
+            V* value_row =
+                shard.values.data() + inserted.first->second * value_dim;
+            for (int64 j = 0; j < value_dim; j++) {
+              value_row[j] = value_values(i, j);
+            }
+          }
+        });
+    return Status::OK();
+  }
+
+  Status Insert(OpKernelContext* ctx, const Tensor& keys,
+                const Tensor& values) override {
+    return DoInsert(ctx, false, keys, values);
+  }
+
+  Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
+    const auto key_values = keys.flat<K>();
+    const int64 value_dim = value_shape_.dim_size(0);
+
+    KeysByShard grouping;
+    GroupKeysByShard<K>(key_values, &grouping);
+    ForEachMutableHashTableShard(
+        ctx, key_values.size(), kMutableHashTableCostPerKey, [&](int s) {
+          TableShard& shard = shards_[s];
+          mutex_lock l(shard.mu);
+          for (int64 k = grouping.offsets[s]; k < grouping.offsets[s + 1];
+               ++k) {
+            auto it = shard.table.find(
+                SubtleMustCopyIfIntegral(key_values(grouping.order[k])));
+            if (it != shard.table.end()) {
+              if (value_dim > 0) shard.free_rows.push_back(it->second);
+              shard.table.erase(it);
+            }
+          }
+        });
+    return Status::OK();
+  }
+
+  Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
+                      const Tensor& values) override {
+    return DoInsert(ctx, true, keys, values);
+  }
+
+  Status ExportValues(OpKernelContext* ctx) override
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    // All shards stay locked while they are streamed out in parallel, so that
+    // the exported keys and values form a consistent snapshot.
+    for (TableShard& shard : shards_) {
+      shard.mu.lock_shared();
     }
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      ValueArray value_vec;
-      for (int64 j = 0; j < value_dim; j++) {
-        V value = value_values(i, j);
-        value_vec.push_back(value);
+    auto unlock = gtl::MakeCleanup([this]() TF_NO_THREAD_SAFETY_ANALYSIS {
+      for (TableShard& shard : shards_) {
+        shard.mu.unlock_shared();
+      }
+    });
+    std::array<int64, kNumMutableHashTableShards + 1> offsets;
+    offsets[0] = 0;
+    for (int s = 0; s < kNumMutableHashTableShards; ++s) {
+      offsets[s + 1] = offsets[s] + shards_[s].table.size();
+    }
+    int64 size = offsets[kNumMutableHashTableShards];
+    int64 value_dim = value_shape_.dim_size(0);
+
+    Tensor* keys;
+    Tensor* values;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("keys", TensorShape({size}), &keys));
+    TF_RETURN_IF_ERROR(ctx->allocate_output(
+        "values", TensorShape({size, value_dim}), &values));
+
+    auto keys_data = keys->flat<K>();
+    auto values_data = values->matrix<V>();
+    ForEachMutableHashTableShard(
+        ctx, size, kMutableHashTableCostPerKey + value_dim,
+        [&](int s) TF_NO_THREAD_SAFETY_ANALYSIS {
+          const TableShard& shard = shards_[s];
+          int64 i = offsets[s];
+          for (const auto& entry : shard.table) {
+            keys_data(i) = entry.first;
+            const V* value_row = shard.values.data() + entry.second * value_dim;
+            for (int64 j = 0; j < value_dim; j++) {
+              values_data(i, j) = value_row[j];
+            }
+            ++i;
+          }
+        });
+    return Status::OK();
+  }
+
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+
+  DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
+
+  TensorShape key_shape() const final { return TensorShape(); }
+
+  TensorShape value_shape() const override { return value_shape_; }
+
+  int64 MemoryUsed() const override {
+    int64 ret = 0;
+    for (const TableShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      // One control byte per slot in addition to the slot itself.
+      ret += shard.table.capacity() * (sizeof(std::pair<K, int64>) + 1) +
+             shard.values.capacity() * sizeof(V) +
+             shard.free_rows.capacity() * sizeof(int64);
+    }
+    return sizeof(MutableHashTableOfTensors) + ret;
+  }
+
+ private:
+  // Row-major [num_rows, value_dim] storage. gtl::InlinedVector is used rather
+  // than std::vector because the latter does not store bools contiguously.
+  typedef gtl::InlinedVector<V, 4> ValueArray;
+
+  struct TableShard {
+    mutable mutex mu;
+    // Maps every key of the shard to the row of `values` holding its value.
+    absl::flat_hash_map<K, int64, MutableHashTableHash<K>> table
+        TF_GUARDED_BY(mu);
+    ValueArray values TF_GUARDED_BY(mu);
+    // Rows of `values` released by Remove, reused by subsequent inserts.
+    std::vector<int64> free_rows TF_GUARDED_BY(mu);
+  };
+
+  TensorShape value_shape_;
+  std::array<TableShard, kNumMutableHashTableShards> shards_;
+};
+
+// Lookup table for embeddings that bounds its own size. A key is only admitted
+// into the table once it has been inserted `min_frequency` times; until then
+// its insert count is tracked approximately in a count-min sketch and the
+// inserted values are dropped, so long-tail keys never take up a row. Every
+// admitted key records how often it was inserted and the step it was last
+// inserted at, where a step is one call to Insert. Keys that have not been
+// inserted for more than `max_idle_steps` steps are treated as absent and
+// evicted, and whenever the table grows beyond `max_size` keys the least
+// frequently inserted keys are evicted. The keys inserted by the current step
+// are evicted last, and the frequencies of all keys are halved after every
+// eviction, so that new keys can displace keys that are no longer hot.
+//
+// Values may be scalars or vectors. Like MutableHashTableOfTensors the values
+// are stored in one contiguous buffer, one row per key.
+template <class K, class V>
+class MutableEvictingHashTable final : public LookupInterface {
+ public:
+  MutableEvictingHashTable(OpKernelContext* ctx, OpKernel* kernel) {
+    OP_REQUIRES_OK(ctx,
+                   GetNodeAttr(kernel->def(), "value_shape", &value_shape_));
+    OP_REQUIRES(ctx,
+                TensorShapeUtils::IsScalar(value_shape_) ||
+                    TensorShapeUtils::IsVector(value_shape_),
+                errors::InvalidArgument(
+                    "Default value must be a scalar or a vector, got shape ",
+                    value_shape_.DebugString()));
+    value_dim_ = value_shape_.num_elements();
+    OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "max_size", &max_size_));
+    OP_REQUIRES(ctx, max_size_ >= 0,
+                errors::InvalidArgument("max_size must be non-negative, got: ",
+                                        max_size_));
+    OP_REQUIRES_OK(
+        ctx, GetNodeAttr(kernel->def(), "min_frequency", &min_frequency_));
+    OP_REQUIRES(ctx, min_frequency_ >= 1,
+                errors::InvalidArgument("min_frequency must be positive, got: ",
+                                        min_frequency_));
+    OP_REQUIRES_OK(
+        ctx, GetNodeAttr(kernel->def(), "max_idle_steps", &max_idle_steps_));
+    OP_REQUIRES(ctx, max_idle_steps_ >= 0,
+                errors::InvalidArgument(
+                    "max_idle_steps must be non-negative, got: ",
+                    max_idle_steps_));
+    if (min_frequency_ > 1) {
+      int64 width = kMinSketchWidth;
+      while (width < kMaxSketchWidth &&
+             (max_size_ == 0 ? width < kDefaultSketchWidth
+                             : width < 2 * max_size_)) {
+        width <<= 1;
+      }
+      sketch_width_ = width;
+      sketch_.resize(kSketchDepth * sketch_width_, 0);
+    }
+  }
+
+  // Expired keys are only erased by the next idle sweep, but like Find and
+  // ExportValues the size treats them as absent.
+  size_t size() const override {
+    tf_shared_lock l(mu_);
+    return NumLiveKeys();
+  }
+
+  Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
+              const Tensor& default_value) override {
+    const auto key_values = key.flat<K>();
+    const int64 num_keys = key_values.size();
+    auto value_values = value->shaped<V, 2>({num_keys, value_dim_});
+    const auto default_flat = default_value.flat<V>();
+
+    // is_full_size_default is true:
+    //   Each key has an independent default value, key_values(i)
+    //   corresponding uses default_flat(i) as its default value.
+    //
+    // is_full_size_default is false:
+    //   All keys will share the default_flat(0) as default value.
+    const bool is_full_size_default =
+        (default_flat.size() == value_values.size());
+
+    tf_shared_lock l(mu_);
+    for (int64 i = 0; i < num_keys; ++i) {
+      const Entry* entry =
+          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
+      if (entry != nullptr && !IsExpired(*entry)) {
+        const V* value_row = values_.data() + entry->row * value_dim_;
+        for (int64 j = 0; j < value_dim_; ++j) {
+          value_values(i, j) = value_row[j];
+        }
+      } else {
+        const int64 default_offset = is_full_size_default ? i * value_dim_ : 0;
+        for (int64 j = 0; j < value_dim_; ++j) {
+          value_values(i, j) = default_flat(default_offset + j);
+        }
       }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          value_vec);
     }
     return Status::OK();
   }
 
   Status Insert(OpKernelContext* ctx, const Tensor& keys,
                 const Tensor& values) override {
-    return DoInsert(false, keys, values);
+    const auto key_values = keys.flat<K>();
+    const int64 num_keys = key_values.size();
+    const auto value_values = values.shaped<V, 2>({num_keys, value_dim_});
+
+    mutex_lock l(mu_);
+    ++step_;
+    for (int64 i = 0; i < num_keys; ++i) {
+      const K key = SubtleMustCopyIfIntegral(key_values(i));
+      auto it = table_.find(key);
+      if (it == table_.end()) {
+        if (!Admit(key)) {
+          continue;
+        }
+        it = table_.emplace(key, Entry{AllocateRow(), 0, 0}).first;
+      } else if (IsExpired(it->second)) {
+        // An expired key starts over as if it had just been admitted.
+        it->second.frequency = 0;
+      }
+      ++it->second.frequency;
+      it->second.last_step = step_;
+      V* value_row = values_.data() + it->second.row * value_dim_;
+      for (int64 j = 0; j < value_dim_; ++j) {
+        value_row[j] = SubtleMustCopyIfIntegral(value_values(i, j));
+      }
+    }
+    Evict();
+    return Status::OK();
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
@@ -249,38 +709,68 @@ class MutableHashTableOfTensors final : public LookupInterface {
 
     mutex_lock l(mu_);
     for (int64 i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
+      auto it = table_.find(SubtleMustCopyIfIntegral(key_values(i)));
+      if (it != table_.end()) {
+        ReleaseRow(it->second.row);
+        table_.erase(it);
+      }
     }
     return Status::OK();
   }
 
   Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
                       const Tensor& values) override {
-    return DoInsert(true, keys, values);
+    const auto key_values = keys.flat<K>();
+    const int64 num_keys = key_values.size();
+    const auto value_values = values.shaped<V, 2>({num_keys, value_dim_});
+
+    // Restored keys bypass admission. Their insert statistics are not part of
+    // the checkpoint, so they restart as freshly admitted keys.
+    mutex_lock l(mu_);
+    table_.clear();
+    values_.clear();
+    free_rows_.clear();
+    std::fill(sketch_.begin(), sketch_.end(), 0);
+    sketch_increments_ = 0;
+    for (int64 i = 0; i < num_keys; ++i) {
+      auto inserted = table_.emplace(SubtleMustCopyIfIntegral(key_values(i)),
+                                     Entry{0, min_frequency_, step_});
+      if (inserted.second) {
+        inserted.first->second.row = AllocateRow();
+      }
+      V* value_row = values_.data() + inserted.first->second.row * value_dim_;
+      for (int64 j = 0; j < value_dim_; ++j) {
+        value_row[j] = SubtleMustCopyIfIntegral(value_values(i, j));
+      }
+    }
+    return Status::OK();
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
     tf_shared_lock l(mu_);
-    int64 size = table_.size();
-    int64 value_dim = value_shape_.dim_size(0);
+    const int64 size = NumLiveKeys();
 
     Tensor* keys;
     Tensor* values;
+    TensorShape values_shape({size});
+    values_shape.AppendShape(value_shape_);
     TF_RETURN_IF_ERROR(
         ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(ctx->allocate_output(
-        "values", TensorShape({size, value_dim}), &values));
+    TF_RETURN_IF_ERROR(ctx->allocate_output("values", values_shape, &values));
 
     auto keys_data = keys->flat<K>();
-    auto values_data = values->matrix<V>();
+    auto values_data = values->shaped<V, 2>({size, value_dim_});
     int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
-      for (int64 j = 0; j < value_dim; j++) {
-        values_data(i, j) = value[j];
+    for (const auto& entry : table_) {
+      if (IsExpired(entry.second)) {
+        continue;
       }
+      keys_data(i) = entry.first;
+      const V* value_row = values_.data() + entry.second.row * value_dim_;
+      for (int64 j = 0; j < value_dim_; ++j) {
+        values_data(i, j) = value_row[j];
+      }
+      ++i;
     }
     return Status::OK();
   }
@@ -294,24 +784,180 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
     tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
+    // One control byte per slot in addition to the slot itself.
+    return sizeof(MutableEvictingHashTable) +
+           table_.capacity() * (sizeof(std::pair<K, Entry>) + 1) +
+           values_.capacity() * sizeof(V) +
+           free_rows_.capacity() * sizeof(int64) +
+           sketch_.capacity() * sizeof(uint32);
+  }
+
+ private:
+  struct Entry {
+    // Row of values_ holding the value of the key.
+    int64 row;
+    // Number of times the key was inserted since it was admitted.
+    int64 frequency;
+    // Step of the last insert of the key.
+    int64 last_step;
+  };
+
+  // Number of hash functions of the count-min sketch.
+  static constexpr int kSketchDepth = 4;
+  // Bounds on the number of counters per sketch row.
+  static constexpr int64 kMinSketchWidth = 1 << 12;
+  static constexpr int64 kDefaultSketchWidth = 1 << 18;
+  static constexpr int64 kMaxSketchWidth = 1 << 22;
+  // The sketch counters are halved after this many increments per counter, so
+  // that the sketch tracks recent rather than all-time frequencies.
+  static constexpr int64 kSketchAgingPeriod = 8;
+  // When the table exceeds max_size_ it is shrunk by this extra fraction of
+  // max_size_, so that the cost of selecting victims is amortized over many
+  // subsequent inserts.
+  static constexpr int64 kEvictionSlackDivisor = 16;
+
+  bool IsExpired(const Entry& entry) const TF_SHARED_LOCKS_REQUIRED(mu_) {
+    return max_idle_steps_ > 0 && step_ - entry.last_step > max_idle_steps_;
+  }
+
+  // Returns the number of keys in the table that are not expired.
+  int64 NumLiveKeys() const TF_SHARED_LOCKS_REQUIRED(mu_) {
+    if (max_idle_steps_ == 0) {
+      return table_.size();
+    }
+    int64 num_keys = 0;
+    for (const auto& entry : table_) {
+      if (!IsExpired(entry.second)) {
+        ++num_keys;
       }
     }
-    return sizeof(MutableHashTableOfTensors) + ret;
+    return num_keys;
+  }
+
+  int64 AllocateRow() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (!free_rows_.empty()) {
+      const int64 row = free_rows_.back();
+      free_rows_.pop_back();
+      return row;
+    }
+    if (value_dim_ == 0) {
+      // Empty values all share the empty row 0.
+      return 0;
+    }
+    const int64 row = values_.size() / value_dim_;
+    values_.resize(values_.size() + value_dim_);
+    return row;
+  }
+
+  void ReleaseRow(int64 row) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (value_dim_ > 0) free_rows_.push_back(row);
+  }
+
+  // Records an insert of a key that is not in the table and returns whether
+  // the key has now been inserted often enough to be admitted.
+  bool Admit(const K& key) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (min_frequency_ <= 1) {
+      return true;
+    }
+    const uint64 hash = MutableHashTableHash<K>()(key);
+    const uint64 h1 = hash;
+    const uint64 h2 = (hash >> 32) | 1;
+    uint32 estimate = std::numeric_limits<uint32>::max();
+    for (int d = 0; d < kSketchDepth; ++d) {
+      uint32& counter =
+          sketch_[d * sketch_width_ + ((h1 + d * h2) & (sketch_width_ - 1))];
+      if (counter < std::numeric_limits<uint32>::max()) {
+        ++counter;
+      }
+      estimate = std::min(estimate, counter);
+    }
+    if (++sketch_increments_ >= kSketchAgingPeriod * sketch_width_) {
+      for (uint32& counter : sketch_) {
+        counter >>= 1;
+      }
+      sketch_increments_ = 0;
+    }
+    return estimate >= min_frequency_;
+  }
+
+  // Evicts idle keys once every max_idle_steps_ steps and the least
+  // frequently inserted keys whenever the table is larger than max_size_.
+  void Evict() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (max_idle_steps_ > 0 &&
+        step_ - last_idle_sweep_step_ >= max_idle_steps_) {
+      last_idle_sweep_step_ = step_;
+      for (auto it = table_.begin(); it != table_.end();) {
+        if (IsExpired(it->second)) {
+          ReleaseRow(it->second.row);
+          table_.erase(it++);
+        } else {
+          ++it;
+        }
+      }
+    }
+    if (max_size_ == 0 || table_.size() <= max_size_) {
+      return;
+    }
+    const int64 target_size =
+        std::max<int64>(0, max_size_ - max_size_ / kEvictionSlackDivisor);
+    const int64 num_victims = table_.size() - target_size;
+    // Victims are the keys with the lowest frequency, breaking ties in favor
+    // of keeping the most recently inserted keys. Keys inserted by the current
+    // step are only evicted if that step alone overflows the table, so that
+    // newly admitted keys get a chance to build up their frequency.
+    typedef std::pair<std::tuple<bool, int64, int64>, const K*> Candidate;
+    std::vector<Candidate> candidates;
+    candidates.reserve(table_.size());
+    for (const auto& entry : table_) {
+      candidates.push_back(
+          {std::make_tuple(entry.second.last_step == step_,
+                           entry.second.frequency, entry.second.last_step),
+           &entry.first});
+    }
+    std::nth_element(candidates.begin(), candidates.begin() + num_victims,
+                     candidates.end(),
+                     [](const Candidate& a, const Candidate& b) {
+                       return a.first < b.first;
+                     });
+    std::vector<K> victims;
+    victims.reserve(num_victims);
+    for (int64 i = 0; i < num_victims; ++i) {
+      victims.push_back(*candidates[i].second);
+    }
+    for (const K& victim : victims) {
+      auto it = table_.find(victim);
+      ReleaseRow(it->second.row);
+      table_.erase(it);
+    }
+    // Frequencies decay with every sweep, so that keys that were hot in the
+    // past eventually make room for the keys that are hot now.
+    for (auto& entry : table_) {
+      entry.second.frequency >>= 1;
+    }
   }
 
- private:
   TensorShape value_shape_;
+  int64 value_dim_;
+  int64 max_size_;
+  int64 min_frequency_;
+  int64 max_idle_steps_;
+  int64 sketch_width_ = 0;
+
   mutable mutex mu_;
-  typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<K, Entry, MutableHashTableHash<K>> table_
+      TF_GUARDED_BY(mu_);
+  // Row-major [num_rows, value_dim_] storage for the values of all keys.
+  gtl::InlinedVector<V, 4> values_ TF_GUARDED_BY(mu_);
+  // Rows of values_ released by removed or evicted keys.
+  std::vector<int64> free_rows_ TF_GUARDED_BY(mu_);
+  // Count-min sketch of the insert counts of keys not yet admitted, stored as
+  // kSketchDepth rows of sketch_width_ counters. Empty if every key is
+  // admitted on its first insert.
+  std::vector<uint32> sketch_ TF_GUARDED_BY(mu_);
+  int64 sketch_increments_ TF_GUARDED_BY(mu_) = 0;
+  int64 step_ TF_GUARDED_BY(mu_) = 0;
+  int64 last_idle_sweep_step_ TF_GUARDED_BY(mu_) = 0;
 };
 
 namespace {
@@ -1098,6 +1744,30 @@ REGISTER_KERNEL(tstring, int64);
 
 #undef REGISTER_KERNEL
 
+// Register the MutableEvictingHashTable op.
+#define REGISTER_KERNEL(key_dtype, value_dtype)                               \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("MutableEvictingHashTable")                                        \
+          .Device(DEVICE_CPU)                                                 \
+          .TypeConstraint<key_dtype>("key_dtype")                             \
+          .TypeConstraint<value_dtype>("value_dtype"),                        \
+      LookupTableOp<lookup::MutableEvictingHashTable<key_dtype, value_dtype>, \
+                    key_dtype, value_dtype>)
+
+REGISTER_KERNEL(int32, double);
+REGISTER_KERNEL(int32, float);
+REGISTER_KERNEL(int32, int32);
+REGISTER_KERNEL(int64, double);
+REGISTER_KERNEL(int64, float);
+REGISTER_KERNEL(int64, int32);
+REGISTER_KERNEL(int64, int64);
+REGISTER_KERNEL(tstring, double);
+REGISTER_KERNEL(tstring, float);
+REGISTER_KERNEL(tstring, int32);
+REGISTER_KERNEL(tstring, int64);
+
+#undef REGISTER_KERNEL
+
 // Register the MutableDenseHashTable op.
 #define REGISTER_KERNEL(key_dtype, value_dtype)                            \
   REGISTER_KERNEL_BUILDER(                                                 \
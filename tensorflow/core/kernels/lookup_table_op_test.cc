@@ -0,0 +1,177 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+// Adds a MutableHashTableOfTensorsV2 node with int64 keys and float vector
+// values. Nodes created with the same `shared_name` refer to the same table.
+Node* MutableHashTableOfTensors(Graph* g, const string& shared_name,
+                                int64 value_dim) {
+  Node* table;
+  TF_CHECK_OK(NodeBuilder(g->NewName("table"), "MutableHashTableOfTensorsV2")
+                  .Attr("key_dtype", DT_INT64)
+                  .Attr("value_dtype", DT_FLOAT)
+                  .Attr("value_shape", TensorShape({value_dim}))
+                  .Attr("shared_name", shared_name)
+                  .Finalize(g, &table));
+  return table;
+}
+
+Tensor RandomKeys(int64 num_keys, int64 max_key, uint64 seed) {
+  random::PhiloxRandom philox(seed);
+  random::SimplePhilox rnd(&philox);
+  Tensor keys(DT_INT64, TensorShape({num_keys}));
+  auto keys_flat = keys.flat<int64>();
+  for (int64 i = 0; i < num_keys; ++i) {
+    keys_flat(i) = rnd.Uniform64(max_key);
+  }
+  return keys;
+}
+
+// Returns a graph inserting `num_keys` keys [0, num_keys) into the table.
+Graph* PopulateTable(const string& shared_name, int64 num_keys,
+                     int64 value_dim) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor keys(DT_INT64, TensorShape({num_keys}));
+  auto keys_flat = keys.flat<int64>();
+  for (int64 i = 0; i < num_keys; ++i) {
+    keys_flat(i) = i;
+  }
+  Tensor values(DT_FLOAT, TensorShape({num_keys, value_dim}));
+  values.flat<float>().setRandom();
+  Node* insert;
+  TF_CHECK_OK(NodeBuilder(g->NewName("insert"), "LookupTableInsertV2")
+                  .Input(MutableHashTableOfTensors(g, shared_name, value_dim))
+                  .Input(test::graph::Constant(g, keys))
+                  .Input(test::graph::Constant(g, values))
+                  .Finalize(g, &insert));
+  FixupSourceAndSinkEdges(g);
+  return g;
+}
+
+SessionOptions BenchmarkOptions(int num_threads) {
+  SessionOptions options;
+  options.config.set_intra_op_parallelism_threads(num_threads);
+  return options;
+}
+
+const int64 kBatchSize = 1 << 16;
+
+// Looks up batches of `kBatchSize` random keys in a table holding
+// `table_size` keys, using `num_threads` worker threads.
+void BM_MutableHashTableOfTensorsFind(::testing::benchmark::State& state) {
+  const int64 table_size = state.range(0);
+  const int num_threads = state.range(1);
+  const int64 batch_size = kBatchSize;
+  const int64 value_dim = 32;
+  const string shared_name = strings::StrCat("bm_find_table_", table_size);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor default_value(DT_FLOAT, TensorShape({value_dim}));
+  default_value.flat<float>().setZero();
+  Node* find;
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("find"), "LookupTableFindV2")
+          .Input(MutableHashTableOfTensors(g, shared_name, value_dim))
+          .Input(test::graph::Constant(
+              g, RandomKeys(batch_size, 2 * table_size, /*seed=*/301)))
+          .Input(test::graph::Constant(g, default_value))
+          .Finalize(g, &find));
+  FixupSourceAndSinkEdges(g);
+
+  const SessionOptions options = BenchmarkOptions(num_threads);
+  test::Benchmark("cpu", g, &options,
+                  PopulateTable(shared_name, table_size, value_dim), nullptr,
+                  "", /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()) * batch_size);
+}
+
+// Inserts batches of `kBatchSize` random keys into a table holding
+// `table_size` keys, using `num_threads` worker threads.
+void BM_MutableHashTableOfTensorsInsert(::testing::benchmark::State& state) {
+  const int64 table_size = state.range(0);
+  const int num_threads = state.range(1);
+  const int64 batch_size = kBatchSize;
+  const int64 value_dim = 32;
+  const string shared_name = strings::StrCat("bm_insert_table_", table_size);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor values(DT_FLOAT, TensorShape({batch_size, value_dim}));
+  values.flat<float>().setRandom();
+  Node* insert;
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("insert"), "LookupTableInsertV2")
+          .Input(MutableHashTableOfTensors(g, shared_name, value_dim))
+          .Input(test::graph::Constant(
+              g, RandomKeys(batch_size, 2 * table_size, /*seed=*/302)))
+          .Input(test::graph::Constant(g, values))
+          .Finalize(g, &insert));
+  FixupSourceAndSinkEdges(g);
+
+  const SessionOptions options = BenchmarkOptions(num_threads);
+  test::Benchmark("cpu", g, &options,
+                  PopulateTable(shared_name, table_size, value_dim), nullptr,
+                  "", /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()) * batch_size);
+}
+
+BENCHMARK(BM_MutableHashTableOfTensorsFind)
+    ->UseRealTime()
+    ->ArgPair(1 << 16, 1)
+    ->ArgPair(1 << 16, 4)
+    ->ArgPair(1 << 16, 16)
+    ->ArgPair(1 << 16, 64)
+    ->ArgPair(1 << 20, 1)
+    ->ArgPair(1 << 20, 4)
+    ->ArgPair(1 << 20, 16)
+    ->ArgPair(1 << 20, 64)
+    ->ArgPair(1 << 22, 1)
+    ->ArgPair(1 << 22, 4)
+    ->ArgPair(1 << 22, 16)
+    ->ArgPair(1 << 22, 64);
+
+BENCHMARK(BM_MutableHashTableOfTensorsInsert)
+    ->UseRealTime()
+    ->ArgPair(1 << 16, 1)
+    ->ArgPair(1 << 16, 4)
+    ->ArgPair(1 << 16, 16)
+    ->ArgPair(1 << 16, 64)
+    ->ArgPair(1 << 20, 1)
+    ->ArgPair(1 << 20, 4)
+    ->ArgPair(1 << 20, 16)
+    ->ArgPair(1 << 20, 64)
+    ->ArgPair(1 << 22, 1)
+    ->ArgPair(1 << 22, 4)
+    ->ArgPair(1 << 22, 16)
+    ->ArgPair(1 << 22, 64);
+
+}  // namespace
+}  // namespace tensorflow
@@ -733,19 +733,21 @@ class BaseBatchMatMulOp : public OpKernel {
       OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT, out_reshaped.shape(),
                                              &out_reshaped_float));
 
-      // TODO: Avoid extra copy to make bfloat16 matmul efficient on CPU.
-      BFloat16ToFloat(in0_reshaped.flat<bfloat16>().data(),
-                      in0_reshaped_float.flat<float>().data(),
-                      in0_reshaped.NumElements());
-      BFloat16ToFloat(in1_reshaped.flat<bfloat16>().data(),
-                      in1_reshaped_float.flat<float>().data(),
-                      in1_reshaped.NumElements());
+      // The products are accumulated in float. The conversions are vectorized
+      // and sharded over the intra op threads (they use the AVX512-BF16
+      // conversion instructions when the build enables them), and the output
+      // is rounded to the nearest bfloat16 rather than truncated.
+      const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+      in0_reshaped_float.flat<float>().device(d) =
+          in0_reshaped.flat<bfloat16>().template cast<float>();
+      in1_reshaped_float.flat<float>().device(d) =
+          in1_reshaped.flat<bfloat16>().template cast<float>();
 
       LaunchBatchMatMul<Device, float>::Launch(
           ctx, in0_reshaped_float, in1_reshaped_float, adj_x_, adj_y_, trans_x_,
           trans_y_, bcast, &out_reshaped_float);
-      FloatToBFloat16(out_reshaped_float.flat<float>().data(),
-                      out_reshaped.flat<bfloat16>().data(), out->NumElements());
+      out_reshaped.flat<bfloat16>().device(d) =
+          out_reshaped_float.flat<float>().template cast<bfloat16>();
     } else {
       LaunchBatchMatMul<Device, Scalar>::Launch(ctx, in0_reshaped, in1_reshaped,
                                                 adj_x_, adj_y_, trans_x_,
@@ -389,6 +389,12 @@ static Graph* Matmul(int m, int k, int n, bool transpose_a, bool transpose_b,
 
 #endif  // GOOGLE_CUDA
 
+// The bfloat16 CPU kernel runs the float one between conversions, compare it
+// with the float benchmarks of the same shapes.
+BM_MatmulDev(128, 512, 512, false, false, bfloat16, DT_BFLOAT16, cpu);
+BM_MatmulDev(128, 1024, 1024, false, false, bfloat16, DT_BFLOAT16, cpu);
+BM_MatmulDev(4096, 4096, 4096, false, false, bfloat16, DT_BFLOAT16, cpu);
+
 // Batch size of 1 included for inference.
 // Typical fully connected layers
 BM_Matmul(1, 512, 512, false, false);
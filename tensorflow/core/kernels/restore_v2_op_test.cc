@@ -34,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
 namespace {
@@ -350,6 +351,54 @@ class RestoreV2OpTest : public OpsTestBase {
   }
 };
 
+// Restores enough tensors that they are read from several threads.
+TEST_F(RestoreV2OpTest, RestoreManyTensors) {
+  const string prefix =
+      io::JoinPath(testing::TmpDir(), "restore_v2_many_tensors");
+  const int kNumTensors = 32;
+  const int kNumElements = 1 << 18;  // 1MB of floats.
+  std::vector<string> tensor_names;
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    for (int i = 0; i < kNumTensors; ++i) {
+      tensor_names.push_back(strings::StrCat("tensor_", i));
+      Tensor t = MakeInput<float>(TensorShape({kNumElements}),
+                                  [i](int x) -> float { return i + x; });
+      TF_ASSERT_OK(writer.Add(tensor_names.back(), t));
+    }
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  TF_ASSERT_OK(
+      NodeDefBuilder("myop", "RestoreV2")
+          .Input(FakeInput())  // prefix
+          .Input(FakeInput())  // tensor_names
+          .Input(FakeInput())  // shape_and_slices
+          .Attr("dtypes", std::vector<DataType>(kNumTensors, DT_FLOAT))
+          .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput<tstring>(TensorShape({}), [&](int x) -> tstring { return prefix; });
+  // Requests the tensors in reverse order of their names.
+  AddInput<tstring>(TensorShape({kNumTensors}), [&](int x) -> tstring {
+    return tensor_names[kNumTensors - 1 - x];
+  });
+  AddInput<tstring>(TensorShape({kNumTensors}),
+                    [](int x) -> tstring { return ""; });
+  TF_ASSERT_OK(RunOpKernel());
+  for (int i = 0; i < kNumTensors; ++i) {
+    const int tensor_index = kNumTensors - 1 - i;
+    Tensor* output = GetOutput(i);
+    ASSERT_TRUE(output->shape().IsSameSize(TensorShape({kNumElements})));
+    for (int x = 0; x < kNumElements; x += 997) {
+      EXPECT_EQ(tensor_index + x, output->flat<float>()(x));
+    }
+  }
+
+  // Missing tensors are reported.
+  (*mutable_input(1).tensor).flat<tstring>()(kNumTensors - 1) = "missing";
+  EXPECT_TRUE(errors::IsNotFound(RunOpKernel()));
+}
+
 // The intended use case (write in V2, read in V2).
 TEST_F(RestoreV2OpTest, RestoreAfterSaveV2) { RunTest("SaveV2"); }
 // For backward compatibility.
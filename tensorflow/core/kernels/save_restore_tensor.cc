@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/kernels/save_restore_tensor.h"
+
+#include <algorithm>
 #include <numeric>
 #include <unordered_map>
 #include <utility>
@@ -237,6 +239,15 @@ namespace {
 // Tensors larger than this threshold will be restored from a thread-pool.
 const int64 kLargeShapeThreshold = 16 << 20;  // 16M
 
+// The remaining tensors are restored from the op thread, unless they add up to
+// at least twice this many bytes.  In that case they are split into groups of
+// consecutive tensors holding at least this many bytes, and each group is
+// restored from the thread-pool using its own BundleReader.
+const int64 kMinRestoreGroupBytes = 4 << 20;  // 4MB
+
+// Number of threads issuing concurrent reads of a checkpoint.
+const int kNumRestoreThreads = 8;
+
 // A restore operation for a single tensor.  Small tensors may be restored
 // directly from the op thread to improve read locality.  Large tensors can be
 // restored from a thread pool: this requires creating a separate BundleReader
@@ -331,6 +342,17 @@ struct RestoreOp {
   ::tensorflow::Status status;
 };
 
+// Runs the restore operations "ops" in order, sharing a new BundleReader so
+// that neighboring tensors are read through the same buffered data files.
+void RunRestoreOpsWithNewReader(const string& reader_prefix,
+                                gtl::ArraySlice<RestoreOp*> ops) {
+  BundleReader reader(Env::Default(), reader_prefix);
+  for (RestoreOp* op : ops) {
+    op->status = reader.status().ok() ? op->run(&reader) : reader.status();
+    if (!op->status.ok()) return;
+  }
+}
+
 }  // namespace
 
 Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
@@ -356,6 +378,8 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   BundleReader default_reader(Env::Default(), prefix_string);
   TF_RETURN_IF_ERROR(default_reader.status());
 
+  // Estimated number of bytes read for each tensor.
+  std::vector<int64> restore_bytes(tensor_names_flat.size());
   std::vector<string> mismatched_errors;
   for (const size_t i : sorted_name_idx) {
     TensorShape restored_full_shape;
@@ -363,6 +387,9 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     const string& tensor_name = tensor_names_flat(i);
     TF_RETURN_IF_ERROR(default_reader.LookupDtypeAndShape(
         tensor_name, &original_dtype, &restored_full_shape));
+    restore_bytes[i] =
+        restored_full_shape.num_elements() *
+        std::max<int64>(DataTypeSize(original_dtype), sizeof(char));
     if (dtypes[i] != original_dtype) {
       string error_msg = strings::StrCat(
           "tensor_name = ", tensor_name, "; expected dtype ",
@@ -376,6 +403,7 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     return errors::InvalidArgument(error_msg);
   }
 
+  int64 direct_restore_bytes = 0;
   for (auto i : sorted_name_idx) {
     const string& tensor_name = tensor_names_flat(i);
     const string& shape_and_slice = shape_and_slices_flat(i);
@@ -385,6 +413,24 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
       pool_restore_ops.emplace_back(op);
     } else {
       direct_restore_ops.emplace_back(op);
+      direct_restore_bytes += restore_bytes[i];
+    }
+  }
+
+  // Splits the small tensors, still sorted by name, into groups of roughly
+  // equal size, so that each reader thread reads a contiguous range of keys.
+  std::vector<std::vector<RestoreOp*> > restore_op_groups;
+  if (direct_restore_bytes >= 2 * kMinRestoreGroupBytes) {
+    const int64 group_bytes = std::max(
+        kMinRestoreGroupBytes, direct_restore_bytes / kNumRestoreThreads);
+    int64 current_group_bytes = group_bytes;
+    for (auto& op : direct_restore_ops) {
+      if (current_group_bytes >= group_bytes) {
+        restore_op_groups.emplace_back();
+        current_group_bytes = 0;
+      }
+      restore_op_groups.back().push_back(op.get());
+      current_group_bytes += restore_bytes[op->idx];
     }
   }
 
@@ -392,17 +438,24 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     // Schedule any threaded operations first, skipping thread pool creation if
     // we don't have any expensive operations.
     std::unique_ptr<thread::ThreadPool> reader_pool;
-    if (!pool_restore_ops.empty()) {
-      reader_pool.reset(
-          new thread::ThreadPool(Env::Default(), "restore_tensors", 8));
+    if (!pool_restore_ops.empty() || !restore_op_groups.empty()) {
+      reader_pool.reset(new thread::ThreadPool(
+          Env::Default(), "restore_tensors", kNumRestoreThreads));
       for (auto& op : pool_restore_ops) {
         reader_pool->Schedule([&op]() { op->run_with_new_reader(); });
       }
+      for (const auto& group : restore_op_groups) {
+        reader_pool->Schedule([&group, &prefix_string]() {
+          RunRestoreOpsWithNewReader(prefix_string, group);
+        });
+      }
     }
 
-    // Read small tensors from the op thread
-    for (auto& op : direct_restore_ops) {
-      TF_RETURN_IF_ERROR(op->run(&default_reader));
+    // Read small tensors from the op thread, unless they have been grouped.
+    if (restore_op_groups.empty()) {
+      for (auto& op : direct_restore_ops) {
+        TF_RETURN_IF_ERROR(op->run(&default_reader));
+      }
     }
   }
 
@@ -410,6 +463,11 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   for (auto& op : pool_restore_ops) {
     TF_RETURN_IF_ERROR(op->status);
   }
+  if (!restore_op_groups.empty()) {
+    for (auto& op : direct_restore_ops) {
+      TF_RETURN_IF_ERROR(op->status);
+    }
+  }
 
   for (auto i : sorted_name_idx) {
     const string& tensor_name = tensor_names_flat(i);
@@ -23,6 +23,7 @@ limitations under the License.
 #define EIGEN_USE_GPU
 #endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 
+#include <algorithm>
 #include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
@@ -38,6 +39,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/segment_reduction_ops.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/util/util.h"
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
@@ -446,7 +448,14 @@ class SparseSegmentReductionOpBase : public OpKernel {
         default_value_(default_value) {}
 
   void Compute(OpKernelContext* context) override {
-    const Tensor& input = context->input(0);
+    ReduceSegments(context, context->input(0));
+  }
+
+ protected:
+  // Reduces the rows of `input` selected by the indices (input 1) into the
+  // segments (input 2). `input` is the data input, or the value of the
+  // variable read by the kernels taking a resource instead.
+  void ReduceSegments(OpKernelContext* context, const Tensor& input) {
     const Tensor& indices = context->input(1);
     const Tensor& segment_ids = context->input(2);
 
@@ -635,6 +644,27 @@ class SparseSegmentReductionOpBase : public OpKernel {
     return res;
   }
 
+  // Prefetches the rows of `input_flat` selected by indices [begin, end),
+  // skipping the out of range ones (they are reported by ReduceImpl).
+  template <typename Tin, typename Tindex>
+  EIGEN_ALWAYS_INLINE void PrefetchRows(
+      const typename TTypes<Tin>::ConstMatrix& input_flat,
+      const typename TTypes<Tindex>::ConstVec& indices_vec, int64 begin,
+      int64 end) {
+    constexpr int64 kCacheLineSize = 64;
+    const int64 row_bytes = input_flat.dimension(1) * sizeof(Tin);
+    if (row_bytes == 0) return;
+    end = std::min<int64>(end, indices_vec.size());
+    for (int64 i = begin; i < end; ++i) {
+      const Tindex index = indices_vec(i);
+      if (!FastBoundsCheck(index, input_flat.dimension(0))) continue;
+      const char* row = reinterpret_cast<const char*>(&input_flat(index, 0));
+      for (int64 offset = 0; offset < row_bytes; offset += kCacheLineSize) {
+        port::prefetch<port::PREFETCH_HINT_T0>(row + offset);
+      }
+    }
+  }
+
   template <typename Tin, typename Tindex, typename Tout>
   int64 ReduceImpl(
       const typename TTypes<Tin>::ConstMatrix& input_flat,
@@ -647,6 +677,10 @@ class SparseSegmentReductionOpBase : public OpKernel {
 
 #define L(n) fetch_val<Tin, Tindex>(input_flat, index##n)
 
+    // The first rows of the next segment are fetched while this one is
+    // reduced, and each block of 8 rows while the previous one is.
+    PrefetchRows<Tin, Tindex>(input_flat, indices_vec, start + num,
+                              start + num + 8);
     if (num == 1) {
       INDEX(0, 0);
       out = L(0);
@@ -736,6 +770,8 @@ class SparseSegmentReductionOpBase : public OpKernel {
         }
       }
       for (; r < num; r += 8) {
+        PrefetchRows<Tin, Tindex>(input_flat, indices_vec, start + r + 8,
+                                  std::min(start + r + 16, start + num));
         INDEX(0, r);
         INDEX(1, r + 1);
         INDEX(2, r + 2);
@@ -16,6 +16,9 @@ limitations under the License.
 // See docs in ../ops/math_ops.cc.
 #include "tensorflow/core/kernels/segment_reduction_ops_impl.h"
 
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/kernels/training_op_helpers.h"
+
 namespace tensorflow {
 
 #define REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, index_type) \
@@ -113,6 +116,88 @@ REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_INDEX_TYPE(float);
 REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_INDEX_TYPE(double);
 #undef REGISTER_CPU_SPARSE_KERNELS
 
+// Same as the SparseSegment{Sum,Mean,SqrtN}[WithNumSegments] kernels, but the
+// rows are read from a resource variable instead of the data input. This fuses
+// the ResourceGather of an embedding lookup into the reduction, so that the
+// gathered rows are never materialized.
+template <class T, typename Index, typename SegmentId>
+class ResourceSparseSegmentReductionOp
+    : public SparseSegmentReductionOpBase<CPUDevice, T, Index, SegmentId> {
+ public:
+  ResourceSparseSegmentReductionOp(OpKernelConstruction* context,
+                                   bool has_num_segments)
+      : SparseSegmentReductionOpBase<CPUDevice, T, Index, SegmentId>(
+            context, HasCombiner(context, "mean"),
+            HasCombiner(context, "sqrtn"), has_num_segments,
+            T(0) /* default_value */) {}
+
+  void Compute(OpKernelContext* context) override {
+    core::RefCountPtr<Var> v;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0), &v));
+    OP_REQUIRES_OK(context,
+                   EnsureSparseVariableAccess<CPUDevice, T>(context, v.get()));
+    // Like ResourceGather, the lock is held for the whole reduction rather
+    // than taking a reference to the tensor, which would make the next write
+    // to the variable copy it.
+    tf_shared_lock ml(*v->mu());
+    const Tensor& params = *v->tensor();
+    OP_REQUIRES(
+        context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+        errors::InvalidArgument("params must be at least 1 dimensional"));
+    this->ReduceSegments(context, params);
+  }
+
+ private:
+  static bool HasCombiner(OpKernelConstruction* context,
+                          const string& combiner) {
+    string value;
+    return context->GetAttr("combiner", &value).ok() && value == combiner;
+  }
+};
+
+template <class T, typename Index, typename SegmentId>
+class ResourceSparseSegmentReductionWithoutNumSegmentsOp
+    : public ResourceSparseSegmentReductionOp<T, Index, SegmentId> {
+ public:
+  explicit ResourceSparseSegmentReductionWithoutNumSegmentsOp(
+      OpKernelConstruction* context)
+      : ResourceSparseSegmentReductionOp<T, Index, SegmentId>(
+            context, false /* has_num_segments */) {}
+};
+
+template <class T, typename Index, typename SegmentId>
+class ResourceSparseSegmentReductionWithNumSegmentsOp
+    : public ResourceSparseSegmentReductionOp<T, Index, SegmentId> {
+ public:
+  explicit ResourceSparseSegmentReductionWithNumSegmentsOp(
+      OpKernelConstruction* context)
+      : ResourceSparseSegmentReductionOp<T, Index, SegmentId>(
+            context, true /* has_num_segments */) {}
+};
+
+#define REGISTER_CPU_SPARSE_KERNELS(type, index_type, segment_ids_type)        \
+  REGISTER_KERNEL_BUILDER(                                                     \
+      Name("_ResourceSparseSegmentReduction")                                  \
+          .Device(DEVICE_CPU)                                                  \
+          .TypeConstraint<type>("dtype")                                       \
+          .TypeConstraint<index_type>("Tidx")                                  \
+          .TypeConstraint<segment_ids_type>("Tsegmentids"),                    \
+      ResourceSparseSegmentReductionWithoutNumSegmentsOp<type, index_type,     \
+                                                         segment_ids_type>);   \
+  REGISTER_KERNEL_BUILDER(                                                     \
+      Name("_ResourceSparseSegmentReductionWithNumSegments")                   \
+          .Device(DEVICE_CPU)                                                  \
+          .TypeConstraint<type>("dtype")                                       \
+          .TypeConstraint<index_type>("Tidx")                                  \
+          .TypeConstraint<segment_ids_type>("Tsegmentids"),                    \
+      ResourceSparseSegmentReductionWithNumSegmentsOp<type, index_type,        \
+                                                      segment_ids_type>);
+REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_INDEX_TYPE(float);
+REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_INDEX_TYPE(double);
+REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_INDEX_TYPE(bfloat16);
+#undef REGISTER_CPU_SPARSE_KERNELS
+
 #undef REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_INDEX_TYPE
 #undef REGISTER_CPU_SPARSE_KERNELS_FOR_EACH_SEGMENT_ID_TYPE
 
@@ -16,6 +16,7 @@ limitations under the License.
 #include <functional>
 #include <vector>
 
+#include "absl/strings/match.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
@@ -23,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_var.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
@@ -31,6 +33,8 @@ limitations under the License.
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -168,4 +172,106 @@ static void BM_SparseSegmentMeanGrad_High(::testing::benchmark::State& state) {
 BENCHMARK(BM_SparseSegmentMeanGrad_Low)->UseRealTime()->Arg(1000)->Arg(100000);
 BENCHMARK(BM_SparseSegmentMeanGrad_High)->UseRealTime()->Arg(1000)->Arg(100000);
 
+class ResourceSparseSegmentReductionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const string& combiner) {
+    TF_ASSERT_OK(NodeDefBuilder("op", op)
+                     .Input(FakeInput(DT_RESOURCE))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("dtype", DT_FLOAT)
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Adds a [4, 2] variable holding 0..7 as the resource input.
+  void AddVariableInput() {
+    Var* var = new Var(DT_FLOAT);
+    *var->tensor() = test::AsTensor<float>({0, 1, 2, 3, 4, 5, 6, 7}, {4, 2});
+    var->is_initialized = true;
+    AddResourceInput<Var>("", "var", var);
+  }
+};
+
+TEST_F(ResourceSparseSegmentReductionOpTest, Sum) {
+  MakeOp("_ResourceSparseSegmentReduction", "sum");
+  AddVariableInput();
+  AddInputFromArray<int32>(TensorShape({4}), {3, 0, 3, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  TF_ASSERT_OK(RunOpKernel());
+  // Segment 1 is empty.
+  test::ExpectTensorEqual<float>(
+      *GetOutput(0), test::AsTensor<float>({6, 8, 0, 0, 8, 10}, {3, 2}));
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, MeanWithNumSegments) {
+  TF_ASSERT_OK(NodeDefBuilder("op",
+                              "_ResourceSparseSegmentReductionWithNumSegments")
+                   .Input(FakeInput(DT_RESOURCE))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(DT_INT32))
+                   .Attr("dtype", DT_FLOAT)
+                   .Attr("combiner", "mean")
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddVariableInput();
+  AddInputFromArray<int32>(TensorShape({3}), {2, 0, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 0, 1});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<float>(
+      *GetOutput(0), test::AsTensor<float>({2, 3, 2, 3, 0, 0}, {3, 2}));
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, IndexOutOfRange) {
+  MakeOp("_ResourceSparseSegmentReduction", "sqrtn");
+  AddVariableInput();
+  AddInputFromArray<int32>(TensorShape({2}), {0, 4});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  const Status status = RunOpKernel();
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code());
+  EXPECT_TRUE(absl::StrContains(status.error_message(), "out of range"))
+      << status;
+}
+
+// Embedding lookups: segments of `segment_size` random rows of a table much
+// larger than the caches.
+static void BM_SparseSegmentSum(::testing::benchmark::State& state) {
+  const int num_indices = state.range(0);
+  const int segment_size = state.range(1);
+  const int kNumRows = 1 << 20;
+  const int kDim = 64;
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor data(DT_FLOAT, TensorShape({kNumRows, kDim}));
+  data.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({num_indices}));
+  Tensor segment_ids(DT_INT32, TensorShape({num_indices}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < num_indices; ++i) {
+    indices.flat<int32>()(i) = rnd.Uniform(kNumRows);
+    segment_ids.flat<int32>()(i) = i / segment_size;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "SparseSegmentSum")
+                  .Input(test::graph::Constant(g, data))
+                  .Input(test::graph::Constant(g, indices))
+                  .Input(test::graph::Constant(g, segment_ids))
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &node));
+
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetBytesProcessed(static_cast<int64>(state.iterations()) *
+                          num_indices * kDim * sizeof(float));
+}
+
+BENCHMARK(BM_SparseSegmentSum)
+    ->UseRealTime()
+    ->ArgPair(1 << 16, 4)
+    ->ArgPair(1 << 16, 32);
+
 }  // namespace tensorflow
@@ -18,11 +18,17 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include "tensorflow/core/kernels/sparse_xent_op.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/math/math_util.h"
 
 namespace tensorflow {
 
@@ -96,8 +102,13 @@ class SparseSoftmaxXentWithLogitsOp : public OpKernel {
   }
 };
 
-// Partial specialization for a CPUDevice, that uses the Eigen implementation
-// from XentEigenImpl.
+// Partial specialization for a CPUDevice, which computes the loss and backprop
+// without materializing the intermediate (logits - max_logits), in two passes
+// over the logits: the first computes the log of the sum of their exponentials
+// with a max for each block of classes, which are then combined (an online
+// log-sum-exp), and the second computes the backprop. Rows are split into
+// blocks of classes so that a few rows with many classes are still
+// parallelized.
 namespace functor {
 template <typename T, typename Index>
 struct SparseXentFunctor<CPUDevice, T, Index> {
@@ -105,8 +116,100 @@ struct SparseXentFunctor<CPUDevice, T, Index> {
                   typename TTypes<Index>::ConstVec labels,
                   typename TTypes<T>::Vec scratch, typename TTypes<T>::Vec loss,
                   typename TTypes<T>::Matrix backprop) {
-    SparseXentEigenImpl<CPUDevice, T, Index>::Compute(ctx, logits, labels,
-                                                      scratch, loss, backprop);
+    // Half precision values are accumulated in float.
+    typedef typename std::conditional<std::is_same<T, Eigen::half>::value,
+                                      float, T>::type Acc;
+    // Reductions are evaluated into a fixed size scalar on the stack, rather
+    // than a rank 0 Eigen::Tensor that would be heap allocated for every block.
+    typedef Eigen::TensorFixedSize<Acc, Eigen::Sizes<>, Eigen::RowMajor>
+        Scalar;
+    constexpr int64 kBlockSize = 16384;
+    const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+    const int64 batch_size = logits.dimension(0);
+    const int64 num_classes = logits.dimension(1);
+    const int64 num_blocks = MathUtil::CeilOfRatio(num_classes, kBlockSize);
+    const int64 block_size = MathUtil::CeilOfRatio(num_classes, num_blocks);
+    const Acc kInfinity = Eigen::NumTraits<Acc>::infinity();
+
+    // The max of the logits of each block, and the sum of their exponentials
+    // relative to that max.
+    std::vector<Acc> block_max(batch_size * num_blocks);
+    std::vector<Acc> block_sum_exp(batch_size * num_blocks);
+    auto reduce_blocks = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        const int64 offset = (i % num_blocks) * block_size;
+        const auto x = typename TTypes<T>::UnalignedConstVec(
+                           &logits(i / num_blocks, offset),
+                           std::min(block_size, num_classes - offset))
+                           .template cast<Acc>();
+        Scalar reduced;
+        reduced = x.maximum();
+        block_max[i] = reduced();
+        if (block_max[i] == -kInfinity) {
+          block_sum_exp[i] = Acc(0);
+        } else {
+          reduced = (x - block_max[i]).exp().sum();
+          block_sum_exp[i] = reduced();
+        }
+      }
+    };
+    const int64 exp_cost = Eigen::internal::functor_traits<
+        Eigen::internal::scalar_exp_op<Acc>>::Cost;
+    d.parallelFor(batch_size * num_blocks,
+                  Eigen::TensorOpCost(block_size * sizeof(T), 0,
+                                      block_size * (exp_cost + 2)),
+                  reduce_blocks);
+
+    // Combines the blocks of each row into max_logits + log_sum_exp, and
+    // computes the loss, before backprop may overwrite the logits.
+    std::vector<Acc> row_log_normalizer(batch_size);
+    for (int64 row = 0; row < batch_size; ++row) {
+      const Acc* max = &block_max[row * num_blocks];
+      const Acc* sum_exp = &block_sum_exp[row * num_blocks];
+      const Acc row_max = *std::max_element(max, max + num_blocks);
+      Acc sum = 0;
+      for (int64 block = 0; block < num_blocks; ++block) {
+        if (max[block] != -kInfinity) {
+          sum += sum_exp[block] * Eigen::numext::exp(max[block] - row_max);
+        }
+      }
+      row_log_normalizer[row] = row_max + Eigen::numext::log(sum);
+      const Index label = internal::SubtleMustCopy(labels(row));
+      loss(row) = FastBoundsCheck(label, num_classes)
+                      ? static_cast<T>(row_log_normalizer[row] -
+                                       static_cast<Acc>(logits(row, label)))
+                      : Eigen::NumTraits<T>::quiet_NaN();
+    }
+
+    // backprop = exp(logits - max_logits - log_sum_exp) - 1{j == label}.
+    auto compute_blocks = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        const int64 row = i / num_blocks;
+        const int64 offset = (i % num_blocks) * block_size;
+        const int64 size = std::min(block_size, num_classes - offset);
+        typename TTypes<T>::UnalignedVec out(&backprop(row, offset), size);
+        const Index label = internal::SubtleMustCopy(labels(row));
+        if (!FastBoundsCheck(label, num_classes)) {
+          out.setConstant(Eigen::NumTraits<T>::quiet_NaN());
+          continue;
+        }
+        out = (typename TTypes<T>::UnalignedConstVec(&logits(row, offset),
+                                                     size)
+                   .template cast<Acc>() -
+               row_log_normalizer[row])
+                  .exp()
+                  .template cast<T>();
+        if (label >= offset && label < offset + size) {
+          out(label - offset) = static_cast<T>(
+              static_cast<Acc>(out(label - offset)) - Acc(1));
+        }
+      }
+    };
+    d.parallelFor(batch_size * num_blocks,
+                  Eigen::TensorOpCost(block_size * sizeof(T),
+                                      block_size * sizeof(T),
+                                      block_size * (exp_cost + 2)),
+                  compute_blocks);
   }
 };
 }  // namespace functor
@@ -64,10 +64,11 @@ Tensor GetTestTensor(int batch) {
   return t;
 }
 
-Graph* SetupStringSplitGraph(const Tensor& input) {
+Graph* SetupStringSplitGraph(const Tensor& input,
+                             const string& delimiter = " ") {
   Graph* g = new Graph(OpRegistry::Global());
   Tensor delim(DT_STRING, TensorShape({}));
-  delim.flat<tstring>().setConstant(" ");
+  delim.flat<tstring>().setConstant(delimiter);
 
   TF_CHECK_OK(NodeBuilder("string_split_op", "StringSplit")
                   .Input(test::graph::Constant(g, input))
@@ -95,6 +96,23 @@ BENCHMARK(BM_StringSplit)
     ->Arg(128)
     ->Arg(256);
 
+// Splits on whitespace and punctuation, as done when tokenizing text.
+static void BM_StringSplitOnCharSet(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+
+  Tensor input = GetTestTensor(batch_size);
+  Graph* g = SetupStringSplitGraph(input, " \t\n.,;:!?()[]*");
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()));
+}
+
+BENCHMARK(BM_StringSplitOnCharSet)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(4096);
+
 Graph* SetupStringSplitV2Graph(const Tensor& input) {
   Graph* g = new Graph(OpRegistry::Global());
   Tensor sep(DT_STRING, TensorShape({}));
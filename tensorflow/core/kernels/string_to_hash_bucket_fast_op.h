@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -45,17 +46,34 @@ class StringToHashBucketOp : public OpKernel {
     auto output_flat = output_tensor->flat<int64>();
 
     typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    auto hash_range = [this, &input_flat, &output_flat](int64 start,
+                                                         int64 end) {
+      for (Index i = start; i < end; ++i) {
+        const uint64 input_hash = hash(input_flat(i));
+        const uint64 bucket_id = input_hash % num_buckets_;
+        // The number of buckets is always in the positive range of int64 so
+        // is the resulting bucket_id. Casting the bucket_id from uint64 to
+        // int64 is safe.
+        output_flat(i) = static_cast<int64>(bucket_id);
+      }
+    };
+    // Large batches of tokens are hashed in parallel, with a cost estimated
+    // from the average string length.
+    const int64 size = input_flat.size();
+    int64 total_bytes = 0;
+    for (Index i = 0; i < size; ++i) total_bytes += input_flat(i).size();
+    const int64 cost_per_unit =
+        kCostPerString + (size > 0 ? total_bytes / size : 0);
+    const auto& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, size,
+          cost_per_unit, hash_range);
   }
 
  private:
+  // Fixed cost of hashing a string and computing its bucket.
+  static constexpr int64 kCostPerString = 20;
+
   int64 num_buckets_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(StringToHashBucketOp);
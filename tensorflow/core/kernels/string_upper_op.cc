@@ -17,11 +17,11 @@ limitations under the License.
 
 #include <string>
 
-#include "absl/strings/ascii.h"
 #include "unicode/unistr.h"  // from @icu
 #include "tensorflow/core/framework/kernel_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/string_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/str_util.h"
@@ -48,9 +48,12 @@ class StringUpperOp : public OpKernel {
     const auto input = input_tensor->flat<tstring>();
     auto output = output_tensor->flat<tstring>();
     if (encoding_.empty()) {
+      // Folds the bytes straight into the output strings, without going
+      // through a temporary std::string.
       for (int64 i = 0; i < input.size(); ++i) {
-        StringPiece entry(input(i));
-        output(i) = absl::AsciiStrToUpper(entry);
+        const tstring& entry = input(i);
+        output(i).resize_uninitialized(entry.size());
+        AsciiToUpper(entry.data(), entry.size(), output(i).mdata());
       }
     } else {
       // The validation of utf-8 has already been done in GetAttr above.
@@ -31,6 +31,24 @@ enum class CharUnit { BYTE, UTF8_CHAR };
 // Whether or not the given byte is the trailing byte of a UTF-8/16/32 char.
 inline bool IsTrailByte(char x) { return static_cast<signed char>(x) < -0x40; }
 
+// Copies the `size` bytes of `in` to `out`, mapping 'A'-'Z' to 'a'-'z' and
+// leaving all other bytes (including non-ASCII ones) unchanged. The loop is
+// branch free so that compilers vectorize it; `in` and `out` may be equal.
+inline void AsciiToLower(const char* in, size_t size, char* out) {
+  for (size_t i = 0; i < size; ++i) {
+    const unsigned char c = in[i];
+    out[i] = c | (static_cast<unsigned char>(c - 'A') < 26 ? 0x20 : 0);
+  }
+}
+
+// Same as AsciiToLower, mapping 'a'-'z' to 'A'-'Z'.
+inline void AsciiToUpper(const char* in, size_t size, char* out) {
+  for (size_t i = 0; i < size; ++i) {
+    const unsigned char c = in[i];
+    out[i] = c & ~(static_cast<unsigned char>(c - 'a') < 26 ? 0x20 : 0);
+  }
+}
+
 // Sets `encoding` based on `str`.
 Status ParseUnicodeEncoding(const string& str, UnicodeEncoding* encoding);
 
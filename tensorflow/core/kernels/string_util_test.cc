@@ -0,0 +1,162 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/string_util.h"
+
+#include <string>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+char ReferenceToLower(char c) {
+  return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+char ReferenceToUpper(char c) {
+  return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+// Returns all 256 byte values, starting at `first`.
+std::string AllBytes(int first) {
+  std::string bytes(256, '\0');
+  for (int i = 0; i < 256; ++i) bytes[i] = static_cast<char>(first + i);
+  return bytes;
+}
+
+TEST(StringUtilTest, AsciiCaseOfAllBytes) {
+  const std::string in = AllBytes(0);
+  std::string lower(in.size(), '\0');
+  std::string upper(in.size(), '\0');
+  AsciiToLower(in.data(), in.size(), &lower[0]);
+  AsciiToUpper(in.data(), in.size(), &upper[0]);
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(lower[i], ReferenceToLower(in[i])) << "byte " << i;
+    EXPECT_EQ(upper[i], ReferenceToUpper(in[i])) << "byte " << i;
+  }
+}
+
+TEST(StringUtilTest, AsciiCaseLeavesUtf8Unchanged) {
+  // UTF-8 "\u00c4rger \u00dcBER \u00d6l", followed by ASCII letters with the
+  // top bit set, which must not be folded either.
+  const std::string in =
+      "\xc3\x84rger \xc3\x9c" "BER \xc3\x96l \xc1\xe1\xda\xfa";
+  std::string out(in.size(), '\0');
+  AsciiToLower(in.data(), in.size(), &out[0]);
+  EXPECT_EQ(out, "\xc3\x84rger \xc3\x9c" "ber \xc3\x96l \xc1\xe1\xda\xfa");
+  AsciiToUpper(in.data(), in.size(), &out[0]);
+  EXPECT_EQ(out, "\xc3\x84RGER \xc3\x9c" "BER \xc3\x96L \xc1\xe1\xda\xfa");
+}
+
+TEST(StringUtilTest, AsciiCaseOfAllLengthsAndAlignments) {
+  // Covers the vectorized loop body and its scalar remainder, for lengths
+  // that are not a multiple of the vector or word size, at every alignment.
+  const std::string bytes = AllBytes(37);
+  for (size_t offset = 0; offset < 16; ++offset) {
+    for (size_t size = 0; size + offset <= 100; ++size) {
+      const char* in = bytes.data() + offset;
+      // Guard bytes around the output catch writes past either end.
+      std::string lower(size + 2, '#');
+      std::string upper(size + 2, '#');
+      AsciiToLower(in, size, &lower[1]);
+      AsciiToUpper(in, size, &upper[1]);
+      ASSERT_EQ(lower.front(), '#');
+      ASSERT_EQ(lower.back(), '#') << "offset " << offset << ", size " << size;
+      ASSERT_EQ(upper.front(), '#');
+      ASSERT_EQ(upper.back(), '#') << "offset " << offset << ", size " << size;
+      for (size_t i = 0; i < size; ++i) {
+        ASSERT_EQ(lower[i + 1], ReferenceToLower(in[i]))
+            << "offset " << offset << " size " << size << " index " << i;
+        ASSERT_EQ(upper[i + 1], ReferenceToUpper(in[i]))
+            << "offset " << offset << " size " << size << " index " << i;
+      }
+    }
+  }
+}
+
+TEST(StringUtilTest, AsciiCaseInPlace) {
+  std::string s = "Hello, World! \xc3\x84";
+  AsciiToLower(s.data(), s.size(), &s[0]);
+  EXPECT_EQ(s, "hello, world! \xc3\x84");
+  AsciiToUpper(s.data(), s.size(), &s[0]);
+  EXPECT_EQ(s, "HELLO, WORLD! \xc3\x84");
+}
+
+void BM_AsciiToLower(::testing::benchmark::State& state) {
+  const int size = state.range(0);
+  std::string in;
+  while (in.size() < static_cast<size_t>(size)) {
+    in += "The Quick Brown Fox Jumps Over The Lazy Dog. ";
+  }
+  in.resize(size);
+  std::string out(size, '\0');
+  for (auto s : state) {
+    AsciiToLower(in.data(), in.size(), &out[0]);
+    testing::DoNotOptimize(out);
+  }
+  state.SetBytesProcessed(static_cast<int64>(state.iterations()) * size);
+}
+BENCHMARK(BM_AsciiToLower)->Arg(7)->Arg(16)->Arg(61)->Arg(256)->Arg(4096);
+
+// Folds the case of a batch of `batch_size` strings of `length` bytes with the
+// StringLower or StringUpper op.
+void BM_StringCase(::testing::benchmark::State& state, const string& op) {
+  const int batch_size = state.range(0);
+  const int length = state.range(1);
+  Tensor input(DT_STRING, TensorShape({batch_size}));
+  auto flat = input.flat<tstring>();
+  for (int i = 0; i < batch_size; ++i) {
+    std::string s;
+    while (s.size() < static_cast<size_t>(length)) {
+      s += "Mixed Case \xc3\x84 Text ";
+    }
+    s.resize(length);
+    flat(i) = s;
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), op)
+                  .Input(test::graph::Constant(g, input))
+                  .Finalize(g, nullptr /* node */));
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetBytesProcessed(static_cast<int64>(state.iterations()) * batch_size *
+                          length);
+}
+
+void BM_StringLower(::testing::benchmark::State& state) {
+  BM_StringCase(state, "StringLower");
+}
+BENCHMARK(BM_StringLower)
+    ->UseRealTime()
+    ->ArgPair(1024, 8)
+    ->ArgPair(1024, 64)
+    ->ArgPair(1024, 1000);
+
+void BM_StringUpper(::testing::benchmark::State& state) {
+  BM_StringCase(state, "StringUpper");
+}
+BENCHMARK(BM_StringUpper)
+    ->UseRealTime()
+    ->ArgPair(1024, 8)
+    ->ArgPair(1024, 64)
+    ->ArgPair(1024, 1000);
+
+}  // namespace
+}  // namespace tensorflow
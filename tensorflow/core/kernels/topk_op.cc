@@ -20,8 +20,10 @@ limitations under the License.
 #include "tensorflow/core/kernels/topk_op.h"
 
 #include <algorithm>
+#include <memory>
 #include <numeric>
 #include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -36,6 +38,75 @@ namespace tensorflow {
 typedef Eigen::ThreadPoolDevice CPUDevice;
 typedef Eigen::GpuDevice GPUDevice;
 
+namespace {
+
+// Minimum number of columns processed by each thread when a single row is
+// split across threads.
+constexpr int64 kMinTopKColumnsPerShard = 32 << 10;
+
+// Returns the number of shards a row of `num_cols` columns should be split in
+// to compute its top k in parallel, or 1 if it isn't worth it.
+int64 NumTopKRowShards(int num_threads, int64 num_cols, int k) {
+  // Each shard keeps its own top k, and k candidates per shard are merged, so
+  // shards should be much wider than k.
+  return std::max<int64>(
+      1, std::min<int64>({num_threads, num_cols / kMinTopKColumnsPerShard,
+                          num_cols / (4 * static_cast<int64>(k))}));
+}
+
+// Writes the indices of the k largest values of the row `input_data` (ties
+// broken by the smaller index) to `indices`, in sorted order. The columns are
+// split in `num_shards` shards, which each select their own top k in parallel,
+// and the candidates of all shards are then merged. Since the order is total,
+// this returns the same indices as a single pass over the row.
+template <typename T>
+void ParallelTopKOfRow(OpKernelContext* context, const T* input_data,
+                       int64 num_cols, int k, int64 num_shards,
+                       int32* indices) {
+  const auto stable_comp = [input_data](const int32 a, const int32 b) {
+    if (input_data[b] < input_data[a]) {
+      return true;
+    } else if (input_data[b] > input_data[a]) {
+      return false;
+    } else {
+      return a < b;
+    }
+  };
+  const int64 cols_per_shard = (num_cols + num_shards - 1) / num_shards;
+  std::vector<std::vector<int32>> candidates(num_shards);
+  const auto select_shards = [&](int64 start_shard, int64 limit_shard) {
+    for (int64 shard = start_shard; shard < limit_shard; ++shard) {
+      const int32 begin = shard * cols_per_shard;
+      const int32 end = std::min(num_cols, begin + cols_per_shard);
+      gtl::TopN<int32, decltype(stable_comp)> filter(k, stable_comp);
+      filter.reserve(k + 1);
+      for (int32 c = begin; c < end; ++c) {
+        filter.push(c);
+      }
+      std::unique_ptr<std::vector<int32>> top_k(filter.ExtractUnsorted());
+      candidates[shard] = std::move(*top_k);
+    }
+  };
+  const double cost_per_shard =
+      cols_per_shard * (3 * Eigen::TensorOpCost::AddCost<int32>() +
+                        Eigen::TensorOpCost::AddCost<T>());
+  auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+  Shard(worker_threads.num_threads, worker_threads.workers, num_shards,
+        static_cast<int64>(cost_per_shard), select_shards);
+
+  gtl::TopN<int32, decltype(stable_comp)> filter(k, stable_comp);
+  filter.reserve(k + 1);
+  for (const auto& shard_candidates : candidates) {
+    for (const int32 c : shard_candidates) {
+      filter.push(c);
+    }
+  }
+  std::unique_ptr<std::vector<int32>> top_k(filter.Extract());
+  std::copy(top_k->begin(), top_k->end(), indices);
+}
+
+}  // namespace
+
 template <typename Device, typename T>
 class TopK : public OpKernel {
  public:
@@ -136,6 +207,24 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // When there are fewer rows than threads, wide rows are split across
+    // threads instead.
+    const int64 num_row_shards =
+        (k < num_cols && num_rows < worker_threads.num_threads)
+            ? NumTopKRowShards(worker_threads.num_threads, num_cols, k)
+            : 1;
+    if (num_row_shards > 1) {
+      for (int64 b = 0; b < num_rows; ++b) {
+        ParallelTopKOfRow(context, &input(b, 0), num_cols, k, num_row_shards,
+                          &indices(b, 0));
+        std::transform(&indices(b, 0), &indices(b, k), &values(b, 0),
+                       [b, &input](const int32 loc) { return input(b, loc); });
+      }
+      return Status::OK();
+    }
+
     auto SortIndices = [&](int64 start_batch, int64 limit_batch) {
       for (int32 b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
@@ -221,7 +310,6 @@ struct TopKFunctor<CPUDevice, T> {
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
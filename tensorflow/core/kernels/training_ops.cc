@@ -17,6 +17,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/training_ops.h"
 
 #include <algorithm>  // NOLINT
+#include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -40,6 +41,72 @@ inline T sgn(const T x) {
   T one(1);
   return (x == zero ? zero : (x < zero ? -one : one));
 }
+
+// Minimum number of updated elements (rows times inner dimension) for which
+// the sparse updates are sharded.
+constexpr int64 kMinParallelSparseApplySize = 16 << 10;
+
+// Calls `update(i, index)` for each offset i of `indices`, where index is the
+// (validated) row updated by the i-th gradient slice, or returns an error if
+// an index is out of range.
+//
+// Large updates are sharded over rows: the offsets are grouped by a hash of
+// their row, keeping their order, and each group is processed by a single
+// thread. The updates of duplicate indices are thus applied in order like in a
+// serial loop, and never race with each other.
+template <typename Tindex, typename Update>
+Status ShardSparseRowUpdates(const CPUDevice& d,
+                             typename TTypes<Tindex>::ConstVec indices,
+                             Tindex first_dim_size, int64 inner_dim,
+                             const Eigen::TensorOpCost& cost_per_row,
+                             const Update& update) {
+  const Tindex N = static_cast<Tindex>(indices.dimension(0));
+  std::vector<Tindex> rows(N);
+  for (Tindex i = 0; i < N; ++i) {
+    rows[i] = internal::SubtleMustCopy(indices(i));
+    if (!FastBoundsCheck(rows[i], first_dim_size)) {
+      return errors::InvalidArgument(strings::StrCat(
+          "Index ", rows[i], " at offset ", i, " in indices is out of range"));
+    }
+  }
+  const int64 num_groups =
+      std::min<int64>(N, static_cast<int64>(d.numThreads()) * 4);
+  if (num_groups <= 1 || N * inner_dim < kMinParallelSparseApplySize) {
+    for (Tindex i = 0; i < N; ++i) update(i, rows[i]);
+    return Status::OK();
+  }
+
+  // Counting sort of the offsets by group.
+  const auto group_of = [num_groups](Tindex row) -> int64 {
+    const uint64 hash = static_cast<uint64>(row) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<int64>((hash >> 32) % num_groups);
+  };
+  std::vector<Tindex> group_offsets(num_groups + 1, 0);
+  for (Tindex i = 0; i < N; ++i) ++group_offsets[group_of(rows[i]) + 1];
+  for (int64 g = 0; g < num_groups; ++g) {
+    group_offsets[g + 1] += group_offsets[g];
+  }
+  std::vector<Tindex> offsets(N);
+  {
+    std::vector<Tindex> next(group_offsets.begin(), group_offsets.end() - 1);
+    for (Tindex i = 0; i < N; ++i) offsets[next[group_of(rows[i])]++] = i;
+  }
+
+  const double rows_per_group = static_cast<double>(N) / num_groups;
+  const Eigen::TensorOpCost cost_per_group(
+      cost_per_row.bytes_loaded() * rows_per_group,
+      cost_per_row.bytes_stored() * rows_per_group,
+      cost_per_row.compute_cycles() * rows_per_group);
+  d.parallelFor(num_groups, cost_per_group, [&](int64 begin, int64 end) {
+    for (int64 g = begin; g < end; ++g) {
+      for (Tindex k = group_offsets[g]; k < group_offsets[g + 1]; ++k) {
+        const Tindex i = offsets[k];
+        update(i, rows[i]);
+      }
+    }
+  });
+  return Status::OK();
+}
 }  // namespace
 
 namespace functor {
@@ -182,46 +249,26 @@ struct SparseApplyAdagrad<CPUDevice, T, Tindex, has_epsilon> {
     const Eigen::TensorOpCost cost(in_bytes, out_bytes, cycles);
 
     if (inner_dim > 1) {
-      for (Tindex i = 0; i < N; ++i) {
-        const Tindex index = internal::SubtleMustCopy(indices(i));
-        if (!FastBoundsCheck(index, first_dim_size)) {
-          return errors::InvalidArgument(
-              strings::StrCat("Index ", index, " at offset ", i,
-                              " in indices is out of range"));
-        }
-      }
-
-      const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
-        for (Tindex i = start_idx; i < end_idx; ++i) {
-          const Tindex index = internal::SubtleMustCopy(indices(i));
-          auto a = accum.template chip<0>(index);
-          auto g = grad.template chip<0>(i);
-          auto v = var.template chip<0>(index);
-          if (update_slots) {
-            a += g.square();
-          }
-          if (has_epsilon) {
-            v -= g.constant(lr_scalar) * g / (a.sqrt() + a.constant(epsilon()));
-          } else {
-            v -= g.constant(lr_scalar) * g * a.rsqrt();
-          }
-        }
-      };
-
-      d.parallelFor(N, cost, shard);
-    } else {
-      for (Tindex i = 0; i < N; ++i) {
-        const Tindex index = internal::SubtleMustCopy(indices(i));
-        if (!FastBoundsCheck(index, first_dim_size)) {
-          return errors::InvalidArgument(
-              strings::StrCat("Index ", index, " at offset ", i,
-                              " in indices is out of range"));
-        }
-      }
-
-      const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
-        for (Tindex i = start_idx; i < end_idx; ++i) {
-          const Tindex index = internal::SubtleMustCopy(indices(i));
+      return ShardSparseRowUpdates<Tindex>(
+          d, indices, first_dim_size, inner_dim, cost,
+          [&](Tindex i, Tindex index) {
+            auto a = accum.template chip<0>(index);
+            auto g = grad.template chip<0>(i);
+            auto v = var.template chip<0>(index);
+            if (update_slots) {
+              a += g.square();
+            }
+            if (has_epsilon) {
+              v -= g.constant(lr_scalar) * g /
+                   (a.sqrt() + a.constant(epsilon()));
+            } else {
+              v -= g.constant(lr_scalar) * g * a.rsqrt();
+            }
+          });
+    }
+    return ShardSparseRowUpdates<Tindex>(
+        d, indices, first_dim_size, inner_dim, cost,
+        [&](Tindex i, Tindex index) {
           T& a = accum(index);
           const T& g = grad(i);
           if (update_slots) {
@@ -232,13 +279,7 @@ struct SparseApplyAdagrad<CPUDevice, T, Tindex, has_epsilon> {
           } else {
             var(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
           }
-        }
-      };
-
-      d.parallelFor(N, cost, shard);
-    }
-
-    return Status::OK();
+        });
   }
 };
 
@@ -286,59 +327,54 @@ struct SparseApplyProximalAdagrad<CPUDevice, T, Tindex> {
     const T lr_scalar = lr();
     const T l1_scalar = l1();
     const T l2_scalar = l2();
+    const Eigen::TensorOpCost cost(
+        inner_dim * sizeof(T) * 3, inner_dim * sizeof(T) * 2,
+        inner_dim * (Eigen::TensorOpCost::AddCost<T>() * 4 +
+                     Eigen::TensorOpCost::MulCost<T>() * 4 +
+                     Eigen::TensorOpCost::DivCost<T>() * 2));
     if (inner_dim > 1) {
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = internal::SubtleMustCopy(indices(i));
-        if (!FastBoundsCheck(index, first_dim_size)) {
-          return errors::InvalidArgument(
-              strings::StrCat("Index ", index, " at offset ", i,
-                              " in indices is out of range"));
-        }
-        auto a = accum.template chip<0>(index);
-        auto g = grad.template chip<0>(i);
-        auto v = var.template chip<0>(index);
-        a += g.square();
-        // compute learning_rate for current step.
-        auto learning_rate = a.constant(lr_scalar) * a.rsqrt();
-        auto prox_v = v;
-        // v = w - g * learning_rate.
-        prox_v -= g * learning_rate;
-        if (l1_scalar > 0) {
-          // compute sign(v) * max(|v|, 0)
-          v = prox_v.sign() *
-              (prox_v.abs() - learning_rate * prox_v.constant(l1_scalar))
-                  .cwiseMax(static_cast<T>(0.0)) /
-              (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
-        } else {
-          v = prox_v /
-              (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
-        }
-      }
-    } else {
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = internal::SubtleMustCopy(indices(i));
-        if (!FastBoundsCheck(index, first_dim_size)) {
-          return errors::InvalidArgument(
-              strings::StrCat("Index ", index, " at offset ", i,
-                              " in indices is out of range"));
-        }
-        T& a = accum(index);
-        const T& g = grad(i);
-        a += g * g;
-        auto learning_rate = lr_scalar / std::sqrt(a);
-        auto prox_v = var(index);
-        prox_v -= learning_rate * g;
-        if (l1_scalar > 0) {
-          var(index) = sgn(prox_v) *
-                       std::max(std::abs(prox_v) - learning_rate * l1_scalar,
-                                static_cast<T>(0.0)) /
-                       (1.0 + l2_scalar * learning_rate);
-        } else {
-          var(index) = prox_v / (1.0 + l2_scalar * learning_rate);
-        }
-      }
+      return ShardSparseRowUpdates<Tindex>(
+          d, indices, first_dim_size, inner_dim, cost,
+          [&](Tindex i, Tindex index) {
+            auto a = accum.template chip<0>(index);
+            auto g = grad.template chip<0>(i);
+            auto v = var.template chip<0>(index);
+            a += g.square();
+            // compute learning_rate for current step.
+            auto learning_rate = a.constant(lr_scalar) * a.rsqrt();
+            auto prox_v = v;
+            // v = w - g * learning_rate.
+            prox_v -= g * learning_rate;
+            if (l1_scalar > 0) {
+              // compute sign(v) * max(|v|, 0)
+              v = prox_v.sign() *
+                  (prox_v.abs() - learning_rate * prox_v.constant(l1_scalar))
+                      .cwiseMax(static_cast<T>(0.0)) /
+                  (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+            } else {
+              v = prox_v /
+                  (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+            }
+          });
     }
-    return Status::OK();
+    return ShardSparseRowUpdates<Tindex>(
+        d, indices, first_dim_size, inner_dim, cost,
+        [&](Tindex i, Tindex index) {
+          T& a = accum(index);
+          const T& g = grad(i);
+          a += g * g;
+          auto learning_rate = lr_scalar / std::sqrt(a);
+          auto prox_v = var(index);
+          prox_v -= learning_rate * g;
+          if (l1_scalar > 0) {
+            var(index) = sgn(prox_v) *
+                         std::max(std::abs(prox_v) - learning_rate * l1_scalar,
+                                  static_cast<T>(0.0)) /
+                         (1.0 + l2_scalar * learning_rate);
+          } else {
+            var(index) = prox_v / (1.0 + l2_scalar * learning_rate);
+          }
+        });
   }
 };
 
@@ -608,75 +644,75 @@ struct SparseApplyFtrl<CPUDevice, T, Tindex, has_l2_shrinkage> {
         l2_shrinkage_scalar = l2_shrinkage();
       }
       T lr_power_scalar = lr_power();
+      const Eigen::TensorOpCost cost(
+          inner_dim * sizeof(T) * 4, inner_dim * sizeof(T) * 3,
+          inner_dim * (Eigen::TensorOpCost::AddCost<T>() * 8 +
+                       Eigen::TensorOpCost::MulCost<T>() * 8 +
+                       Eigen::TensorOpCost::DivCost<T>() * 4));
       if (inner_dim > 1) {
         const Tindex first_dim_size =
             static_cast<Tindex>(var_flat.dimension(0));
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          if (!FastBoundsCheck(index, first_dim_size)) {
-            return errors::InvalidArgument(
-                strings::StrCat("Index ", index, " at offset ", i,
-                                " in indices is out of range"));
-          }
-          auto accum = accum_flat.template chip<0>(index);
-          auto linear = linear_flat.template chip<0>(index);
-          auto grad = grad_flat.template chip<0>(i);
-          auto var = var_flat.template chip<0>(index);
-
-          if (has_l2_shrinkage) {
-            auto grad_with_shrinkage =
-                grad + static_cast<T>(2) * l2_shrinkage_scalar * var;
-            ComputeFtrl(/*grad=*/grad,
-                        /*grad_maybe_with_shrinkage=*/grad_with_shrinkage,
-                        /*accum=*/accum, /*linear=*/linear, /*var=*/var,
-                        /*l1_scalar=*/l1_scalar, /*l2_scalar=*/l2_scalar,
-                        /*multiply_linear_by_lr=*/multiply_linear_by_lr,
-                        /*lr_power_scalar=*/lr_power_scalar,
-                        /*lr_scalar=*/lr_scalar);
-          } else {
-            ComputeFtrl(/*grad=*/grad, /*grad_maybe_with_shrinkage=*/grad,
-                        /*accum=*/accum, /*linear=*/linear, /*var=*/var,
-                        /*l1_scalar=*/l1_scalar, /*l2_scalar=*/l2_scalar,
-                        /*multiply_linear_by_lr=*/multiply_linear_by_lr,
-                        /*lr_power_scalar=*/lr_power_scalar,
-                        /*lr_scalar=*/lr_scalar);
-          }
-        }
+        return ShardSparseRowUpdates<Tindex>(
+            d, indices_vec, first_dim_size, inner_dim, cost,
+            [&](Tindex i, Tindex index) {
+              auto accum = accum_flat.template chip<0>(index);
+              auto linear = linear_flat.template chip<0>(index);
+              auto grad = grad_flat.template chip<0>(i);
+              auto var = var_flat.template chip<0>(index);
+
+              if (has_l2_shrinkage) {
+                auto grad_with_shrinkage =
+                    grad + static_cast<T>(2) * l2_shrinkage_scalar * var;
+                ComputeFtrl(/*grad=*/grad,
+                            /*grad_maybe_with_shrinkage=*/grad_with_shrinkage,
+                            /*accum=*/accum, /*linear=*/linear, /*var=*/var,
+                            /*l1_scalar=*/l1_scalar, /*l2_scalar=*/l2_scalar,
+                            /*multiply_linear_by_lr=*/multiply_linear_by_lr,
+                            /*lr_power_scalar=*/lr_power_scalar,
+                            /*lr_scalar=*/lr_scalar);
+              } else {
+                ComputeFtrl(/*grad=*/grad, /*grad_maybe_with_shrinkage=*/grad,
+                            /*accum=*/accum, /*linear=*/linear, /*var=*/var,
+                            /*l1_scalar=*/l1_scalar, /*l2_scalar=*/l2_scalar,
+                            /*multiply_linear_by_lr=*/multiply_linear_by_lr,
+                            /*lr_power_scalar=*/lr_power_scalar,
+                            /*lr_scalar=*/lr_scalar);
+              }
+            });
       } else {
         const Tindex first_dim_size = accum_flat.size();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          if (!FastBoundsCheck(index, first_dim_size)) {
-            return errors::InvalidArgument(
-                strings::StrCat("Index ", index, " at offset ", i,
-                                " in indices is out of range"));
-          }
-          T& a = accum_flat(index);
-          T& l = linear_flat(index);
-          T& v = var_flat(index);
-          T g;
-          if (has_l2_shrinkage) {
-            g = grad_flat(i) +
-                (static_cast<T>(2) * l2_shrinkage_scalar * var_flat(index));
-          } else {
-            g = grad_flat(i);
-          }
-
-          T updated_a = a + grad_flat(i) * grad_flat(i);
-          using Eigen::numext::pow;
-          T sigma = pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
-          if (!multiply_linear_by_lr) {
-            sigma /= lr_scalar;
-          }
-          T updated_l = (multiply_linear_by_lr ? l + g * lr_scalar - sigma * v
-                                               : l + g - sigma * v);
-          v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar, l2_scalar,
-                          lr_power_scalar, multiply_linear_by_lr);
-          a = updated_a;
-          l = updated_l;
-        }
+        return ShardSparseRowUpdates<Tindex>(
+            d, indices_vec, first_dim_size, inner_dim, cost,
+            [&](Tindex i, Tindex index) {
+              T& a = accum_flat(index);
+              T& l = linear_flat(index);
+              T& v = var_flat(index);
+              T g;
+              if (has_l2_shrinkage) {
+                g = grad_flat(i) +
+                    (static_cast<T>(2) * l2_shrinkage_scalar * var_flat(index));
+              } else {
+                g = grad_flat(i);
+              }
+
+              T updated_a = a + grad_flat(i) * grad_flat(i);
+              using Eigen::numext::pow;
+              T sigma =
+                  pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
+              if (!multiply_linear_by_lr) {
+                sigma /= lr_scalar;
+              }
+              T updated_l =
+                  (multiply_linear_by_lr ? l + g * lr_scalar - sigma * v
+                                         : l + g - sigma * v);
+              v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar,
+                              l2_scalar, lr_power_scalar,
+                              multiply_linear_by_lr);
+              a = updated_a;
+              l = updated_l;
+            });
       }
     }
     return Status::OK();
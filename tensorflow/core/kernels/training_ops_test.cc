@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -80,6 +81,16 @@ static Node* Iota(Graph* g, int n) {
   return test::graph::Constant(g, data);
 }
 
+// Returns n indices drawn from [0, num_rows), with duplicates.
+static Node* RandomIndices(Graph* g, int n, int num_rows) {
+  Tensor data(DT_INT32, TensorShape({n}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  int32* base = data.flat<int32>().data();
+  for (int i = 0; i < n; ++i) base[i] = rnd.Uniform(num_rows);
+  return test::graph::Constant(g, data);
+}
+
 static Node* Scalar(Graph* g, float val) {
   Tensor data(DT_FLOAT, TensorShape({}));
   data.flat<float>()(0) = val;
@@ -198,6 +209,94 @@ BENCHMARK(BM_SparseAdagrad)
     ->ArgPair(128, 32 << 10)
     ->ArgPair(128, 128 << 10);
 
+// Embedding tables: updates of 16K random rows (with duplicates) of a table of
+// 256K rows of dimension n.
+constexpr int kEmbeddingRows = 256 << 10;
+constexpr int kEmbeddingUpdates = 16 << 10;
+
+static void SparseAdagradEmbedding(int32 n, Graph** init_g, Graph** train_g) {
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = Var(g, kEmbeddingRows, n);
+    auto accum = Var(g, kEmbeddingRows, n);
+    test::graph::Assign(g, var, Zeros(g, kEmbeddingRows, n));
+    test::graph::Assign(g, accum, Zeros(g, kEmbeddingRows, n));
+    *init_g = g;
+  }
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = Var(g, kEmbeddingRows, n);
+    auto accum = Var(g, kEmbeddingRows, n);
+    auto lr = Scalar(g, 0.01);
+    auto grad = Random(g, kEmbeddingUpdates, n);
+    auto indices = RandomIndices(g, kEmbeddingUpdates, kEmbeddingRows);
+    test::graph::Multi(g, "SparseApplyAdagrad",
+                       {var, accum, lr, grad, indices});
+    *train_g = g;
+  }
+}
+static void BM_SparseAdagradEmbedding(::testing::benchmark::State& state) {
+  const int n = state.range(0);
+
+  Graph* init;
+  Graph* train;
+  SparseAdagradEmbedding(n, &init, &train);
+  test::Benchmark("cpu", train, GetMultiThreadedOptions(), init, nullptr, "",
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  const int64 tot = static_cast<int64>(state.iterations()) * kEmbeddingUpdates *
+                    n;
+  state.SetItemsProcessed(tot);
+  state.SetBytesProcessed(tot * sizeof(float));
+}
+BENCHMARK(BM_SparseAdagradEmbedding)->UseRealTime()->Arg(16)->Arg(64)->Arg(256);
+
+static void SparseFtrlEmbedding(int32 n, Graph** init_g, Graph** train_g) {
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = Var(g, kEmbeddingRows, n);
+    auto accum = Var(g, kEmbeddingRows, n);
+    auto linear = Var(g, kEmbeddingRows, n);
+    Tensor initial_accum(DT_FLOAT, TensorShape({kEmbeddingRows, n}));
+    initial_accum.flat<float>().setConstant(0.1f);
+    test::graph::Assign(g, var, Zeros(g, kEmbeddingRows, n));
+    test::graph::Assign(g, accum, test::graph::Constant(g, initial_accum));
+    test::graph::Assign(g, linear, Zeros(g, kEmbeddingRows, n));
+    *init_g = g;
+  }
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = Var(g, kEmbeddingRows, n);
+    auto accum = Var(g, kEmbeddingRows, n);
+    auto linear = Var(g, kEmbeddingRows, n);
+    auto grad = Random(g, kEmbeddingUpdates, n);
+    auto indices = RandomIndices(g, kEmbeddingUpdates, kEmbeddingRows);
+    auto lr = Scalar(g, 0.01);
+    auto l1 = Scalar(g, 0.001);
+    auto l2 = Scalar(g, 0.001);
+    auto lr_power = Scalar(g, -0.5);
+    test::graph::Multi(
+        g, "SparseApplyFtrl",
+        {var, accum, linear, grad, indices, lr, l1, l2, lr_power});
+    *train_g = g;
+  }
+}
+static void BM_SparseFtrlEmbedding(::testing::benchmark::State& state) {
+  const int n = state.range(0);
+
+  Graph* init;
+  Graph* train;
+  SparseFtrlEmbedding(n, &init, &train);
+  test::Benchmark("cpu", train, GetMultiThreadedOptions(), init, nullptr, "",
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  const int64 tot = static_cast<int64>(state.iterations()) * kEmbeddingUpdates *
+                    n;
+  state.SetItemsProcessed(tot);
+  state.SetBytesProcessed(tot * sizeof(float));
+}
+BENCHMARK(BM_SparseFtrlEmbedding)->UseRealTime()->Arg(16)->Arg(64)->Arg(256);
+
 static void Momentum(int32 n, Graph** init_g, Graph** train_g) {
   TensorShape shape({n});
   {
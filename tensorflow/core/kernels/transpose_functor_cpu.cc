@@ -15,7 +15,9 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <complex>
+#include <type_traits>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/attr_value.pb.h"
@@ -25,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/math/math_util.h"
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
@@ -65,12 +68,209 @@ void TransposeSimple(const CPUDevice& device, const Tensor& in,
   device.parallelFor(in.NumElements(), cost, std::move(transpose_fn));
 }
 
+// Transposes the `rows` x `cols` tile `src`, whose rows are `src_stride`
+// elements apart, into `dst`, whose rows are `dst_stride` elements apart.
+template <typename T>
+void TransposeTile(const T* src, const int64 src_stride, const int64 rows,
+                   const int64 cols, T* dst, const int64 dst_stride) {
+  int64 r = 0;
+#ifdef EIGEN_VECTORIZE
+  // Square blocks of 4 or 8-byte elements are transposed in registers, as
+  // packets of floats or doubles, which only moves their bits.
+  typedef typename std::conditional<sizeof(T) == sizeof(float), float,
+                                    double>::type Scalar;
+  typedef typename Eigen::internal::packet_traits<Scalar>::type Packet;
+  constexpr int kPacketSize = Eigen::internal::unpacket_traits<Packet>::size;
+  if (sizeof(T) == sizeof(Scalar) && kPacketSize > 1) {
+    for (; r + kPacketSize <= rows; r += kPacketSize) {
+      int64 c = 0;
+      for (; c + kPacketSize <= cols; c += kPacketSize) {
+        Eigen::internal::PacketBlock<Packet, kPacketSize> block;
+        for (int i = 0; i < kPacketSize; ++i) {
+          block.packet[i] = Eigen::internal::ploadu<Packet>(
+              reinterpret_cast<const Scalar*>(src + (r + i) * src_stride + c));
+        }
+        Eigen::internal::ptranspose(block);
+        for (int i = 0; i < kPacketSize; ++i) {
+          Eigen::internal::pstoreu(
+              reinterpret_cast<Scalar*>(dst + (c + i) * dst_stride + r),
+              block.packet[i]);
+        }
+      }
+      for (; c < cols; ++c) {
+        for (int i = 0; i < kPacketSize; ++i) {
+          dst[c * dst_stride + r + i] = src[(r + i) * src_stride + c];
+        }
+      }
+    }
+  }
+#endif
+  for (; r < rows; ++r) {
+    for (int64 c = 0; c < cols; ++c) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+}
+
+// Transposes without the index computations of an Eigen shuffle for each
+// element. The dimensions of size 1 are dropped and the dimensions which stay
+// adjacent are merged, and the remaining matrix transposes are left to Eigen.
+// Otherwise, if the innermost dimension is kept, each row of the output is
+// copied from a row of the input. If not, the innermost dimensions of the input
+// and of the output are transposed by tiles which fit in the L1 cache. Both are
+// parallelized over the rows or tiles.
+template <typename T>
+void TransposeBlocked(const CPUDevice& device, const Tensor& in,
+                      const gtl::ArraySlice<int32> perm, Tensor* out) {
+  const T* p = reinterpret_cast<const T*>(in.tensor_data().data());
+  T* q = reinterpret_cast<T*>(const_cast<char*>((out->tensor_data().data())));
+  const int64 num_elements = in.NumElements();
+  if (num_elements == 0) return;
+
+  TensorShape shape;
+  internal::TransposePermsVec shape_perm;
+  internal::TransposePermsVec shape_index(in.dims(), -1);
+  for (int i = 0; i < in.dims(); ++i) {
+    if (in.dim_size(i) != 1) {
+      shape_index[i] = shape.dims();
+      shape.AddDim(in.dim_size(i));
+    }
+  }
+  for (const int32 d : perm) {
+    if (shape_index[d] >= 0) shape_perm.push_back(shape_index[d]);
+  }
+  internal::TransposePermsVec out_positions;
+  internal::TransposeDimsVec dims;
+  if (shape.dims() >= 2) {
+    internal::ReduceTransposeDimensions(shape, shape_perm, &out_positions,
+                                        &dims);
+  }
+  const int ndims = dims.size();
+  if (ndims < 2) {
+    // The transpose does not move any element.
+    device.memcpy(q, p, num_elements * sizeof(T));
+    return;
+  }
+  if (ndims == 2) {
+    // Eigen already transposes matrices efficiently.
+    Tensor in_matrix;
+    Tensor out_matrix;
+    CHECK(in_matrix.CopyFrom(in, TensorShape({dims[0], dims[1]})));
+    CHECK(out_matrix.CopyFrom(*out, TensorShape({dims[1], dims[0]})));
+    internal::TransposeUsingEigen<CPUDevice, T, 2>(
+        device, in_matrix, {1, 0}, /*conjugate=*/false, &out_matrix);
+    return;
+  }
+  // ReduceTransposeDimensions gives the position in the output of each merged
+  // dimension of the input, which is the inverse of their permutation.
+  internal::TransposePermsVec new_perm(ndims);
+  for (int i = 0; i < ndims; ++i) new_perm[out_positions[i]] = i;
+
+  internal::TransposeDimsVec in_strides(ndims);
+  internal::TransposeDimsVec out_strides(ndims);
+  in_strides[ndims - 1] = 1;
+  out_strides[ndims - 1] = 1;
+  for (int i = ndims - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * dims[i + 1];
+    out_strides[i] = out_strides[i + 1] * dims[new_perm[i + 1]];
+  }
+  // The output dimensions iterated over outside of the rows or tiles, with
+  // their strides in the input and in the output.
+  internal::TransposeDimsVec outer_dims;
+  internal::TransposeDimsVec outer_in_strides;
+  internal::TransposeDimsVec outer_out_strides;
+  const int inner_out_dim =
+      std::find(new_perm.begin(), new_perm.end(), ndims - 1) - new_perm.begin();
+  for (int i = 0; i < ndims - 1; ++i) {
+    if (i == inner_out_dim) continue;
+    outer_dims.push_back(dims[new_perm[i]]);
+    outer_in_strides.push_back(in_strides[new_perm[i]]);
+    outer_out_strides.push_back(out_strides[i]);
+  }
+  const int num_outer_dims = outer_dims.size();
+
+  if (inner_out_dim == ndims - 1) {
+    // Each row of the output is a row of the input.
+    const int64 row_size = dims[ndims - 1];
+    auto copy_rows = [&](int64 begin, int64 end) {
+      // The index of the row in the output dimensions, and its offset in the
+      // input, updated from one row to the next.
+      internal::TransposeDimsVec index(num_outer_dims);
+      int64 in_offset = 0;
+      for (int64 i = num_outer_dims - 1, t = begin; i >= 0; --i) {
+        index[i] = t % outer_dims[i];
+        t /= outer_dims[i];
+        in_offset += index[i] * outer_in_strides[i];
+      }
+      for (int64 row = begin; row < end; ++row) {
+        std::copy_n(p + in_offset, row_size, q + row * row_size);
+        for (int i = num_outer_dims - 1; i >= 0; --i) {
+          in_offset += outer_in_strides[i];
+          if (++index[i] < outer_dims[i]) break;
+          in_offset -= outer_dims[i] * outer_in_strides[i];
+          index[i] = 0;
+        }
+      }
+    };
+    const Eigen::TensorOpCost cost(
+        row_size * sizeof(T), row_size * sizeof(T),
+        num_outer_dims * 2 * Eigen::TensorOpCost::AddCost<int64>());
+    device.parallelFor(num_elements / row_size, cost, copy_rows);
+    return;
+  }
+
+  // The tiles are rows x cols submatrices of the input, where rows index the
+  // input dimension which becomes innermost in the output, and cols index the
+  // innermost dimension of the input. Tiles are widened along a short
+  // dimension so that they keep about kTileSize * kTileSize elements.
+  constexpr int64 kTileSize = 32;
+  const int64 rows = dims[new_perm[ndims - 1]];
+  const int64 cols = dims[ndims - 1];
+  const int64 src_stride = in_strides[new_perm[ndims - 1]];
+  const int64 dst_stride = out_strides[inner_out_dim];
+  const int64 tile_rows =
+      std::max(kTileSize, kTileSize * kTileSize / std::min(cols, kTileSize));
+  const int64 tile_cols =
+      std::max(kTileSize, kTileSize * kTileSize / std::min(rows, kTileSize));
+  const int64 num_row_tiles = MathUtil::CeilOfRatio(rows, tile_rows);
+  const int64 num_col_tiles = MathUtil::CeilOfRatio(cols, tile_cols);
+  const int64 num_tiles = num_row_tiles * num_col_tiles;
+  auto transpose_tiles = [&](int64 begin, int64 end) {
+    for (int64 tile = begin; tile < end; ++tile) {
+      int64 in_offset = 0;
+      int64 out_offset = 0;
+      for (int64 i = num_outer_dims - 1, t = tile / num_tiles; i >= 0; --i) {
+        const int64 index = t % outer_dims[i];
+        t /= outer_dims[i];
+        in_offset += index * outer_in_strides[i];
+        out_offset += index * outer_out_strides[i];
+      }
+      const int64 r = (tile % num_tiles) / num_col_tiles * tile_rows;
+      const int64 c = (tile % num_col_tiles) * tile_cols;
+      TransposeTile(p + in_offset + r * src_stride + c, src_stride,
+                    std::min(tile_rows, rows - r),
+                    std::min(tile_cols, cols - c),
+                    q + out_offset + c * dst_stride + r, dst_stride);
+    }
+  };
+  const int64 tile_size = std::min(tile_rows, rows) * std::min(tile_cols, cols);
+  const Eigen::TensorOpCost cost(
+      tile_size * sizeof(T), tile_size * sizeof(T),
+      tile_size * Eigen::TensorOpCost::AddCost<int64>());
+  device.parallelFor(num_elements / (rows * cols) * num_tiles, cost,
+                     transpose_tiles);
+}
+
 }  // namespace
 
 template <typename T, bool conjugate>
 struct Transpose<CPUDevice, T, conjugate> {
   static void run(const CPUDevice& d, const Tensor& in,
                   const gtl::ArraySlice<int32> perm, Tensor* out) {
+    if (!conjugate && std::is_trivially_copyable<T>::value) {
+      TransposeBlocked<T>(d, in, perm, out);
+      return;
+    }
     switch (in.dims()) {
       case 2:
         internal::TransposeUsingEigen<CPUDevice, T, 2>(d, in, perm, conjugate,
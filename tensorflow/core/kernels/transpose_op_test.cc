@@ -0,0 +1,184 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Transposes `in` one element at a time.
+template <typename T>
+Tensor ReferenceTranspose(const Tensor& in, const std::vector<int32>& perm) {
+  const int ndims = in.dims();
+  TensorShape out_shape;
+  for (const int32 d : perm) out_shape.AddDim(in.dim_size(d));
+  Tensor out(in.dtype(), out_shape);
+  std::vector<int64> in_strides(ndims, 1);
+  for (int i = ndims - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * in.dim_size(i + 1);
+  }
+  const auto in_flat = in.flat<T>();
+  auto out_flat = out.flat<T>();
+  for (int64 o = 0; o < out.NumElements(); ++o) {
+    int64 i = 0;
+    for (int64 d = ndims - 1, t = o; d >= 0; --d) {
+      i += (t % out_shape.dim_size(d)) * in_strides[perm[d]];
+      t /= out_shape.dim_size(d);
+    }
+    out_flat(o) = in_flat(i);
+  }
+  return out;
+}
+
+class TransposeOpTest : public OpsTestBase {
+ protected:
+  template <typename T>
+  void Check(const TensorShape& shape, const std::vector<int32>& perm) {
+    const DataType dtype = DataTypeToEnum<T>::value;
+    TF_ASSERT_OK(NodeDefBuilder("transpose", "Transpose")
+                     .Input(FakeInput(dtype))
+                     .Input(FakeInput(DT_INT32))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    std::vector<T> values(shape.num_elements());
+    for (int64 i = 0; i < values.size(); ++i) {
+      values[i] = T(static_cast<float>(i % 251));
+    }
+    Tensor input(dtype, shape);
+    test::FillValues<T>(&input, values);
+    AddInputFromArray<T>(shape, values);
+    AddInputFromArray<int32>(TensorShape({static_cast<int64>(perm.size())}),
+                             perm);
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorEqual<T>(ReferenceTranspose<T>(input, perm),
+                               *GetOutput(0));
+  }
+};
+
+TEST_F(TransposeOpTest, Matrix) { Check<float>({67, 45}, {1, 0}); }
+
+TEST_F(TransposeOpTest, InnermostDimensionKept) {
+  Check<float>({3, 37, 5, 16}, {0, 2, 1, 3});
+}
+
+TEST_F(TransposeOpTest, InnermostDimensionMoved) {
+  Check<float>({4, 37, 9, 71}, {0, 2, 3, 1});
+}
+
+TEST_F(TransposeOpTest, NHWCToNCHW) {
+  Check<float>({2, 19, 23, 3}, {0, 3, 1, 2});
+}
+
+TEST_F(TransposeOpTest, NCHWToNHWC) {
+  Check<float>({2, 3, 19, 23}, {0, 2, 3, 1});
+}
+
+TEST_F(TransposeOpTest, FiveDimensions) {
+  Check<float>({2, 5, 7, 3, 11}, {4, 1, 3, 0, 2});
+}
+
+TEST_F(TransposeOpTest, DimensionsOfSizeOne) {
+  Check<float>({1, 5, 1, 7, 1}, {3, 2, 0, 4, 1});
+}
+
+TEST_F(TransposeOpTest, Identity) { Check<float>({5, 1, 7}, {1, 0, 2}); }
+
+TEST_F(TransposeOpTest, Empty) { Check<float>({5, 0, 7}, {2, 0, 1}); }
+
+TEST_F(TransposeOpTest, Uint8) { Check<uint8>({3, 41, 5, 33}, {3, 0, 2, 1}); }
+
+TEST_F(TransposeOpTest, Bfloat16) {
+  Check<bfloat16>({3, 41, 5, 33}, {0, 3, 1, 2});
+}
+
+TEST_F(TransposeOpTest, Int64) { Check<int64>({3, 41, 5, 33}, {1, 3, 2, 0}); }
+
+TEST_F(TransposeOpTest, Complex128) {
+  Check<complex128>({3, 17, 5, 9}, {0, 3, 2, 1});
+}
+
+// Transposes a float tensor of the given shape.
+Graph* TransposeGraph(const TensorShape& shape,
+                      const std::vector<int32>& perm) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, shape);
+  input.flat<float>().setRandom();
+  Tensor perm_tensor(DT_INT32, TensorShape({static_cast<int64>(perm.size())}));
+  std::copy(perm.begin(), perm.end(), perm_tensor.flat<int32>().data());
+  Node* transpose;
+  TF_CHECK_OK(NodeBuilder(g->NewName("transpose"), "Transpose")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, perm_tensor))
+                  .Finalize(g, &transpose));
+  return g;
+}
+
+void RunTransposeBenchmark(::testing::benchmark::State& state,
+                           const TensorShape& shape,
+                           const std::vector<int32>& perm) {
+  test::Benchmark("cpu", TransposeGraph(shape, perm),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetBytesProcessed(state.iterations() * shape.num_elements() *
+                          sizeof(float));
+}
+
+// [batch, seq, heads, depth] -> [batch, heads, seq, depth], as for attention.
+void BM_TransposeSplitHeads(::testing::benchmark::State& state) {
+  RunTransposeBenchmark(state, {32, 128, 16, 64}, {0, 2, 1, 3});
+}
+BENCHMARK(BM_TransposeSplitHeads)->UseRealTime();
+
+// [batch, seq, heads, depth] -> [batch, heads, depth, seq].
+void BM_TransposeKeys(::testing::benchmark::State& state) {
+  RunTransposeBenchmark(state, {32, 128, 16, 64}, {0, 2, 3, 1});
+}
+BENCHMARK(BM_TransposeKeys)->UseRealTime();
+
+void BM_TransposeNHWCToNCHW(::testing::benchmark::State& state) {
+  RunTransposeBenchmark(state, {32, 224, 224, 3}, {0, 3, 1, 2});
+}
+BENCHMARK(BM_TransposeNHWCToNCHW)->UseRealTime();
+
+void BM_TransposeNCHWToNHWC(::testing::benchmark::State& state) {
+  RunTransposeBenchmark(state, {32, 3, 224, 224}, {0, 2, 3, 1});
+}
+BENCHMARK(BM_TransposeNCHWToNHWC)->UseRealTime();
+
+void BM_Transpose5D(::testing::benchmark::State& state) {
+  RunTransposeBenchmark(state, {16, 32, 16, 16, 32}, {0, 4, 1, 2, 3});
+}
+BENCHMARK(BM_Transpose5D)->UseRealTime();
+
+void BM_TransposeMatrix(::testing::benchmark::State& state) {
+  RunTransposeBenchmark(state, {4096, 4096}, {1, 0});
+}
+BENCHMARK(BM_TransposeMatrix)->UseRealTime();
+
+}  // namespace
+}  // namespace tensorflow
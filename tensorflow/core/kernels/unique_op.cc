@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -26,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
@@ -68,6 +71,11 @@ struct UniqueOpHashMap<bfloat16, TIndex> {
   using map_type = std::unordered_map<bfloat16, TIndex>;
 };
 
+// Vectors with at least this many elements are uniquified in parallel, and
+// scanned in blocks of this many elements.
+constexpr int64 kMinParallelUniqueSize = 128 * 1024;
+constexpr int64 kUniqueBlockSize = 16 * 1024;
+
 // `UniqueOp` computes the unique elements in the input tensor.
 //
 // * `T` is the element type.
@@ -142,6 +150,15 @@ class UniqueOp : public OpKernel {
                                 1, TensorShape({new_sizes[1]}), &idx));
     auto idx_vec = idx->template vec<TIndex>();
 
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    if (new_sizes[0] == 1 && new_sizes[2] == 1 &&
+        input.NumElements() >= kMinParallelUniqueSize &&
+        worker_threads.num_threads > 1) {
+      ComputeParallel(context, input, axis, idx_vec);
+      return;
+    }
+
     int64 uniq_size;
     if (new_sizes[0] == 1 && new_sizes[2] == 1) {
       // Specialized and faster implementation when unique is run over single
@@ -237,6 +254,143 @@ class UniqueOp : public OpKernel {
       }
     }
   }
+
+ private:
+  // Parallel version of the single element case, which keeps the order of
+  // the unique elements (by first occurrence):
+  // 1. The elements are assigned to power of two shards by hash, and their
+  //    indices are scattered (in order) to a contiguous range per shard.
+  // 2. Each shard is uniquified by its own map, which records the index of
+  //    the first occurrence of each element. All the occurrences of an element
+  //    fall in the same shard.
+  // 3. The unique elements are numbered in order by a prefix sum over the
+  //    first occurrences, and the other occurrences copy the number of their
+  //    first occurrence.
+  void ComputeParallel(OpKernelContext* context, const Tensor& input,
+                       int64 axis, typename TTypes<TIndex>::Vec idx_vec) {
+    using MapType = typename UniqueOpHashMap<T, TIndex>::map_type;
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    auto Tin = input.flat<T>();
+    const int64 N = static_cast<int64>(Tin.size());
+    const int64 num_blocks = (N + kUniqueBlockSize - 1) / kUniqueBlockSize;
+    int log_num_shards = 0;
+    while ((1 << log_num_shards) < worker_threads.num_threads &&
+           log_num_shards < 8) {
+      ++log_num_shards;
+    }
+    const int num_shards = 1 << log_num_shards;
+
+    // Calls `fn(task)` for each of the `num_tasks` tasks on the worker threads.
+    auto parallel_for = [&worker_threads](
+                            int64 num_tasks, int64 cost_per_task,
+                            const std::function<void(int64)>& fn) {
+      Shard(worker_threads.num_threads, worker_threads.workers, num_tasks,
+            cost_per_task, [&fn](int64 first, int64 last) {
+              for (int64 task = first; task < last; ++task) fn(task);
+            });
+    };
+    auto block_end = [N](int64 block) {
+      return std::min(N, (block + 1) * kUniqueBlockSize);
+    };
+
+    // 1. Shards the elements, keeping the indices of each shard in order.
+    std::vector<uint8> shard_of(N);
+    std::vector<int64> block_offsets(num_blocks * num_shards, 0);
+    parallel_for(num_blocks, 10 * kUniqueBlockSize, [&](int64 block) {
+      const typename MapType::hasher hasher;
+      int64* shard_counts = &block_offsets[block * num_shards];
+      for (int64 i = block * kUniqueBlockSize; i < block_end(block); ++i) {
+        // The hash is remixed, since std::hash is the identity for integers.
+        const uint64 h =
+            static_cast<uint64>(hasher(Tin(i))) * 0x9E3779B97F4A7C15ULL;
+        const int shard =
+            log_num_shards == 0 ? 0 : h >> (64 - log_num_shards);
+        shard_of[i] = shard;
+        ++shard_counts[shard];
+      }
+    });
+    std::vector<int64> shard_starts(num_shards + 1, 0);
+    for (int shard = 0; shard < num_shards; ++shard) {
+      int64 offset = shard_starts[shard];
+      for (int64 block = 0; block < num_blocks; ++block) {
+        int64& block_offset = block_offsets[block * num_shards + shard];
+        const int64 count = block_offset;
+        block_offset = offset;
+        offset += count;
+      }
+      shard_starts[shard + 1] = offset;
+    }
+    std::vector<int32> sharded_indices(N);
+    parallel_for(num_blocks, 2 * kUniqueBlockSize, [&](int64 block) {
+      int64* shard_offsets = &block_offsets[block * num_shards];
+      for (int64 i = block * kUniqueBlockSize; i < block_end(block); ++i) {
+        sharded_indices[shard_offsets[shard_of[i]]++] = i;
+      }
+    });
+
+    // 2. Finds the first occurrence of every element. Only the counts of the
+    // first occurrences are used.
+    const bool with_counts = num_outputs() > 2;
+    std::vector<int32> first_occurrence(N);
+    std::vector<int32> counts(with_counts ? N : 0);
+    parallel_for(num_shards, 100 * N / num_shards, [&](int64 shard) {
+      MapType uniq;
+      uniq.reserve(shard_starts[shard + 1] - shard_starts[shard]);
+      for (int64 k = shard_starts[shard]; k < shard_starts[shard + 1]; ++k) {
+        const int32 i = sharded_indices[k];
+        const int32 first = uniq.emplace(Tin(i), i).first->second;
+        first_occurrence[i] = first;
+        if (with_counts) ++counts[first];
+      }
+    });
+
+    // 3. Numbers the unique elements by first occurrence.
+    std::vector<int64> block_uniques(num_blocks + 1, 0);
+    parallel_for(num_blocks, kUniqueBlockSize, [&](int64 block) {
+      int64 num_uniques = 0;
+      for (int64 i = block * kUniqueBlockSize; i < block_end(block); ++i) {
+        if (first_occurrence[i] == i) ++num_uniques;
+      }
+      block_uniques[block + 1] = num_uniques;
+    });
+    for (int64 block = 0; block < num_blocks; ++block) {
+      block_uniques[block + 1] += block_uniques[block];
+    }
+    const int64 uniq_size = block_uniques[num_blocks];
+
+    TensorShape output_shape(input.shape());
+    output_shape.set_dim(axis, uniq_size);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    auto Tout = output->flat<T>();
+    TIndex* count_output_data = nullptr;
+    if (with_counts) {
+      Tensor* count_output = nullptr;
+      OP_REQUIRES_OK(context,
+                     context->allocate_output(2, TensorShape({uniq_size}),
+                                              &count_output));
+      count_output_data = count_output->vec<TIndex>().data();
+    }
+
+    parallel_for(num_blocks, 2 * kUniqueBlockSize, [&](int64 block) {
+      int64 j = block_uniques[block];
+      for (int64 i = block * kUniqueBlockSize; i < block_end(block); ++i) {
+        if (first_occurrence[i] != i) continue;
+        idx_vec(i) = j;
+        Tout(j) = Tin(i);
+        if (with_counts) count_output_data[j] = counts[i];
+        ++j;
+      }
+    });
+    // Only reads the numbers of the first occurrences, set above.
+    parallel_for(num_blocks, 2 * kUniqueBlockSize, [&](int64 block) {
+      for (int64 i = block * kUniqueBlockSize; i < block_end(block); ++i) {
+        const int32 first = first_occurrence[i];
+        if (first != i) idx_vec(i) = idx_vec(first);
+      }
+    });
+  }
 };
 
 #define REGISTER_UNIQUE(type)                                    \
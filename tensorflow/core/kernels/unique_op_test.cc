@@ -13,13 +13,19 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
@@ -28,6 +34,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -37,6 +45,81 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+class UniqueOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, DataType type) {
+    TF_ASSERT_OK(NodeDefBuilder("unique", op)
+                     .Input(FakeInput(type))
+                     .Attr("T", type)
+                     .Attr("out_idx", DT_INT32)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Checks the outputs against a sequential uniquification of `values`.
+  template <typename T>
+  void ExpectUnique(const std::vector<T>& values, bool with_counts) {
+    std::vector<T> expected_y;
+    std::vector<int32> expected_idx;
+    std::vector<int32> expected_count;
+    absl::flat_hash_map<T, int32> ids;
+    for (const T& value : values) {
+      auto it = ids.emplace(value, expected_y.size());
+      if (it.second) {
+        expected_y.push_back(value);
+        expected_count.push_back(0);
+      }
+      expected_idx.push_back(it.first->second);
+      ++expected_count[it.first->second];
+    }
+    test::ExpectTensorEqual<T>(*GetOutput(0), test::AsTensor<T>(expected_y));
+    test::ExpectTensorEqual<int32>(*GetOutput(1),
+                                   test::AsTensor<int32>(expected_idx));
+    if (with_counts) {
+      test::ExpectTensorEqual<int32>(*GetOutput(2),
+                                     test::AsTensor<int32>(expected_count));
+    }
+  }
+};
+
+// The inputs below are large enough to be uniquified in parallel.
+
+TEST_F(UniqueOpTest, LargeInt64) {
+  MakeOp("Unique", DT_INT64);
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> values(300 * 1000);
+  for (int64& value : values) value = rnd.Uniform64(50 * 1000);
+  AddInputFromArray<int64>(TensorShape({300 * 1000}), values);
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectUnique(values, /*with_counts=*/false);
+}
+
+TEST_F(UniqueOpTest, LargeInt32WithCounts) {
+  MakeOp("UniqueWithCounts", DT_INT32);
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int32> values(300 * 1000);
+  // Mostly distinct values, with a few very frequent ones.
+  for (int32& value : values) {
+    value = rnd.OneIn(4) ? rnd.Uniform(8) : rnd.Uniform(1 << 30);
+  }
+  AddInputFromArray<int32>(TensorShape({300 * 1000}), values);
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectUnique(values, /*with_counts=*/true);
+}
+
+TEST_F(UniqueOpTest, LargeString) {
+  MakeOp("Unique", DT_STRING);
+  std::vector<tstring> values(200 * 1000);
+  for (int i = 0; i < 200 * 1000; ++i) {
+    values[i] = strings::StrCat("id", (i * 7919) % 30011);
+  }
+  AddInputFromArray<tstring>(TensorShape({200 * 1000}), values);
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectUnique(values, /*with_counts=*/false);
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -111,6 +194,38 @@ void BM_Unique_INT32_Repeat(::testing::benchmark::State& state) {
                           sizeof(int32));
 }
 
+// Benchmarks embedding ids: `dim` int64 ids, of which about one in
+// `duplication` is distinct.
+void BM_Unique_INT64_Ids(::testing::benchmark::State& state) {
+  const int dim = state.range(0);
+  const int duplication = state.range(1);
+
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  const int64 num_ids = std::max(1, dim / duplication);
+  auto input_flat = input.flat<int64>();
+  for (int i = 0; i < dim; ++i) {
+    // Spreads the ids over the whole int64 range, like hashed feature ids.
+    input_flat(i) = static_cast<int64>(rnd.Uniform64(num_ids) *
+                                       0x9E3779B97F4A7C15ULL);
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+  FixupSourceAndSinkEdges(g);
+
+  test::Benchmark("cpu", g, nullptr, nullptr, nullptr,
+                  "SINGLE_THREADED_EXECUTOR", /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()) * dim);
+}
+
 TensorProto GetRandomStringsTensorProto(int dim, int max_str_len) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_STRING);
@@ -193,6 +308,18 @@ BENCHMARK(BM_Unique_INT32_Repeat)
     ->ArgPair(64 * 1024, 64 * 1024 * 1024)
     ->ArgPair(1024 * 1024, 64 * 1024 * 1024);
 
+BENCHMARK(BM_Unique_INT64_Ids)
+    ->UseRealTime()
+    ->ArgPair(64 * 1024, 1)
+    ->ArgPair(64 * 1024, 10)
+    ->ArgPair(64 * 1024, 100)
+    ->ArgPair(1024 * 1024, 1)
+    ->ArgPair(1024 * 1024, 10)
+    ->ArgPair(1024 * 1024, 100)
+    ->ArgPair(16 * 1024 * 1024, 1)
+    ->ArgPair(16 * 1024 * 1024, 10)
+    ->ArgPair(16 * 1024 * 1024, 100);
+
 BENCHMARK(BM_Unique_STRING)
     ->UseRealTime()
     ->Arg(32)
@@ -17,6 +17,10 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 
 #include "tensorflow/core/framework/op_kernel.h"
@@ -24,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/kernels/xent_op.h"
+#include "tensorflow/core/lib/math/math_util.h"
 #include "tensorflow/core/util/bcast.h"
 
 namespace tensorflow {
@@ -113,8 +118,137 @@ struct XentFunctorBase {
   }
 };
 
+// Computes the loss and backprop on CPU without materializing the
+// intermediate (logits - max_logits), in two passes over the logits: the first
+// computes the log of the sum of their exponentials with a max for each block
+// of classes, which are then combined (an online log-sum-exp), and the second
+// computes both the loss and the backprop. Rows are split into blocks of
+// classes so that a few rows with many classes are still parallelized.
+template <typename T>
+void XentStreaming(const CPUDevice& d, typename TTypes<T>::ConstMatrix logits,
+                   typename TTypes<T>::ConstMatrix labels,
+                   typename TTypes<T>::Vec loss,
+                   typename TTypes<T>::Matrix backprop) {
+  // Half precision values are accumulated in float.
+  typedef typename std::conditional<std::is_same<T, Eigen::half>::value, float,
+                                    T>::type Acc;
+  // Reductions are evaluated into a fixed size scalar on the stack, rather than
+  // a rank 0 Eigen::Tensor that would be heap allocated for every block.
+  typedef Eigen::TensorFixedSize<Acc, Eigen::Sizes<>, Eigen::RowMajor> Scalar;
+  constexpr int64 kBlockSize = 16384;
+  const int64 batch_size = logits.dimension(0);
+  const int64 num_classes = logits.dimension(1);
+  if (num_classes == 0) {
+    // The loss sums over no classes, and backprop is empty.
+    loss.setZero();
+    return;
+  }
+  const int64 num_blocks = MathUtil::CeilOfRatio(num_classes, kBlockSize);
+  const int64 block_size = MathUtil::CeilOfRatio(num_classes, num_blocks);
+  auto block_logits = [&](int64 row, int64 block) {
+    const int64 begin = block * block_size;
+    return typename TTypes<T>::UnalignedConstVec(
+        &logits(row, begin), std::min(block_size, num_classes - begin));
+  };
+  const Acc kInfinity = Eigen::NumTraits<Acc>::infinity();
+
+  // The max of the logits of each block, and the sum of their exponentials
+  // relative to that max.
+  std::vector<Acc> block_max(batch_size * num_blocks);
+  std::vector<Acc> block_sum_exp(batch_size * num_blocks);
+  auto reduce_blocks = [&](int64 begin, int64 end) {
+    for (int64 i = begin; i < end; ++i) {
+      const auto x = block_logits(i / num_blocks, i % num_blocks)
+                         .template cast<Acc>();
+      Scalar reduced;
+      reduced = x.maximum();
+      block_max[i] = reduced();
+      if (block_max[i] == -kInfinity) {
+        block_sum_exp[i] = Acc(0);
+      } else {
+        reduced = (x - block_max[i]).exp().sum();
+        block_sum_exp[i] = reduced();
+      }
+    }
+  };
+  const int64 exp_cost = Eigen::internal::functor_traits<
+      Eigen::internal::scalar_exp_op<Acc>>::Cost;
+  d.parallelFor(batch_size * num_blocks,
+                Eigen::TensorOpCost(block_size * sizeof(T), 0,
+                                    block_size * (exp_cost + 2)),
+                reduce_blocks);
+
+  // Combines the blocks of each row.
+  std::vector<Acc> row_max(batch_size);
+  std::vector<Acc> row_log_sum_exp(batch_size);
+  for (int64 row = 0; row < batch_size; ++row) {
+    const Acc* max = &block_max[row * num_blocks];
+    const Acc* sum_exp = &block_sum_exp[row * num_blocks];
+    row_max[row] = *std::max_element(max, max + num_blocks);
+    Acc sum = 0;
+    for (int64 block = 0; block < num_blocks; ++block) {
+      if (max[block] != -kInfinity) {
+        sum += sum_exp[block] * Eigen::numext::exp(max[block] - row_max[row]);
+      }
+    }
+    row_log_sum_exp[row] = Eigen::numext::log(sum);
+  }
+
+  // backprop = exp(logits - max_logits - log_sum_exp) - labels, and the loss
+  // of each block is sum(labels * (log_sum_exp - (logits - max_logits))). The
+  // loss is computed first, as backprop may reuse the buffer of the logits.
+  std::vector<Acc> block_loss(batch_size * num_blocks);
+  auto compute_blocks = [&](int64 begin, int64 end) {
+    for (int64 i = begin; i < end; ++i) {
+      const int64 row = i / num_blocks;
+      const int64 offset = (i % num_blocks) * block_size;
+      const int64 size = std::min(block_size, num_classes - offset);
+      const auto x = block_logits(row, i % num_blocks).template cast<Acc>();
+      const auto y = typename TTypes<T>::UnalignedConstVec(
+                         &labels(row, offset), size)
+                         .template cast<Acc>();
+      Scalar loss_sum;
+      loss_sum = (y * (row_log_sum_exp[row] - (x - row_max[row]))).sum();
+      block_loss[i] = loss_sum();
+      typename TTypes<T>::UnalignedVec(&backprop(row, offset), size) =
+          ((x - (row_max[row] + row_log_sum_exp[row])).exp() - y)
+              .template cast<T>();
+    }
+  };
+  d.parallelFor(batch_size * num_blocks,
+                Eigen::TensorOpCost(2 * block_size * sizeof(T),
+                                    block_size * sizeof(T),
+                                    block_size * (exp_cost + 6)),
+                compute_blocks);
+  for (int64 row = 0; row < batch_size; ++row) {
+    Acc sum = 0;
+    for (int64 block = 0; block < num_blocks; ++block) {
+      sum += block_loss[row * num_blocks + block];
+    }
+    loss(row) = static_cast<T>(sum);
+  }
+}
+
 template <typename T>
-struct XentFunctor<CPUDevice, T> : XentFunctorBase<CPUDevice, T> {};
+struct XentFunctor<CPUDevice, T> {
+  void operator()(const CPUDevice& d,
+                  const Eigen::DSizes<Eigen::DenseIndex, 2>& shape,
+                  const Eigen::array<Eigen::DenseIndex, 2>& logits_bcast,
+                  const Eigen::array<Eigen::DenseIndex, 2>& labels_bcast,
+                  typename TTypes<T>::ConstMatrix logits,
+                  typename TTypes<T>::ConstMatrix labels,
+                  typename TTypes<T>::Matrix scratch,
+                  typename TTypes<T>::Vec loss,
+                  typename TTypes<T>::Matrix backprop) {
+    const Eigen::array<Eigen::DenseIndex, 2> no_bcast{1, 1};
+    if (logits_bcast == no_bcast && labels_bcast == no_bcast) {
+      XentStreaming<T>(d, logits, labels, loss, backprop);
+    } else {
+      XentFunctorBase<CPUDevice, T>()(d, shape, logits_bcast, labels_bcast,
+                                      logits, labels, scratch, loss, backprop);
+    }
+  }
+};
 
 }  // namespace functor
 
@@ -61,4 +61,7 @@ BM_XentDev(16, 10000, cpu);
 BM_XentDev(32, 10000, cpu);
 BM_XentDev(64, 10000, cpu);
 
+// A few rows with a large vocabulary.
+BM_XentDev(8, 1000000, cpu);
+
 }  // end namespace tensorflow
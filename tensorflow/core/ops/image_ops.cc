@@ -511,6 +511,46 @@ REGISTER_OP("DecodeAndCropJpeg")
       return Status::OK();
     });
 
+// --------------------------------------------------------------------------
+// Fused DecodeJpeg, Slice (optional), ExpandDims and ResizeBilinear, which
+// uses the scaled IDCT of libjpeg to decode the image (or the crop window) at
+// the smallest scale no smaller than `size`. `crop_begin` and `crop_size` have
+// the semantics of the begin and size inputs of a Slice of the decoded
+// [height, width, channels] image, and are empty to resize the whole image.
+// The tf.data decode_and_resize_fusion optimization rewrites the unfused ops
+// to this op.
+REGISTER_OP("_DecodeAndResizeJpeg")
+    .Input("contents: string")
+    .Input("crop_begin: int32")
+    .Input("crop_size: int32")
+    .Input("size: int32")
+    .Output("resized_images: float")
+    .Attr("channels: int = 0")
+    .Attr("fancy_upscaling: bool = true")
+    .Attr("try_recover_truncated: bool = false")
+    .Attr("acceptable_fraction: float = 1.0")
+    .Attr("dct_method: string = ''")
+    .Attr("align_corners: bool = false")
+    .Attr("half_pixel_centers: bool = false")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &unused));
+      DimensionHandle channels_dim = c->UnknownDim();
+      int32 channels;
+      TF_RETURN_IF_ERROR(c->GetAttr("channels", &channels));
+      if (channels != 0) {
+        if (channels < 0) {
+          return errors::InvalidArgument("channels must be non-negative, got ",
+                                         channels);
+        }
+        channels_dim = c->MakeDim(channels);
+      }
+      return SetOutputToSizedImage(c, c->MakeDim(1), 3 /* size_input_idx */,
+                                   channels_dim);
+    });
+
 // --------------------------------------------------------------------------
 REGISTER_OP("EncodeJpeg")
     .Input("image: uint8")
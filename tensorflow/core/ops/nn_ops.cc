@@ -420,6 +420,219 @@ output.
 create these operators.
 )doc");
 
+// --------------------------------------------------------------------------
+// Ops for tensors in the blocked NCHW[x]c layout, which are created by the
+// Grappler layout optimizer on CPU. A blocked tensor has the shape
+// [batch, ceil(channels / block_size), height, width, block_size], and the
+// channels past the end of the original NHWC tensor are zero.
+
+namespace {
+
+// Returns the number of channel blocks for `channels` channels.
+Status ChannelBlocks(InferenceContext* c, DimensionHandle channels,
+                     int64 block_size, DimensionHandle* blocks) {
+  TF_RETURN_IF_ERROR(c->Add(channels, block_size - 1, blocks));
+  return c->Divide(*blocks, block_size, /*evenly_divisible=*/false, blocks);
+}
+
+// Shape function for ops applying a 2D window over a blocked input. The output
+// has `out_blocks` channel blocks, or as many as the input if it is null.
+Status BlockedWindowedShape(InferenceContext* c, int64 window_rows,
+                            int64 window_cols,
+                            const DimensionHandle* out_blocks) {
+  ShapeHandle input;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 5, &input));
+  std::vector<int32> strides;
+  TF_RETURN_IF_ERROR(c->GetAttr("strides", &strides));
+  if (strides.size() != 4) {
+    return errors::InvalidArgument("strides must have 4 elements, got ",
+                                   strides.size());
+  }
+  Padding padding;
+  TF_RETURN_IF_ERROR(c->GetAttr("padding", &padding));
+
+  DimensionHandle output_rows, output_cols;
+  TF_RETURN_IF_ERROR(GetWindowedOutputSizeFromDims(
+      c, c->Dim(input, 2), window_rows, strides[1], padding, &output_rows));
+  TF_RETURN_IF_ERROR(GetWindowedOutputSizeFromDims(
+      c, c->Dim(input, 3), window_cols, strides[2], padding, &output_cols));
+  const DimensionHandle blocks =
+      out_blocks != nullptr ? *out_blocks : c->Dim(input, 1);
+  c->set_output(0, c->MakeShape({c->Dim(input, 0), blocks, output_rows,
+                                 output_cols, c->Dim(input, 4)}));
+  return Status::OK();
+}
+
+}  // namespace
+
+REGISTER_OP("_ToBlockedLayout")
+    .Input("x: T")
+    .Output("y: T")
+    .Attr("T: {float}")
+    .Attr("block_size: int >= 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 4, &input));
+      int64 block_size;
+      TF_RETURN_IF_ERROR(c->GetAttr("block_size", &block_size));
+      DimensionHandle blocks;
+      TF_RETURN_IF_ERROR(
+          ChannelBlocks(c, c->Dim(input, 3), block_size, &blocks));
+      c->set_output(0, c->MakeShape({c->Dim(input, 0), blocks,
+                                     c->Dim(input, 1), c->Dim(input, 2),
+                                     c->MakeDim(block_size)}));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts an NHWC tensor to the blocked NCHW[block_size]c layout.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_FromBlockedLayout")
+    .Input("x: T")
+    .Output("y: T")
+    .Attr("T: {float}")
+    .Attr("num_channels: int >= 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 5, &input));
+      int64 num_channels;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_channels", &num_channels));
+      c->set_output(0, c->MakeShape({c->Dim(input, 0), c->Dim(input, 2),
+                                     c->Dim(input, 3),
+                                     c->MakeDim(num_channels)}));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts a tensor in the blocked NCHW[x]c layout back to NHWC, keeping the
+first `num_channels` channels.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_ToBlockedFilter")
+    .Input("filter: T")
+    .Output("blocked_filter: T")
+    .Attr("T: {float}")
+    .Attr("block_size: int >= 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle filter;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 4, &filter));
+      int64 block_size;
+      TF_RETURN_IF_ERROR(c->GetAttr("block_size", &block_size));
+      DimensionHandle in_blocks, out_blocks;
+      TF_RETURN_IF_ERROR(
+          ChannelBlocks(c, c->Dim(filter, 2), block_size, &in_blocks));
+      TF_RETURN_IF_ERROR(
+          ChannelBlocks(c, c->Dim(filter, 3), block_size, &out_blocks));
+      c->set_output(0, c->MakeShape({out_blocks, in_blocks, c->Dim(filter, 0),
+                                     c->Dim(filter, 1), c->MakeDim(block_size),
+                                     c->MakeDim(block_size)}));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts an HWIO convolution filter to the blocked layout of `_BlockedConv2D`:
+[out_blocks, in_blocks, height, width, block_size (in), block_size (out)], with
+zeros for the padding channels.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_BlockedConv2D")
+    .Input("input: T")
+    .Input("filter: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("strides: list(int)")
+    .Attr("padding: {'SAME', 'VALID'}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle filter;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 6, &filter));
+      const DimensionHandle rows = c->Dim(filter, 2);
+      const DimensionHandle cols = c->Dim(filter, 3);
+      const DimensionHandle out_blocks = c->Dim(filter, 0);
+      if (!c->ValueKnown(rows) || !c->ValueKnown(cols)) {
+        ShapeHandle input;
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 5, &input));
+        c->set_output(0, c->UnknownShapeOfRank(5));
+        return Status::OK();
+      }
+      return BlockedWindowedShape(c, c->Value(rows), c->Value(cols),
+                                  &out_blocks);
+    })
+    .Doc(R"doc(
+Computes a 2D convolution of a blocked NCHW[x]c `input` with a `filter` blocked
+by `_ToBlockedFilter`, and returns the result in the same blocked layout.
+`strides` are in NHWC order.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_BlockedBiasAdd")
+    .Input("value: T")
+    .Input("bias: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 5, &input));
+      ShapeHandle bias;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &bias));
+      c->set_output(0, input);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Adds `bias` to the channels of a blocked NCHW[x]c `value`.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_BlockedMaxPool")
+    .Input("input: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("ksize: list(int) >= 4")
+    .Attr("strides: list(int) >= 4")
+    .Attr("padding: {'SAME', 'VALID'}")
+    .SetShapeFn([](InferenceContext* c) {
+      std::vector<int32> ksize;
+      TF_RETURN_IF_ERROR(c->GetAttr("ksize", &ksize));
+      return BlockedWindowedShape(c, ksize[1], ksize[2], nullptr);
+    })
+    .Doc(R"doc(
+Performs max pooling on a blocked NCHW[x]c `input`. `ksize` and `strides` are in
+NHWC order.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_BlockedAvgPool")
+    .Input("input: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("ksize: list(int) >= 4")
+    .Attr("strides: list(int) >= 4")
+    .Attr("padding: {'SAME', 'VALID'}")
+    .SetShapeFn([](InferenceContext* c) {
+      std::vector<int32> ksize;
+      TF_RETURN_IF_ERROR(c->GetAttr("ksize", &ksize));
+      return BlockedWindowedShape(c, ksize[1], ksize[2], nullptr);
+    })
+    .Doc(R"doc(
+Performs average pooling on a blocked NCHW[x]c `input`. `ksize` and `strides`
+are in NHWC order.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
 namespace {
 
 Status CommonFusedConvCalculations(InferenceContext* c, bool has_resize) {
@@ -1184,6 +1397,63 @@ REGISTER_OP("Softmax")
 
 // --------------------------------------------------------------------------
 
+REGISTER_OP("_FusedScaledDotProductAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("args: num_args * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_args: int >= 0 = 0")
+    .Attr("scale: float = 1.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query, key, value;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 3, &query));
+      if (!c->RankKnown(query)) {
+        c->set_output(0, c->UnknownShape());
+        return Status::OK();
+      }
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), c->Rank(query), &key));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), c->Rank(query), &value));
+
+      ShapeHandle batch, key_batch, value_batch;
+      TF_RETURN_IF_ERROR(c->Subshape(query, 0, -2, &batch));
+      TF_RETURN_IF_ERROR(c->Subshape(key, 0, -2, &key_batch));
+      TF_RETURN_IF_ERROR(c->Subshape(value, 0, -2, &value_batch));
+      TF_RETURN_IF_ERROR(c->Merge(batch, key_batch, &batch));
+      TF_RETURN_IF_ERROR(c->Merge(batch, value_batch, &batch));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(query, -1), c->Dim(key, -1), &unused));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(key, -2), c->Dim(value, -2), &unused));
+
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          batch, c->Vector(c->Dim(query, -2)), &output));
+      TF_RETURN_IF_ERROR(
+          c->Concatenate(output, c->Vector(c->Dim(value, -1)), &output));
+      c->set_output(0, output);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Computes softmax(query * key^T * scale + mask) * value.
+
+The inputs have shapes [..., query_length, depth] for `query`,
+[..., key_length, depth] for `key` and [..., key_length, value_depth] for
+`value`, with the same leading (batch) dimensions. The output has the shape
+[..., query_length, value_depth]. If `num_args` is 1, `args` is an additive mask
+which is broadcast to the [..., query_length, key_length] attention scores.
+
+The scores are computed by blocks of keys, with an online softmax, so that they
+are never materialized for all the keys.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+// --------------------------------------------------------------------------
+
 REGISTER_OP("LogSoftmax")
     .Input("logits: T")
     .Output("logsoftmax: T")
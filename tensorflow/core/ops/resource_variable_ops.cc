@@ -21,6 +21,7 @@
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/lib/core/errors.h"
 
+using ::tensorflow::shape_inference::DimensionHandle;
 using ::tensorflow::shape_inference::InferenceContext;
 using ::tensorflow::shape_inference::ShapeAndType;
 using ::tensorflow::shape_inference::ShapeHandle;
@@ -303,6 +304,65 @@ REGISTER_OP("ResourceGatherNd")
 
 namespace {
 
+Status ResourceSparseSegmentReductionShape(InferenceContext* c) {
+  std::vector<ShapeAndType> handle_shape_and_type;
+  TF_RETURN_IF_ERROR(shape_inference::ValidateVariableResourceHandle(
+      c, &handle_shape_and_type));
+  ShapeHandle var_shape;
+  TF_RETURN_IF_ERROR(
+      c->WithRankAtLeast(handle_shape_and_type[0].shape, 1, &var_shape));
+
+  ShapeHandle indices_shape;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &indices_shape));
+  ShapeHandle segment_ids_shape;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &segment_ids_shape));
+  ShapeHandle unused;
+  TF_RETURN_IF_ERROR(c->Merge(indices_shape, segment_ids_shape, &unused));
+
+  DimensionHandle num_segments = c->UnknownDim();
+  if (c->num_inputs() > 3) {
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+    TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(3, &num_segments));
+  }
+  ShapeHandle var_subshape;
+  TF_RETURN_IF_ERROR(c->Subshape(var_shape, 1, &var_subshape));
+  ShapeHandle out;
+  TF_RETURN_IF_ERROR(
+      c->Concatenate(c->Vector(num_segments), var_subshape, &out));
+  c->set_output(0, out);
+  return Status::OK();
+}
+
+}  // namespace
+
+// Fused SparseSegment{Sum,Mean,SqrtN}(ResourceGather(resource, unique_ids),
+// unique_idx, segment_ids), reading the rows straight from the variable.
+// Created by the arithmetic optimizer.
+REGISTER_OP("_ResourceSparseSegmentReduction")
+    .Input("resource: resource")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Output("output: dtype")
+    .Attr("dtype: {bfloat16, float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .SetShapeFn(ResourceSparseSegmentReductionShape);
+
+REGISTER_OP("_ResourceSparseSegmentReductionWithNumSegments")
+    .Input("resource: resource")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("num_segments: int32")
+    .Output("output: dtype")
+    .Attr("dtype: {bfloat16, float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .SetShapeFn(ResourceSparseSegmentReductionShape);
+
+namespace {
+
 Status ResourceScatterUpdateShape(InferenceContext* c) {
   std::vector<ShapeAndType> handle_shape_and_type;
   TF_RETURN_IF_ERROR(shape_inference::ValidateVariableResourceHandle(
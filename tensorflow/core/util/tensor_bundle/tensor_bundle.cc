@@ -42,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/bfloat16.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/saved_tensor_slice_util.h"
 #include "tensorflow/core/util/tensor_bundle/byte_swap.h"
@@ -52,7 +53,8 @@ namespace tensorflow {
 // Versioning of the tensor bundle format.
 const int kTensorBundleMinProducer = 0;
 const int kTensorBundleMinConsumer = 0;
-const int kTensorBundleVersion = 1;
+const int kTensorBundleIncrementalMinConsumer = 2;
+const int kTensorBundleVersion = 2;
 
 // Size of our input buffer for streaming reads
 static const int kBufferSize = 1024 * 1024;
@@ -387,6 +389,73 @@ table::Options TableBuilderOptions() {
   return o;
 }
 
+// Records a fingerprint of the bytes of "val", which must have a dtype that
+// can be copied with memcpy, in "entry".  Never records 0, which marks a
+// missing fingerprint.
+void SetTensorFingerprint(const Tensor& val, BundleEntryProto* entry) {
+  Fprint128 fingerprint = Fingerprint128(val.tensor_data());
+  if (fingerprint.low64 == 0 && fingerprint.high64 == 0) fingerprint.low64 = 1;
+  entry->set_fingerprint_low64(fingerprint.low64);
+  entry->set_fingerprint_high64(fingerprint.high64);
+}
+
+// Returns "base_prefix" as recorded in the header of the bundle "prefix":
+// relative to the directory of "prefix", unless the two are on different file
+// systems, in which case "base_prefix" is returned as is.
+Status RelativeBasePrefix(StringPiece prefix, StringPiece base_prefix,
+                          string* relative) {
+  StringPiece scheme, host, path;
+  StringPiece base_scheme, base_host, base_path;
+  io::ParseURI(prefix, &scheme, &host, &path);
+  io::ParseURI(base_prefix, &base_scheme, &base_host, &base_path);
+  if (scheme != base_scheme || host != base_host) {
+    *relative = string(base_prefix);
+    return Status::OK();
+  }
+  if (io::IsAbsolutePath(path) != io::IsAbsolutePath(base_path)) {
+    return errors::InvalidArgument(
+        "Cannot record base bundle ", base_prefix, " relative to bundle ",
+        prefix, "; both prefixes must be absolute or both relative");
+  }
+  const std::vector<string> dir = str_util::Split(
+      io::CleanPath(io::Dirname(path)), '/', str_util::SkipEmpty());
+  const std::vector<string> base =
+      str_util::Split(io::CleanPath(base_path), '/', str_util::SkipEmpty());
+  size_t common = 0;
+  while (common < dir.size() && common + 1 < base.size() &&
+         dir[common] == base[common]) {
+    ++common;
+  }
+  std::vector<string> parts;
+  for (size_t i = common; i < dir.size(); ++i) {
+    if (dir[i] == ".") continue;
+    if (dir[i] == "..") {
+      return errors::InvalidArgument("Cannot record base bundle ", base_prefix,
+                                     " relative to bundle ", prefix);
+    }
+    parts.push_back("..");
+  }
+  for (size_t i = common; i < base.size(); ++i) {
+    if (base[i] != ".") parts.push_back(base[i]);
+  }
+  *relative = str_util::Join(parts, "/");
+  return Status::OK();
+}
+
+// Returns the prefix of the base bundle of the bundle "prefix", given the
+// "base_prefix" recorded in its header.
+string ResolveBasePrefix(StringPiece prefix, StringPiece base_prefix) {
+  StringPiece scheme, host, path;
+  io::ParseURI(base_prefix, &scheme, &host, &path);
+  if (base_prefix.empty() || !scheme.empty() || io::IsAbsolutePath(path)) {
+    return string(base_prefix);
+  }
+  io::ParseURI(prefix, &scheme, &host, &path);
+  return io::CreateURI(
+      scheme, host,
+      io::CleanPath(io::JoinPath(io::Dirname(path), base_prefix)));
+}
+
 // Writes zeros to output buffer to align the next write to the requested
 // alignment. "size" is the current size of the buffer and is updated to the
 // new size.
@@ -427,6 +496,20 @@ BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
     return;
   }
 
+  if (!options_.base_prefix.empty()) {
+    if (options_.base_prefix == prefix_) {
+      status_ = errors::InvalidArgument(
+          "A bundle cannot be written on top of itself: ", prefix_);
+      return;
+    }
+    base_reader_.reset(new BundleReader(env_, options_.base_prefix));
+    status_ = base_reader_->status();
+    if (!status_.ok()) return;
+    status_ = RelativeBasePrefix(prefix_, options_.base_prefix,
+                                 &header_base_prefix_);
+    if (!status_.ok()) return;
+  }
+
   std::unique_ptr<WritableFile> wrapper;
   status_ = env_->NewWritableFile(data_path_, &wrapper);
   if (!status_.ok()) return;
@@ -448,6 +531,16 @@ Status BundleWriter::Add(StringPiece key, const Tensor& val) {
   BundleEntryProto* entry = &entries_[key_string];
   entry->set_dtype(val.dtype());
   val.shape().AsProto(entry->mutable_shape());
+
+  if ((options_.fingerprint_tensors || base_reader_ != nullptr) &&
+      DataTypeCanUseMemcpy(val.dtype())) {
+    SetTensorFingerprint(val, entry);
+    // Unchanged tensors of an incremental bundle only get a metadata entry.
+    if (base_reader_ != nullptr && FoundInBase(key_string, val, entry)) {
+      return status_;
+    }
+  }
+
   entry->set_shard_id(0);
   entry->set_offset(size_);
 
@@ -514,6 +607,31 @@ Status BundleWriter::AddSlice(StringPiece full_tensor_key,
   return status_;
 }
 
+bool BundleWriter::FoundInBase(const string& key, const Tensor& val,
+                               BundleEntryProto* entry) {
+  // Fingerprints are computed on the bytes in memory, so they can only be
+  // compared if both bundles have the same endianness.
+  if (base_reader_->need_to_swap_bytes_) return false;
+  BundleEntryProto base_entry;
+  if (!base_reader_->GetBundleEntryProto(key, &base_entry).ok()) return false;
+  if (!base_entry.slices().empty() || base_entry.dtype() != val.dtype() ||
+      base_entry.fingerprint_low64() != entry->fingerprint_low64() ||
+      base_entry.fingerprint_high64() != entry->fingerprint_high64() ||
+      base_entry.size() != val.TotalBytes() ||
+      TensorShape(base_entry.shape()) != val.shape()) {
+    return false;
+  }
+  // The checksum of the bytes written for "val" would be that of its bytes in
+  // memory, check it against the base entry too.
+  const StringPiece data = val.tensor_data();
+  const uint32 crc32c = crc32c::Mask(crc32c::Value(data.data(), data.size()));
+  if (crc32c != base_entry.crc32c()) return false;
+  entry->set_in_base(true);
+  entry->set_size(base_entry.size());
+  entry->set_crc32c(crc32c);
+  return true;
+}
+
 // TODO(zongheng): on metadata write failure or !status_.ok(), consider removing
 // the orphaned data file.
 Status BundleWriter::Finish() {
@@ -547,7 +665,10 @@ Status BundleWriter::Finish() {
     if (!port::kLittleEndian) header.set_endianness(BundleHeaderProto::BIG);
     VersionDef* version = header.mutable_version();
     version->set_producer(kTensorBundleVersion);
-    version->set_min_consumer(kTensorBundleMinConsumer);
+    version->set_min_consumer(options_.base_prefix.empty()
+                                  ? kTensorBundleMinConsumer
+                                  : kTensorBundleIncrementalMinConsumer);
+    header.set_base_prefix(header_base_prefix_);
 
     builder.Add(kHeaderEntryKey, header.SerializeAsString());
 
@@ -582,6 +703,8 @@ struct MergeState {
   bool seen_first_bundle = false;
   BundleHeaderProto_Endianness endianness;
   VersionDef version;
+  // Prefix of the base bundle of all the bundles, if they are incremental.
+  string base_prefix;
 
   // Tensor key -> BundleEntryProto.
   std::map<string, BundleEntryProto> entries;
@@ -623,6 +746,8 @@ static Status MergeOneBundle(Env* env, StringPiece prefix,
       merge_state->seen_first_bundle = true;
       merge_state->endianness = header.endianness();
       merge_state->version = header.version();
+      merge_state->base_prefix =
+          ResolveBasePrefix(prefix, header.base_prefix());
     } else {
       // Validates "endianness".
       if (merge_state->endianness != header.endianness()) {
@@ -638,6 +763,14 @@ static Status MergeOneBundle(Env* env, StringPiece prefix,
             "Merging bundles with different format versions: merged ",
             merge_version, " vs. curr ", curr_version);
       }
+      // Validates "base_prefix".
+      const string base_prefix =
+          ResolveBasePrefix(prefix, header.base_prefix());
+      if (merge_state->base_prefix != base_prefix) {
+        return errors::InvalidArgument(
+            "Merging bundles with different base bundles: merged ",
+            merge_state->base_prefix, " vs. curr ", base_prefix);
+      }
     }
     num_shards = header.num_shards();
     iter->Next();
@@ -721,6 +854,12 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
     header.set_num_shards(merge.num_shards);
     header.set_endianness(merge.endianness);
     *header.mutable_version() = merge.version;
+    if (!merge.base_prefix.empty()) {
+      string base_prefix;
+      TF_RETURN_IF_ERROR(
+          RelativeBasePrefix(merged_prefix, merge.base_prefix, &base_prefix));
+      header.set_base_prefix(base_prefix);
+    }
     builder.Add(kHeaderEntryKey, header.SerializeAsString());
     // All others.
     for (const auto& p : merge.entries) {
@@ -787,6 +926,7 @@ BundleReader::BundleReader(Env* env, StringPiece prefix)
     return;
   }
   num_shards_ = header.num_shards();
+  base_prefix_ = ResolveBasePrefix(prefix_, header.base_prefix());
   if ((header.endianness() == BundleHeaderProto::BIG && port::kLittleEndian) ||
       (header.endianness() == BundleHeaderProto::LITTLE &&
        !port::kLittleEndian)) {
@@ -841,6 +981,10 @@ Status BundleReader::GetBundleEntryProto(StringPiece key,
 }
 
 Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
+  if (entry.in_base()) {
+    return GetBaseValue(key(), entry, val);
+  }
+
   Tensor* ret = val;
   const TensorShape stored_shape(TensorShape(entry.shape()));
   if (val->NumElements() == 0) {
@@ -936,6 +1080,40 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
   return Status::OK();
 }
 
+Status BundleReader::GetBaseValue(StringPiece key,
+                                  const BundleEntryProto& entry, Tensor* val) {
+  if (base_prefix_.empty()) {
+    return errors::DataLoss("Tensor ", key, " in bundle ", prefix_,
+                            " is stored in a base bundle, but the bundle has "
+                            "no base bundle");
+  }
+  if (base_reader_ == nullptr) {
+    base_reader_.reset(new BundleReader(env_, base_prefix_));
+  }
+  if (!base_reader_->status().ok()) {
+    return errors::DataLoss("Failed to open base bundle ", base_prefix_,
+                            " of bundle ", prefix_, ": ",
+                            base_reader_->status().ToString());
+  }
+  const string key_string(key);
+  BundleEntryProto base_entry;
+  Status s = base_reader_->GetBundleEntryProto(key_string, &base_entry);
+  if (!s.ok()) {
+    return errors::DataLoss("Tensor ", key_string, " of bundle ", prefix_,
+                            " is missing from base bundle ", base_prefix_,
+                            ": ", s.ToString());
+  }
+  if (!base_entry.slices().empty() || base_entry.dtype() != entry.dtype() ||
+      TensorShape(base_entry.shape()) != TensorShape(entry.shape()) ||
+      base_entry.size() != entry.size() ||
+      base_entry.crc32c() != entry.crc32c()) {
+    return errors::DataLoss("Tensor ", key_string, " of bundle ", prefix_,
+                            " does not match its entry in base bundle ",
+                            base_prefix_);
+  }
+  return base_reader_->GetValue(base_entry, val);
+}
+
 Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
@@ -57,11 +57,33 @@ limitations under the License.
 //        "/fs/model/train/ckpt-step/tmp/worker1-step"},
 //       "/fs/model/train/ckpt-step/ckpt" /* merged prefix */);
 //
+// A bundle can be written incrementally on top of a previous bundle by setting
+// BundleWriter::Options::base_prefix.  Tensors whose contents did not change
+// since the base bundle are then not written again; their metadata entries
+// refer to the base bundle instead, which BundleReader follows transparently.
+// An incremental bundle can serve as the base of another one, forming a chain
+// that must be kept around (and deleted) as a whole.  The base prefix is
+// recorded relative to the directory of the bundle, so a chain can be moved as
+// a whole:
+//
+//   BundleWriter::Options options;
+//   options.fingerprint_tensors = true;
+//   BundleWriter full(env, "/fs/model/train/ckpt-1000/ckpt", options);
+//   ...
+//   options.base_prefix = "/fs/model/train/ckpt-1000/ckpt";
+//   BundleWriter incremental(env, "/fs/model/train/ckpt-2000/ckpt", options);
+//
+// The SaveV2 op exposes both options as the "base_prefix" and
+// "fingerprint_tensors" attrs, and MergeV2Checkpoints keeps the base of the
+// merged bundles.  CheckpointManager does not know about chains, and deletes
+// the base bundles of a chain independently.
+//
 
 #ifndef TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 #define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -83,6 +105,7 @@ limitations under the License.
 
 namespace tensorflow {
 
+class BundleReader;
 class FileOutputBuffer;
 
 // Versioning of the tensor bundle format.
@@ -91,8 +114,13 @@ class FileOutputBuffer;
 // History:
 // 0. Any tensor bundles produced before this field was added.
 // 1. Added this field (2016-09-14).
+// 2. Added incremental bundles (BundleHeaderProto.base_prefix) (2021-03-01).
+//    Incremental bundles have a min_consumer of
+//    kTensorBundleIncrementalMinConsumer, so that older readers reject them
+//    instead of reading the entries stored in a base bundle as empty.
 extern const int kTensorBundleMinProducer;
 extern const int kTensorBundleMinConsumer;
+extern const int kTensorBundleIncrementalMinConsumer;
 extern const int kTensorBundleVersion;
 
 // The empty string, hence always the first key in the metadata table.  Its
@@ -112,6 +140,16 @@ class BundleWriter {
     // Alignment, in bytes, for tensor data.
     // Must be >= 1. The default size of 1 densely packs tensors.
     int data_alignment{1};
+    // If non-empty, the prefix of the bundle this bundle is written on top
+    // of.  A tensor added with the same key, dtype, shape and contents as in
+    // the base bundle is not written again but refers to the base bundle.
+    // Only applies to tensors whose dtype can be copied with memcpy and whose
+    // base entry carries a fingerprint (see "fingerprint_tensors").
+    string base_prefix;
+    // Whether to record a fingerprint of the contents of every tensor, so
+    // that this bundle can serve as the base of an incremental bundle.
+    // Implied by a non-empty "base_prefix".
+    bool fingerprint_tensors{false};
   };
   BundleWriter(Env* env, StringPiece prefix,
                const Options& options = Options());
@@ -146,8 +184,19 @@ class BundleWriter {
   Status status() const { return status_; }
 
  private:
+  // Returns true iff "val" is stored under "key" in the base bundle, in which
+  // case "entry" is updated to refer to the base bundle.  "entry" must hold
+  // the fingerprint of "val".
+  bool FoundInBase(const string& key, const Tensor& val,
+                   BundleEntryProto* entry);
+
   Env* const env_;  // Not owned.
   const Options options_;
+  // Reader of the bundle named by "options_.base_prefix", if any.
+  std::unique_ptr<BundleReader> base_reader_;
+  // "options_.base_prefix" as recorded in the header, relative to the
+  // directory of the bundle.
+  string header_base_prefix_;
   const string prefix_;
   string metadata_path_;
   string data_path_;
@@ -283,9 +332,20 @@ class BundleReader {
                        const TensorSlice& slice_spec,
                        Tensor* val) TF_MUST_USE_RESULT;
 
+  // Reads the value of the entry "entry" keyed by "key", whose contents are
+  // stored in the base bundle.  Opens the base bundle on first use.
+  // REQUIRES: entry.in_base()
+  Status GetBaseValue(StringPiece key, const BundleEntryProto& entry,
+                      Tensor* val) TF_MUST_USE_RESULT;
+
   Env* env_;  // Not owned.
   const string prefix_;
 
+  // Prefix of the bundle holding the contents of "in_base" entries, from the
+  // header entry.  Empty unless this is an incremental bundle.
+  string base_prefix_;
+  std::unique_ptr<BundleReader> base_reader_;
+
   Status status_;
   RandomAccessFile* metadata_;  // Owned.
   table::Table* table_;
@@ -306,6 +366,7 @@ class BundleReader {
   // differs from that of the current system's processor architecture.
   bool need_to_swap_bytes_;
 
+  friend class BundleWriter;  // For comparing against base bundle entries.
   friend class TensorBundleAlignmentTest;  // For testing data alignment.
 
   TF_DISALLOW_COPY_AND_ASSIGN(BundleReader);
@@ -901,6 +901,219 @@ TEST(TensorBundleTest, Error) {
   }
 }
 
+uint64 DataFileSize(const string& prefix) {
+  uint64 size;
+  TF_CHECK_OK(Env::Default()->GetFileSize(DataFilename(prefix, 0, 1), &size));
+  return size;
+}
+
+BundleHeaderProto ReadHeader(const string& prefix) {
+  BundleHeaderProto header;
+  BundleReader reader(Env::Default(), prefix);
+  TF_CHECK_OK(reader.status());
+  reader.Seek(kHeaderEntryKey);
+  CHECK(reader.Valid());
+  CHECK(ParseProtoUnlimited(&header, reader.value().data(),
+                            reader.value().size()));
+  return header;
+}
+
+TEST(TensorBundleTest, IncrementalBundles) {
+  const TensorShape kFullShape({2, 3});
+  const TensorSlice kSlice1 = TensorSlice::ParseOrDie("0,1:-");
+  const TensorSlice kSlice2 = TensorSlice::ParseOrDie("1,1:-");
+  Tensor strs(DT_STRING, TensorShape({2}));
+  test::FillValues<tstring>(&strs, {"hello", "world"});
+
+  BundleWriter::Options options;
+  options.fingerprint_tensors = true;
+  {
+    BundleWriter writer(Env::Default(), Prefix("incremental_0"), options);
+    TF_ASSERT_OK(writer.Add("changed", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Add("strs", strs));
+    TF_ASSERT_OK(writer.Add("unchanged", Constant_2x3(2.f)));
+    TF_ASSERT_OK(writer.AddSlice("part", kFullShape, kSlice1,
+                                 Constant<float>(3.f, TensorShape({1, 3}))));
+    TF_ASSERT_OK(writer.AddSlice("part", kFullShape, kSlice2,
+                                 Constant<float>(4.f, TensorShape({1, 3}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  // Only the changed tensor, the changed slice and the string tensor, which
+  // is never deduplicated, are written again.
+  options.base_prefix = Prefix("incremental_0");
+  {
+    BundleWriter writer(Env::Default(), Prefix("incremental_1"), options);
+    TF_ASSERT_OK(writer.Add("changed", Constant_2x3(5.f)));
+    TF_ASSERT_OK(writer.Add("strs", strs));
+    TF_ASSERT_OK(writer.Add("unchanged", Constant_2x3(2.f)));
+    TF_ASSERT_OK(writer.AddSlice("part", kFullShape, kSlice1,
+                                 Constant<float>(3.f, TensorShape({1, 3}))));
+    TF_ASSERT_OK(writer.AddSlice("part", kFullShape, kSlice2,
+                                 Constant<float>(6.f, TensorShape({1, 3}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_EQ(DataFileSize(Prefix("incremental_0")) - 2 * 3 * sizeof(float) -
+                3 * sizeof(float),
+            DataFileSize(Prefix("incremental_1")));
+  // Older readers must reject incremental bundles, but not full ones.
+  EXPECT_EQ(kTensorBundleMinConsumer,
+            ReadHeader(Prefix("incremental_0")).version().min_consumer());
+  const BundleHeaderProto header = ReadHeader(Prefix("incremental_1"));
+  EXPECT_EQ(kTensorBundleIncrementalMinConsumer,
+            header.version().min_consumer());
+  EXPECT_EQ("incremental_0", header.base_prefix());
+  // Nothing changed, so only the string tensor is written again.
+  options.base_prefix = Prefix("incremental_1");
+  {
+    BundleWriter writer(Env::Default(), Prefix("incremental_2"), options);
+    TF_ASSERT_OK(writer.Add("changed", Constant_2x3(5.f)));
+    TF_ASSERT_OK(writer.Add("strs", strs));
+    TF_ASSERT_OK(writer.Add("unchanged", Constant_2x3(2.f)));
+    TF_ASSERT_OK(writer.AddSlice("part", kFullShape, kSlice1,
+                                 Constant<float>(3.f, TensorShape({1, 3}))));
+    TF_ASSERT_OK(writer.AddSlice("part", kFullShape, kSlice2,
+                                 Constant<float>(6.f, TensorShape({1, 3}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_EQ(DataFileSize(Prefix("incremental_1")) - 2 * 3 * sizeof(float) -
+                3 * sizeof(float),
+            DataFileSize(Prefix("incremental_2")));
+
+  // Every bundle of the chain reads back its own contents.
+  Tensor part(DT_FLOAT, kFullShape);
+  {
+    BundleReader reader(Env::Default(), Prefix("incremental_1"));
+    TF_ASSERT_OK(reader.status());
+    Expect<float>(&reader, "changed", Constant_2x3(5.f));
+    Expect<tstring>(&reader, "strs", strs);
+    Expect<float>(&reader, "unchanged", Constant_2x3(2.f));
+    test::FillValues<float>(&part, {3, 3, 3, 6, 6, 6});
+    Expect<float>(&reader, "part", part);
+  }
+  {
+    BundleReader reader(Env::Default(), Prefix("incremental_2"));
+    TF_ASSERT_OK(reader.status());
+    Expect<float>(&reader, "changed", Constant_2x3(5.f));
+    Expect<tstring>(&reader, "strs", strs);
+    Expect<float>(&reader, "unchanged", Constant_2x3(2.f));
+    Expect<float>(&reader, "part", part);
+    Tensor slice(DT_FLOAT, TensorShape({1, 3}));
+    TF_ASSERT_OK(reader.LookupSlice("part", kSlice1, &slice));
+    test::ExpectTensorEqual<float>(slice,
+                                   Constant<float>(3.f, TensorShape({1, 3})));
+  }
+
+  // An incremental bundle cannot be read without its base bundles.
+  TF_ASSERT_OK(Env::Default()->DeleteFile(
+      DataFilename(Prefix("incremental_0"), 0, 1)));
+  {
+    BundleReader reader(Env::Default(), Prefix("incremental_2"));
+    TF_ASSERT_OK(reader.status());
+    Expect<float>(&reader, "changed", Constant_2x3(5.f));
+    Tensor val(DT_FLOAT, kFullShape);
+    EXPECT_TRUE(errors::IsNotFound(reader.Lookup("unchanged", &val)));
+  }
+}
+
+TEST(TensorBundleTest, IncrementalBundleWithoutFingerprints) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("no_fingerprints"));
+    TF_ASSERT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  // The base bundle has no fingerprints to compare against, so every tensor
+  // is written in full.
+  BundleWriter::Options options;
+  options.base_prefix = Prefix("no_fingerprints");
+  {
+    BundleWriter writer(Env::Default(), Prefix("no_fingerprints_1"), options);
+    TF_ASSERT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_EQ(DataFileSize(Prefix("no_fingerprints")),
+            DataFileSize(Prefix("no_fingerprints_1")));
+  BundleReader reader(Env::Default(), Prefix("no_fingerprints_1"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "foo", Constant_2x3(1.f));
+
+  {  // A bundle cannot be its own base.
+    options.base_prefix = Prefix("no_fingerprints_1");
+    BundleWriter writer(Env::Default(), Prefix("no_fingerprints_1"), options);
+    EXPECT_TRUE(errors::IsInvalidArgument(writer.status()));
+  }
+  {  // The base bundle must exist.
+    options.base_prefix = Prefix("nonexist");
+    BundleWriter writer(Env::Default(), Prefix("no_fingerprints_2"), options);
+    EXPECT_TRUE(errors::IsNotFound(writer.status()));
+  }
+}
+
+TEST(TensorBundleTest, IncrementalBundleChainCanBeMoved) {
+  Env* env = Env::Default();
+  const string dir = Prefix("chain");
+  TF_ASSERT_OK(env->RecursivelyCreateDir(io::JoinPath(dir, "base")));
+  BundleWriter::Options options;
+  options.fingerprint_tensors = true;
+  {
+    BundleWriter writer(env, io::JoinPath(dir, "base", "ckpt"), options);
+    TF_ASSERT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  options.base_prefix = io::JoinPath(dir, "base", "ckpt");
+  {
+    BundleWriter writer(env, io::JoinPath(dir, "step_1", "ckpt"), options);
+    TF_ASSERT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_EQ("../base/ckpt",
+            ReadHeader(io::JoinPath(dir, "step_1", "ckpt")).base_prefix());
+
+  // The chain still reads back once its directory has been moved.
+  const string moved = Prefix("moved_chain");
+  TF_ASSERT_OK(env->RenameFile(dir, moved));
+  BundleReader reader(env, io::JoinPath(moved, "step_1", "ckpt"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "foo", Constant_2x3(1.f));
+}
+
+TEST(TensorBundleTest, MergeIncrementalBundles) {
+  Env* env = Env::Default();
+  BundleWriter::Options options;
+  options.fingerprint_tensors = true;
+  {
+    BundleWriter writer(env, Prefix("merge_base"), options);
+    TF_ASSERT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Add("bar", Constant_2x3(2.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  // As in a sharded save, the shards are written in a temporary directory.
+  options.base_prefix = Prefix("merge_base");
+  {
+    BundleWriter writer(env, Prefix("merge_temp/part-0"), options);
+    TF_ASSERT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  {
+    BundleWriter writer(env, Prefix("merge_temp/part-1"), options);
+    TF_ASSERT_OK(writer.Add("bar", Constant_2x3(3.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_EQ("../merge_base",
+            ReadHeader(Prefix("merge_temp/part-0")).base_prefix());
+  TF_ASSERT_OK(MergeBundles(
+      env, {Prefix("merge_temp/part-0"), Prefix("merge_temp/part-1")},
+      Prefix("merged_incremental")));
+
+  const BundleHeaderProto header = ReadHeader(Prefix("merged_incremental"));
+  EXPECT_EQ("merge_base", header.base_prefix());
+  EXPECT_EQ(kTensorBundleIncrementalMinConsumer,
+            header.version().min_consumer());
+  BundleReader reader(env, Prefix("merged_incremental"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "foo", Constant_2x3(1.f));
+  Expect<float>(&reader, "bar", Constant_2x3(3.f));
+}
+
 TEST(TensorBundleTest, Checksum) {
   // Randomly flips a byte in [pos_lhs, end of data file), or exactly byte
   // pos_lhs if exact_pos == True.
@@ -457,6 +457,7 @@ class OptimizeDatasetTest(test_base.DatasetTestBase, parameterized.TestCase):
   def testOptimizationEnabled(self):
     """Tests the optimization settings by enabling all."""
     options = dataset_ops.Options()
+    options.experimental_optimization.decode_and_resize_fusion = True
     options.experimental_optimization.filter_fusion = True
     options.experimental_optimization.filter_with_random_uniform_fusion = True
     options.experimental_optimization.hoist_random_uniform = True
@@ -474,6 +475,7 @@ class OptimizeDatasetTest(test_base.DatasetTestBase, parameterized.TestCase):
     options.experimental_slack = True
 
     expected_optimizations_enabled = [
+        "decode_and_resize_fusion",
         "filter_fusion",
         "filter_with_random_uniform_fusion",
         "hoist_random_uniform",
@@ -505,6 +507,7 @@ class OptimizeDatasetTest(test_base.DatasetTestBase, parameterized.TestCase):
   def testOptimizationDisabled(self):
     """Tests the optimization settings by disabling all."""
     options = dataset_ops.Options()
+    options.experimental_optimization.decode_and_resize_fusion = False
     options.experimental_optimization.filter_fusion = False
     options.experimental_optimization.filter_with_random_uniform_fusion = False
     options.experimental_optimization.hoist_random_uniform = False
@@ -523,6 +526,7 @@ class OptimizeDatasetTest(test_base.DatasetTestBase, parameterized.TestCase):
 
     expected_optimizations_enabled = []
     expected_optimizations_disabled = [
+        "decode_and_resize_fusion",
         "filter_fusion",
         "filter_with_random_uniform_fusion",
         "hoist_random_uniform",
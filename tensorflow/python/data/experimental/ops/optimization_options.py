@@ -125,6 +125,16 @@ class OptimizationOptions(options.OptionsBase):
       "budget to use. Values greater than the available RAM in bytes may "
       "result in OOM. If None, defaults to half of the available RAM in bytes.")
 
+  decode_and_resize_fusion = options.create_option(
+      name="decode_and_resize_fusion",
+      ty=bool,
+      docstring=
+      "Whether to fuse `tf.io.decode_jpeg()` followed by an optional "
+      "`tf.slice()` and `tf.image.resize()` in map transformations into a "
+      "single op, which decodes JPEG images at a reduced scale when the "
+      "resized image is smaller. The results differ slightly from the unfused "
+      "transformations. If None, defaults to False.")
+
   filter_fusion = options.create_option(
       name="filter_fusion",
       ty=bool,
@@ -259,6 +269,7 @@ class OptimizationOptions(options.OptionsBase):
       result = MapVectorizationOptions()._graph_rewrites()  # pylint: disable=protected-access
 
     all_optimizations = [
+        "decode_and_resize_fusion",
         "filter_fusion",
         "filter_with_random_uniform_fusion",
         "hoist_random_uniform",
@@ -1001,6 +1001,7 @@ class Context(object):
     rewriter_bool("disable_model_pruning")
     rewriter_toggle("scoped_allocator_optimization")
     rewriter_toggle("pin_to_host_optimization")
+    rewriter_toggle("cost_based_placement")
     rewriter_toggle("implementation_selector")
     rewriter_toggle("auto_mixed_precision")
     rewriter_bool("disable_meta_optimizer")
@@ -1578,6 +1579,7 @@ class Context(object):
     rewriter_bool("disable_model_pruning")
     rewriter_toggle("scoped_allocator_optimization")
     rewriter_toggle("pin_to_host_optimization")
+    rewriter_toggle("cost_based_placement")
     rewriter_toggle("implementation_selector")
     rewriter_toggle("auto_mixed_precision")
     rewriter_bool("disable_meta_optimizer")
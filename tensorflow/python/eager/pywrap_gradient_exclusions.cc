@@ -50,7 +50,7 @@ auto OpGradientInfoInit(const T &a) {
 
 absl::optional<tensorflow::gtl::FlatSet<int>> OpGradientUnusedInputIndices(
     const tensorflow::string &op_name) {
-  static std::array<OpIndexInfo, 358> a = {{
+  static std::array<OpIndexInfo, 359> a = {{
       {"Acosh"},
       {"AllToAll", 1, {0}},
       {"ApproximateEqual"},
@@ -201,6 +201,7 @@ absl::optional<tensorflow::gtl::FlatSet<int>> OpGradientUnusedInputIndices(
       {"Multinomial"},
       {"MutableDenseHashTable"},
       {"MutableDenseHashTableV2"},
+      {"MutableEvictingHashTable"},
       {"MutableHashTable"},
       {"MutableHashTableOfTensors"},
       {"MutableHashTableOfTensorsV2"},
@@ -421,7 +422,7 @@ absl::optional<tensorflow::gtl::FlatSet<int>> OpGradientUnusedInputIndices(
 
 absl::optional<tensorflow::gtl::FlatSet<int>> OpGradientUnusedOutputIndices(
     const tensorflow::string &op_name) {
-  static std::array<OpIndexInfo, 475> a = {{
+  static std::array<OpIndexInfo, 476> a = {{
       {"Abs"},
       {"AccumulateNV2"},
       {"Acos"},
@@ -638,6 +639,7 @@ absl::optional<tensorflow::gtl::FlatSet<int>> OpGradientUnusedOutputIndices(
       {"Multinomial"},
       {"MutableDenseHashTable"},
       {"MutableDenseHashTableV2"},
+      {"MutableEvictingHashTable"},
       {"MutableHashTable"},
       {"MutableHashTableOfTensors"},
       {"MutableHashTableOfTensorsV2"},
@@ -217,6 +217,8 @@ def set_optimizer_experimental_options(options):
       - scoped_allocator_optimization: Try to allocate some independent Op
         outputs contiguously in order to merge or eliminate downstream Ops.
       - pin_to_host_optimization: Force small ops onto the CPU.
+      - cost_based_placement: Place ops without a requested device type across
+        the CPU devices and accelerators based on the cost model.
       - implementation_selector: Enable the swap of kernel implementations based
         on the device placement.
       - auto_mixed_precision: Change certain float32 ops to float16 on Volta
@@ -42,6 +42,7 @@ from tensorflow.python.framework import tensor_spec
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import gen_lookup_ops
 from tensorflow.python.ops import lookup_ops
 from tensorflow.python.ops import map_fn
 from tensorflow.python.ops import string_ops
@@ -3302,6 +3303,56 @@ class MutableHashTableOpTest(test.TestCase):
     output2 = table2.lookup(input_string)
     self.assertAllEqual(expected_output, self.evaluate(output2))
 
+  def testMutableHashTableOfTensorsLargeBatch(self):
+    # Large enough for the keys to be spread over every shard of the table.
+    num_keys = 10000
+    default_val = constant_op.constant([-1, -1], dtypes.int64)
+    keys = np.arange(num_keys, dtype=np.int64)
+    values = np.stack([keys, 2 * keys], axis=1)
+    table = lookup_ops.MutableHashTable(dtypes.int64, dtypes.int64,
+                                        default_val)
+    # The last of several duplicate keys in one batch wins.
+    self.evaluate(
+        table.insert(
+            np.concatenate([keys, keys]),
+            np.concatenate([np.zeros_like(values), values])))
+    self.assertAllEqual(num_keys, self.evaluate(table.size()))
+
+    # Removed rows are reused by later inserts without clobbering other keys.
+    self.evaluate(table.remove(keys[::2]))
+    self.assertAllEqual(num_keys // 2, self.evaluate(table.size()))
+    self.evaluate(table.insert(keys[::4], -values[::4]))
+    self.assertAllEqual(num_keys // 2 + num_keys // 4,
+                        self.evaluate(table.size()))
+
+    expected = values.copy()
+    expected[::2] = -1
+    expected[::4] = -values[::4]
+    self.assertAllEqual(expected, self.evaluate(table.lookup(keys)))
+
+    exported_keys, exported_values = self.evaluate(table.export())
+    order = np.argsort(exported_keys)
+    present = expected[:, 0] != -1
+    self.assertAllEqual(keys[present], exported_keys[order])
+    self.assertAllEqual(expected[present], exported_values[order])
+
+  def testMutableHashTableOfTensorsEmptyValues(self):
+    default_val = constant_op.constant([], dtypes.int64)
+    keys = constant_op.constant([0, 1, 2], dtypes.int64)
+    values = array_ops.zeros([3, 0], dtypes.int64)
+    table = lookup_ops.MutableHashTable(dtypes.int64, dtypes.int64,
+                                        default_val)
+    self.evaluate(table.insert(keys, values))
+    self.assertAllEqual(3, self.evaluate(table.size()))
+    self.evaluate(table.remove(constant_op.constant([1], dtypes.int64)))
+    self.evaluate(table.insert(constant_op.constant([3], dtypes.int64),
+                               array_ops.zeros([1, 0], dtypes.int64)))
+    self.assertAllEqual(3, self.evaluate(table.size()))
+    self.assertAllEqual(
+        np.zeros([4, 0]),
+        self.evaluate(table.lookup(constant_op.constant([0, 1, 2, 3],
+                                                        dtypes.int64))))
+
   def testMutableHashTableOfTensorsInvalidShape(self):
     default_val = constant_op.constant([-1, -1], dtypes.int64)
     keys = constant_op.constant(["brain", "salad", "surgery"])
@@ -3677,6 +3728,201 @@ class MutableHashTableOpTest(test.TestCase):
     self.assertTrue(inferred_shapes[1].is_compatible_with(actual_shapes[1]))
 
 
+class MutableEvictingHashTableTest(test.TestCase):
+
+  def _create_table(self, **kwargs):
+    return gen_lookup_ops.mutable_evicting_hash_table(
+        key_dtype=dtypes.int64,
+        value_dtype=dtypes.float32,
+        value_shape=[2],
+        **kwargs)
+
+  def _insert(self, table, keys, values):
+    self.evaluate(
+        gen_lookup_ops.lookup_table_insert_v2(
+            table, constant_op.constant(keys, dtypes.int64),
+            constant_op.constant(values, dtypes.float32)))
+
+  def _lookup(self, table, keys):
+    return self.evaluate(
+        gen_lookup_ops.lookup_table_find_v2(
+            table, constant_op.constant(keys, dtypes.int64),
+            constant_op.constant([-1.0, -1.0])))
+
+  def _size(self, table):
+    return self.evaluate(gen_lookup_ops.lookup_table_size_v2(table))
+
+  @test_util.run_deprecated_v1
+  def testInsertFindRemove(self):
+    with self.cached_session():
+      table = self._create_table()
+      self._insert(table, [1, 2, 3], [[1, 1], [2, 2], [3, 3]])
+      self.assertAllEqual(3, self._size(table))
+      self.evaluate(
+          gen_lookup_ops.lookup_table_remove_v2(
+              table, constant_op.constant([2], dtypes.int64)))
+      self.assertAllEqual(2, self._size(table))
+      self.assertAllEqual([[1, 1], [-1, -1], [3, 3]],
+                          self._lookup(table, [1, 2, 3]))
+
+  @test_util.run_deprecated_v1
+  def testMinFrequency(self):
+    with self.cached_session():
+      table = self._create_table(min_frequency=3)
+      for step in range(3):
+        self._insert(table, [7, 8], [[step, step], [step, step]])
+        self._insert(table, [7], [[step, step]])
+      # Key 7 was inserted six times and admitted on its third insert, key 8
+      # was inserted three times and admitted on its last insert.
+      self.assertAllEqual(2, self._size(table))
+      self.assertAllEqual([[2, 2], [2, 2], [-1, -1]],
+                          self._lookup(table, [7, 8, 9]))
+
+      table = self._create_table(min_frequency=3)
+      self._insert(table, [7, 8], [[1, 1], [1, 1]])
+      self._insert(table, [7], [[2, 2]])
+      self.assertAllEqual(0, self._size(table))
+      self.assertAllEqual([[-1, -1], [-1, -1]], self._lookup(table, [7, 8]))
+
+  @test_util.run_deprecated_v1
+  def testMaxSizeEvictsLeastFrequentKeys(self):
+    with self.cached_session():
+      table = self._create_table(max_size=4)
+      for _ in range(3):
+        self._insert(table, [1, 2, 3], [[1, 1], [2, 2], [3, 3]])
+      self._insert(table, [4], [[4, 4]])
+      self.assertAllEqual(4, self._size(table))
+      self._insert(table, [5], [[5, 5]])
+      # Keys 4 and 5 were inserted once. Key 4 is older and is evicted.
+      self.assertAllEqual(4, self._size(table))
+      self.assertAllEqual([[1, 1], [2, 2], [3, 3], [-1, -1], [5, 5]],
+                          self._lookup(table, [1, 2, 3, 4, 5]))
+
+  @test_util.run_deprecated_v1
+  def testMaxSizeAdmitsNewKeysIntoFullTable(self):
+    with self.cached_session():
+      table = self._create_table(max_size=4)
+      for _ in range(5):
+        self._insert(table, [1, 2, 3, 4], [[1, 1], [2, 2], [3, 3], [4, 4]])
+      # The table is full of frequent keys, but the key of the current insert
+      # is kept and the least frequent older key is evicted instead.
+      self._insert(table, [5], [[5, 5]])
+      self.assertAllEqual(4, self._size(table))
+      self.assertAllEqual([[5, 5]], self._lookup(table, [5]))
+      # The eviction halved the frequencies of the older keys from 5 to 2, so
+      # key 5, with a frequency of 3 after three more inserts, is no longer the
+      # least frequent key when key 6 overflows the table.
+      for _ in range(3):
+        self._insert(table, [5], [[5, 5]])
+      self._insert(table, [6], [[6, 6]])
+      self.assertAllEqual(4, self._size(table))
+      self.assertAllEqual([[5, 5], [6, 6]], self._lookup(table, [5, 6]))
+
+  @test_util.run_deprecated_v1
+  def testEmptyValues(self):
+    with self.cached_session():
+      table = gen_lookup_ops.mutable_evicting_hash_table(
+          key_dtype=dtypes.int64,
+          value_dtype=dtypes.float32,
+          value_shape=[0],
+          max_size=2)
+      self.evaluate(
+          gen_lookup_ops.lookup_table_insert_v2(
+              table, constant_op.constant([1, 2, 3], dtypes.int64),
+              array_ops.zeros([3, 0])))
+      self.assertAllEqual(2, self._size(table))
+
+  @test_util.run_deprecated_v1
+  def testMaxIdleSteps(self):
+    with self.cached_session():
+      table = self._create_table(max_idle_steps=2)
+      self._insert(table, [1, 2], [[1, 1], [2, 2]])
+      self._insert(table, [1], [[1, 1]])
+      self._insert(table, [1], [[1, 1]])
+      self.assertAllEqual([[1, 1], [2, 2]], self._lookup(table, [1, 2]))
+      self._insert(table, [1], [[1, 1]])
+      # Key 2 has not been inserted during the last two steps.
+      self.assertAllEqual([[1, 1], [-1, -1]], self._lookup(table, [1, 2]))
+      self.assertAllEqual(1, self._size(table))
+
+  @test_util.run_deprecated_v1
+  def testExportImport(self):
+    with self.cached_session():
+      table = self._create_table(max_size=10)
+      self._insert(table, [1, 2, 3], [[1, 1], [2, 2], [3, 3]])
+      keys, values = gen_lookup_ops.lookup_table_export_v2(
+          table, dtypes.int64, dtypes.float32)
+      keys, values = self.evaluate([keys, values])
+      order = np.argsort(keys)
+      self.assertAllEqual([1, 2, 3], keys[order])
+      self.assertAllEqual([[1, 1], [2, 2], [3, 3]], values[order])
+
+      restored = self._create_table(max_size=10)
+      self.evaluate(
+          gen_lookup_ops.lookup_table_import_v2(restored, keys, values))
+      self.assertAllEqual(3, self._size(restored))
+      self.assertAllEqual([[1, 1], [2, 2], [3, 3]],
+                          self._lookup(restored, [1, 2, 3]))
+
+  @test_util.run_deprecated_v1
+  def testSizeExcludesExpiredKeys(self):
+    with self.cached_session():
+      table = self._create_table(max_idle_steps=3)
+      self._insert(table, [1, 2], [[1, 1], [2, 2]])
+      for _ in range(4):
+        self._insert(table, [1], [[1, 1]])
+      # Key 2 has expired but was not swept yet, it is neither counted nor
+      # exported.
+      self.assertAllEqual(1, self._size(table))
+      keys, _ = gen_lookup_ops.lookup_table_export_v2(
+          table, dtypes.int64, dtypes.float32)
+      self.assertAllEqual([1], self.evaluate(keys))
+
+  def testPythonTable(self):
+    table = lookup_ops.MutableEvictingHashTable(
+        dtypes.int64, dtypes.float32, [-1.0, -1.0], max_size=2)
+    self.evaluate(
+        table.insert(
+            constant_op.constant([1, 2, 3], dtypes.int64),
+            constant_op.constant([[1, 1], [2, 2], [3, 3]], dtypes.float32)))
+    self.assertAllEqual(2, self.evaluate(table.size()))
+    self.evaluate(table.remove(constant_op.constant([3], dtypes.int64)))
+    self.assertAllEqual(1, self.evaluate(table.size()))
+    self.assertAllEqual([[-1, -1], [-1, -1]],
+                        self.evaluate(table.lookup(
+                            constant_op.constant([3, 4], dtypes.int64))))
+
+  @test_util.run_v1_only("SaverV1")
+  def testSaveRestore(self):
+    save_dir = os.path.join(self.get_temp_dir(), "save_restore")
+    save_path = os.path.join(tempfile.mkdtemp(prefix=save_dir), "hash")
+
+    with self.session(graph=ops.Graph()) as sess:
+      table = lookup_ops.MutableEvictingHashTable(
+          dtypes.int64, dtypes.float32, [-1.0, -1.0], max_size=10, name="t1")
+      save = saver.Saver()
+      self.evaluate(
+          table.insert(
+              constant_op.constant([1, 2, 3], dtypes.int64),
+              constant_op.constant([[1, 1], [2, 2], [3, 3]], dtypes.float32)))
+      self.assertEqual(save_path, save.save(sess, save_path))
+
+    with self.session(graph=ops.Graph()) as sess:
+      table = lookup_ops.MutableEvictingHashTable(
+          dtypes.int64, dtypes.float32, [-1.0, -1.0], max_size=10, name="t1")
+      self.evaluate(
+          table.insert(
+              constant_op.constant([4], dtypes.int64),
+              constant_op.constant([[4, 4]], dtypes.float32)))
+      save = saver.Saver()
+      save.restore(sess, save_path)
+      self.assertAllEqual(3, self.evaluate(table.size()))
+      self.assertAllEqual(
+          [[1, 1], [2, 2], [3, 3], [-1, -1]],
+          self.evaluate(
+              table.lookup(constant_op.constant([1, 2, 3, 4], dtypes.int64))))
+
+
 class MutableHashTableBenchmark(test.Benchmark):
 
   def _create_table(self):
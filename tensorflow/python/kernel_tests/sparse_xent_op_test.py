@@ -191,6 +191,14 @@ class SparseXentTest(test.TestCase):
   def testEmpty(self):
     self._testXent(np.zeros((0, 3)), np.zeros((0,), dtype=np.int32))
 
+  def testManyClasses(self):
+    # The logits of each row are reduced in several blocks of classes, one of
+    # which only has -inf logits in the second row.
+    np.random.seed(0)
+    features = np.random.randn(3, 40000).astype(np.float32) * 5
+    features[1, :20000] = -np.inf
+    self._testXent(features, np.array([17, 39999, 20000]).astype(np.int64))
+
   @test_util.run_in_graph_and_eager_modes(use_gpu=True)
   def testGradient(self):
     with self.session(use_gpu=True) as sess:
@@ -167,6 +167,18 @@ class TopKTest(test.TestCase):
       values = -np.sort(-inputs, axis=1)[:, :k]
       self._validateTopK(inputs, k, values, indices)
 
+  def testWideRowStableTopK(self):
+    # Few rows wide enough to be split across threads.
+    b = 2
+    n = 300000
+    for k in [10, 1000]:
+      # Lots of repeated integers taking values in [0, 100]
+      inputs = np.random.randint(0, 101, size=(b, n)).astype(np.int32)
+      # Use mergesort, a stable sort, to get the indices.
+      indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices)
+
   def testTopAll(self):
     inputs = [[0.1, 0.3, 0.2, 0.4], [0.1, 0.3, 0.3, 0.2]]
     self._validateTopK(inputs, 4, [[0.4, 0.3, 0.2, 0.1], [0.3, 0.3, 0.2, 0.1]],
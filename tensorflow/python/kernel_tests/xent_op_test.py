@@ -217,6 +217,27 @@ class XentTest(test.TestCase):
         np.array([[1., 1., 1., 1.], [1., 2., 3., 4.]]).astype(np.float64),
         np.array([[0., 0., 0., 1.], [0., .5, .5, 0.]]).astype(np.float64))
 
+  def testManyClasses(self):
+    # The logits of each row are reduced in several blocks of classes, with
+    # different maxima in the second row.
+    np.random.seed(0)
+    features = np.random.randn(3, 40000).astype(np.float32) * 5
+    features[1, :20000] -= 100
+    labels = np.random.rand(3, 40000).astype(np.float32)
+    labels /= np.sum(labels, axis=1, keepdims=True)
+    self._testXent(features, labels, use_gpu=False)
+
+  def testNoClasses(self):
+    for dtype in np.float16, np.float32, np.float64:
+      features = np.zeros([2, 0]).astype(dtype)
+      labels = np.zeros([2, 0]).astype(dtype)
+      with self.cached_session(use_gpu=False):
+        loss, backprop = gen_nn_ops.softmax_cross_entropy_with_logits(
+            features, labels)
+        tf_loss, tf_backprop = self.evaluate([loss, backprop])
+      self.assertAllEqual(np.zeros([2]).astype(dtype), tf_loss)
+      self.assertEqual((2, 0), tf_backprop.shape)
+
   @test_util.run_deprecated_v1
   def testGradient(self):
     with self.cached_session() as sess:
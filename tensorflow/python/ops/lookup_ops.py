@@ -1967,6 +1967,83 @@ class MutableHashTable(LookupInterface):
                                                        restored_tensors[1])
 
 
+class MutableEvictingHashTable(MutableHashTable):
+  """A mutable hash table for embeddings that bounds its own size.
+
+  A key is admitted into the table only once it has been inserted
+  `min_frequency` times, and admitted keys are evicted when they have not been
+  inserted during the last `max_idle_steps` calls to `insert`, or when the
+  table grows beyond `max_size` keys, least frequently inserted keys first.
+  Missing and evicted keys are looked up as `default_value`.
+
+  Example usage:
+
+  ```python
+  table = MutableEvictingHashTable(key_dtype=tf.int64, value_dtype=tf.float32,
+                                   default_value=[0.0] * 16, max_size=1000000,
+                                   min_frequency=2)
+  sess.run(table.insert(ids, embeddings))
+  out = table.lookup(query_ids)
+  ```
+
+  Only the keys and values are checkpointed. Restored keys are admitted as is
+  and restart with fresh insert statistics.
+  """
+
+  def __init__(self,
+               key_dtype,
+               value_dtype,
+               default_value,
+               max_size=0,
+               min_frequency=1,
+               max_idle_steps=0,
+               name="MutableEvictingHashTable",
+               checkpoint=True):
+    """Creates an empty `MutableEvictingHashTable` object.
+
+    Args:
+      key_dtype: the type of the key tensors.
+      value_dtype: the type of the value tensors.
+      default_value: The scalar or vector value to use if a key is missing in
+        the table.
+      max_size: The maximum number of keys in the table, or 0 for no bound.
+      min_frequency: The number of inserts after which a key is admitted.
+      max_idle_steps: The number of `insert` calls after which a key that was
+        not inserted is evicted, or 0 to never evict idle keys.
+      name: A name for the operation (optional).
+      checkpoint: if True, the contents of the table are saved to and restored
+        from checkpoints. If `shared_name` is empty for a checkpointed table, it
+        is shared using the table node name.
+
+    Returns:
+      A `MutableEvictingHashTable` object.
+    """
+    self._max_size = max_size
+    self._min_frequency = min_frequency
+    self._max_idle_steps = max_idle_steps
+    super(MutableEvictingHashTable, self).__init__(
+        key_dtype, value_dtype, default_value, name=name, checkpoint=checkpoint)
+
+  def _create_resource(self):
+    use_node_name_sharing = self._checkpoint and self._shared_name is None
+    table_ref = gen_lookup_ops.mutable_evicting_hash_table(
+        shared_name=self._shared_name,
+        use_node_name_sharing=use_node_name_sharing,
+        key_dtype=self._key_dtype,
+        value_dtype=self._value_dtype,
+        value_shape=self._default_value.get_shape(),
+        max_size=self._max_size,
+        min_frequency=self._min_frequency,
+        max_idle_steps=self._max_idle_steps,
+        name=self._name)
+
+    if context.executing_eagerly():
+      self._table_name = None
+    else:
+      self._table_name = table_ref.op.name.split("/")[-1]
+    return table_ref
+
+
 @tf_export("lookup.experimental.DenseHashTable")
 class DenseHashTable(LookupInterface):
   """A generic mutable hash table implementation using tensors as backing store.
@@ -2286,3 +2363,4 @@ ops.NotDifferentiable("MutableHashTable")
 ops.NotDifferentiable("MutableHashTableV2")
 ops.NotDifferentiable("MutableHashTableOfTensors")
 ops.NotDifferentiable("MutableHashTableOfTensorsV2")
+ops.NotDifferentiable("MutableEvictingHashTable")
@@ -40,9 +40,13 @@ class CheckpointOptions(object):
   """
 
   # Define object attributes in __slots__ for improved memory and performance.
-  __slots__ = ("experimental_io_device",)
+  __slots__ = ("experimental_io_device", "experimental_base_prefix",
+               "experimental_fingerprint_tensors")
 
-  def __init__(self, experimental_io_device=None):
+  def __init__(self,
+               experimental_io_device=None,
+               experimental_base_prefix=None,
+               experimental_fingerprint_tensors=False):
     """Creates an object that stores options for a Checkpoint.
 
     Args:
@@ -55,5 +59,19 @@ class CheckpointOptions(object):
         This is for example useful if you want to save to a local directory,
         such as "/tmp" when running in a distributed setting. In that case pass
         a device for the host where the "/tmp" directory is accessible.
+
+      experimental_base_prefix: string. Applies when saving. If specified, the
+        prefix of a previous checkpoint to write an incremental checkpoint on
+        top of. Variables that did not change since that checkpoint are not
+        written again, and are restored from it instead, so it must be kept
+        as long as the new checkpoint is. Only variables saved with
+        `experimental_fingerprint_tensors` in the previous checkpoint are
+        detected as unchanged.
+
+      experimental_fingerprint_tensors: bool. Applies when saving. Whether to
+        record a fingerprint of every variable saved, so that the checkpoint
+        can serve as the `experimental_base_prefix` of a later one.
     """
     self.experimental_io_device = experimental_io_device
+    self.experimental_base_prefix = experimental_base_prefix
+    self.experimental_fingerprint_tensors = experimental_fingerprint_tensors
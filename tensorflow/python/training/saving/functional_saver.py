@@ -80,7 +80,13 @@ class _SingleDeviceSaver(object):
           tensor_slices.append(spec.slice_spec)
     save_device = options.experimental_io_device or "cpu:0"
     with ops.device(save_device):
-      return io_ops.save_v2(file_prefix, tensor_names, tensor_slices, tensors)
+      return io_ops.save_v2(
+          file_prefix,
+          tensor_names,
+          tensor_slices,
+          tensors,
+          base_prefix=options.experimental_base_prefix or "",
+          fingerprint_tensors=options.experimental_fingerprint_tensors)
 
   def restore(self, file_prefix, options=None):
     """Restore the saveable objects from a checkpoint with `file_prefix`.
@@ -20,6 +20,8 @@ from __future__ import print_function
 
 import os
 
+import numpy as np
+
 from tensorflow.python.eager import context
 from tensorflow.python.eager import remote
 from tensorflow.python.eager import test
@@ -28,6 +30,7 @@ from tensorflow.python.framework import config
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import test_util
+from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import resource_variable_ops
 from tensorflow.python.platform import gfile
 from tensorflow.python.training import server_lib
@@ -100,6 +103,36 @@ class SaverTest(test.TestCase):
         if op.type in ("SaveV2", "RestoreV2"):
           self.assertEqual(LOCALHOST, op.device)
 
+  @test_util.run_in_graph_and_eager_modes
+  def test_incremental_checkpoint(self):
+    v1 = resource_variable_ops.ResourceVariable(array_ops.ones([1000]))
+    v2 = resource_variable_ops.ResourceVariable(array_ops.zeros([1000]))
+    self.evaluate([v1.initializer, v2.initializer])
+    saver = functional_saver.MultiDeviceSaver(
+        saveable_object_util.saveable_objects_for_op(v1, "v1") +
+        saveable_object_util.saveable_objects_for_op(v2, "v2"))
+    base_prefix = os.path.join(self.get_temp_dir(), "base")
+    self.evaluate(saver.save(
+        constant_op.constant(base_prefix),
+        checkpoint_options.CheckpointOptions(
+            experimental_fingerprint_tensors=True)))
+    # Only v2 changed, so only v2 is written in the incremental checkpoint.
+    self.evaluate(v2.assign(array_ops.ones([1000])))
+    prefix = os.path.join(self.get_temp_dir(), "incremental")
+    self.evaluate(saver.save(
+        constant_op.constant(prefix),
+        checkpoint_options.CheckpointOptions(
+            experimental_base_prefix=base_prefix)))
+    data_size = lambda p: sum(
+        gfile.Stat(f).length for f in gfile.Glob(p + ".data-*"))
+    self.assertLess(data_size(prefix), data_size(base_prefix))
+
+    self.evaluate([v1.assign(array_ops.zeros([1000])),
+                   v2.assign(array_ops.zeros([1000]))])
+    self.evaluate(saver.restore(prefix))
+    self.assertAllEqual(np.ones([1000]), self.evaluate(v1))
+    self.assertAllEqual(np.ones([1000]), self.evaluate(v2))
+
   def test_to_proto(self):
     v1 = resource_variable_ops.ResourceVariable(2.)
     saver = functional_saver.MultiDeviceSaver(
@@ -389,6 +389,68 @@ class TrainingOpsTest(TensorFlowTestCase):
       indices = np.array([0, 2]).astype(index_type)
       self._testTypesForSparseFtrlMultiplyLinearByLr(x, y, z, lr, grad, indices)
 
+  @test_util.run_v1_only("Sparse apply ops return a ref, so they are not "
+                         "supported in eager mode.")
+  def testShardedSparseApplyMatchesSerialUpdates(self):
+    # Above 16K updated elements the sparse updates are sharded by row across
+    # threads. Many duplicate indices check that the updates of a row are still
+    # applied in order, like the serial loop below.
+    lr, l1, l2 = 0.1, 0.001, 0.01
+    rng = np.random.RandomState(0)
+    for num_rows, dim, num_updates in [(64, 8, 4096), (256, 1, 20000)]:
+      x = rng.uniform(-1, 1, size=(num_rows, dim))
+      y = rng.uniform(0.1, 1, size=(num_rows, dim))
+      z = rng.uniform(-1, 1, size=(num_rows, dim))
+      grad = rng.uniform(-1, 1, size=(num_updates, dim))
+      indices = rng.randint(num_rows, size=num_updates).astype(np.int32)
+
+      adagrad_var, adagrad_accum = x.copy(), y.copy()
+      proximal_var, proximal_accum = x.copy(), y.copy()
+      ftrl_var, ftrl_accum, ftrl_linear = x.copy(), y.copy(), z.copy()
+      for g, row in zip(grad, indices):
+        adagrad_accum[row] += g * g
+        adagrad_var[row] -= lr * g / np.sqrt(adagrad_accum[row])
+
+        proximal_accum[row] += g * g
+        proximal_lr = lr / np.sqrt(proximal_accum[row])
+        prox = proximal_var[row] - proximal_lr * g
+        proximal_var[row] = (
+            np.sign(prox) * np.maximum(np.abs(prox) - proximal_lr * l1, 0) /
+            (1 + proximal_lr * l2))
+
+        new_accum = ftrl_accum[row] + g * g
+        ftrl_linear[row] += g - (np.sqrt(new_accum) -
+                                 np.sqrt(ftrl_accum[row])) / lr * ftrl_var[row]
+        ftrl_var[row] = (
+            (np.clip(ftrl_linear[row], -l1, l1) - ftrl_linear[row]) /
+            (np.sqrt(new_accum) / lr + 2 * l2))
+        ftrl_accum[row] = new_accum
+
+      with self.session(use_gpu=False):
+        var = variables.VariableV1(x)
+        accum = variables.VariableV1(y)
+        proximal = variables.VariableV1(x)
+        proximal_acc = variables.VariableV1(y)
+        ftrl = variables.VariableV1(x)
+        ftrl_acc = variables.VariableV1(y)
+        linear = variables.VariableV1(z)
+        self.evaluate(variables.global_variables_initializer())
+        self.evaluate([
+            training_ops.sparse_apply_adagrad(var, accum, lr, grad, indices),
+            training_ops.sparse_apply_proximal_adagrad(proximal, proximal_acc,
+                                                       lr, l1, l2, grad,
+                                                       indices),
+            training_ops.sparse_apply_ftrl(ftrl, ftrl_acc, linear, grad,
+                                           indices, lr, l1, l2, -0.5)
+        ])
+        self.assertAllClose(adagrad_var, self.evaluate(var))
+        self.assertAllClose(adagrad_accum, self.evaluate(accum))
+        self.assertAllClose(proximal_var, self.evaluate(proximal))
+        self.assertAllClose(proximal_accum, self.evaluate(proximal_acc))
+        self.assertAllClose(ftrl_var, self.evaluate(ftrl))
+        self.assertAllClose(ftrl_accum, self.evaluate(ftrl_acc))
+        self.assertAllClose(ftrl_linear, self.evaluate(linear))
+
   @test_util.run_v1_only("ApplyAdam op returns a ref, so it is not "
                          "supported in eager mode.")
   def testApplyAdam(self):